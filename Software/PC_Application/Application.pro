@@ -1,6 +1,8 @@
 HEADERS += \
     ../VNA_embedded/Application/Communication/Protocol.hpp \
+    ../VNA_embedded/Application/Drivers/LogRecord.hpp \
     Calibration/calibration.h \
+    Calibration/calibrationbuilder.h \
     Calibration/calibrationtracedialog.h \
     Calibration/calkit.h \
     Calibration/calkitdialog.h \
@@ -14,6 +16,7 @@ HEADERS += \
     Device/devicelog.h \
     Device/firmwareupdatedialog.h \
     Device/manualcontroldialog.h \
+    Device/profilingdialog.h \
     Generator/generator.h \
     Generator/signalgenwidget.h \
     SpectrumAnalyzer/spectrumanalyzer.h \
@@ -32,9 +35,11 @@ HEADERS += \
     Traces/traceplot.h \
     Traces/tracesmithchart.h \
     Traces/tracewidget.h \
+    VNA/processingpipeline.h \
     VNA/vna.h \
     appwindow.h \
     averaging.h \
+    conversion.h \
     mode.h \
     preferences.h \
     qwtplotpiecewisecurve.h \
@@ -43,7 +48,9 @@ HEADERS += \
 
 SOURCES += \
     ../VNA_embedded/Application/Communication/Protocol.cpp \
+    ../VNA_embedded/Application/Drivers/LogRecord.cpp \
     Calibration/calibration.cpp \
+    Calibration/calibrationbuilder.cpp \
     Calibration/calibrationtracedialog.cpp \
     Calibration/calkit.cpp \
     Calibration/calkitdialog.cpp \
@@ -58,6 +65,7 @@ SOURCES += \
     Device/devicelog.cpp \
     Device/firmwareupdatedialog.cpp \
     Device/manualcontroldialog.cpp \
+    Device/profilingdialog.cpp \
     Generator/generator.cpp \
     Generator/signalgenwidget.cpp \
     SpectrumAnalyzer/spectrumanalyzer.cpp \
@@ -76,9 +84,11 @@ SOURCES += \
     Traces/traceplot.cpp \
     Traces/tracesmithchart.cpp \
     Traces/tracewidget.cpp \
+    VNA/processingpipeline.cpp \
     VNA/vna.cpp \
     appwindow.cpp \
     averaging.cpp \
+    conversion.cpp \
     main.cpp \
     mode.cpp \
     preferences.cpp \
@@ -101,6 +111,7 @@ FORMS += \
     Device/devicelog.ui \
     Device/firmwareupdatedialog.ui \
     Device/manualcontroldialog.ui \
+    Device/profilingdialog.ui \
     Generator/signalgenwidget.ui \
     Tools/impedancematchdialog.ui \
     Traces/bodeplotaxisdialog.ui \
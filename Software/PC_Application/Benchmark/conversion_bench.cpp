@@ -0,0 +1,119 @@
+#include "conversion.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+#include <getopt.h>
+
+using namespace std;
+
+// documented in conversion.h
+static constexpr double ErrorBoundDB = 1e-8;
+
+static void Usage(const char *name) {
+    printf("Usage: %s [options]\n"
+           "  -n <samples>  number of samples per conversion (default 1000000)\n"
+           "  -r <n>        repetitions, the fastest one is reported (default 20)\n"
+           "  -h            show this help\n", name);
+}
+
+// Returns the fastest of 'repetitions' runs of f in ns
+template<typename F> static double Fastest(unsigned int repetitions, F f) {
+    double best = numeric_limits<double>::max();
+    for(unsigned int i=0;i<repetitions;i++) {
+        auto start = chrono::steady_clock::now();
+        f();
+        auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        if(ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+// Largest deviation of FastPowerDB from the exact value. Covers every binary exponent of the normal range with
+// mantissas spread across [1,2), the approximation error only depends on the mantissa
+static double MaxPowerError(unsigned int mantissas) {
+    double maxError = 0;
+    for(int e=numeric_limits<double>::min_exponent-1;e<numeric_limits<double>::max_exponent;e++) {
+        for(unsigned int i=0;i<mantissas;i++) {
+            double power = ldexp(1.0 + (double) i / mantissas, e);
+            double exact = 10 * log10l((long double) power);
+            double error = fabs(Conversion::FastPowerDB(power) - exact);
+            if(error > maxError) {
+                maxError = error;
+            }
+        }
+    }
+    return maxError;
+}
+
+int main(int argc, char **argv) {
+    unsigned int samples = 1000000;
+    unsigned int repetitions = 20;
+    int opt;
+    while((opt = getopt(argc, argv, "n:r:h")) != -1) {
+        switch(opt) {
+        case 'n': samples = strtoul(optarg, nullptr, 0); break;
+        case 'r': repetitions = strtoul(optarg, nullptr, 0); break;
+        default:
+            Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if(samples == 0 || repetitions == 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    // typical S parameters: magnitudes from -120dB to +20dB with random phase, plus a few special values that
+    // take the exact fallback
+    mt19937_64 rng(1);
+    uniform_real_distribution<double> magDB(-120, 20), phase(-M_PI, M_PI);
+    vector<complex<double>> S(samples);
+    for(auto &s : S) {
+        s = polar(pow(10, magDB(rng) / 20), phase(rng));
+    }
+    S[0] = 0;
+    S[samples / 2] = numeric_limits<double>::denorm_min();
+
+    vector<double> scalar(samples), batch(samples);
+    double scalarNs = Fastest(repetitions, [&]() {
+        for(unsigned int i=0;i<samples;i++) {
+            scalar[i] = 20*log10(abs(S[i]));
+        }
+    });
+    double batchNs = Fastest(repetitions, [&]() {
+        Conversion::MagnitudeDB(S.data(), batch.data(), samples);
+    });
+
+    double maxError = 0;
+    unsigned int mismatches = 0;
+    for(unsigned int i=0;i<samples;i++) {
+        if(std::isinf(scalar[i]) || std::isinf(batch[i])) {
+            // only zero gives -inf
+            mismatches += scalar[i] != batch[i];
+            continue;
+        }
+        double error = fabs(scalar[i] - batch[i]);
+        if(error > maxError) {
+            maxError = error;
+        }
+    }
+    double powerError = MaxPowerError(4096);
+
+    printf("Magnitude in dB, %u samples (fastest of %u runs):\n", samples, repetitions);
+    printf("  20*log10(abs(S))         %8.2fns per sample\n", scalarNs / samples);
+    printf("  Conversion::MagnitudeDB  %8.2fns per sample (%.2fx faster)\n", batchNs / samples, scalarNs / batchNs);
+    printf("Max. deviation from the scalar conversion: %.2edB\n", maxError);
+    printf("Max. error of FastPowerDB over the normal range: %.2edB (bound %.0edB)\n", powerError, ErrorBoundDB);
+    // the scalar conversion itself rounds abs() and log10(), allow for that on top of the bound
+    if(powerError > ErrorBoundDB || maxError > 2 * ErrorBoundDB || mismatches > 0) {
+        fprintf(stderr, "Error bound exceeded\n");
+        return 1;
+    }
+    return 0;
+}
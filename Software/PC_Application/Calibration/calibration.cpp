@@ -3,6 +3,11 @@
 #include <QMessageBox>
 #include <QFileDialog>
 #include <fstream>
+#include <cmath>
+#include <thread>
+#include <exception>
+#include <cstring>
+#include <QFile>
 
 using namespace std;
 
@@ -23,7 +28,7 @@ Calibration::Calibration()
 
 void Calibration::clearMeasurements()
 {
-    for(auto m : measurements) {
+    for(auto &m : measurements) {
         m.second.datapoints.clear();
     }
 }
@@ -53,8 +58,7 @@ bool Calibration::constructErrorTerms(Calibration::Type type)
     bool isTRL = type == Type::TRL;
     if(minFreq < kit.minFreq(isTRL) || maxFreq > kit.maxFreq(isTRL)) {
         // Calkit does not support complete calibration range
-        QMessageBox::critical(nullptr, "Unable to perform calibration", "The calibration kit does not support the complete span. Please choose a different calibration kit or a narrower span.");
-        return false;
+        throw runtime_error("The calibration kit does not support the complete span. Please choose a different calibration kit or a narrower span.");
     }
     switch(type) {
     case Type::Port1SOL: constructPort1SOL(); break;
@@ -65,6 +69,7 @@ bool Calibration::constructErrorTerms(Calibration::Type type)
     case Type::None: break;
     }
     this->type = type;
+    sweepPoints.clear();
     return true;
 }
 
@@ -72,6 +77,64 @@ void Calibration::resetErrorTerms()
 {
     type = Type::None;
     points.clear();
+    sweepPoints.clear();
+}
+
+void Calibration::setErrorTerms(const Calibration &from)
+{
+    type = from.type;
+    points = from.points;
+    sweepPoints = from.sweepPoints;
+}
+
+void Calibration::constructPoints(unsigned int nPoints, std::function<void (unsigned int, Calibration::Point &)> construct)
+{
+    points.resize(nPoints);
+    // every point only depends on the measurements at its own frequency, split the points evenly across all cores
+    unsigned int threads = max(thread::hardware_concurrency(), 1U);
+    // small calibrations are not worth the thread overhead
+    constexpr unsigned int minPointsPerThread = 256;
+    threads = min(threads, max(nPoints / minPointsPerThread, 1U));
+    vector<thread> workers;
+    vector<exception_ptr> exceptions(threads);
+    for(unsigned int t=0;t<threads;t++) {
+        unsigned int start = (uint64_t) nPoints * t / threads;
+        unsigned int stop = (uint64_t) nPoints * (t + 1) / threads;
+        auto work = [=, &construct, &exceptions]() {
+            try {
+                for(unsigned int i=start;i<stop;i++) {
+                    construct(i, points[i]);
+                }
+            } catch (...) {
+                exceptions[t] = current_exception();
+            }
+        };
+        if(t < threads - 1) {
+            workers.emplace_back(work);
+        } else {
+            // last chunk is handled by the calling thread
+            work();
+        }
+    }
+    for(auto &w : workers) {
+        w.join();
+    }
+    for(auto &e : exceptions) {
+        if(e) {
+            points.clear();
+            rethrow_exception(e);
+        }
+    }
+}
+
+std::vector<double> Calibration::frequencyGrid(const std::vector<Protocol::Datapoint> &datapoints)
+{
+    vector<double> ret;
+    ret.reserve(datapoints.size());
+    for(const auto &d : datapoints) {
+        ret.push_back(d.frequency);
+    }
+    return ret;
 }
 
 void Calibration::construct12TermPoints()
@@ -80,29 +143,37 @@ void Calibration::construct12TermPoints()
     requiredMeasurements.push_back(Measurement::Isolation);
     bool isolation_measured = SanityCheckSamples(requiredMeasurements);
 
-    points.clear();
-    for(unsigned int i = 0;i<measurements[Measurement::Port1Open].datapoints.size();i++) {
-        Point p;
-        p.frequency = measurements[Measurement::Port1Open].datapoints[i].frequency;
+    const auto &port1Open = measurements[Measurement::Port1Open].datapoints;
+    const auto &port1Short = measurements[Measurement::Port1Short].datapoints;
+    const auto &port1Load = measurements[Measurement::Port1Load].datapoints;
+    const auto &port2Open = measurements[Measurement::Port2Open].datapoints;
+    const auto &port2Short = measurements[Measurement::Port2Short].datapoints;
+    const auto &port2Load = measurements[Measurement::Port2Load].datapoints;
+    const auto &isolation = measurements[Measurement::Isolation].datapoints;
+    const auto &through = measurements[Measurement::Through].datapoints;
+    // standards are evaluated for all frequencies beforehand, the kit is not accessed by the worker threads
+    auto standards = kit.toSOLT(frequencyGrid(port1Open));
+    constructPoints(port1Open.size(), [&](unsigned int i, Point &p) {
+        p.frequency = port1Open[i].frequency;
         // extract required complex reflection/transmission factors from datapoints
-        auto S11_open = complex<double>(measurements[Measurement::Port1Open].datapoints[i].real_S11, measurements[Measurement::Port1Open].datapoints[i].imag_S11);
-        auto S11_short = complex<double>(measurements[Measurement::Port1Short].datapoints[i].real_S11, measurements[Measurement::Port1Short].datapoints[i].imag_S11);
-        auto S11_load = complex<double>(measurements[Measurement::Port1Load].datapoints[i].real_S11, measurements[Measurement::Port1Load].datapoints[i].imag_S11);
-        auto S22_open = complex<double>(measurements[Measurement::Port2Open].datapoints[i].real_S22, measurements[Measurement::Port2Open].datapoints[i].imag_S22);
-        auto S22_short = complex<double>(measurements[Measurement::Port2Short].datapoints[i].real_S22, measurements[Measurement::Port2Short].datapoints[i].imag_S22);
-        auto S22_load = complex<double>(measurements[Measurement::Port2Load].datapoints[i].real_S22, measurements[Measurement::Port2Load].datapoints[i].imag_S22);
+        auto S11_open = complex<double>(port1Open[i].real_S11, port1Open[i].imag_S11);
+        auto S11_short = complex<double>(port1Short[i].real_S11, port1Short[i].imag_S11);
+        auto S11_load = complex<double>(port1Load[i].real_S11, port1Load[i].imag_S11);
+        auto S22_open = complex<double>(port2Open[i].real_S22, port2Open[i].imag_S22);
+        auto S22_short = complex<double>(port2Short[i].real_S22, port2Short[i].imag_S22);
+        auto S22_load = complex<double>(port2Load[i].real_S22, port2Load[i].imag_S22);
         auto S21_isolation = complex<double>(0,0);
         auto S12_isolation = complex<double>(0,0);
         if(isolation_measured) {
-            S21_isolation = complex<double>(measurements[Measurement::Isolation].datapoints[i].real_S21, measurements[Measurement::Isolation].datapoints[i].imag_S21);
-            S12_isolation = complex<double>(measurements[Measurement::Isolation].datapoints[i].real_S12, measurements[Measurement::Isolation].datapoints[i].imag_S12);
+            S21_isolation = complex<double>(isolation[i].real_S21, isolation[i].imag_S21);
+            S12_isolation = complex<double>(isolation[i].real_S12, isolation[i].imag_S12);
         }
-        auto S11_through = complex<double>(measurements[Measurement::Through].datapoints[i].real_S11, measurements[Measurement::Through].datapoints[i].imag_S11);
-        auto S21_through = complex<double>(measurements[Measurement::Through].datapoints[i].real_S21, measurements[Measurement::Through].datapoints[i].imag_S21);
-        auto S22_through = complex<double>(measurements[Measurement::Through].datapoints[i].real_S22, measurements[Measurement::Through].datapoints[i].imag_S22);
-        auto S12_through = complex<double>(measurements[Measurement::Through].datapoints[i].real_S12, measurements[Measurement::Through].datapoints[i].imag_S12);
+        auto S11_through = complex<double>(through[i].real_S11, through[i].imag_S11);
+        auto S21_through = complex<double>(through[i].real_S21, through[i].imag_S21);
+        auto S22_through = complex<double>(through[i].real_S22, through[i].imag_S22);
+        auto S12_through = complex<double>(through[i].real_S12, through[i].imag_S12);
 
-        auto actual = kit.toSOLT(p.frequency);
+        const auto &actual = (*standards)[i];
         // Forward calibration
         computeSOL(S11_short, S11_open, S11_load, p.fe00, p.fe11, p.fe10e01, actual.Open, actual.Short, actual.Load);
         p.fe30 = S21_isolation;
@@ -118,22 +189,23 @@ void Calibration::construct12TermPoints()
         p.re11 = ((S22_through - p.re33)*(1.0 - p.re22 * actual.ThroughS22)-actual.ThroughS22*p.re23e32)
                 / ((S22_through - p.re33)*(actual.ThroughS11-p.re22*deltaS)-deltaS*p.re23e32);
         p.re23e01 = (S12_through - p.re03)*(1.0 - p.re11*actual.ThroughS11 - p.re22*actual.ThroughS22 + p.re11*p.re22*deltaS) / actual.ThroughS12;
-        points.push_back(p);
-    }
+    });
 }
 
 void Calibration::constructPort1SOL()
 {
-    points.clear();
-    for(unsigned int i = 0;i<measurements[Measurement::Port1Open].datapoints.size();i++) {
-        Point p;
-        p.frequency = measurements[Measurement::Port1Open].datapoints[i].frequency;
+    const auto &port1Open = measurements[Measurement::Port1Open].datapoints;
+    const auto &port1Short = measurements[Measurement::Port1Short].datapoints;
+    const auto &port1Load = measurements[Measurement::Port1Load].datapoints;
+    auto standards = kit.toSOLT(frequencyGrid(port1Open));
+    constructPoints(port1Open.size(), [&](unsigned int i, Point &p) {
+        p.frequency = port1Open[i].frequency;
         // extract required complex reflection/transmission factors from datapoints
-        auto S11_open = complex<double>(measurements[Measurement::Port1Open].datapoints[i].real_S11, measurements[Measurement::Port1Open].datapoints[i].imag_S11);
-        auto S11_short = complex<double>(measurements[Measurement::Port1Short].datapoints[i].real_S11, measurements[Measurement::Port1Short].datapoints[i].imag_S11);
-        auto S11_load = complex<double>(measurements[Measurement::Port1Load].datapoints[i].real_S11, measurements[Measurement::Port1Load].datapoints[i].imag_S11);
+        auto S11_open = complex<double>(port1Open[i].real_S11, port1Open[i].imag_S11);
+        auto S11_short = complex<double>(port1Short[i].real_S11, port1Short[i].imag_S11);
+        auto S11_load = complex<double>(port1Load[i].real_S11, port1Load[i].imag_S11);
         // OSL port1
-        auto actual = kit.toSOLT(p.frequency);
+        const auto &actual = (*standards)[i];
         // See page 13 of https://www.rfmentor.com/sites/default/files/NA_Error_Models_and_Cal_Methods.pdf
         computeSOL(S11_short, S11_open, S11_load, p.fe00, p.fe11, p.fe10e01, actual.Open, actual.Short, actual.Load);
         // All other calibration coefficients to ideal values
@@ -146,22 +218,23 @@ void Calibration::constructPort1SOL()
         p.re03 = 0.0;
         p.re11 = 0.0;
         p.re23e01 = 1.0;
-        points.push_back(p);
-    }
+    });
 }
 
 void Calibration::constructPort2SOL()
 {
-    points.clear();
-    for(unsigned int i = 0;i<measurements[Measurement::Port2Open].datapoints.size();i++) {
-        Point p;
-        p.frequency = measurements[Measurement::Port2Open].datapoints[i].frequency;
+    const auto &port2Open = measurements[Measurement::Port2Open].datapoints;
+    const auto &port2Short = measurements[Measurement::Port2Short].datapoints;
+    const auto &port2Load = measurements[Measurement::Port2Load].datapoints;
+    auto standards = kit.toSOLT(frequencyGrid(port2Open));
+    constructPoints(port2Open.size(), [&](unsigned int i, Point &p) {
+        p.frequency = port2Open[i].frequency;
         // extract required complex reflection/transmission factors from datapoints
-        auto S22_open = complex<double>(measurements[Measurement::Port2Open].datapoints[i].real_S22, measurements[Measurement::Port2Open].datapoints[i].imag_S22);
-        auto S22_short = complex<double>(measurements[Measurement::Port2Short].datapoints[i].real_S22, measurements[Measurement::Port2Short].datapoints[i].imag_S22);
-        auto S22_load = complex<double>(measurements[Measurement::Port2Load].datapoints[i].real_S22, measurements[Measurement::Port2Load].datapoints[i].imag_S22);
+        auto S22_open = complex<double>(port2Open[i].real_S22, port2Open[i].imag_S22);
+        auto S22_short = complex<double>(port2Short[i].real_S22, port2Short[i].imag_S22);
+        auto S22_load = complex<double>(port2Load[i].real_S22, port2Load[i].imag_S22);
         // OSL port2
-        auto actual = kit.toSOLT(p.frequency);
+        const auto &actual = (*standards)[i];
         // See page 19 of https://www.rfmentor.com/sites/default/files/NA_Error_Models_and_Cal_Methods.pdf
         computeSOL(S22_short, S22_open, S22_load, p.re33, p.re22, p.re23e32, actual.Open, actual.Short, actual.Load);
         // All other calibration coefficients to ideal values
@@ -174,20 +247,19 @@ void Calibration::constructPort2SOL()
         p.re03 = 0.0;
         p.re11 = 0.0;
         p.re23e01 = 1.0;
-        points.push_back(p);
-    }
+    });
 }
 
 void Calibration::constructTransmissionNormalization()
 {
-    points.clear();
-    for(unsigned int i = 0;i<measurements[Measurement::Through].datapoints.size();i++) {
-        Point p;
-        p.frequency = measurements[Measurement::Through].datapoints[i].frequency;
+    const auto &through = measurements[Measurement::Through].datapoints;
+    auto standards = kit.toSOLT(frequencyGrid(through));
+    constructPoints(through.size(), [&](unsigned int i, Point &p) {
+        p.frequency = through[i].frequency;
         // extract required complex reflection/transmission factors from datapoints
-        auto S21_through = complex<double>(measurements[Measurement::Through].datapoints[i].real_S21, measurements[Measurement::Through].datapoints[i].imag_S21);
-        auto S12_through = complex<double>(measurements[Measurement::Through].datapoints[i].real_S12, measurements[Measurement::Through].datapoints[i].imag_S12);
-        auto actual = kit.toSOLT(p.frequency);
+        auto S21_through = complex<double>(through[i].real_S21, through[i].imag_S21);
+        auto S12_through = complex<double>(through[i].real_S12, through[i].imag_S12);
+        const auto &actual = (*standards)[i];
         p.fe10e32 = S21_through / actual.ThroughS21;
         p.re23e01 = S12_through / actual.ThroughS12;
         // All other calibration coefficients to ideal values
@@ -201,8 +273,7 @@ void Calibration::constructTransmissionNormalization()
         p.re33 = 0.0;
         p.re22 = 0.0;
         p.re23e32 = 1.0;
-        points.push_back(p);
-    }
+    });
 }
 
 template<typename T>
@@ -260,30 +331,34 @@ template<typename T> void solveQuadratic(T a, T b, T c, T &result1, T &result2)
 
 void Calibration::constructTRL()
 {
-    points.clear();
-    for(unsigned int i = 0;i<measurements[Measurement::Through].datapoints.size();i++) {
-        Point p;
-        p.frequency = measurements[Measurement::Through].datapoints[i].frequency;
+    const auto &through = measurements[Measurement::Through].datapoints;
+    const auto &line = measurements[Measurement::Line].datapoints;
+    const auto &port1Short = measurements[Measurement::Port1Short].datapoints;
+    const auto &port2Short = measurements[Measurement::Port2Short].datapoints;
+    const auto &port1Open = measurements[Measurement::Port1Open].datapoints;
+    const auto &port2Open = measurements[Measurement::Port2Open].datapoints;
+    constructPoints(through.size(), [&](unsigned int i, Point &p) {
+        p.frequency = through[i].frequency;
 
         // grab raw measurements
-        auto S11_through = complex<double>(measurements[Measurement::Through].datapoints[i].real_S11, measurements[Measurement::Through].datapoints[i].imag_S11);
-        auto S21_through = complex<double>(measurements[Measurement::Through].datapoints[i].real_S21, measurements[Measurement::Through].datapoints[i].imag_S21);
-        auto S22_through = complex<double>(measurements[Measurement::Through].datapoints[i].real_S22, measurements[Measurement::Through].datapoints[i].imag_S22);
-        auto S12_through = complex<double>(measurements[Measurement::Through].datapoints[i].real_S12, measurements[Measurement::Through].datapoints[i].imag_S12);
-        auto S11_line = complex<double>(measurements[Measurement::Line].datapoints[i].real_S11, measurements[Measurement::Line].datapoints[i].imag_S11);
-        auto S21_line = complex<double>(measurements[Measurement::Line].datapoints[i].real_S21, measurements[Measurement::Line].datapoints[i].imag_S21);
-        auto S22_line = complex<double>(measurements[Measurement::Line].datapoints[i].real_S22, measurements[Measurement::Line].datapoints[i].imag_S22);
-        auto S12_line = complex<double>(measurements[Measurement::Line].datapoints[i].real_S12, measurements[Measurement::Line].datapoints[i].imag_S12);
+        auto S11_through = complex<double>(through[i].real_S11, through[i].imag_S11);
+        auto S21_through = complex<double>(through[i].real_S21, through[i].imag_S21);
+        auto S22_through = complex<double>(through[i].real_S22, through[i].imag_S22);
+        auto S12_through = complex<double>(through[i].real_S12, through[i].imag_S12);
+        auto S11_line = complex<double>(line[i].real_S11, line[i].imag_S11);
+        auto S21_line = complex<double>(line[i].real_S21, line[i].imag_S21);
+        auto S22_line = complex<double>(line[i].real_S22, line[i].imag_S22);
+        auto S12_line = complex<double>(line[i].real_S12, line[i].imag_S12);
         auto trl = kit.toTRL(p.frequency);
         complex<double> S11_reflection, S22_reflection;
         if(trl.reflectionIsNegative) {
             // used short
-            S11_reflection = complex<double>(measurements[Measurement::Port1Short].datapoints[i].real_S11, measurements[Measurement::Port1Short].datapoints[i].imag_S11);
-            S22_reflection = complex<double>(measurements[Measurement::Port2Short].datapoints[i].real_S22, measurements[Measurement::Port2Short].datapoints[i].imag_S22);
+            S11_reflection = complex<double>(port1Short[i].real_S11, port1Short[i].imag_S11);
+            S22_reflection = complex<double>(port2Short[i].real_S22, port2Short[i].imag_S22);
         } else {
             // used open
-            S11_reflection = complex<double>(measurements[Measurement::Port1Open].datapoints[i].real_S11, measurements[Measurement::Port1Open].datapoints[i].imag_S11);
-            S22_reflection = complex<double>(measurements[Measurement::Port2Open].datapoints[i].real_S22, measurements[Measurement::Port2Open].datapoints[i].imag_S22);
+            S11_reflection = complex<double>(port1Open[i].real_S11, port1Open[i].imag_S11);
+            S22_reflection = complex<double>(port2Open[i].real_S22, port2Open[i].imag_S22);
         }
         // calculate TRL calibration
         // variable names and formulas according to http://emlab.uiuc.edu/ece451/notes/new_TRL.pdf
@@ -354,8 +429,7 @@ void Calibration::constructTRL()
         // no isolation measurement available
         p.re03 = 0.0;
 
-        points.push_back(p);
-    }
+    });
 }
 
 void Calibration::correctMeasurement(Protocol::Datapoint &d)
@@ -395,30 +469,69 @@ void Calibration::correctMeasurement(Protocol::Datapoint &d)
     d.imag_S22 = S22.imag();
 }
 
+void Calibration::setSweepFrequencies(const std::vector<uint64_t> &frequencies)
+{
+    sweepPoints.clear();
+    if(!points.size()) {
+        return;
+    }
+    sweepPoints.reserve(frequencies.size());
+    // the sweep frequencies are usually sorted, walk through both lists in parallel (restart if they are not)
+    auto high = points.cbegin();
+    uint64_t last = 0;
+    for(auto f : frequencies) {
+        if(f < last) {
+            high = points.cbegin();
+        }
+        last = f;
+        while(high != points.cend() && high->frequency < f) {
+            high++;
+        }
+        auto p = interpolatePoint(high, f);
+        // outside of the calibration the first/last point is used, keep the sweep frequency for the lookup
+        p.frequency = f;
+        sweepPoints.push_back(p);
+    }
+}
+
 Calibration::InterpolationType Calibration::getInterpolation(Protocol::SweepSettings settings)
+{
+    vector<uint64_t> frequencies;
+    for(unsigned int i=0;i<settings.points;i++) {
+        if(settings.points <= 1) {
+            frequencies.push_back(settings.f_start);
+        } else if(settings.logSweep && settings.f_start > 0) {
+            frequencies.push_back(settings.f_start * pow((double) settings.f_stop / settings.f_start, (double) i / (settings.points - 1)));
+        } else {
+            frequencies.push_back(settings.f_start + (settings.f_stop - settings.f_start) * i / (settings.points - 1));
+        }
+    }
+    return getInterpolation(frequencies);
+}
+
+Calibration::InterpolationType Calibration::getInterpolation(const std::vector<uint64_t> &frequencies)
 {
     if(!points.size()) {
         return InterpolationType::NoCalibration;
     }
-    if(settings.f_start < points.front().frequency || settings.f_stop > points.back().frequency) {
-        return InterpolationType::Extrapolate;
+    if(!frequencies.size()) {
+        return InterpolationType::Unchanged;
     }
-    // Either exact or interpolation, check individual frequencies
-    uint32_t f_step;
-    if(settings.points > 1) {
-        f_step = (settings.f_stop - settings.f_start) / (settings.points - 1);
-    } else {
-        f_step = settings.f_stop - settings.f_start;
+    if(frequencies.front() < points.front().frequency || frequencies.back() > points.back().frequency) {
+        return InterpolationType::Extrapolate;
     }
-    for(uint64_t f = settings.f_start; f <= settings.f_stop; f += f_step) {
-        if(find_if(points.begin(), points.end(), [&f](const Point& p){
-            return abs(f - p.frequency) < 100;
-        }) == points.end()) {
+    // Either exact or interpolation, check individual frequencies. Both lists are sorted, walk through them in parallel
+    auto p = points.begin();
+    for(auto f : frequencies) {
+        while(p != points.end() && p->frequency + 100 <= f) {
+            p++;
+        }
+        if(p == points.end() || abs((double) f - p->frequency) >= 100) {
             return InterpolationType::Interpolate;
         }
     }
     // if we get here all frequency points were matched
-    if(points.front().frequency == settings.f_start && points.back().frequency == settings.f_stop) {
+    if(points.size() == frequencies.size()) {
         return InterpolationType::Unchanged;
     } else {
         return InterpolationType::Exact;
@@ -592,6 +705,63 @@ std::vector<Trace *> Calibration::getErrorTermTraces()
     return traces;
 }
 
+// Binary calibration file: header, followed by one block per measurement and the optional error terms.
+// All values are stored in the byte order of the host (checked with the byteOrder field) and all data is
+// stored as arrays (one array per value, not one struct per point). Every array starts at a multiple of
+// 8 bytes to keep the data aligned in the mapped file. The error terms are stored as the arrays frequency
+// followed by real and imag of every error term (all double).
+static constexpr char binaryMagic[8] = {'V', 'N', 'A', 'C', 'A', 'L', 'B', '\0'};
+static constexpr uint16_t binaryVersion = 1;
+static constexpr uint32_t binaryByteOrder = 0x01020304;
+
+using BinaryHeader = struct {
+    char magic[8];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t byteOrder;
+    // calibration type, Type::None if the file only contains measurements
+    uint32_t type;
+    // number of measurement blocks
+    uint32_t measurements;
+    // 0 if the error terms are not included
+    uint32_t errorTermPoints;
+    uint32_t reserved;
+    uint64_t payloadSize;
+    uint32_t payloadCRC;
+    // calculated with this field set to 0
+    uint32_t headerCRC;
+};
+
+// Followed by the arrays frequency (uint64_t), pointNum (uint32_t) and real/imag of S11, S21, S12 and S22 (float)
+using BinaryMeasurementHeader = struct {
+    uint32_t measurement;
+    uint32_t points;
+    int64_t timestamp;
+};
+
+static uint32_t binaryCRC(const uchar *data, uint64_t size)
+{
+    uint32_t crc = 0;
+    while(size > 0) {
+        // Protocol::CRC32 is limited to 32 bit lengths
+        uint32_t chunk = min(size, (uint64_t) 1 << 30);
+        crc = Protocol::CRC32(crc, data, chunk);
+        data += chunk;
+        size -= chunk;
+    }
+    return crc;
+}
+
+static bool isBinaryCalibration(const uchar *data, qint64 size)
+{
+    return size >= (qint64) sizeof(binaryMagic) && memcmp(data, binaryMagic, sizeof(binaryMagic)) == 0;
+}
+
+const std::array<std::complex<double> Calibration::Point::*, 12> Calibration::errorTerms = {
+    &Point::fe00, &Point::fe11, &Point::fe10e01, &Point::fe10e32, &Point::fe22, &Point::fe30,
+    &Point::re33, &Point::re11, &Point::re23e32, &Point::re23e01, &Point::re22, &Point::re03,
+};
+
 bool Calibration::openFromFile(QString filename)
 {
     if(filename.isEmpty()) {
@@ -602,6 +772,22 @@ bool Calibration::openFromFile(QString filename)
         }
     }
 
+    try {
+        auto warning = loadFromFile(filename);
+        if(!warning.isEmpty()) {
+            QMessageBox::warning(nullptr, "Missing calibration kit", warning);
+        }
+    } catch(runtime_error e) {
+        QMessageBox::warning(nullptr, "File parsing error", e.what());
+        return false;
+    }
+
+    return true;
+}
+
+QString Calibration::loadFromFile(QString filename)
+{
+    QString warning;
     // attempt to load associated calibration kit first (needs to be available when performing calibration)
     auto calkit_file = filename;
     auto dotPos = calkit_file.lastIndexOf('.');
@@ -612,29 +798,47 @@ bool Calibration::openFromFile(QString filename)
     try {
         kit = Calkit::fromFile(calkit_file.toStdString());
     } catch (runtime_error e) {
-        QMessageBox::warning(nullptr, "Missing calibration kit", "The calibration kit file associated with the selected calibration could not be parsed. The calibration might not be accurate. (" + QString(e.what()) + ")");
+        warning = "The calibration kit file associated with the selected calibration could not be parsed. The calibration might not be accurate. (" + QString(e.what()) + ")";
     }
 
-    ifstream file;
-    file.open(filename.toStdString());
-    try {
-        file >> *this;
-    } catch(runtime_error e) {
-        QMessageBox::warning(nullptr, "File parsing error", e.what());
-        return false;
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly)) {
+        throw runtime_error("Unable to open file \"" + filename.toStdString() + "\"");
+    }
+    auto size = file.size();
+    auto data = file.map(0, size);
+    QByteArray buffer;
+    if(!data) {
+        // mapping is not supported by every file system, fall back to reading the whole file
+        buffer = file.readAll();
+        data = (uchar*) buffer.data();
+        size = buffer.size();
+    }
+    if(isBinaryCalibration(data, size)) {
+        readBinary(data, size);
+    } else {
+        // text format
+        file.close();
+        ifstream text;
+        text.open(filename.toStdString());
+        text >> *this;
     }
 
-    return true;
+    return warning;
 }
 
-bool Calibration::saveToFile(QString filename)
+bool Calibration::saveToFile(QString filename, bool binary)
 {
     if(filename.isEmpty()) {
-        filename = QFileDialog::getSaveFileName(nullptr, "Save calibration data", "", "Calibration files (*.cal)", nullptr, QFileDialog::DontUseNativeDialog);
+        const QString binaryFilter = "Calibration files (*.cal)";
+        const QString textFilter = "Calibration files, text format (*.cal)";
+        QString selectedFilter = binaryFilter;
+        filename = QFileDialog::getSaveFileName(nullptr, "Save calibration data", "", binaryFilter + ";;" + textFilter, &selectedFilter, QFileDialog::DontUseNativeDialog);
         if(filename.isEmpty()) {
             // aborted selection
             return false;
         }
+        binary = selectedFilter != textFilter;
     }
     // strip any potential file name extension and set default
     auto dotPos = filename.lastIndexOf('.');
@@ -644,8 +848,13 @@ bool Calibration::saveToFile(QString filename)
     auto calibration_file = filename;
     calibration_file.append(".cal");
     ofstream file;
-    file.open(calibration_file.toStdString());
-    file << *this;
+    if(binary) {
+        file.open(calibration_file.toStdString(), ios::binary);
+        writeBinary(file);
+    } else {
+        file.open(calibration_file.toStdString());
+        file << *this;
+    }
 
     auto calkit_file = filename;
     calkit_file.append(".calkit");
@@ -654,6 +863,175 @@ bool Calibration::saveToFile(QString filename)
     return true;
 }
 
+void Calibration::writeBinary(std::ostream &out) const
+{
+    vector<uchar> payload;
+    auto append = [&](const void *data, size_t size) {
+        auto u8 = (const uchar*) data;
+        payload.insert(payload.end(), u8, u8 + size);
+        // pad to the next array
+        payload.resize((payload.size() + 7) & ~7ULL, 0);
+    };
+    auto appendArray = [&](unsigned int n, auto get) {
+        using T = decltype(get(0));
+        vector<T> values(n);
+        for(unsigned int i=0;i<n;i++) {
+            values[i] = get(i);
+        }
+        append(values.data(), n * sizeof(T));
+    };
+
+    BinaryHeader header = {};
+    memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+    header.version = binaryVersion;
+    header.headerSize = sizeof(BinaryHeader);
+    header.byteOrder = binaryByteOrder;
+    header.type = (uint32_t) type;
+
+    for(const auto &m : measurements) {
+        const auto &d = m.second.datapoints;
+        if(d.size() == 0) {
+            continue;
+        }
+        BinaryMeasurementHeader mh = {};
+        mh.measurement = (uint32_t) m.first;
+        mh.points = d.size();
+        mh.timestamp = m.second.timestamp.toSecsSinceEpoch();
+        append(&mh, sizeof(mh));
+        appendArray(d.size(), [&](unsigned int i) { return d[i].frequency; });
+        appendArray(d.size(), [&](unsigned int i) { return d[i].pointNum; });
+        for(auto value : {&Protocol::Datapoint::real_S11, &Protocol::Datapoint::imag_S11,
+                            &Protocol::Datapoint::real_S21, &Protocol::Datapoint::imag_S21,
+                            &Protocol::Datapoint::real_S12, &Protocol::Datapoint::imag_S12,
+                            &Protocol::Datapoint::real_S22, &Protocol::Datapoint::imag_S22}) {
+            appendArray(d.size(), [&](unsigned int i) { return d[i].*value; });
+        }
+        header.measurements++;
+    }
+
+    if(type != Type::None) {
+        header.errorTermPoints = points.size();
+        appendArray(points.size(), [&](unsigned int i) { return points[i].frequency; });
+        for(auto term : errorTerms) {
+            appendArray(points.size(), [&](unsigned int i) { return (points[i].*term).real(); });
+            appendArray(points.size(), [&](unsigned int i) { return (points[i].*term).imag(); });
+        }
+    }
+
+    header.payloadSize = payload.size();
+    header.payloadCRC = binaryCRC(payload.data(), payload.size());
+    header.headerCRC = binaryCRC((const uchar*) &header, sizeof(header));
+    out.write((const char*) &header, sizeof(header));
+    out.write((const char*) payload.data(), payload.size());
+}
+
+void Calibration::readBinary(const uchar *data, qint64 size)
+{
+    BinaryHeader header;
+    if(size < (qint64) sizeof(header)) {
+        throw runtime_error("Calibration file is truncated");
+    }
+    memcpy(&header, data, sizeof(header));
+    if(header.byteOrder != binaryByteOrder) {
+        throw runtime_error("Calibration file has been created on a machine with a different byte order");
+    }
+    if(header.version > binaryVersion) {
+        throw runtime_error("Calibration file has been created by a newer version of this application");
+    }
+    auto headerCRC = header.headerCRC;
+    header.headerCRC = 0;
+    if(headerCRC != binaryCRC((const uchar*) &header, sizeof(header))) {
+        throw runtime_error("Calibration file header is corrupted");
+    }
+    if(header.type > (uint32_t) Type::None) {
+        throw runtime_error("Calibration file contains an unknown calibration type");
+    }
+    if(header.headerSize < sizeof(header) || (uint64_t) size - header.headerSize < header.payloadSize) {
+        throw runtime_error("Calibration file is truncated");
+    }
+    auto payload = data + header.headerSize;
+    if(header.payloadCRC != binaryCRC(payload, header.payloadSize)) {
+        throw runtime_error("Calibration file is corrupted (checksum mismatch)");
+    }
+
+    uint64_t offset = 0;
+    auto read = [&](void *dest, uint64_t size) {
+        if(header.payloadSize - offset < size) {
+            throw runtime_error("Calibration file is truncated");
+        }
+        memcpy(dest, payload + offset, size);
+        offset += (size + 7) & ~7ULL;
+    };
+
+    clearMeasurements();
+    resetErrorTerms();
+    try {
+        for(unsigned int j=0;j<header.measurements;j++) {
+            BinaryMeasurementHeader mh;
+            read(&mh, sizeof(mh));
+            if(mh.measurement > (uint32_t) Measurement::Line) {
+                throw runtime_error("Calibration file contains an unknown measurement");
+            }
+            auto &m = measurements[(Measurement) mh.measurement];
+            m.timestamp = QDateTime::fromSecsSinceEpoch(mh.timestamp);
+            auto &d = m.datapoints;
+            d.resize(mh.points);
+            vector<uint64_t> frequencies(mh.points);
+            read(frequencies.data(), mh.points * sizeof(uint64_t));
+            vector<uint32_t> pointNums(mh.points);
+            read(pointNums.data(), mh.points * sizeof(uint32_t));
+            for(unsigned int i=0;i<mh.points;i++) {
+                d[i] = Protocol::Datapoint();
+                d[i].frequency = frequencies[i];
+                d[i].pointNum = pointNums[i];
+            }
+            vector<float> values(mh.points);
+            for(auto value : {&Protocol::Datapoint::real_S11, &Protocol::Datapoint::imag_S11,
+                                &Protocol::Datapoint::real_S21, &Protocol::Datapoint::imag_S21,
+                                &Protocol::Datapoint::real_S12, &Protocol::Datapoint::imag_S12,
+                                &Protocol::Datapoint::real_S22, &Protocol::Datapoint::imag_S22}) {
+                read(values.data(), mh.points * sizeof(float));
+                for(unsigned int i=0;i<mh.points;i++) {
+                    d[i].*value = values[i];
+                }
+            }
+        }
+
+        auto t = (Type) header.type;
+        if(header.errorTermPoints > 0) {
+            // use the error terms as saved, independent of the current calibration kit
+            vector<double> values(header.errorTermPoints);
+            points.resize(header.errorTermPoints);
+            read(values.data(), values.size() * sizeof(double));
+            for(unsigned int i=0;i<points.size();i++) {
+                points[i].frequency = values[i];
+            }
+            vector<double> imag(header.errorTermPoints);
+            for(auto term : errorTerms) {
+                read(values.data(), values.size() * sizeof(double));
+                read(imag.data(), imag.size() * sizeof(double));
+                for(unsigned int i=0;i<points.size();i++) {
+                    points[i].*term = complex<double>(values[i], imag[i]);
+                }
+            }
+            minFreq = points.front().frequency;
+            maxFreq = points.back().frequency;
+            type = t;
+        } else if(t != Type::None) {
+            // only the measurements have been saved
+            if(!calculationPossible(t)) {
+                throw runtime_error("Incomplete calibration data, the requested \"" + TypeToString(t).toStdString() + "\"-Calibration could not be performed.");
+            }
+            constructErrorTerms(t);
+        }
+    } catch (...) {
+        // do not keep a partially loaded calibration
+        clearMeasurements();
+        resetErrorTerms();
+        throw;
+    }
+}
+
 ostream& operator<<(ostream &os, const Calibration &c)
 {
     for(auto m : c.measurements) {
@@ -718,14 +1096,15 @@ bool Calibration::SanityCheckSamples(const std::vector<Calibration::Measurement>
     // sanity check measurements, all need to be of the same size with the same frequencies (except for isolation which may be empty)
     vector<uint64_t> freqs;
     for(auto type : requiredMeasurements) {
-        auto m = measurements[type];
+        const auto &m = measurements[type];
         if(m.datapoints.size() == 0) {
             // empty required measurement
             return false;
         }
         if(freqs.size() == 0) {
             // this is the first measurement, create frequency vector
-            for(auto p : m.datapoints) {
+            freqs.reserve(m.datapoints.size());
+            for(const auto &p : m.datapoints) {
                 freqs.push_back(p.frequency);
             }
         } else {
@@ -750,40 +1129,42 @@ Calibration::Point Calibration::getCalibrationPoint(Protocol::Datapoint &d)
     if(!points.size()) {
         throw runtime_error("No calibration points available");
     }
-    if(d.frequency <= points.front().frequency) {
+    if(d.pointNum < sweepPoints.size()) {
+        const auto &p = sweepPoints[d.pointNum];
+        auto deviation = p.frequency > d.frequency ? p.frequency - d.frequency : d.frequency - p.frequency;
+        if(deviation <= sweepFrequencyTolerance) {
+            // already interpolated for this sweep
+            return p;
+        }
+    }
+    auto p = lower_bound(points.cbegin(), points.cend(), d.frequency, [](const Point &p, uint64_t freq) -> bool {
+        return p.frequency < freq;
+    });
+    return interpolatePoint(p, d.frequency);
+}
+
+Calibration::Point Calibration::interpolatePoint(std::vector<Point>::const_iterator high, uint64_t frequency) const
+{
+    if(high == points.cbegin()) {
         // use first point even for lower frequencies
         return points.front();
     }
-    if(d.frequency >= points.back().frequency) {
+    if(high == points.cend()) {
         // use last point even for higher frequencies
         return points.back();
     }
-    auto p = lower_bound(points.begin(), points.end(), d.frequency, [](Point p, uint64_t freq) -> bool {
-        return p.frequency < freq;
-    });
-    if(p->frequency == d.frequency) {
+    if(high->frequency == frequency) {
         // Exact match, return point
-        return *p;
+        return *high;
     }
     // need to interpolate
-    auto high = p;
-    p--;
-    auto low = p;
-    double alpha = (d.frequency - low->frequency) / (high->frequency - low->frequency);
+    auto low = high - 1;
+    double alpha = (frequency - low->frequency) / (high->frequency - low->frequency);
     Point ret;
-    ret.frequency = d.frequency;
-    ret.fe00 = low->fe00 * (1 - alpha) + high->fe00 * alpha;
-    ret.fe11 = low->fe11 * (1 - alpha) + high->fe11 * alpha;
-    ret.fe22 = low->fe22 * (1 - alpha) + high->fe22 * alpha;
-    ret.fe30 = low->fe30 * (1 - alpha) + high->fe30 * alpha;
-    ret.re03 = low->re03 * (1 - alpha) + high->re03 * alpha;
-    ret.re11 = low->re11 * (1 - alpha) + high->re11 * alpha;
-    ret.re22 = low->re22 * (1 - alpha) + high->re22 * alpha;
-    ret.re33 = low->re33 * (1 - alpha) + high->re33 * alpha;
-    ret.fe10e01 = low->fe10e01 * (1 - alpha) + high->fe10e01 * alpha;
-    ret.fe10e32 = low->fe10e32 * (1 - alpha) + high->fe10e32 * alpha;
-    ret.re23e01 = low->re23e01 * (1 - alpha) + high->re23e01 * alpha;
-    ret.re23e32 = low->re23e32 * (1 - alpha) + high->re23e32 * alpha;
+    ret.frequency = frequency;
+    for(auto term : errorTerms) {
+        ret.*term = (*low).*term * (1 - alpha) + (*high).*term * alpha;
+    }
     return ret;
 }
 
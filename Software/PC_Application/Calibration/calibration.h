@@ -10,6 +10,8 @@
 #include "calkit.h"
 #include "Traces/tracemodel.h"
 #include <QDateTime>
+#include <functional>
+#include <array>
 #include "calkit.h"
 
 class Calibration
@@ -43,10 +45,18 @@ public:
 
 
     bool calculationPossible(Type type);
+    // Throws runtime_error if the calibration kit does not cover the calibration span.
+    // The error terms of the points are calculated in parallel on all cores
     bool constructErrorTerms(Type type);
     void resetErrorTerms();
+    // copies the error terms (but not the measurements) of another calibration
+    void setErrorTerms(const Calibration &from);
 
     void correctMeasurement(Protocol::Datapoint &d);
+    // Interpolates the error terms for the frequencies of a sweep (indexed by the point number of the received datapoints).
+    // Datapoints that match this table are corrected without searching and interpolating the calibration points.
+    // The table is discarded when the error terms change
+    void setSweepFrequencies(const std::vector<uint64_t> &frequencies);
 
     enum class InterpolationType {
         Unchanged, // Nothing has changed, settings and calibration points match
@@ -57,6 +67,8 @@ public:
     };
 
     InterpolationType getInterpolation(Protocol::SweepSettings settings);
+    // for sweeps with arbitrary frequencies (e.g. segmented sweeps), frequencies must be sorted
+    InterpolationType getInterpolation(const std::vector<uint64_t> &frequencies);
 
     static QString MeasurementToString(Measurement m);
     static QString TypeToString(Type t);
@@ -82,7 +94,13 @@ public:
     std::vector<Trace*> getErrorTermTraces();
 
     bool openFromFile(QString filename = QString());
-    bool saveToFile(QString filename = QString());
+    // Same as openFromFile without any user interaction, may be called outside of the GUI thread. Throws runtime_error
+    // if the file could not be parsed, a non-fatal problem with the calibration kit is returned as warning.
+    // Both the binary and the text format are accepted
+    QString loadFromFile(QString filename);
+    // The binary format also contains the error terms, they are used as saved when loading the file. The text format
+    // only contains the measurements (the error terms are constructed again with the calibration kit when loading)
+    bool saveToFile(QString filename = QString(), bool binary = true);
     Type getType() const;
 
     Calkit& getCalibrationKit();
@@ -95,6 +113,9 @@ private:
     void constructTransmissionNormalization();
     void constructTRL();
     bool SanityCheckSamples(const std::vector<Measurement> &requiredMeasurements);
+    void writeBinary(std::ostream &out) const;
+    // data may point directly into the mapped file, throws runtime_error if the data is not a valid calibration
+    void readBinary(const uchar *data, qint64 size);
     class Point
     {
     public:
@@ -105,6 +126,14 @@ private:
         std::complex<double> re33, re11, re23e32, re23e01, re22, re03;
     };
     Point getCalibrationPoint(Protocol::Datapoint &d);
+    // high is the first calibration point at or above the frequency
+    Point interpolatePoint(std::vector<Point>::const_iterator high, uint64_t frequency) const;
+    // resizes the points and calls construct for each index (from multiple threads)
+    void constructPoints(unsigned int nPoints, std::function<void(unsigned int index, Point &p)> construct);
+    // frequencies of the measurement, used to evaluate the calibration kit for all points at once
+    static std::vector<double> frequencyGrid(const std::vector<Protocol::Datapoint> &datapoints);
+    // all error terms of a point, in the order they are stored in the binary calibration file
+    static const std::array<std::complex<double> Point::*, 12> errorTerms;
     /*
      * Constructs directivity, match and tracking correction factors from measurements of three distinct impedances
      * Normally, an open, short and load are used (with ideal reflection coefficients of 1, -1 and 0 respectively).
@@ -134,6 +163,10 @@ private:
     std::map<Measurement, MeasurementData> measurements;
     double minFreq, maxFreq;
     std::vector<Point> points;
+    // error terms at the frequencies of the current sweep, see setSweepFrequencies
+    std::vector<Point> sweepPoints;
+    // maximum deviation between the sweep frequencies and the frequencies reported by the device (rounding)
+    static constexpr uint64_t sweepFrequencyTolerance = 1;
 
     Calkit kit;
 };
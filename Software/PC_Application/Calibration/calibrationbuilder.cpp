@@ -0,0 +1,118 @@
+#include "calibrationbuilder.h"
+#include <exception>
+
+using namespace std;
+
+CalibrationBuilder::CalibrationBuilder()
+    : requestID(0),
+      running(true),
+      working(false)
+{
+    thread = std::thread(&CalibrationBuilder::run, this);
+}
+
+CalibrationBuilder::~CalibrationBuilder()
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        running = false;
+        pending = nullptr;
+    }
+    cv.notify_one();
+    thread.join();
+}
+
+void CalibrationBuilder::construct(const Calibration &cal, Calibration::Type type)
+{
+    // the copy is taken here, the calibration of the caller may be changed while the error terms are constructed
+    auto copy = make_shared<Calibration>(cal);
+    {
+        lock_guard<mutex> lock(mtx);
+        requestID++;
+        pending = [=](Result &r) {
+            r.loaded = false;
+            if(copy->constructErrorTerms(type)) {
+                r.cal = copy;
+            } else {
+                r.error = "Not all required measurements for the calibration are available";
+            }
+        };
+    }
+    cv.notify_one();
+}
+
+void CalibrationBuilder::load(QString filename)
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        requestID++;
+        pending = [=](Result &r) {
+            r.loaded = true;
+            auto cal = make_shared<Calibration>();
+            r.warning = cal->loadFromFile(filename);
+            r.cal = cal;
+        };
+    }
+    cv.notify_one();
+}
+
+void CalibrationBuilder::cancel()
+{
+    lock_guard<mutex> lock(mtx);
+    requestID++;
+    pending = nullptr;
+    // a finished result might not have been picked up yet
+    result = Result();
+}
+
+bool CalibrationBuilder::busy()
+{
+    lock_guard<mutex> lock(mtx);
+    return working || pending;
+}
+
+CalibrationBuilder::Result CalibrationBuilder::takeResult()
+{
+    lock_guard<mutex> lock(mtx);
+    auto ret = result;
+    result = Result();
+    return ret;
+}
+
+void CalibrationBuilder::run()
+{
+    unique_lock<mutex> lock(mtx);
+    while(running) {
+        cv.wait(lock, [=](){
+            return !running || pending;
+        });
+        if(!running) {
+            break;
+        }
+        auto job = pending;
+        pending = nullptr;
+        auto id = requestID;
+        working = true;
+        lock.unlock();
+
+        Result r;
+        try {
+            job(r);
+        } catch (const exception &e) {
+            // anything escaping the job would terminate the application, report it like a failed calibration
+            r.cal = nullptr;
+            r.error = e.what();
+        } catch (...) {
+            r.cal = nullptr;
+            r.error = "Unknown error";
+        }
+
+        lock.lock();
+        working = false;
+        if(id == requestID) {
+            result = r;
+            // queued connection, the result is picked up in the GUI thread
+            emit finished();
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef CALIBRATIONBUILDER_H
+#define CALIBRATIONBUILDER_H
+
+#include <QObject>
+#include "calibration.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <functional>
+
+// Constructs or loads calibrations in a worker thread. Only the latest request is of interest: a request
+// replaces a pending one and the result of a request that has been superseded in the meantime is dropped.
+class CalibrationBuilder : public QObject
+{
+    Q_OBJECT
+public:
+    CalibrationBuilder();
+    ~CalibrationBuilder();
+
+    class Result {
+    public:
+        // nullptr if the calibration could not be constructed/loaded
+        std::shared_ptr<Calibration> cal;
+        // true if the calibration has been loaded from a file (including its measurements)
+        bool loaded = false;
+        QString error;
+        QString warning;
+    };
+
+    // Constructs the error terms on a copy of the calibration
+    void construct(const Calibration &cal, Calibration::Type type);
+    // Loads the calibration from a file, error terms are constructed if the file contains a calibration type
+    void load(QString filename);
+    // Drops the pending request and the result of the running one
+    void cancel();
+    bool busy();
+
+    // Result of the last finished request (GUI thread, after finished has been emitted)
+    Result takeResult();
+
+signals:
+    void finished();
+
+private:
+    void run();
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::function<void(Result&)> pending;
+    // incremented with every request, results are only valid if no other request has been made in the meantime
+    unsigned int requestID;
+    bool running;
+    bool working;
+    Result result;
+    std::thread thread;
+};
+
+#endif // CALIBRATIONBUILDER_H
@@ -151,75 +151,100 @@ void Calkit::edit()
     dialog->show();
 }
 
+std::deque<Calkit::SOLTGrid> Calkit::SOLTGridCache;
+std::mutex Calkit::SOLTGridMutex;
+
 Calkit::SOLT Calkit::toSOLT(double frequency)
 {
     fillTouchstoneCache();
     SOLT ref;
     if(load_measurements) {
         ref.Load = ts_load->interpolate(frequency).S[0];
-    } else {
-        auto imp_load = complex<double>(load_Z0, 0);
-        ref.Load = (imp_load - complex<double>(50.0)) / (imp_load + complex<double>(50.0));
     }
-
     if(open_measurements) {
         ref.Open = ts_open->interpolate(frequency).S[0];
-    } else {
-        // calculate fringing capacitance for open
-        double Cfringing = open_C0 * 1e-15 + open_C1 * 1e-27 * frequency + open_C2 * 1e-36 * pow(frequency, 2) + open_C3 * 1e-45 * pow(frequency, 3);
-        // convert to impedance
-        if (Cfringing == 0) {
-            // special case to avoid issues with infinity
-            ref.Open = complex<double>(1.0, 0);
-        } else {
-            auto imp_open = complex<double>(0, -1.0 / (frequency * 2 * M_PI * Cfringing));
-            ref.Open = (imp_open - complex<double>(50.0)) / (imp_open + complex<double>(50.0));
-        }
-        // transform the delay into a phase shift for the given frequency
-        double open_phaseshift = -2 * M_PI * frequency * 2 * open_delay * 1e-12;
-        double open_att_db = open_loss * 1e9 * 4.3429 * 2 * open_delay * 1e-12 / open_Z0 * sqrt(frequency / 1e9);
-        double open_att = pow(10.0, -open_att_db / 10.0);
-        auto open_correction = polar<double>(open_att, open_phaseshift);
-        ref.Open *= open_correction;
     }
-
     if(short_measurements) {
         ref.Short = ts_short->interpolate(frequency).S[0];
-    } else {
-        // calculate inductance for short
-        double Lseries = short_L0 * 1e-12 + short_L1 * 1e-24 * frequency + short_L2 * 1e-33 * pow(frequency, 2) + short_L3 * 1e-42 * pow(frequency, 3);
-        // convert to impedance
-        auto imp_short = complex<double>(0, frequency * 2 * M_PI * Lseries);
-        ref.Short =  (imp_short - complex<double>(50.0)) / (imp_short + complex<double>(50.0));
-        // transform the delay into a phase shift for the given frequency
-        double short_phaseshift = -2 * M_PI * frequency * 2 * short_delay * 1e-12;
-        double short_att_db = short_loss * 1e9 * 4.3429 * 2 * short_delay * 1e-12 / short_Z0 * sqrt(frequency / 1e9);;
-        double short_att = pow(10.0, -short_att_db / 10.0);
-        auto short_correction = polar<double>(short_att, short_phaseshift);
-        ref.Short *= short_correction;
     }
-
     if(through_measurements) {
         auto interp = ts_through->interpolate(frequency);
         ref.ThroughS11 = interp.S[0];
         ref.ThroughS12 = interp.S[1];
         ref.ThroughS21 = interp.S[2];
         ref.ThroughS22 = interp.S[3];
-    } else {
-        // calculate effect of through
-        double through_phaseshift = -2 * M_PI * frequency * through_delay * 1e-12;
-        double through_att_db = through_loss * 1e9 * 4.3429 * through_delay * 1e-12 / through_Z0 * sqrt(frequency / 1e9);;
-        double through_att = pow(10.0, -through_att_db / 10.0);
-        ref.ThroughS12 = polar<double>(through_att, through_phaseshift);
-        // Assume symmetric and perfectly matched through for other parameters
-        ref.ThroughS21 = ref.ThroughS12;
-        ref.ThroughS11 = 0.0;
-        ref.ThroughS22 = 0.0;
     }
-
+    evaluateModels(frequency, ref);
     return ref;
 }
 
+std::shared_ptr<const std::vector<Calkit::SOLT>> Calkit::toSOLT(const std::vector<double> &frequencies)
+{
+    fillTouchstoneCache();
+    auto parameters = SOLTParameters();
+    auto matches = [&](const SOLTGrid &g) {
+        return g.parameters == parameters && g.frequencies == frequencies
+                && g.ts_open == ts_open && g.ts_short == ts_short && g.ts_load == ts_load && g.ts_through == ts_through;
+    };
+    {
+        lock_guard<mutex> lock(SOLTGridMutex);
+        for(auto it = SOLTGridCache.begin();it != SOLTGridCache.end();it++) {
+            if(matches(*it)) {
+                // move to the front, the least recently used grid is dropped first
+                auto g = *it;
+                SOLTGridCache.erase(it);
+                SOLTGridCache.push_front(g);
+                return g.standards;
+            }
+        }
+    }
+
+    // not cached, evaluate all standards. Measured standards are interpolated in a single pass over the grid
+    auto standards = make_shared<vector<SOLT>>(frequencies.size());
+    auto &ref = *standards;
+    Touchstone::Resampled resampled;
+    auto fillMeasured = [&](shared_ptr<Touchstone> ts, vector<complex<double> SOLT::*> dest) {
+        ts->resample(frequencies, resampled);
+        for(unsigned int p=0;p<dest.size();p++) {
+            const auto &values = resampled.S[p];
+            for(unsigned int i=0;i<frequencies.size();i++) {
+                ref[i].*dest[p] = values[i];
+            }
+        }
+    };
+    if(load_measurements) {
+        fillMeasured(ts_load, {&SOLT::Load});
+    }
+    if(open_measurements) {
+        fillMeasured(ts_open, {&SOLT::Open});
+    }
+    if(short_measurements) {
+        fillMeasured(ts_short, {&SOLT::Short});
+    }
+    if(through_measurements) {
+        // all four parameters with a single resampling pass
+        fillMeasured(ts_through, {&SOLT::ThroughS11, &SOLT::ThroughS12, &SOLT::ThroughS21, &SOLT::ThroughS22});
+    }
+    for(unsigned int i=0;i<frequencies.size();i++) {
+        evaluateModels(frequencies[i], ref[i]);
+    }
+
+    SOLTGrid g;
+    g.parameters = parameters;
+    g.frequencies = frequencies;
+    g.ts_open = ts_open;
+    g.ts_short = ts_short;
+    g.ts_load = ts_load;
+    g.ts_through = ts_through;
+    g.standards = standards;
+    lock_guard<mutex> lock(SOLTGridMutex);
+    SOLTGridCache.push_front(g);
+    if(SOLTGridCache.size() > SOLTGridCacheSize) {
+        SOLTGridCache.pop_back();
+    }
+    return standards;
+}
+
 Calkit::TRL Calkit::toTRL(double)
 {
     TRL trl;
@@ -240,7 +265,7 @@ double Calkit::minFreq(bool TRL)
     } else {
         fillTouchstoneCache();
         double min = std::numeric_limits<double>::min();
-        array<Touchstone*, 4> ts_list = {ts_open, ts_short, ts_load, ts_through};
+        array<Touchstone*, 4> ts_list = {ts_open.get(), ts_short.get(), ts_load.get(), ts_through.get()};
         // find the highest minimum frequency in all measurement files
         for(auto ts : ts_list) {
             if(!ts) {
@@ -262,7 +287,7 @@ double Calkit::maxFreq(bool TRL)
     } else {
         fillTouchstoneCache();
         double max = std::numeric_limits<double>::max();
-        array<Touchstone*, 4> ts_list = {ts_open, ts_short, ts_load, ts_through};
+        array<Touchstone*, 4> ts_list = {ts_open.get(), ts_short.get(), ts_load.get(), ts_through.get()};
         // find the highest minimum frequency in all measurement files
         for(auto ts : ts_list) {
             if(!ts) {
@@ -284,13 +309,9 @@ bool Calkit::isTRLReflectionShort() const
 
 void Calkit::clearTouchstoneCache()
 {
-    delete ts_open;
     ts_open = nullptr;
-    delete ts_short;
     ts_short = nullptr;
-    delete ts_load;
     ts_load = nullptr;
-    delete ts_through;
     ts_through = nullptr;
     ts_cached = false;
 }
@@ -301,24 +322,85 @@ void Calkit::fillTouchstoneCache()
         return;
     }
     if(open_measurements) {
-        ts_open = new Touchstone(1);
-        *ts_open = Touchstone::fromFile(open_file);
+        ts_open = make_shared<Touchstone>(Touchstone::fromFile(open_file));
         ts_open->reduceTo1Port(open_Sparam);
     }
     if(short_measurements) {
-        ts_short = new Touchstone(1);
-        *ts_short = Touchstone::fromFile(short_file);
-        ts_open->reduceTo1Port(short_Sparam);
+        ts_short = make_shared<Touchstone>(Touchstone::fromFile(short_file));
+        ts_short->reduceTo1Port(short_Sparam);
     }
     if(load_measurements) {
-        ts_load = new Touchstone(1);
-        *ts_load = Touchstone::fromFile(load_file);
-        ts_open->reduceTo1Port(load_Sparam);
+        ts_load = make_shared<Touchstone>(Touchstone::fromFile(load_file));
+        ts_load->reduceTo1Port(load_Sparam);
     }
     if(through_measurements) {
-        ts_through = new Touchstone(2);
-        *ts_through = Touchstone::fromFile(through_file);
+        ts_through = make_shared<Touchstone>(Touchstone::fromFile(through_file));
         ts_through->reduceTo2Port(through_Sparam1, through_Sparam2);
     }
     ts_cached = true;
 }
+
+void Calkit::evaluateModels(double frequency, Calkit::SOLT &ref)
+{
+    if(!load_measurements) {
+        auto imp_load = complex<double>(load_Z0, 0);
+        ref.Load = (imp_load - complex<double>(50.0)) / (imp_load + complex<double>(50.0));
+    }
+
+    // the loss of all standards scales with the square root of the frequency
+    double sqrtGHz = sqrt(frequency / 1e9);
+
+    if(!open_measurements) {
+        // calculate fringing capacitance for open (polynomial in Horner form)
+        double Cfringing = 1e-15 * (open_C0 + frequency * 1e-12 * (open_C1 + frequency * 1e-9 * (open_C2 + frequency * 1e-9 * open_C3)));
+        // convert to impedance
+        if (Cfringing == 0) {
+            // special case to avoid issues with infinity
+            ref.Open = complex<double>(1.0, 0);
+        } else {
+            auto imp_open = complex<double>(0, -1.0 / (frequency * 2 * M_PI * Cfringing));
+            ref.Open = (imp_open - complex<double>(50.0)) / (imp_open + complex<double>(50.0));
+        }
+        // transform the delay into a phase shift for the given frequency
+        double open_phaseshift = -2 * M_PI * frequency * 2 * open_delay * 1e-12;
+        double open_att_db = open_loss * 1e9 * 4.3429 * 2 * open_delay * 1e-12 / open_Z0 * sqrtGHz;
+        double open_att = exp(-open_att_db * M_LN10 / 10.0);
+        auto open_correction = polar<double>(open_att, open_phaseshift);
+        ref.Open *= open_correction;
+    }
+
+    if(!short_measurements) {
+        // calculate inductance for short (polynomial in Horner form)
+        double Lseries = 1e-12 * (short_L0 + frequency * 1e-12 * (short_L1 + frequency * 1e-9 * (short_L2 + frequency * 1e-9 * short_L3)));
+        // convert to impedance
+        auto imp_short = complex<double>(0, frequency * 2 * M_PI * Lseries);
+        ref.Short =  (imp_short - complex<double>(50.0)) / (imp_short + complex<double>(50.0));
+        // transform the delay into a phase shift for the given frequency
+        double short_phaseshift = -2 * M_PI * frequency * 2 * short_delay * 1e-12;
+        double short_att_db = short_loss * 1e9 * 4.3429 * 2 * short_delay * 1e-12 / short_Z0 * sqrtGHz;
+        double short_att = exp(-short_att_db * M_LN10 / 10.0);
+        auto short_correction = polar<double>(short_att, short_phaseshift);
+        ref.Short *= short_correction;
+    }
+
+    if(!through_measurements) {
+        // calculate effect of through
+        double through_phaseshift = -2 * M_PI * frequency * through_delay * 1e-12;
+        double through_att_db = through_loss * 1e9 * 4.3429 * through_delay * 1e-12 / through_Z0 * sqrtGHz;
+        double through_att = exp(-through_att_db * M_LN10 / 10.0);
+        ref.ThroughS12 = polar<double>(through_att, through_phaseshift);
+        // Assume symmetric and perfectly matched through for other parameters
+        ref.ThroughS21 = ref.ThroughS12;
+        ref.ThroughS11 = 0.0;
+        ref.ThroughS22 = 0.0;
+    }
+}
+
+std::vector<double> Calkit::SOLTParameters()
+{
+    return {open_Z0, open_delay, open_loss, open_C0, open_C1, open_C2, open_C3,
+            short_Z0, short_delay, short_loss, short_L0, short_L1, short_L2, short_L3,
+            load_Z0,
+            through_Z0, through_delay, through_loss,
+            (double) open_measurements, (double) short_measurements, (double) load_measurements, (double) through_measurements};
+}
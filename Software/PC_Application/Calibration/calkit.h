@@ -3,6 +3,10 @@
 
 #include <string>
 #include <complex>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
 #include "touchstone.h"
 
 class Calkit
@@ -29,6 +33,9 @@ public:
     static Calkit fromFile(std::string filename);
     void edit();
     SOLT toSOLT(double frequency);
+    // Same as toSOLT for a whole frequency grid. The result is cached, the standards are only evaluated again
+    // if the grid or the definition of the standards changed
+    std::shared_ptr<const std::vector<SOLT>> toSOLT(const std::vector<double> &frequencies);
     TRL toTRL(double frequency);
     double minFreq(bool TRL = false);
     double maxFreq(bool TRL = false);
@@ -57,11 +64,28 @@ private:
     std::string open_file, short_file, load_file, through_file;
     int open_Sparam, short_Sparam, load_Sparam, through_Sparam1, through_Sparam2;
 
-    Touchstone *ts_open, *ts_short, *ts_load, *ts_through;
+    // shared between copies of the kit, clearing the cache of one copy does not affect the others
+    std::shared_ptr<Touchstone> ts_open, ts_short, ts_load, ts_through;
     bool ts_cached;
 
     void clearTouchstoneCache();
     void fillTouchstoneCache();
+    // evaluates the standards that are defined by coefficients (the measured standards are left untouched)
+    void evaluateModels(double frequency, SOLT &ref);
+
+    // Evaluated grids of the last calibration kits, shared by all kits (and their copies)
+    class SOLTGrid {
+    public:
+        // every coefficient that influences the SOLT standards
+        std::vector<double> parameters;
+        std::shared_ptr<Touchstone> ts_open, ts_short, ts_load, ts_through;
+        std::vector<double> frequencies;
+        std::shared_ptr<const std::vector<SOLT>> standards;
+    };
+    std::vector<double> SOLTParameters();
+    static constexpr unsigned int SOLTGridCacheSize = 4;
+    static std::deque<SOLTGrid> SOLTGridCache;
+    static std::mutex SOLTGridMutex;
 };
 
 #endif // CALKIT_H
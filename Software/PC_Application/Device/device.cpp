@@ -5,6 +5,7 @@
 #include <QString>
 #include <QMessageBox>
 #include <mutex>
+#include <QDateTime>
 
 using namespace std;
 
@@ -111,7 +112,7 @@ static Protocol::DeviceLimits limits = {
     .maxFreq = 6000000000,
     .minIFBW = 10,
     .maxIFBW = 50000,
-    .maxPoints = 4501,
+    .maxPoints = 100001,
     .cdbm_min = -4000,
     .cdbm_max = 0,
     .minRBW = 10,
@@ -172,6 +173,8 @@ Device::Device(QString serial)
     connect(dataBuffer, &USBInBuffer::DataReceived, this, &Device::ReceivedData, Qt::DirectConnection);
     connect(dataBuffer, &USBInBuffer::TransferError, this, &Device::ConnectionLost);
     connect(logBuffer, &USBInBuffer::DataReceived, this, &Device::ReceivedLog, Qt::DirectConnection);
+    qRegisterMetaType<uint16_t>("uint16_t");
+    connect(this, &Device::LogFormatMissing, this, &Device::RequestLogFormat, Qt::QueuedConnection);
     connect(&transmissionTimer, &QTimer::timeout, this, &Device::transmissionTimeout);
     transmissionTimer.setSingleShot(true);
     transmissionActive = false;
@@ -218,6 +221,23 @@ bool Device::Configure(Protocol::SweepSettings settings)
     return SendPacket(p);
 }
 
+bool Device::Configure(Protocol::SweepSettings settings, const std::vector<Protocol::SweepSegment> &segments)
+{
+    if(segments.size() > Protocol::MaxSweepSegments) {
+        return false;
+    }
+    // transfer all segments first, the device only starts the sweep after receiving the settings
+    for(unsigned int i=0;i<segments.size();i++) {
+        Protocol::PacketInfo p;
+        p.type = Protocol::PacketType::SweepSegment;
+        p.segment = segments[i];
+        p.segment.index = i;
+        SendPacket(p);
+    }
+    settings.segments = segments.size();
+    return Configure(settings);
+}
+
 bool Device::Configure(Protocol::SpectrumAnalyzerSettings settings)
 {
     Protocol::PacketInfo p;
@@ -226,6 +246,26 @@ bool Device::Configure(Protocol::SpectrumAnalyzerSettings settings)
     return SendPacket(p);
 }
 
+bool Device::Configure(Protocol::GeneratorSettings settings, const std::vector<Protocol::GeneratorListEntry> &list)
+{
+    if(list.size() > Protocol::MaxGeneratorListEntries) {
+        return false;
+    }
+    // transfer all list entries first, the device only starts stepping through them after receiving the settings
+    for(unsigned int i=0;i<list.size();i++) {
+        Protocol::PacketInfo p;
+        p.type = Protocol::PacketType::GeneratorListEntry;
+        p.generatorListEntry = list[i];
+        p.generatorListEntry.index = i;
+        SendPacket(p);
+    }
+    settings.listEntries = list.size();
+    Protocol::PacketInfo p;
+    p.type = Protocol::PacketType::Generator;
+    p.generator = settings;
+    return SendPacket(p);
+}
+
 bool Device::SetManual(Protocol::ManualControl manual)
 {
     Protocol::PacketInfo p;
@@ -382,6 +422,7 @@ void Device::ReceivedData()
 {
     Protocol::PacketInfo packet;
     uint16_t handled_len;
+    std::vector<Protocol::RawDatapoint> raw;
     do {
         handled_len = Protocol::DecodeBuffer(dataBuffer->getBuffer(), dataBuffer->getReceived(), &packet);
         dataBuffer->removeBytes(handled_len);
@@ -389,12 +430,19 @@ void Device::ReceivedData()
         case Protocol::PacketType::Datapoint:
             emit DatapointReceived(packet.datapoint);
             break;
+        case Protocol::PacketType::RawDatapoint:
+            // collected and passed on as a batch
+            raw.push_back(packet.rawDatapoint);
+            break;
         case Protocol::PacketType::Status:
             emit ManualStatusReceived(packet.status);
             break;
         case Protocol::PacketType::SpectrumAnalyzerResult:
             emit SpectrumResultReceived(packet.spectrumResult);
             break;
+        case Protocol::PacketType::GeneratorStep:
+            emit GeneratorStepReceived(packet.generatorStep);
+            break;
         case Protocol::PacketType::DeviceInfo:
             lastInfo = packet.info;
             lastInfoValid = true;
@@ -411,10 +459,16 @@ void Device::ReceivedData()
         case Protocol::PacketType::DeviceLimits:
             limits = packet.limits;
             break;
+        case Protocol::PacketType::ProfilingReport:
+            emit ProfilingReceived(packet.profiling);
+            break;
         default:
             break;
         }
     } while (handled_len > 0);
+    if(raw.size() > 0) {
+        emit RawDatapointsReceived(raw);
+    }
 }
 
 void Device::ReceivedLog()
@@ -422,14 +476,111 @@ void Device::ReceivedLog()
     uint16_t handled_len;
     do {
         handled_len = 0;
-        auto firstLinebreak = (uint8_t*) memchr(logBuffer->getBuffer(), '\n', logBuffer->getReceived());
-        if(firstLinebreak) {
-            handled_len = firstLinebreak - logBuffer->getBuffer();
-            auto line = QString::fromLatin1((const char*) logBuffer->getBuffer(), handled_len - 1);
-            emit LogLineReceived(line);
-            logBuffer->removeBytes(handled_len + 1);
+        auto buf = logBuffer->getBuffer();
+        auto len = logBuffer->getReceived();
+        if(len == 0) {
+            break;
+        }
+        if(buf[0] == LogRecord::MarkerEntry || buf[0] == LogRecord::MarkerFormat) {
+            if(len < LogRecord::HeaderSize || len < LogRecord::HeaderSize + buf[1]) {
+                // record not complete yet
+                break;
+            }
+            handled_len = LogRecord::HeaderSize + buf[1];
+            if(buf[0] == LogRecord::MarkerFormat) {
+                AddLogFormat(buf, handled_len);
+            } else {
+                pendingLog.push_back(QByteArray((const char*) buf, handled_len));
+            }
+        } else {
+            auto firstLinebreak = (uint8_t*) memchr(buf, '\n', len);
+            if(firstLinebreak) {
+                handled_len = firstLinebreak - buf + 1;
+                // strip line ending
+                auto lineLength = firstLinebreak - buf;
+                if(lineLength > 0 && buf[lineLength - 1] == '\r') {
+                    lineLength--;
+                }
+                pendingLog.push_back(QByteArray((const char*) buf, lineLength));
+            }
         }
+        logBuffer->removeBytes(handled_len);
     } while(handled_len > 0);
+    ProcessPendingLog();
+}
+
+void Device::RequestLogFormat(uint16_t id)
+{
+    Protocol::PacketInfo p;
+    p.type = Protocol::PacketType::RequestLogFormat;
+    p.logFormatID = id;
+    SendPacket(p);
+}
+
+void Device::AddLogFormat(const uint8_t *record, uint16_t length)
+{
+    if(length < LogRecord::HeaderSize + 5) {
+        return;
+    }
+    uint16_t id;
+    memcpy(&id, &record[2], 2);
+    auto module = (const char*) &record[5];
+    auto moduleLength = strnlen(module, length - 5);
+    if(5 + moduleLength + 1 >= length) {
+        return;
+    }
+    auto format = module + moduleLength + 1;
+    auto formatLength = strnlen(format, length - 5 - moduleLength - 1);
+    LogFormat f;
+    f.level = record[4];
+    f.module = QByteArray(module, moduleLength);
+    f.format = QByteArray(format, formatLength);
+    logFormats[id] = f;
+    logFormatRequests.erase(id);
+}
+
+void Device::ProcessPendingLog()
+{
+    while(!pendingLog.empty()) {
+        auto &r = pendingLog.front();
+        if(r.isEmpty() || (uint8_t) r[0] != LogRecord::MarkerEntry) {
+            emit LogLineReceived(QString::fromLatin1(r));
+            pendingLog.pop_front();
+            continue;
+        }
+        if(r.size() < LogRecord::EntryHeaderSize) {
+            pendingLog.pop_front();
+            continue;
+        }
+        uint16_t id;
+        uint32_t tick;
+        memcpy(&id, r.constData() + 2, 2);
+        memcpy(&tick, r.constData() + 4, 4);
+        char line[512];
+        int written;
+        auto f = logFormats.find(id);
+        if(f == logFormats.end()) {
+            if(pendingLog.size() < maxPendingLog) {
+                // hold back this and all following lines until the format is known
+                auto now = QDateTime::currentMSecsSinceEpoch();
+                auto request = logFormatRequests.find(id);
+                if(request == logFormatRequests.end() || now - request->second > logFormatRequestTimeout) {
+                    logFormatRequests[id] = now;
+                    emit LogFormatMissing(id);
+                }
+                break;
+            }
+            // format did not arrive, give up on this entry
+            written = snprintf(line, sizeof(line), "%05lu [     ?,???]: unknown log format #%u", (unsigned long) tick, id);
+        } else {
+            written = snprintf(line, sizeof(line), "%05lu [%6.6s,%s]: ", (unsigned long) tick,
+                               f->second.module.constData(), LogRecord::LevelName(f->second.level));
+            LogRecord::Format(f->second.format.constData(), (const uint8_t*) r.constData() + LogRecord::EntryHeaderSize,
+                              r.size() - LogRecord::EntryHeaderSize, &line[written], sizeof(line) - written);
+        }
+        emit LogLineReceived(QString::fromLatin1(line));
+        pendingLog.pop_front();
+    }
 }
 
 QString Device::serial() const
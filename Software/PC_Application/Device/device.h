@@ -2,12 +2,16 @@
 #define DEVICE_H
 
 #include "../VNA_embedded/Application/Communication/Protocol.hpp"
+#include "../VNA_embedded/Application/Drivers/LogRecord.hpp"
 #include <functional>
 #include <libusb-1.0/libusb.h>
 #include <thread>
 #include <QObject>
 #include <condition_variable>
 #include <set>
+#include <vector>
+#include <map>
+#include <deque>
 #include <QQueue>
 #include <QTimer>
 
@@ -15,6 +19,8 @@ Q_DECLARE_METATYPE(Protocol::Datapoint);
 Q_DECLARE_METATYPE(Protocol::ManualStatus);
 Q_DECLARE_METATYPE(Protocol::DeviceInfo);
 Q_DECLARE_METATYPE(Protocol::SpectrumAnalyzerResult);
+Q_DECLARE_METATYPE(Protocol::ProfilingReport);
+Q_DECLARE_METATYPE(Protocol::GeneratorStep);
 
 class USBInBuffer : public QObject {
     Q_OBJECT;
@@ -58,7 +64,9 @@ public:
     ~Device();
     bool SendPacket(Protocol::PacketInfo packet, std::function<void(TransmissionResult)> cb = nullptr, unsigned int timeout = 10);
     bool Configure(Protocol::SweepSettings settings);
+    bool Configure(Protocol::SweepSettings settings, const std::vector<Protocol::SweepSegment> &segments);
     bool Configure(Protocol::SpectrumAnalyzerSettings settings);
+    bool Configure(Protocol::GeneratorSettings settings, const std::vector<Protocol::GeneratorListEntry> &list);
     bool SetManual(Protocol::ManualControl manual);
     bool SendFirmwareChunk(Protocol::FirmwarePacket &fw);
     bool SendCommandWithoutPayload(Protocol::PacketType type);
@@ -71,16 +79,23 @@ public:
     static Protocol::DeviceLimits Limits();
 signals:
     void DatapointReceived(Protocol::Datapoint);
+    // all raw datapoints contained in one USB transfer
+    void RawDatapointsReceived(std::vector<Protocol::RawDatapoint>);
     void ManualStatusReceived(Protocol::ManualStatus);
     void SpectrumResultReceived(Protocol::SpectrumAnalyzerResult);
+    void GeneratorStepReceived(Protocol::GeneratorStep);
+    void ProfilingReceived(Protocol::ProfilingReport);
     void DeviceInfoUpdated();
     void ConnectionLost();
     void AckReceived();
     void NackReceived();
     void LogLineReceived(QString line);
+    // emitted from the USB thread, handled in the thread of the device object
+    void LogFormatMissing(uint16_t id);
 private slots:
     void ReceivedData();
     void ReceivedLog();
+    void RequestLogFormat(uint16_t id);
     void transmissionTimeout() {
         transmissionFinished(TransmissionResult::Timeout);
     }
@@ -91,6 +106,9 @@ private:
     static constexpr int EP_Log_In_Addr = 0x82;
 
     void USBHandleThread();
+    void AddLogFormat(const uint8_t *record, uint16_t length);
+    // Passes on all received log lines and entries up to the first one with a (still) unknown format
+    void ProcessPendingLog();
     // foundCallback is called for every device that is found. If it returns true the search continues, otherwise it is aborted.
     // When the search is aborted the last found device is still opened
     static void SearchDevices(std::function<bool(libusb_device_handle *handle, QString serial)> foundCallback, libusb_context *context);
@@ -100,6 +118,20 @@ private:
     USBInBuffer *dataBuffer;
     USBInBuffer *logBuffer;
 
+    using LogFormat = struct {
+        uint8_t level;
+        QByteArray module;
+        QByteArray format;
+    };
+    // Formats of deferred log entries, requested from the device on first use
+    std::map<uint16_t, LogFormat> logFormats;
+    std::map<uint16_t, qint64> logFormatRequests;
+    // Received log lines (plain text) and entries (binary records) in order
+    std::deque<QByteArray> pendingLog;
+    // Entries with an unknown format are held back to keep the order. If the format does not arrive, they are dropped
+    static constexpr unsigned int maxPendingLog = 500;
+    static constexpr qint64 logFormatRequestTimeout = 1000;
+
     using Transmission = struct {
         Protocol::PacketInfo packet;
         unsigned int timeout;
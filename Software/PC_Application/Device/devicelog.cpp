@@ -1,6 +1,7 @@
 #include "devicelog.h"
 #include "ui_devicelog.h"
 #include <QScrollBar>
+#include <QTextCursor>
 #include <QFileDialog>
 #include <fstream>
 
@@ -11,6 +12,10 @@ DeviceLog::DeviceLog(QWidget *parent) :
     ui(new Ui::DeviceLog)
 {
     ui->setupUi(this);
+    ui->text->setMaximumBlockCount(maxLines);
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(flushInterval);
+    connect(&flushTimer, &QTimer::timeout, this, &DeviceLog::flush);
     connect(ui->bClear, &QPushButton::clicked, this, &DeviceLog::clear);
 }
 
@@ -21,37 +26,67 @@ DeviceLog::~DeviceLog()
 
 void DeviceLog::addLine(QString line)
 {
-    // Set color depending on log level
-    QColor color = Qt::black;
-    if(line.contains(",CRT]")) {
-        color = Qt::red;
-    } else if(line.contains(",ERR]")) {
-        color = QColor(255, 94, 0);
-    } else if(line.contains(",WRN]")) {
-        color = QColor(255, 174, 26);
-    } else if(line.contains(",DBG")) {
-        color = Qt::gray;
-    }
-    QTextCharFormat tf;
-    tf = ui->text->currentCharFormat();
-    tf.setForeground(QBrush(color));
-    ui->text->setCurrentCharFormat(tf);
-    ui->text->appendPlainText(line);
-    if(ui->cbAutoscroll->isChecked()) {
-        QScrollBar *sb = ui->text->verticalScrollBar();
-        sb->setValue(sb->maximum());
+    pending.append(line);
+    if(!flushTimer.isActive()) {
+        flushTimer.start();
     }
 }
 
 void DeviceLog::clear()
 {
+    pending.clear();
     ui->text->clear();
 }
 
+static QColor levelColor(const QString &line)
+{
+    // level is located at the end of the line header, e.g. "00123 [   VNA,INF]: "
+    auto end = line.indexOf(']');
+    if(end < 4) {
+        return Qt::black;
+    }
+    auto level = line.midRef(end - 4, 4);
+    if(level == ",CRT") {
+        return Qt::red;
+    } else if(level == ",ERR") {
+        return QColor(255, 94, 0);
+    } else if(level == ",WRN") {
+        return QColor(255, 174, 26);
+    } else if(level == ",DBG") {
+        return Qt::gray;
+    }
+    return Qt::black;
+}
+
+void DeviceLog::flush()
+{
+    if(pending.isEmpty()) {
+        return;
+    }
+    QTextCursor cursor(ui->text->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.beginEditBlock();
+    QTextCharFormat tf;
+    for(const auto &line : pending) {
+        if(!ui->text->document()->isEmpty()) {
+            cursor.insertBlock();
+        }
+        tf.setForeground(QBrush(levelColor(line)));
+        cursor.insertText(line, tf);
+    }
+    cursor.endEditBlock();
+    pending.clear();
+    if(ui->cbAutoscroll->isChecked()) {
+        QScrollBar *sb = ui->text->verticalScrollBar();
+        sb->setValue(sb->maximum());
+    }
+}
+
 void DeviceLog::on_bToFile_clicked()
 {
     auto filename = QFileDialog::getSaveFileName(this, "Select file for device log", "", "", nullptr, QFileDialog::DontUseNativeDialog);
     if(filename.length() > 0) {
+        flush();
         // create file
         ofstream file;
         file.open(filename.toStdString());
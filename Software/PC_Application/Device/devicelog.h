@@ -2,6 +2,8 @@
 #define DEVICELOG_H
 
 #include <QWidget>
+#include <QTimer>
+#include <QStringList>
 
 namespace Ui {
 class DeviceLog;
@@ -21,9 +23,15 @@ public slots:
 
 private slots:
     void on_bToFile_clicked();
+    void flush();
 
 private:
+    // Lines are collected and appended in batches, the oldest lines are removed when the limit is reached
+    static constexpr int flushInterval = 100;
+    static constexpr int maxLines = 10000;
     Ui::DeviceLog *ui;
+    QStringList pending;
+    QTimer flushTimer;
 };
 
 #endif // DEVICELOG_H
@@ -4,6 +4,7 @@
 #include <QDebug>
 #include <QButtonGroup>
 #include <complex>
+#include "conversion.h"
 
 using namespace std;
 
@@ -191,27 +192,27 @@ void ManualControlDialog::NewStatus(Protocol::ManualStatus status)
     ui->port1max->setText(QString::number(status.port1max));
     auto port1 = complex<double>(status.port1real, status.port1imag);
     ui->port1mag->setText(QString::number(abs(port1)));
-    ui->port1phase->setText(QString::number(arg(port1)*180/M_PI));
+    ui->port1phase->setText(QString::number(Conversion::Phase(port1)));
 
     ui->port2min->setText(QString::number(status.port2min));
     ui->port2max->setText(QString::number(status.port2max));
     auto port2 = complex<double>(status.port2real, status.port2imag);
     ui->port2mag->setText(QString::number(abs(port2)));
-    ui->port2phase->setText(QString::number(arg(port2)*180/M_PI));
+    ui->port2phase->setText(QString::number(Conversion::Phase(port2)));
 
     ui->refmin->setText(QString::number(status.refmin));
     ui->refmax->setText(QString::number(status.refmax));
     auto ref = complex<double>(status.refreal, status.refimag);
     ui->refmag->setText(QString::number(abs(ref)));
-    ui->refphase->setText(QString::number(arg(ref)*180/M_PI));
+    ui->refphase->setText(QString::number(Conversion::Phase(ref)));
 
     auto port1referenced = port1 / ref;
     auto port2referenced = port2 / ref;
-    auto port1db = 20*log10(abs(port1referenced));
-    auto port2db = 20*log10(abs(port2referenced));
+    auto port1db = Conversion::dB(port1referenced);
+    auto port2db = Conversion::dB(port2referenced);
 
-    ui->port1referenced->setText(QString::number(port1db, 'f', 1) + "db@" + QString::number(arg(port1referenced)*180/M_PI, 'f', 0) + "°");
-    ui->port2referenced->setText(QString::number(port2db, 'f', 1) + "db@" + QString::number(arg(port2referenced)*180/M_PI, 'f', 0) + "°");
+    ui->port1referenced->setText(QString::number(port1db, 'f', 1) + "db@" + QString::number(Conversion::Phase(port1referenced), 'f', 0) + "°");
+    ui->port2referenced->setText(QString::number(port2db, 'f', 1) + "db@" + QString::number(Conversion::Phase(port2referenced), 'f', 0) + "°");
 
     // PLL state
     ui->SourceLocked->setChecked(status.source_locked);
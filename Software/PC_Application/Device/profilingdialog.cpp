@@ -0,0 +1,74 @@
+#include "profilingdialog.h"
+#include "ui_profilingdialog.h"
+
+static constexpr int refreshInterval = 1000;
+
+static const char *sectionNames[Protocol::ProfilingSections] = {
+    "Sample read",
+    "Measurement done",
+    "Sweep halted",
+    "Communication send",
+    "USB transmit",
+    "VNA setup",
+};
+
+ProfilingDialog::ProfilingDialog(Device &dev, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::ProfilingDialog),
+    dev(dev)
+{
+    ui->setupUi(this);
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    ui->table->setRowCount(Protocol::ProfilingSections);
+    for(int i=0;i<Protocol::ProfilingSections;i++) {
+        ui->table->setItem(i, 0, new QTableWidgetItem(sectionNames[i]));
+    }
+
+    qRegisterMetaType<Protocol::ProfilingReport>("ProfilingReport");
+    connect(&dev, &Device::ProfilingReceived, this, &ProfilingDialog::NewReport);
+    connect(ui->bRefresh, &QPushButton::clicked, this, &ProfilingDialog::RequestReport);
+    connect(&refreshTimer, &QTimer::timeout, this, &ProfilingDialog::RequestReport);
+    connect(ui->cbAutoRefresh, &QCheckBox::toggled, [=](bool enabled) {
+        if(enabled) {
+            refreshTimer.start(refreshInterval);
+        } else {
+            refreshTimer.stop();
+        }
+    });
+    // the first report also discards whatever has been accumulated since the last request
+    RequestReport();
+}
+
+ProfilingDialog::~ProfilingDialog()
+{
+    delete ui;
+}
+
+void ProfilingDialog::NewReport(Protocol::ProfilingReport report)
+{
+    if(!report.timerFrequency) {
+        return;
+    }
+    auto toMicroseconds = [&](uint32_t cycles) -> QString {
+        return QString::number(cycles * 1000000.0 / report.timerFrequency, 'f', 2);
+    };
+    for(int i=0;i<Protocol::ProfilingSections;i++) {
+        auto &s = report.sections[i];
+        ui->table->setItem(i, 1, new QTableWidgetItem(QString::number(s.count)));
+        if(s.count) {
+            ui->table->setItem(i, 2, new QTableWidgetItem(toMicroseconds(s.min)));
+            ui->table->setItem(i, 3, new QTableWidgetItem(toMicroseconds(s.avg)));
+            ui->table->setItem(i, 4, new QTableWidgetItem(toMicroseconds(s.max)));
+        } else {
+            for(int j=2;j<=4;j++) {
+                ui->table->setItem(i, j, new QTableWidgetItem("-"));
+            }
+        }
+    }
+}
+
+void ProfilingDialog::RequestReport()
+{
+    dev.SendCommandWithoutPayload(Protocol::PacketType::RequestProfiling);
+}
@@ -0,0 +1,30 @@
+#ifndef PROFILINGDIALOG_H
+#define PROFILINGDIALOG_H
+
+#include <QDialog>
+#include <QTimer>
+#include "device.h"
+
+namespace Ui {
+class ProfilingDialog;
+}
+
+class ProfilingDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit ProfilingDialog(Device &dev, QWidget *parent = nullptr);
+    ~ProfilingDialog();
+
+public slots:
+    void NewReport(Protocol::ProfilingReport report);
+
+private:
+    void RequestReport();
+    Ui::ProfilingDialog *ui;
+    Device &dev;
+    QTimer refreshTimer;
+};
+
+#endif // PROFILINGDIALOG_H
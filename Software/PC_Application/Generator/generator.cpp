@@ -1,5 +1,15 @@
 #include "generator.h"
 #include <QSettings>
+#include <QToolBar>
+#include <QToolButton>
+#include <QMenu>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
 
 Generator::Generator(AppWindow *window)
     : Mode(window, "Signal Generator")
@@ -18,6 +28,31 @@ Generator::Generator(AppWindow *window)
         central->setLevel(pref.Startup.Generator.level);
     }
 
+    // List toolbar
+    auto tb_list = new QToolBar("List");
+    auto bList = new QToolButton();
+    bList->setText("List");
+    bList->setToolTip("Step through a list of frequencies, levels and dwell times");
+    bList->setPopupMode(QToolButton::InstantPopup);
+    auto listMenu = new QMenu();
+    connect(listMenu->addAction("Load list..."), &QAction::triggered, this, &Generator::LoadList);
+    connect(listMenu->addAction("Clear list"), &QAction::triggered, this, &Generator::ClearList);
+    bList->setMenu(listMenu);
+    tb_list->addWidget(bList);
+    cbStepStatus = new QCheckBox("Step status");
+    cbStepStatus->setToolTip("Report every started list entry");
+    connect(cbStepStatus, &QCheckBox::toggled, this, &Generator::updateDevice);
+    tb_list->addWidget(cbStepStatus);
+    cbTrigger = new QCheckBox("Trigger output");
+    cbTrigger->setToolTip("Pulse the trigger output at the start of every list entry");
+    connect(cbTrigger, &QCheckBox::toggled, this, &Generator::updateDevice);
+    tb_list->addWidget(cbTrigger);
+    lList = new QLabel();
+    tb_list->addWidget(lList);
+    window->addToolBar(tb_list);
+    toolbars.insert(tb_list);
+    UpdateListStatus();
+
     finalize(central);
     connect(central, &SignalgeneratorWidget::SettingsChanged, this, &Generator::updateDevice);
 }
@@ -34,18 +69,93 @@ void Generator::deactivate()
 
 void Generator::initializeDevice()
 {
+    qRegisterMetaType<Protocol::GeneratorStep>("GeneratorStep");
+    connect(window->getDevice(), &Device::GeneratorStepReceived, this, &Generator::NewStep, Qt::UniqueConnection);
     updateDevice();
 }
 
 void Generator::updateDevice()
 {
+    UpdateListStatus();
     if(!window->getDevice()) {
         // can't update if not connected
         return;
     }
-    // TODO comment in once status is filled with valid values
-    Protocol::PacketInfo p;
-    p.type = Protocol::PacketType::Generator;
-    p.generator = central->getDeviceStatus();
-    window->getDevice()->SendPacket(p);
+    auto s = central->getDeviceStatus();
+    s.listStatus = cbStepStatus->isChecked() ? 1 : 0;
+    s.listTrigger = cbTrigger->isChecked() ? 1 : 0;
+    window->getDevice()->Configure(s, list);
+}
+
+void Generator::LoadList()
+{
+    auto filename = QFileDialog::getOpenFileName(nullptr, "Load generator list", "", "Generator list (*.txt *.csv)", nullptr, QFileDialog::DontUseNativeDialog);
+    if(filename.isEmpty()) {
+        // aborted selection
+        return;
+    }
+    ifstream file;
+    file.open(filename.toStdString());
+    if(!file.is_open()) {
+        QMessageBox::warning(this, "Generator list", "Unable to open file");
+        return;
+    }
+    // one entry per line: frequency[Hz] level[dBm] dwell time[s]
+    std::vector<Protocol::GeneratorListEntry> newList;
+    string line;
+    while(getline(file, line)) {
+        // remove comments and separators
+        line = line.substr(0, line.find('#'));
+        replace(line.begin(), line.end(), ',', ' ');
+        istringstream iss(line);
+        double frequency, level, dwell;
+        if(!(iss >> frequency >> level >> dwell)) {
+            // empty or malformed line
+            continue;
+        }
+        if(frequency < Device::Limits().minFreq || frequency > Device::Limits().maxFreq
+                || level < Device::Limits().cdbm_min / 100.0 || level > Device::Limits().cdbm_max / 100.0
+                || dwell <= 0 || dwell > UINT32_MAX / 1000000.0) {
+            QMessageBox::warning(this, "Generator list", "Invalid entry: \"" + QString::fromStdString(line) + "\"");
+            return;
+        }
+        Protocol::GeneratorListEntry e;
+        e.frequency = frequency;
+        e.cdbm_level = level * 100;
+        e.dwell_us = dwell * 1000000;
+        newList.push_back(e);
+    }
+    if(newList.size() == 0 || newList.size() > Protocol::MaxGeneratorListEntries) {
+        QMessageBox::warning(this, "Generator list", "The list must contain between 1 and " + QString::number(Protocol::MaxGeneratorListEntries)
+                             + " entries (got " + QString::number(newList.size()) + ")");
+        return;
+    }
+    list = newList;
+    updateDevice();
+}
+
+void Generator::ClearList()
+{
+    if(list.size() > 0) {
+        list.clear();
+        updateDevice();
+    }
+}
+
+void Generator::NewStep(Protocol::GeneratorStep s)
+{
+    if(list.size() > 0) {
+        lList->setText("Entry " + QString::number(s.entry + 1) + "/" + QString::number(list.size()));
+    }
+}
+
+void Generator::UpdateListStatus()
+{
+    if(list.size() > 0) {
+        lList->setText("List with " + QString::number(list.size()) + " entries");
+    } else {
+        lList->setText("No list");
+    }
+    cbStepStatus->setEnabled(list.size() > 0);
+    cbTrigger->setEnabled(list.size() > 0);
 }
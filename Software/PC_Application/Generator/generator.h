@@ -3,6 +3,9 @@
 
 #include "mode.h"
 #include "signalgenwidget.h"
+#include <QLabel>
+#include <QCheckBox>
+#include <vector>
 
 class Generator : public Mode
 {
@@ -12,8 +15,18 @@ public:
     void initializeDevice() override;
 private slots:
     void updateDevice();
+    // List mode
+    void LoadList();
+    void ClearList();
+    void NewStep(Protocol::GeneratorStep s);
 private:
+    void UpdateListStatus();
+
     SignalgeneratorWidget *central;
+    // if not empty, the device steps through these entries instead of generating the fixed frequency/level
+    std::vector<Protocol::GeneratorListEntry> list;
+    QCheckBox *cbStepStatus, *cbTrigger;
+    QLabel *lList;
 };
 
 #endif // GENERATOR_H
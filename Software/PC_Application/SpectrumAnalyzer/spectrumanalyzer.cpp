@@ -46,6 +46,9 @@ SpectrumAnalyzer::SpectrumAnalyzer(AppWindow *window)
       central(new TileWidget(traceModel))
 {
     averages = 1;
+    settings.FastScan = 0;
+    fastScanThreshold = -80.0;
+    settings.FastScanThreshold = pow(10.0, fastScanThreshold / 20.0 + 7.5);
 
     // Create default traces
     auto tPort1 = new Trace("Port1", Qt::yellow);
@@ -173,6 +176,24 @@ SpectrumAnalyzer::SpectrumAnalyzer(AppWindow *window)
     });
     tb_acq->addWidget(cbSignalID);
 
+    cbFastScan = new QCheckBox("Fast scan");
+    cbFastScan->setToolTip("Scan the span with a wide RBW first and only measure signals above the threshold with the selected RBW");
+    tb_acq->addWidget(cbFastScan);
+    auto sbThreshold = new QSpinBox;
+    sbThreshold->setRange(-120, 0);
+    sbThreshold->setSuffix(" dBm");
+    sbThreshold->setToolTip("Fast scan threshold");
+    sbThreshold->setEnabled(false);
+    connect(cbFastScan, &QCheckBox::toggled, [=](bool enabled) {
+        settings.FastScan = enabled;
+        sbThreshold->setEnabled(enabled);
+        SettingsChanged();
+    });
+    connect(sbThreshold, qOverload<int>(&QSpinBox::valueChanged), this, &SpectrumAnalyzer::SetFastScanThreshold);
+    connect(this, &SpectrumAnalyzer::fastScanThresholdChanged, sbThreshold, &QSpinBox::setValue);
+    sbThreshold->setValue(fastScanThreshold);
+    tb_acq->addWidget(sbThreshold);
+
     window->addToolBar(tb_acq);
     toolbars.insert(tb_acq);
 
@@ -358,6 +379,18 @@ void SpectrumAnalyzer::SetAveraging(unsigned int averages)
     SettingsChanged();
 }
 
+void SpectrumAnalyzer::SetFastScanThreshold(double level)
+{
+    if(level == fastScanThreshold) {
+        return;
+    }
+    fastScanThreshold = level;
+    // same scaling as the received data, see NewDatapoint
+    settings.FastScanThreshold = pow(10.0, level / 20.0 + 7.5);
+    emit fastScanThresholdChanged(level);
+    SettingsChanged();
+}
+
 void SpectrumAnalyzer::UpdateAverageCount()
 {
     lAverages->setText(QString::number(average.getLevel()) + "/");
@@ -394,6 +427,8 @@ void SpectrumAnalyzer::LoadSweepSettings()
     cbDetector->setCurrentIndex(s.value("SADetector", pref.Startup.SA.detector).toInt());
     SetAveraging(s.value("SAAveraging", pref.Startup.SA.averaging).toInt());
     cbSignalID->setChecked(s.value("SASignalID", pref.Startup.SA.signalID).toBool());
+    SetFastScanThreshold(s.value("SAFastScanThreshold", fastScanThreshold).toDouble());
+    cbFastScan->setChecked(s.value("SAFastScan", false).toBool());
 }
 
 void SpectrumAnalyzer::StoreSweepSettings()
@@ -406,4 +441,6 @@ void SpectrumAnalyzer::StoreSweepSettings()
     s.setValue("SADetector", settings.Detector);
     s.setValue("SAAveraging", averages);
     s.setValue("SASignalID", static_cast<bool>(settings.SignalID));
+    s.setValue("SAFastScan", static_cast<bool>(settings.FastScan));
+    s.setValue("SAFastScanThreshold", fastScanThreshold);
 }
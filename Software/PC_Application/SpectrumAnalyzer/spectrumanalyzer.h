@@ -31,6 +31,7 @@ private slots:
     // Acquisition control
     void SetRBW(double bandwidth);
     void SetAveraging(unsigned int averages);
+    void SetFastScanThreshold(double level);
 
 signals:
 
@@ -43,12 +44,13 @@ private:
 
     Protocol::SpectrumAnalyzerSettings  settings;
     unsigned int averages;
+    double fastScanThreshold;
     TraceModel traceModel;
     TraceMarkerModel *markerModel;
     Averaging average;
 
     TileWidget *central;
-    QCheckBox *cbSignalID;
+    QCheckBox *cbSignalID, *cbFastScan;
     QComboBox *cbWindowType, *cbDetector;
     QLabel *lAverages;
 
@@ -61,6 +63,7 @@ signals:
     void RBWChanged(double RBW);
 
     void averagingChanged(unsigned int averages);
+    void fastScanThresholdChanged(double level);
 };
 
 #endif // VNA_H
@@ -1,6 +1,7 @@
 #include "impedancematchdialog.h"
 #include "ui_impedancematchdialog.h"
 #include "Tools/eseries.h"
+#include "conversion.h"
 
 using namespace std;
 
@@ -67,7 +68,7 @@ void ImpedanceMatchDialog::on_cSource_currentIndexChanged(int index)
         auto m = qvariant_cast<TraceMarker*>(ui->cSource->itemData(index));
         ui->rbSeries->setChecked(true);
         auto data = m->getData();
-        auto reflection = Z0 * (1.0 + data) / (1.0 - data);
+        auto reflection = Conversion::Impedance(data, Z0);
         ui->zReal->setValue(reflection.real());
         ui->zImag->setValue(reflection.imag());
         ui->zFreq->setValue(m->getFrequency());
@@ -238,8 +239,7 @@ void ImpedanceMatchDialog::calculateMatch()
         }
         ui->mReal->setValue(Zmatched.real());
         ui->mImag->setValue(Zmatched.imag());
-        double reflection = abs((Zmatched-Z0)/(Zmatched+Z0));
-        auto loss = 20.0*log10(reflection);
+        auto loss = Conversion::dB((Zmatched-Z0)/(Zmatched+Z0));
         ui->mLoss->setValue(loss);
 
         // set correct image
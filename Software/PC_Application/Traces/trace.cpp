@@ -1,4 +1,5 @@
 #include "trace.h"
+#include "conversion.h"
 
 using namespace std;
 
@@ -7,6 +8,8 @@ Trace::Trace(QString name, QColor color, LiveParameter live)
       _color(color),
       _liveType(LivedataType::Overwrite),
       _liveParam(live),
+      _domain(Domain::Frequency),
+      timeIndex(0),
       reflection(true),
       visible(true),
       paused(false),
@@ -26,19 +29,26 @@ void Trace::clear() {
         return;
     }
     _data.clear();
+    levels.clear();
+    timeIndex = 0;
     emit cleared(this);
     emit dataChanged();
 }
 
 void Trace::addData(Trace::Data d) {
-    // add or replace data in vector while keeping it sorted with increasing frequency
-    auto lower = lower_bound(_data.begin(), _data.end(), d, [](const Data &lhs, const Data &rhs) -> bool {
-        return lhs.frequency < rhs.frequency;
+    if(_domain == Domain::Time) {
+        addTimeData(d);
+        return;
+    }
+    // add or replace data in vector while keeping it sorted with increasing frequency (or power)
+    auto lower = lower_bound(_data.begin(), _data.end(), d, [this](const Data &lhs, const Data &rhs) -> bool {
+        return key(lhs) < key(rhs);
     });
     if(lower == _data.end()) {
         // highest frequency yet, add to vector
         _data.push_back(d);
-    } else if(lower->frequency == d.frequency) {
+        levels.update(_data, _data.size() - 1);
+    } else if(key(*lower) == key(d)) {
         switch(_liveType) {
         case LivedataType::Overwrite:
             // replace this data element
@@ -57,15 +67,52 @@ void Trace::addData(Trace::Data d) {
             }
             break;
         }
-
+        levels.update(_data, lower - _data.begin());
     } else {
-        // insert at this position
+        // insert at this position, all following samples move
         _data.insert(lower, d);
+        levels.invalidate();
     }
     emit dataAdded(this, d);
     emit dataChanged();
 }
 
+void Trace::setData(std::vector<Trace::Data> data)
+{
+    _data = move(data);
+    levels.invalidate();
+    timeIndex = 0;
+    emit dataChanged();
+}
+
+void Trace::addTimeData(Trace::Data d)
+{
+    // the samples of a zero span sweep arrive in chronological order. Each sweep starts at zero again and
+    // replaces the samples of the previous sweep one by one
+    if(timeIndex > 0 && timeIndex <= _data.size() && d.time < _data[timeIndex - 1].time) {
+        timeIndex = 0;
+    }
+    if(timeIndex >= _data.size()) {
+        _data.push_back(d);
+        levels.update(_data, _data.size() - 1);
+    } else {
+        auto &old = _data[timeIndex];
+        bool replace = false;
+        switch(_liveType) {
+        case LivedataType::Overwrite: replace = true; break;
+        case LivedataType::MaxHold: replace = abs(d.S) > abs(old.S); break;
+        case LivedataType::MinHold: replace = abs(d.S) < abs(old.S); break;
+        }
+        if(replace) {
+            old = d;
+            levels.update(_data, timeIndex);
+        }
+    }
+    timeIndex++;
+    emit dataAdded(this, d);
+    emit dataChanged();
+}
+
 void Trace::setName(QString name) {
     _name = name;
     emit nameChanged();
@@ -76,16 +123,17 @@ void Trace::fillFromTouchstone(Touchstone &t, unsigned int parameter, QString fi
     if(parameter >= t.ports()*t.ports()) {
         throw runtime_error("Parameter for touchstone out of range");
     }
-    clear();
+    _domain = Domain::Frequency;
     setTouchstoneParameter(parameter);
     setTouchstoneFilename(filename);
+    // touchstone data is already sorted by frequency
+    vector<Data> data(t.points());
     for(unsigned int i=0;i<t.points();i++) {
-        auto tData = t.point(i);
-        Data d;
-        d.frequency = tData.frequency;
-        d.S = t.point(i).S[parameter];
-        addData(d);
+        const auto &tData = t.point(i);
+        data[i].frequency = tData.frequency;
+        data[i].S = tData.S[parameter];
     }
+    setData(move(data));
     // check if parameter is square (e.i. S11/S22/S33/...)
     parameter++;
     bool isSquare = false;
@@ -119,6 +167,20 @@ void Trace::fromLivedata(Trace::LivedataType type, LiveParameter param)
     emit typeChanged(this);
 }
 
+void Trace::setDomain(Trace::Domain domain)
+{
+    if(domain != _domain) {
+        // data is sorted differently in the other domain, start over (even if paused)
+        _data.clear();
+        levels.clear();
+        timeIndex = 0;
+        _domain = domain;
+        emit cleared(this);
+        emit dataChanged();
+        emit typeChanged(this);
+    }
+}
+
 void Trace::setColor(QColor color) {
     if(_color != color) {
         _color = color;
@@ -203,17 +265,25 @@ bool Trace::isReflection()
 
 double Trace::findExtremumFreq(bool max)
 {
-    double compare = max ? numeric_limits<double>::min() : numeric_limits<double>::max();
-    double freq = 0.0;
-    for(auto d : _data) {
-        double amplitude = abs(d.S);
-        if((max && (amplitude > compare)) || (!max && (amplitude < compare))) {
-            // higher/lower extremum found
-            compare = amplitude;
-            freq = d.frequency;
-        }
+    if(_data.size() == 0) {
+        return 0.0;
     }
-    return freq;
+    return _data[findExtremumIndex(max, 0, _data.size() - 1)].frequency;
+}
+
+unsigned int Trace::findExtremumIndex(bool max, unsigned int from, unsigned int to)
+{
+    return levelIndex().extremum(max, from, to);
+}
+
+int Trace::findLevelCrossing(unsigned int index, double level, bool upwards)
+{
+    return levelIndex().findBelow(index, level, upwards);
+}
+
+double Trace::magnitude(unsigned int index)
+{
+    return levelIndex().level(index);
 }
 
 std::vector<double> Trace::findPeakFrequencies(unsigned int maxPeaks, double minLevel, double minValley)
@@ -226,11 +296,12 @@ std::vector<double> Trace::findPeakFrequencies(unsigned int maxPeaks, double min
     double frequency = 0.0;
     double max_dbm = -200.0;
     double min_dbm = 200.0;
-    for(auto d : _data) {
-        double dbm = 20*log10(abs(d.S));
+    auto &cached = levelIndex();
+    for(unsigned int i=0;i<_data.size();i++) {
+        double dbm = cached.level(i);
         if((dbm >= max_dbm) && (min_dbm <= dbm - minValley)) {
             // potential peak frequency
-            frequency = d.frequency;
+            frequency = _data[i].frequency;
             max_dbm = dbm;
         }
         if(dbm <= min_dbm) {
@@ -282,19 +353,19 @@ unsigned int Trace::getTouchstoneParameter() const
     return touchstoneParameter;
 }
 
-std::complex<double> Trace::getData(double frequency)
+std::complex<double> Trace::getData(double x)
 {
-    if(_data.size() == 0 || frequency < minFreq() || frequency > maxFreq()) {
+    if(_data.size() == 0 || x < key(_data.front()) || x > key(_data.back())) {
         return std::numeric_limits<std::complex<double>>::quiet_NaN();
     }
 
-    return sample(index(frequency)).S;
+    return sample(index(x)).S;
 }
 
-int Trace::index(double frequency)
+int Trace::index(double x)
 {
-    auto lower = lower_bound(_data.begin(), _data.end(), frequency, [](const Data &lhs, const double freq) -> bool {
-        return lhs.frequency < freq;
+    auto lower = lower_bound(_data.begin(), _data.end(), x, [this](const Data &lhs, const double value) -> bool {
+        return key(lhs) < value;
     });
     return lower - _data.begin();
 }
@@ -303,3 +374,134 @@ void Trace::setTouchstoneParameter(int value)
 {
     touchstoneParameter = value;
 }
+
+constexpr unsigned int Trace::LevelIndex::none;
+
+Trace::LevelIndex &Trace::levelIndex()
+{
+    if(!levels.isValid()) {
+        levels.rebuild(_data);
+    }
+    return levels;
+}
+
+void Trace::LevelIndex::clear()
+{
+    valid = true;
+    samples = 0;
+    leaves = 0;
+    levels.clear();
+    maxNodes.clear();
+    minNodes.clear();
+}
+
+void Trace::LevelIndex::rebuild(const std::vector<Trace::Data> &data)
+{
+    samples = data.size();
+    leaves = 1;
+    while(leaves < samples) {
+        leaves *= 2;
+    }
+    levels.assign(leaves, numeric_limits<double>::quiet_NaN());
+    maxNodes.assign(2 * leaves, none);
+    minNodes.assign(2 * leaves, none);
+    vector<complex<double>> S(samples);
+    for(unsigned int i=0;i<samples;i++) {
+        S[i] = data[i].S;
+        maxNodes[leaves + i] = minNodes[leaves + i] = i;
+    }
+    Conversion::MagnitudeDB(S.data(), levels.data(), samples);
+    for(unsigned int n=leaves-1;n>=1;n--) {
+        maxNodes[n] = pick(maxNodes[2*n], maxNodes[2*n+1], true);
+        minNodes[n] = pick(minNodes[2*n], minNodes[2*n+1], false);
+    }
+    valid = true;
+}
+
+void Trace::LevelIndex::update(const std::vector<Trace::Data> &data, unsigned int index)
+{
+    if(!valid) {
+        // rebuilt on the next query anyway
+        return;
+    }
+    if(data.size() > leaves) {
+        // tree is full, rebuild with twice the size
+        rebuild(data);
+        return;
+    }
+    samples = data.size();
+    Conversion::MagnitudeDB(&data[index].S, &levels[index], 1);
+    maxNodes[leaves + index] = minNodes[leaves + index] = index;
+    for(unsigned int n=(leaves + index)/2;n>=1;n/=2) {
+        maxNodes[n] = pick(maxNodes[2*n], maxNodes[2*n+1], true);
+        minNodes[n] = pick(minNodes[2*n], minNodes[2*n+1], false);
+    }
+}
+
+unsigned int Trace::LevelIndex::extremum(bool max, unsigned int from, unsigned int to)
+{
+    auto &nodes = max ? maxNodes : minNodes;
+    unsigned int best = none;
+    for(unsigned int l = leaves + from, r = leaves + to + 1;l < r;l /= 2, r /= 2) {
+        if(l & 1) {
+            best = pick(best, nodes[l++], max);
+        }
+        if(r & 1) {
+            best = pick(best, nodes[--r], max);
+        }
+    }
+    // only NaN samples in the range, fall back to the first one
+    return best == none ? from : best;
+}
+
+int Trace::LevelIndex::findBelow(unsigned int from, double level, bool upwards)
+{
+    if(from >= samples) {
+        return -1;
+    }
+    return findBelow(1, 0, leaves - 1, from, level, upwards);
+}
+
+unsigned int Trace::LevelIndex::pick(unsigned int a, unsigned int b, bool max)
+{
+    if(a == none || std::isnan(levels[a])) {
+        return b;
+    } else if(b == none || std::isnan(levels[b])) {
+        return a;
+    }
+    if((max && levels[b] > levels[a]) || (!max && levels[b] < levels[a]) || (levels[b] == levels[a] && b < a)) {
+        return b;
+    } else {
+        return a;
+    }
+}
+
+int Trace::LevelIndex::findBelow(unsigned int node, unsigned int nodeFrom, unsigned int nodeTo, unsigned int from, double level, bool upwards)
+{
+    if((upwards && nodeTo < from) || (!upwards && nodeFrom > from)) {
+        // node completely outside of the search range
+        return -1;
+    }
+    if(minNodes[node] == none || !(levels[minNodes[node]] <= level)) {
+        // no sample below the level in this node
+        return -1;
+    }
+    if(nodeFrom == nodeTo) {
+        return nodeFrom;
+    }
+    // search the child closer to the start first
+    auto mid = (nodeFrom + nodeTo) / 2;
+    int found;
+    if(upwards) {
+        found = findBelow(2*node, nodeFrom, mid, from, level, upwards);
+        if(found < 0) {
+            found = findBelow(2*node+1, mid+1, nodeTo, from, level, upwards);
+        }
+    } else {
+        found = findBelow(2*node+1, mid+1, nodeTo, from, level, upwards);
+        if(found < 0) {
+            found = findBelow(2*node, nodeFrom, mid, from, level, upwards);
+        }
+    }
+    return found;
+}
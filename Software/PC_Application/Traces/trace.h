@@ -6,6 +6,7 @@
 #include <map>
 #include <QColor>
 #include <set>
+#include <limits>
 #include "touchstone.h"
 
 class TraceMarker;
@@ -18,9 +19,21 @@ public:
     class Data {
     public:
         double frequency;
+        // time since the start of the sweep in seconds (only used by time domain traces)
+        double time = 0.0;
+        // excitation level in dBm (only used by power domain traces)
+        double power = 0.0;
         std::complex<double> S;
     };
 
+    // Quantity along which the data is sorted. Time domain traces contain the measurements of a zero span sweep,
+    // power domain traces the measurements of a power sweep
+    enum class Domain {
+        Frequency,
+        Time,
+        Power,
+    };
+
     enum class LiveParameter {
         S11,
         S12,
@@ -42,9 +55,21 @@ public:
 
     void clear();
     void addData(Data d);
+    // Replaces all data at once (must be sorted along the domain), emits dataChanged only once
+    void setData(std::vector<Data> data);
     void setName(QString name);
     void fillFromTouchstone(Touchstone &t, unsigned int parameter, QString filename = QString());
     void fromLivedata(LivedataType type, LiveParameter param);
+    void setDomain(Domain domain);
+    Domain domain() { return _domain; }
+    // position of a sample in the domain of this trace
+    double key(const Data &d) {
+        switch(_domain) {
+        case Domain::Time: return d.time;
+        case Domain::Power: return d.power;
+        default: return d.frequency;
+        }
+    }
     QString name() { return _name; };
     QColor color() { return _color; };
     bool isVisible();
@@ -61,6 +86,13 @@ public:
     double minFreq() { return _data.front().frequency; };
     double maxFreq() { return _data.back().frequency; };
     double findExtremumFreq(bool max);
+    // index of the sample with the highest/lowest magnitude within [from, to] (logarithmic in the trace size)
+    unsigned int findExtremumIndex(bool max, unsigned int from, unsigned int to);
+    // Searches for the first sample at or below level (in dB), starting at index and moving towards higher indices
+    // (upwards) or lower indices. Returns -1 if there is no such sample
+    int findLevelCrossing(unsigned int index, double level, bool upwards);
+    // magnitude of a sample in dB
+    double magnitude(unsigned int index);
     /* Searches for peaks in the trace data and returns the peak frequencies in ascending order.
      * Up to maxPeaks will be returned, with higher level peaks taking priority over lower level peaks.
      * Only peaks with at least minLevel will be considered.
@@ -70,8 +102,9 @@ public:
     Data sample(unsigned int index) { return _data.at(index); }
     QString getTouchstoneFilename() const;
     unsigned int getTouchstoneParameter() const;
-    std::complex<double> getData(double frequency);
-    int index(double frequency);
+    // frequency, time or power, depending on the domain
+    std::complex<double> getData(double x);
+    int index(double x);
     std::set<TraceMarker *> getMarkers() const;
     void setCalibration(bool value);
     void setReflection(bool value);
@@ -98,7 +131,41 @@ signals:
     void markerRemoved(TraceMarker *m);
 
 private:
+    // Segment tree over the magnitude of the samples (in dB). Kept up to date sample by sample while the data
+    // arrives, only rebuilt completely when samples have been shifted (insertion in the middle of the trace)
+    class LevelIndex {
+    public:
+        void clear();
+        void rebuild(const std::vector<Data> &data);
+        // the sample at index has been replaced or appended
+        void update(const std::vector<Data> &data, unsigned int index);
+        void invalidate() { valid = false; }
+        bool isValid() { return valid; }
+        double level(unsigned int index) { return levels[index]; }
+        unsigned int extremum(bool max, unsigned int from, unsigned int to);
+        int findBelow(unsigned int from, double level, bool upwards);
+    private:
+        static constexpr unsigned int none = std::numeric_limits<unsigned int>::max();
+        // index of the higher/lower sample (the lower index on equal levels)
+        unsigned int pick(unsigned int a, unsigned int b, bool max);
+        int findBelow(unsigned int node, unsigned int nodeFrom, unsigned int nodeTo, unsigned int from, double level, bool upwards);
+        bool valid = true;
+        unsigned int samples = 0;
+        // number of leaves, power of two
+        unsigned int leaves = 0;
+        std::vector<double> levels;
+        // node 1 is the root, the children of node n are 2n and 2n+1. Leaves start at index leaves
+        std::vector<unsigned int> maxNodes, minNodes;
+    };
+    LevelIndex &levelIndex();
+
+    void addTimeData(Data d);
+
     std::vector<Data> _data;
+    LevelIndex levels;
+    Domain _domain;
+    // position of the next time domain sample, starts again at the beginning with every sweep
+    unsigned int timeIndex;
     QString _name;
     QColor _color;
     LivedataType _liveType;
@@ -13,6 +13,7 @@
 #include <qwt_picker_machine.h>
 #include "bodeplotaxisdialog.h"
 #include <preferences.h>
+#include "conversion.h"
 
 using namespace std;
 
@@ -20,13 +21,9 @@ set<TraceBodePlot*> TraceBodePlot::allPlots;
 
 static double AxisTransformation(TraceBodePlot::YAxisType type, complex<double> data) {
     switch(type) {
-    case TraceBodePlot::YAxisType::Magnitude: return 20*log10(abs(data)); break;
-    case TraceBodePlot::YAxisType::Phase: return arg(data) * 180.0 / M_PI; break;
-    case TraceBodePlot::YAxisType::VSWR:
-        if(abs(data) < 1.0) {
-            return (1+abs(data)) / (1-abs(data));
-        }
-        break;
+    case TraceBodePlot::YAxisType::Magnitude: return Conversion::dB(data); break;
+    case TraceBodePlot::YAxisType::Phase: return Conversion::Phase(data); break;
+    case TraceBodePlot::YAxisType::VSWR: return Conversion::VSWR(data); break;
     default: break;
     }
     return numeric_limits<double>::quiet_NaN();
@@ -43,8 +40,13 @@ public:
     QPointF sample(size_t i) const override {
         Trace::Data d = t.sample(i);
         QPointF p;
-        p.setX(d.frequency);
-        p.setY(AxisTransformation(E, d.S));
+        p.setX(t.key(d));
+        if(E == TraceBodePlot::YAxisType::Magnitude) {
+            // already converted by the trace
+            p.setY(t.magnitude(i));
+        } else {
+            p.setY(AxisTransformation(E, d.S));
+        }
         return p;
     }
     QRectF boundingRect() const override {
@@ -276,6 +278,7 @@ void TraceBodePlot::enableTraceAxis(Trace *t, int axis, bool enabled)
             connect(t, &Trace::colorChanged, this, &TraceBodePlot::traceColorChanged);
             connect(t, &Trace::visibilityChanged, this, &TraceBodePlot::traceColorChanged);
             connect(t, &Trace::visibilityChanged, this, &TraceBodePlot::triggerReplot);
+            connect(t, &Trace::typeChanged, this, &TraceBodePlot::updateXAxis);
             if(axis == 0) {
                 connect(t, &Trace::markerAdded, this, &TraceBodePlot::markerAdded);
                 connect(t, &Trace::markerRemoved, this, &TraceBodePlot::markerRemoved);
@@ -299,6 +302,7 @@ void TraceBodePlot::enableTraceAxis(Trace *t, int axis, bool enabled)
                 disconnect(t, &Trace::colorChanged, this, &TraceBodePlot::traceColorChanged);
                 disconnect(t, &Trace::visibilityChanged, this, &TraceBodePlot::traceColorChanged);
                 disconnect(t, &Trace::visibilityChanged, this, &TraceBodePlot::triggerReplot);
+                disconnect(t, &Trace::typeChanged, this, &TraceBodePlot::updateXAxis);
             }
             if(axis == 0) {
                 disconnect(t, &Trace::markerAdded, this, &TraceBodePlot::markerAdded);
@@ -311,6 +315,7 @@ void TraceBodePlot::enableTraceAxis(Trace *t, int axis, bool enabled)
         }
 
         updateContextMenu();
+        updateXAxis();
         replot();
     }
 }
@@ -331,9 +336,24 @@ bool TraceBodePlot::supported(Trace *t, TraceBodePlot::YAxisType type)
     return true;
 }
 
+bool TraceBodePlot::frequencyDomain()
+{
+    for(int axis = 0;axis < 2;axis++) {
+        for(auto t : tracesAxis[axis]) {
+            if(t->domain() != Trace::Domain::Frequency) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 void TraceBodePlot::updateXAxis()
 {
-    if(XAxis.autorange && sweep_fmax-sweep_fmin > 0) {
+    if(XAxis.autorange && !frequencyDomain()) {
+        // zero span or power sweep, the range is only known from the received data
+        plot->setAxisAutoScale(QwtPlot::xBottom, true);
+    } else if(XAxis.autorange && sweep_fmax-sweep_fmin > 0) {
         QList<double> tickList;
         for(double tick = sweep_fmin;tick <= sweep_fmax;tick+= (sweep_fmax-sweep_fmin)/10) {
             tickList.append(tick);
@@ -67,6 +67,8 @@ private:
     QString AxisTypeToName(YAxisType type);
     void enableTraceAxis(Trace *t, int axis, bool enabled);
     bool supported(Trace *t, YAxisType type);
+    // none of the displayed traces contains time or power domain data
+    bool frequencyDomain();
     void updateXAxis();
     QwtSeriesData<QPointF> *createQwtSeriesData(Trace &t, int axis);
 
@@ -7,6 +7,7 @@
 #include <QDebug>
 #include "tracemarkermodel.h"
 #include "unit.h"
+#include "conversion.h"
 
 using namespace std;
 
@@ -71,8 +72,7 @@ QString TraceMarker::readableData()
     case Type::Manual:
     case Type::Maximum:
     case Type::Minimum: {
-        auto phase = arg(data);
-        return QString::number(toDecibel(), 'g', 4) + "db@" + QString::number(phase*180/M_PI, 'g', 4);
+        return QString::number(toDecibel(), 'g', 4) + "db@" + QString::number(Conversion::Phase(data), 'g', 4);
     }
     case Type::Delta:
         if(!delta) {
@@ -81,8 +81,7 @@ QString TraceMarker::readableData()
             // calculate difference between markers
             auto freqDiff = frequency - delta->frequency;
             auto valueDiff = data / delta->data;
-            auto phase = arg(valueDiff);
-            return Unit::ToString(freqDiff, "Hz", " kMG") + " / " + QString::number(toDecibel(), 'g', 4) + "db@" + QString::number(phase*180/M_PI, 'g', 4);
+            return Unit::ToString(freqDiff, "Hz", " kMG") + " / " + QString::number(toDecibel(), 'g', 4) + "db@" + QString::number(Conversion::Phase(valueDiff), 'g', 4);
         }
     case Type::Lowpass:
     case Type::Highpass:
@@ -317,7 +316,7 @@ void TraceMarker::setType(TraceMarker::Type t)
 
 double TraceMarker::toDecibel()
 {
-    return 20*log10(abs(data));
+    return Conversion::dB(data);
 }
 
 void TraceMarker::setNumber(int value)
@@ -461,25 +460,15 @@ void TraceMarker::update()
             break;
         } else {
             // find the maximum
-            auto peakFreq = parentTrace->findExtremumFreq(true);
+            auto peakIndex = parentTrace->findExtremumIndex(true, 0, parentTrace->size() - 1);
             // this marker shows the insertion loss
-            setFrequency(peakFreq);
+            setFrequency(parentTrace->sample(peakIndex).frequency);
             // find the cutoff frequency
-            auto index = parentTrace->index(peakFreq);
-            auto peakAmplitude = 20*log10(abs(parentTrace->sample(index).S));
-            auto cutoff = peakAmplitude + cutoffAmplitude;
-            int inc = type == Type::Lowpass ? 1 : -1;
-            while(index >= 0 && index < (int) parentTrace->size()) {
-                auto amplitude = 20*log10(abs(parentTrace->sample(index).S));
-                if(amplitude <= cutoff) {
-                    break;
-                }
-                index += inc;
-            }
+            auto cutoff = parentTrace->magnitude(peakIndex) + cutoffAmplitude;
+            auto index = parentTrace->findLevelCrossing(peakIndex, cutoff, type == Type::Lowpass);
             if(index < 0) {
-                index = 0;
-            } else if(index >= (int) parentTrace->size()) {
-                index = parentTrace->size() - 1;
+                // trace never drops below the cutoff level, use the end of the trace
+                index = type == Type::Lowpass ? parentTrace->size() - 1 : 0;
             }
             // set position of cutoff marker
             helperMarkers[0]->setFrequency(parentTrace->sample(index).frequency);
@@ -491,37 +480,21 @@ void TraceMarker::update()
             break;
         } else {
             // find the maximum
-            auto peakFreq = parentTrace->findExtremumFreq(true);
+            auto peakIndex = parentTrace->findExtremumIndex(true, 0, parentTrace->size() - 1);
             // this marker shows the insertion loss
-            setFrequency(peakFreq);
+            setFrequency(parentTrace->sample(peakIndex).frequency);
             // find the cutoff frequencies
-            auto index = parentTrace->index(peakFreq);
-            auto peakAmplitude = 20*log10(abs(parentTrace->sample(index).S));
-            auto cutoff = peakAmplitude + cutoffAmplitude;
-
-            auto low_index = index;
-            while(low_index >= 0) {
-                auto amplitude = 20*log10(abs(parentTrace->sample(low_index).S));
-                if(amplitude <= cutoff) {
-                    break;
-                }
-                low_index--;
-            }
+            auto cutoff = parentTrace->magnitude(peakIndex) + cutoffAmplitude;
+
+            auto low_index = parentTrace->findLevelCrossing(peakIndex, cutoff, false);
             if(low_index < 0) {
                 low_index = 0;
             }
             // set position of cutoff marker
             helperMarkers[0]->setFrequency(parentTrace->sample(low_index).frequency);
 
-            auto high_index = index;
-            while(high_index < (int) parentTrace->size()) {
-                auto amplitude = 20*log10(abs(parentTrace->sample(high_index).S));
-                if(amplitude <= cutoff) {
-                    break;
-                }
-                high_index++;
-            }
-            if(high_index >= (int) parentTrace->size()) {
+            auto high_index = parentTrace->findLevelCrossing(peakIndex, cutoff, true);
+            if(high_index < 0) {
                 high_index = parentTrace->size() - 1;
             }
             // set position of cutoff marker
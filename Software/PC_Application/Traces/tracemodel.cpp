@@ -4,13 +4,18 @@
 using namespace std;
 
 TraceModel::TraceModel(QObject *parent)
-    : QAbstractTableModel(parent)
+    : QAbstractTableModel(parent),
+      liveDomain(Trace::Domain::Frequency),
+      sweepStartUs(0)
 {
     traces.clear();
 }
 
 void TraceModel::addTrace(Trace *t)
 {
+    if(t->isLive()) {
+        t->setDomain(liveDomain);
+    }
     beginInsertRows(QModelIndex(), traces.size(), traces.size());
     traces.push_back(t);
     endInsertRows();
@@ -127,6 +132,16 @@ bool TraceModel::PortExcitationRequired(int port)
     return false;
 }
 
+void TraceModel::setLiveDomain(Trace::Domain domain)
+{
+    liveDomain = domain;
+    for(auto t : traces) {
+        if(t->isLive()) {
+            t->setDomain(domain);
+        }
+    }
+}
+
 void TraceModel::clearVNAData()
 {
     for(auto t : traces) {
@@ -139,10 +154,17 @@ void TraceModel::clearVNAData()
 
 void TraceModel::addVNAData(Protocol::Datapoint d)
 {
+    if(d.pointNum == 0) {
+        sweepStartUs = d.us;
+    }
+    // the device timestamp wraps around, the difference is still correct
+    double time = (uint32_t) (d.us - sweepStartUs) / 1000000.0;
     for(auto t : traces) {
         if (t->isLive() && !t->isPaused()) {
             Trace::Data td;
             td.frequency = d.frequency;
+            td.time = time;
+            td.power = d.cdbm / 100.0;
             switch(t->liveParameter()) {
             case Trace::LiveParameter::S11: td.S = complex<double>(d.real_S11, d.imag_S11); break;
             case Trace::LiveParameter::S12: td.S = complex<double>(d.real_S12, d.imag_S12); break;
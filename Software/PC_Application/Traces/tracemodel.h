@@ -25,6 +25,8 @@ public:
     std::vector<Trace*> getTraces();
 
     bool PortExcitationRequired(int port);
+    // Domain of all live traces, time domain for zero span sweeps and power domain for power sweeps
+    void setLiveDomain(Trace::Domain domain);
 
 signals:
     void SpanChanged(double fmin, double fmax);
@@ -39,6 +41,9 @@ public slots:
 
 private:
     std::vector<Trace*> traces;
+    Trace::Domain liveDomain;
+    // device timestamp of the first point in the current sweep
+    uint32_t sweepStartUs;
 };
 
 #endif // TRACEMODEL_H
@@ -8,15 +8,47 @@
 
 using namespace std;
 
+set<TraceSmithChart*> TraceSmithChart::allCharts;
+
 TraceSmithChart::TraceSmithChart(TraceModel &model, QWidget *parent)
     : TracePlot(parent)
 {
+    selectedMarker = nullptr;
+    gridValid = false;
+    plotToPixelXOffset = plotToPixelYOffset = 0.0;
+    plotToPixelXScale = plotToPixelYScale = 1.0;
     chartLinesPen = QPen(palette().windowText(), 0.75);
     thinPen = QPen(palette().windowText(), 0.25);
     textPen = QPen(palette().windowText(), 0.25);
     pointDataPen = QPen(QColor("red"), 4.0, Qt::SolidLine, Qt::RoundCap);
     lineDataPen = QPen(QColor("blue"), 1.0);
     initializeTraceInfo(model);
+    allCharts.insert(this);
+}
+
+TraceSmithChart::~TraceSmithChart()
+{
+    allCharts.erase(this);
+}
+
+void TraceSmithChart::enableTrace(Trace *t, bool enabled)
+{
+    TracePlot::enableTrace(t, enabled);
+    if(enabled) {
+        connect(t, &Trace::dataChanged, this, &TraceSmithChart::traceDataChanged, Qt::UniqueConnection);
+        traceCoordinates[t].valid = false;
+    } else {
+        disconnect(t, &Trace::dataChanged, this, &TraceSmithChart::traceDataChanged);
+        traceCoordinates.erase(t);
+    }
+}
+
+void TraceSmithChart::updateGraphColors()
+{
+    for(auto c : allCharts) {
+        c->gridValid = false;
+        c->update();
+    }
 }
 
 QPoint TraceSmithChart::plotToPixel(std::complex<double> S)
@@ -81,7 +113,7 @@ void TraceSmithChart::mouseMoveEvent(QMouseEvent *event)
     }
 }
 
-void TraceSmithChart::draw(QPainter * painter, double width_factor) {
+void TraceSmithChart::drawGrid(QPainter * painter, double width_factor) {
     painter->setPen(QPen(1.0 * width_factor));
     painter->setBrush(palette().windowText());
     painter->setRenderHint(QPainter::Antialiasing);
@@ -119,6 +151,68 @@ void TraceSmithChart::draw(QPainter * painter, double width_factor) {
         rectangle = QRectF(smithCoordMax - radius, 0, 2 * radius, 2 * radius);
         painter->drawArc(rectangle, 1440, span);
     }
+}
+
+void TraceSmithChart::updateGrid()
+{
+    auto pref = Preferences::getInstance();
+    auto ratio = devicePixelRatioF();
+    grid = QPixmap(size() * ratio);
+    grid.setDevicePixelRatio(ratio);
+    grid.fill(pref.General.graphColors.background);
+
+    QPainter painter(&grid);
+    double side = qMin(width(), height()) * screenUsage;
+    painter.setViewport((width()-side)/2, (height()-side)/2, side, side);
+    painter.setWindow(-smithCoordMax, -smithCoordMax, 2*smithCoordMax, 2*smithCoordMax);
+    drawGrid(&painter, 2*smithCoordMax/side);
+
+    gridValid = true;
+}
+
+void TraceSmithChart::updateTraceCoordinates(Trace *t, QPolygonF &polyline)
+{
+    // keeps the capacity, no reallocation unless the trace grew
+    polyline.clear();
+    unsigned int nPoints = t->size();
+    polyline.reserve(nPoints);
+    QPoint lastPixel;
+    for(unsigned int i=0;i<nPoints;i++) {
+        auto S = t->sample(i).S;
+        if(isnan(S.real())) {
+            break;
+        }
+        QPointF point(S.real() * plotToPixelXScale + plotToPixelXOffset, S.imag() * plotToPixelYScale + plotToPixelYOffset);
+        auto pixel = point.toPoint();
+        if(polyline.size() > 0 && pixel == lastPixel) {
+            // still in the same pixel, the line segment would not be visible
+            continue;
+        }
+        polyline.append(point);
+        lastPixel = pixel;
+    }
+}
+
+void TraceSmithChart::replot()
+{
+    update();
+}
+
+void TraceSmithChart::paintEvent(QPaintEvent * /* the event */)
+{
+    double side = qMin(width(), height()) * screenUsage;
+    plotToPixelXOffset = width()/2;
+    plotToPixelYOffset = height()/2;
+    plotToPixelXScale = side/2;
+    plotToPixelYScale = -side/2;
+
+    if(!gridValid) {
+        updateGrid();
+    }
+
+    QPainter painter(this);
+    painter.drawPixmap(0, 0, grid);
+    painter.setRenderHint(QPainter::Antialiasing);
 
     for(auto t : traces) {
         if(!t.second) {
@@ -130,58 +224,42 @@ void TraceSmithChart::draw(QPainter * painter, double width_factor) {
             // trace marked invisible
             continue;
         }
-        painter->setPen(QPen(trace->color(), 1.5 * width_factor));
-        int nPoints = trace->size();
-        for(int i=1;i<nPoints;i++) {
-            auto last = trace->sample(i-1).S;
-            auto now = trace->sample(i).S;
-            if(isnan(now.real())) {
-                break;
-            }
-            // scale to size of smith diagram
-            last *= smithCoordMax;
-            now *= smithCoordMax;
-            // draw line
-            painter->drawLine(std::real(last), -std::imag(last), std::real(now), -std::imag(now));
+        auto &coords = traceCoordinates[trace];
+        if(!coords.valid) {
+            updateTraceCoordinates(trace, coords.polyline);
+            coords.valid = true;
         }
+        painter.setPen(QPen(trace->color(), 1.5));
+        painter.drawPolyline(coords.polyline);
         if(trace->size() > 0) {
             // only draw markers if the trace has at least one point
             auto markers = t.first->getMarkers();
             for(auto m : markers) {
-                auto coords = m->getData();
-                coords *= smithCoordMax;
+                auto point = plotToPixel(m->getData());
                 auto symbol = m->getSymbol();
-                symbol = symbol.scaled(symbol.width()*width_factor, symbol.height()*width_factor);
-                painter->drawPixmap(coords.real() - symbol.width()/2, -coords.imag() - symbol.height(), symbol);
+                painter.drawPixmap(point.x() - symbol.width()/2, point.y() - symbol.height(), symbol);
             }
         }
     }
 }
 
-void TraceSmithChart::replot()
+void TraceSmithChart::resizeEvent(QResizeEvent *event)
 {
-    update();
+    // grid and trace coordinates depend on the chart size
+    gridValid = false;
+    for(auto &c : traceCoordinates) {
+        c.second.valid = false;
+    }
+    TracePlot::resizeEvent(event);
 }
 
-void TraceSmithChart::paintEvent(QPaintEvent * /* the event */)
+void TraceSmithChart::traceDataChanged()
 {
-    auto pref = Preferences::getInstance();
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
-    painter.setBackground(QBrush(pref.General.graphColors.background));
-    painter.fillRect(0, 0, width(), height(), QBrush(pref.General.graphColors.background));
-
-    double side = qMin(width(), height()) * screenUsage;
-
-    painter.setViewport((width()-side)/2, (height()-side)/2, side, side);
-    painter.setWindow(-smithCoordMax, -smithCoordMax, 2*smithCoordMax, 2*smithCoordMax);
-
-    plotToPixelXOffset = width()/2;
-    plotToPixelYOffset = height()/2;
-    plotToPixelXScale = side/2;
-    plotToPixelYScale = -side/2;
-
-    draw(&painter, 2*smithCoordMax/side);
+    auto t = qobject_cast<Trace*>(sender());
+    auto it = traceCoordinates.find(t);
+    if(it != traceCoordinates.end()) {
+        it->second.valid = false;
+    }
 }
 
 bool TraceSmithChart::supported(Trace *t)
@@ -3,12 +3,19 @@
 
 #include "traceplot.h"
 #include <QPen>
+#include <QPixmap>
+#include <QPolygonF>
 
 class TraceSmithChart : public TracePlot
 {
     Q_OBJECT
 public:
     TraceSmithChart(TraceModel &model, QWidget *parent = 0);
+    ~TraceSmithChart();
+
+    void enableTrace(Trace *t, bool enabled) override;
+    // redraws the cached grid of all smith charts (e.g. after the colors have been changed)
+    static void updateGraphColors();
 
 protected:
     static constexpr double ReferenceImpedance = 50.0;
@@ -21,9 +28,14 @@ protected:
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
 
     bool supported(Trace *t) override;
-    void draw(QPainter * painter, double width_factor);
+    void drawGrid(QPainter * painter, double width_factor);
+    // renders the static grid into the cached pixmap
+    void updateGrid();
+    // transforms the trace data into pixel coordinates, consecutive samples within the same pixel are skipped
+    void updateTraceCoordinates(Trace *t, QPolygonF &polyline);
     void replot() override;
     QPen textPen;
     QPen chartLinesPen;
@@ -39,6 +51,23 @@ protected:
     double plotToPixelXOffset, plotToPixelXScale;
     double plotToPixelYOffset, plotToPixelYScale;
     TraceMarker *selectedMarker;
+
+    // the grid only changes on resize or color changes, it is rendered once and then reused for every repaint
+    QPixmap grid;
+    bool gridValid;
+
+    class TraceCoordinates {
+    public:
+        QPolygonF polyline;
+        bool valid = false;
+    };
+    // trace data in pixel coordinates, recalculated only when the trace data or the chart size changes
+    std::map<Trace*, TraceCoordinates> traceCoordinates;
+
+    static std::set<TraceSmithChart*> allCharts;
+
+private slots:
+    void traceDataChanged();
 };
 
 #endif // TRACESMITHCHART_H
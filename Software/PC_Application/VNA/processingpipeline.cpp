@@ -0,0 +1,242 @@
+#include "processingpipeline.h"
+#include "conversion.h"
+#include <limits>
+#include <cmath>
+
+using namespace std;
+
+ProcessingPipeline::ProcessingPipeline()
+    : currentGeneration(0),
+      averages(1),
+      averagingGeneration(0),
+      resultsSignalled(false),
+      running(true)
+{
+    // created from the end of the pipeline, each stage needs its successor
+    averagingStage = make_unique<Stage>("Averaging", [=](Item &i){ average(i); }, [=](Item &i){ publish(i); });
+    correctionStage = make_unique<Stage>("Correction", [=](Item &i){ correct(i); }, [=](Item &i){ averagingStage->push(i); });
+    decodeStage = make_unique<Stage>("Decode", [=](Item &i){ decode(i); }, [=](Item &i){ correctionStage->push(i); });
+}
+
+ProcessingPipeline::~ProcessingPipeline()
+{
+    // no more results are handed off, unblocks the last stage if the output is full
+    running = false;
+    decodeStage.reset();
+    correctionStage.reset();
+    averagingStage.reset();
+}
+
+void ProcessingPipeline::addDatapoint(const Protocol::Datapoint &d)
+{
+    Item item;
+    item.result.measured = d;
+    item.isRaw = false;
+    item.result.generation = currentGeneration;
+    item.queued = chrono::steady_clock::now();
+    decodeStage->push(item);
+}
+
+void ProcessingPipeline::addRawDatapoints(const std::vector<Protocol::RawDatapoint> &raw)
+{
+    Item item;
+    item.isRaw = true;
+    item.result.generation = currentGeneration;
+    item.queued = chrono::steady_clock::now();
+    for(auto &r : raw) {
+        item.raw = r;
+        decodeStage->push(item);
+    }
+}
+
+void ProcessingPipeline::setAverages(unsigned int averages)
+{
+    this->averages = averages;
+}
+
+void ProcessingPipeline::setCalibration(std::shared_ptr<Calibration> cal)
+{
+    // the previous calibration is deleted as soon as the correction stage drops its last reference
+    atomic_store(&calibration, cal);
+}
+
+void ProcessingPipeline::clearCalibration()
+{
+    atomic_store(&calibration, shared_ptr<Calibration>());
+}
+
+void ProcessingPipeline::reset()
+{
+    currentGeneration++;
+}
+
+void ProcessingPipeline::takeResults(std::vector<ProcessingPipeline::Result> &results)
+{
+    // clear the flag first, results published from now on trigger another signal
+    resultsSignalled = false;
+    Item item;
+    while(output.pop(item)) {
+        outputStats.add(chrono::steady_clock::now() - item.queued);
+        results.push_back(item.result);
+    }
+}
+
+std::vector<ProcessingPipeline::StageStatistics> ProcessingPipeline::getStatistics()
+{
+    std::vector<StageStatistics> ret;
+    for(auto s : {decodeStage.get(), correctionStage.get(), averagingStage.get()}) {
+        ret.push_back(s->stats.take(s->name, s->queue.size()));
+    }
+    ret.push_back(outputStats.take("Handoff", output.size()));
+    return ret;
+}
+
+void ProcessingPipeline::decode(ProcessingPipeline::Item &item)
+{
+    auto &d = item.result.measured;
+    item.result.minReference = numeric_limits<double>::max();
+    item.result.overload = false;
+    if(!item.isRaw) {
+        // already decoded by the device
+        return;
+    }
+    // calculate the ratios in double precision
+    auto &r = item.raw;
+    d.frequency = r.frequency;
+    d.us = r.us;
+    d.cdbm = r.cdbm;
+    d.pointNum = r.pointNum;
+    complex<double> S[2][2];
+    for(int port=0;port<2;port++) {
+        if(port == 0 ? !r.excitePort1 : !r.excitePort2) {
+            continue;
+        }
+        auto &e = r.excitation[port];
+        auto ref = complex<double>(e.RefI, e.RefQ);
+        // same receiver is used for the reflection (port 1 when exciting port 1) and the transmission
+        S[0][port] = complex<double>(e.P1I, e.P1Q) / ref;
+        S[1][port] = complex<double>(e.P2I, e.P2Q) / ref;
+        auto refLevel = Conversion::dB(ref);
+        if(refLevel < item.result.minReference) {
+            item.result.minReference = refLevel;
+        }
+    }
+    d.real_S11 = S[0][0].real();
+    d.imag_S11 = S[0][0].imag();
+    d.real_S21 = S[1][0].real();
+    d.imag_S21 = S[1][0].imag();
+    d.real_S12 = S[0][1].real();
+    d.imag_S12 = S[0][1].imag();
+    d.real_S22 = S[1][1].real();
+    d.imag_S22 = S[1][1].imag();
+    item.result.overload = r.port1Overload || r.port2Overload || r.refOverload;
+}
+
+void ProcessingPipeline::correct(ProcessingPipeline::Item &item)
+{
+    item.result.processed = item.result.measured;
+    auto cal = atomic_load(&calibration);
+    if(cal) {
+        cal->correctMeasurement(item.result.processed);
+    }
+}
+
+void ProcessingPipeline::average(ProcessingPipeline::Item &item)
+{
+    if(item.result.generation != averagingGeneration) {
+        // first point after a reset, start with a new averaging history
+        averagingGeneration = item.result.generation;
+        averaging.setAverages(averages);
+    }
+    item.result.processed = averaging.process(item.result.processed);
+    item.result.averageLevel = averaging.getLevel();
+}
+
+void ProcessingPipeline::publish(ProcessingPipeline::Item &item)
+{
+    while(!output.push(item)) {
+        if(!running) {
+            return;
+        }
+        // GUI thread is lagging behind
+        this_thread::yield();
+    }
+    if(!resultsSignalled.exchange(true)) {
+        // queued connection, the GUI picks up all results that are available by then
+        emit resultsAvailable();
+    }
+}
+
+void ProcessingPipeline::Statistics::add(std::chrono::steady_clock::duration latency)
+{
+    unsigned long long ns = chrono::duration_cast<chrono::nanoseconds>(latency).count();
+    processed++;
+    latencySum += ns;
+    auto max = latencyMax.load();
+    while(ns > max && !latencyMax.compare_exchange_weak(max, ns));
+}
+
+ProcessingPipeline::StageStatistics ProcessingPipeline::Statistics::take(QString name, unsigned int queueDepth)
+{
+    StageStatistics s;
+    s.name = name;
+    s.queueDepth = queueDepth;
+    s.processed = processed.exchange(0);
+    auto sum = latencySum.exchange(0);
+    s.avgLatency = s.processed > 0 ? sum / 1000.0 / s.processed : 0.0;
+    s.maxLatency = latencyMax.exchange(0) / 1000.0;
+    return s;
+}
+
+ProcessingPipeline::Stage::Stage(QString name, std::function<void (Item &)> process, std::function<void (Item &)> forward)
+    : name(name),
+      process(process),
+      forward(forward),
+      running(true)
+{
+    thread = std::thread(&Stage::run, this);
+}
+
+ProcessingPipeline::Stage::~Stage()
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        running = false;
+    }
+    cv.notify_one();
+    thread.join();
+}
+
+void ProcessingPipeline::Stage::push(const ProcessingPipeline::Item &item)
+{
+    while(!queue.push(item)) {
+        if(!running) {
+            return;
+        }
+        this_thread::yield();
+    }
+    {
+        // synchronize with the check for an empty queue in run(), otherwise the wakeup could get lost
+        lock_guard<mutex> lock(mtx);
+    }
+    cv.notify_one();
+}
+
+void ProcessingPipeline::Stage::run()
+{
+    Item item;
+    while(running) {
+        if(!queue.pop(item)) {
+            unique_lock<mutex> lock(mtx);
+            cv.wait(lock, [=](){
+                return !running || queue.size() > 0;
+            });
+            continue;
+        }
+        process(item);
+        auto now = chrono::steady_clock::now();
+        stats.add(now - item.queued);
+        item.queued = now;
+        forward(item);
+    }
+}
@@ -0,0 +1,178 @@
+#ifndef PROCESSINGPIPELINE_H
+#define PROCESSINGPIPELINE_H
+
+#include <QObject>
+#include "Device/device.h"
+#include "Calibration/calibration.h"
+#include "averaging.h"
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <functional>
+
+// Queue with a fixed capacity for exactly one producer and one consumer thread.
+// Neither push nor pop block or lock, synchronization is done with the head and tail indices only.
+template<typename T, unsigned int capacity>
+class LockFreeQueue {
+    static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+public:
+    LockFreeQueue() : head(0), tail(0), buffer(capacity) {}
+    // producer side, returns false if the queue is full
+    bool push(const T &item) {
+        auto t = tail.load(std::memory_order_relaxed);
+        if(t - head.load(std::memory_order_acquire) >= capacity) {
+            return false;
+        }
+        buffer[t % capacity] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    // consumer side, returns false if the queue is empty
+    bool pop(T &item) {
+        auto h = head.load(std::memory_order_relaxed);
+        if(h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = buffer[h % capacity];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    unsigned int size() {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+private:
+    // free running indices, they wrap around together with the buffer because the capacity is a power of two
+    std::atomic<unsigned int> head, tail;
+    std::vector<T> buffer;
+};
+
+// Processes received VNA datapoints outside of the GUI thread. Every stage runs in its own thread and
+// passes the points on to the next stage through a lock-free queue:
+// Decode (raw receiver values to ratios) -> Correction (calibration) -> Averaging -> GUI handoff
+class ProcessingPipeline : public QObject
+{
+    Q_OBJECT
+public:
+    ProcessingPipeline();
+    ~ProcessingPipeline();
+
+    class Result {
+    public:
+        // ratios as measured, without calibration and averaging (required for calibration measurements)
+        Protocol::Datapoint measured;
+        // corrected and averaged datapoint
+        Protocol::Datapoint processed;
+        // number of sweeps contained in the averaged datapoint
+        unsigned int averageLevel;
+        // only valid for raw datapoints: weakest reference level and ADC overload
+        double minReference;
+        bool overload;
+        // results from before the last reset are outdated and should be ignored
+        unsigned int generation;
+    };
+
+    class StageStatistics {
+    public:
+        QString name;
+        // points waiting in front of this stage
+        unsigned int queueDepth;
+        // points processed since the last call of getStatistics
+        unsigned long processed;
+        // time between entering the queue of this stage and leaving it in us
+        double avgLatency;
+        double maxLatency;
+    };
+
+    // Input of the pipeline, may be called from any single thread (usually the USB thread of the device)
+    void addDatapoint(const Protocol::Datapoint &d);
+    void addRawDatapoints(const std::vector<Protocol::RawDatapoint> &raw);
+
+    // Configuration, all changes take effect at the next reset
+    void setAverages(unsigned int averages);
+    // Replaces the calibration used by the correction stage. The correction stage keeps using the previous calibration
+    // until it has finished the current point, the calibration must not be modified afterwards
+    void setCalibration(std::shared_ptr<Calibration> cal);
+    void clearCalibration();
+    // Discards the averaging history. Points already in the pipeline are marked as outdated
+    void reset();
+    unsigned int generation() { return currentGeneration.load(); }
+
+    // Moves all finished results into the vector (GUI thread only)
+    void takeResults(std::vector<Result> &results);
+    // Statistics of all stages since the last call
+    std::vector<StageStatistics> getStatistics();
+
+signals:
+    // Emitted once when new results are available, no further signal until takeResults has been called
+    void resultsAvailable();
+
+private:
+    static constexpr unsigned int QueueSize = 4096;
+
+    class Item {
+    public:
+        Result result;
+        Protocol::RawDatapoint raw;
+        bool isRaw;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    class Statistics {
+    public:
+        Statistics() : processed(0), latencySum(0), latencyMax(0) {}
+        void add(std::chrono::steady_clock::duration latency);
+        StageStatistics take(QString name, unsigned int queueDepth);
+    private:
+        std::atomic<unsigned long> processed;
+        // in ns
+        std::atomic<unsigned long long> latencySum, latencyMax;
+    };
+
+    class Stage {
+    public:
+        Stage(QString name, std::function<void(Item&)> process, std::function<void(Item&)> forward);
+        ~Stage();
+        // blocks only if the queue of this stage is full
+        void push(const Item &item);
+        QString name;
+        LockFreeQueue<Item, QueueSize> queue;
+        Statistics stats;
+    private:
+        void run();
+        std::function<void(Item&)> process;
+        std::function<void(Item&)> forward;
+        std::atomic<bool> running;
+        // only used to sleep while the queue is empty, the data itself is passed without locking
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::thread thread;
+    };
+
+    void decode(Item &item);
+    void correct(Item &item);
+    void average(Item &item);
+    void publish(Item &item);
+
+    std::atomic<unsigned int> currentGeneration;
+    std::atomic<unsigned int> averages;
+    // calibration used by the correction stage, replaced as a whole by the GUI thread
+    std::shared_ptr<Calibration> calibration;
+
+    // only accessed by the averaging stage
+    Averaging averaging;
+    unsigned int averagingGeneration;
+
+    // finished points, consumed by the GUI thread
+    LockFreeQueue<Item, QueueSize> output;
+    Statistics outputStats;
+    std::atomic<bool> resultsSignalled;
+    std::atomic<bool> running;
+
+    // declared last: stages are destroyed (and their threads stopped) before the data they access
+    std::unique_ptr<Stage> averagingStage, correctionStage, decodeStage;
+};
+
+#endif // PROCESSINGPIPELINE_H
@@ -14,13 +14,17 @@
 #include <QSettings>
 #include <algorithm>
 #include <QMessageBox>
+#include <QInputDialog>
 #include <QFileDialog>
 #include <QFile>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <QDateTime>
 #include "unit.h"
 #include <queue>
+#include <complex>
+#include <limits>
 #include "CustomWidgets/toggleswitch.h"
 #include "Device/manualcontroldialog.h"
 #include "Traces/tracemodel.h"
@@ -47,9 +51,16 @@ VNA::VNA(AppWindow *window)
       central(new TileWidget(traceModel))
 {
     averages = 1;
+    deviceAveraging = false;
+    decimation = 1;
     calValid = false;
     calMeasuring = false;
     calDialog.reset();
+    tuneActive = false;
+    averageLevel = 0;
+    recallingPreset = false;
+    connect(&pipeline, &ProcessingPipeline::resultsAvailable, this, &VNA::NewResults);
+    connect(&calBuilder, &CalibrationBuilder::finished, this, &VNA::CalibrationBuilt);
 
     // Create default traces
     auto tS11 = new Trace("S11", Qt::yellow);
@@ -120,6 +131,14 @@ VNA::VNA(AppWindow *window)
     actions.insert(toolsMenu->menuAction());
     auto impedanceMatching = toolsMenu->addAction("Impedance Matching");
     connect(impedanceMatching, &QAction::triggered, this, &VNA::StartImpedanceMatching);
+    auto settlingAutoTune = toolsMenu->addAction("Auto-tune Settling Time");
+    connect(settlingAutoTune, &QAction::triggered, this, &VNA::StartSettlingAutoTune);
+
+    // Presets menu, populated whenever it is opened
+    presetMenu = new QMenu("Presets");
+    window->menuBar()->insertMenu(window->getUi()->menuWindow->menuAction(), presetMenu);
+    actions.insert(presetMenu->menuAction());
+    connect(presetMenu, &QMenu::aboutToShow, this, &VNA::UpdatePresetMenu);
 
     defaultCalMenu = new QMenu("Default Calibration");
     assignDefaultCal = defaultCalMenu->addAction("Assign...");
@@ -198,6 +217,30 @@ VNA::VNA(AppWindow *window)
     connect(bZoomOut, &QPushButton::clicked, this, &VNA::SpanZoomOut);
     tb_sweep->addWidget(bZoomOut);
 
+    auto cbLogSweep = new QCheckBox("Log");
+    cbLogSweep->setToolTip("Logarithmic frequency spacing");
+    connect(cbLogSweep, &QCheckBox::toggled, this, &VNA::SetLogSweep);
+    connect(this, &VNA::logSweepChanged, cbLogSweep, &QCheckBox::setChecked);
+    tb_sweep->addWidget(cbLogSweep);
+
+    auto cbZeroSpan = new QCheckBox("Zero span");
+    cbZeroSpan->setToolTip("Continuously measure the center frequency and display the measurements over time");
+    connect(cbZeroSpan, &QCheckBox::toggled, this, &VNA::SetZeroSpan);
+    connect(this, &VNA::zeroSpanChanged, cbZeroSpan, &QCheckBox::setChecked);
+    tb_sweep->addWidget(cbZeroSpan);
+
+    auto bSegments = new QToolButton();
+    bSegments->setText("Segments");
+    bSegments->setToolTip("Segmented sweep with individual points, IF bandwidth and level per segment");
+    bSegments->setPopupMode(QToolButton::InstantPopup);
+    auto segmentMenu = new QMenu();
+    connect(segmentMenu->addAction("Load segment table..."), &QAction::triggered, this, &VNA::LoadSegmentTable);
+    connect(segmentMenu->addAction("Load frequency list..."), &QAction::triggered, this, &VNA::LoadFrequencyList);
+    auto segmentClear = segmentMenu->addAction("Clear segments");
+    connect(segmentClear, &QAction::triggered, this, &VNA::ClearSegments);
+    bSegments->setMenu(segmentMenu);
+    tb_sweep->addWidget(bSegments);
+
     window->addToolBar(tb_sweep);
     toolbars.insert(tb_sweep);
 
@@ -215,9 +258,24 @@ VNA::VNA(AppWindow *window)
     tb_acq->addWidget(new QLabel("Level:"));
     tb_acq->addWidget(dbm);
 
+    auto cbPowerSweep = new QCheckBox("Power sweep to");
+    cbPowerSweep->setToolTip("Step the stimulus level from the level to the stop level at the center frequency and display the measurements over the level");
+    connect(cbPowerSweep, &QCheckBox::toggled, this, &VNA::SetPowerSweep);
+    connect(this, &VNA::powerSweepChanged, cbPowerSweep, &QCheckBox::setChecked);
+    tb_acq->addWidget(cbPowerSweep);
+    auto dbmStop = new QDoubleSpinBox();
+    dbmStop->setFixedWidth(95);
+    dbmStop->setRange(-100.0, 100.0);
+    dbmStop->setSingleStep(0.25);
+    dbmStop->setSuffix("dbm");
+    dbmStop->setToolTip("Stop level of the power sweep");
+    connect(dbmStop, qOverload<double>(&QDoubleSpinBox::valueChanged), this, &VNA::SetStopSourceLevel);
+    connect(this, &VNA::stopSourceLevelChanged, dbmStop, &QDoubleSpinBox::setValue);
+    tb_acq->addWidget(dbmStop);
+
     auto points = new QSpinBox();
-    points->setFixedWidth(55);
-    points->setRange(1, 4501);
+    points->setFixedWidth(65);
+    points->setRange(1, Device::Limits().maxPoints);
     points->setValue(settings.points);
     points->setSingleStep(100);
     points->setToolTip("Points/sweep");
@@ -244,6 +302,32 @@ VNA::VNA(AppWindow *window)
     connect(sbAverages, qOverload<int>(&QSpinBox::valueChanged), this, &VNA::SetAveraging);
     connect(this, &VNA::averagingChanged, sbAverages, &QSpinBox::setValue);
     tb_acq->addWidget(sbAverages);
+    auto cbDeviceAveraging = new QCheckBox("Per point");
+    cbDeviceAveraging->setToolTip("Point averaging: the device measures each point repeatedly and averages the results. "
+                                  "This has the same effect as a narrower IF bandwidth, it does not average complete sweeps");
+    connect(cbDeviceAveraging, &QCheckBox::toggled, this, &VNA::SetDeviceAveraging);
+    connect(this, &VNA::deviceAveragingChanged, cbDeviceAveraging, &QCheckBox::setChecked);
+    tb_acq->addWidget(cbDeviceAveraging);
+
+    tb_acq->addWidget(new QLabel("Decimation:"));
+    auto sbDecimation = new QSpinBox;
+    sbDecimation->setRange(1, 100);
+    sbDecimation->setFixedWidth(45);
+    sbDecimation->setToolTip("Only transfer every n-th point (preview of dense sweeps)");
+    connect(sbDecimation, qOverload<int>(&QSpinBox::valueChanged), this, &VNA::SetDecimation);
+    connect(this, &VNA::decimationChanged, sbDecimation, &QSpinBox::setValue);
+    tb_acq->addWidget(sbDecimation);
+
+    auto cbRawData = new QCheckBox("Raw I/Q");
+    cbRawData->setToolTip("Transfer the raw receiver values and calculate the S-parameters on the PC");
+    connect(cbRawData, &QCheckBox::toggled, this, &VNA::SetRawData);
+    connect(this, &VNA::rawDataChanged, cbRawData, &QCheckBox::setChecked);
+    tb_acq->addWidget(cbRawData);
+    lRawStatus = new QLabel;
+    lRawStatus->setToolTip("Weakest reference level and number of points with ADC overload in the last sweep");
+    tb_acq->addWidget(lRawStatus);
+    lProcessing = new QLabel;
+    tb_acq->addWidget(lProcessing);
 
     window->addToolBar(tb_acq);
     toolbars.insert(tb_acq);
@@ -334,6 +418,20 @@ VNA::VNA(AppWindow *window)
 
     // Set initial sweep settings
     auto pref = Preferences::getInstance();
+    settings.logSweep = 0;
+    settings.settlingTime = 0;
+    settings.segments = 0;
+    settings.averages = 1;
+    settings.decimation = 1;
+    settings.rawData = 0;
+    settings.zeroSpan = 0;
+    settings.powerSweep = 0;
+    settings.cdbm_excitation_stop = Device::Limits().cdbm_min;
+    rawData = false;
+    zeroSpan = false;
+    powerSweep = false;
+    rawOverloads = 0;
+    rawMinReference = std::numeric_limits<double>::max();
     if(pref.Acquisition.alwaysExciteBothPorts) {
         settings.excitePort1 = 1;
         settings.excitePort2 = 1;
@@ -348,6 +446,7 @@ VNA::VNA(AppWindow *window)
         settings.f_stop = pref.Startup.DefaultSweep.stop;
         ConstrainAndUpdateFrequencies();
         SetSourceLevel(pref.Startup.DefaultSweep.excitation);
+        SetStopSourceLevel(Device::Limits().cdbm_min / 100.0);
         SetIFBandwidth(pref.Startup.DefaultSweep.bandwidth);
         SetAveraging(pref.Startup.DefaultSweep.averaging);
         SetPoints(pref.Startup.DefaultSweep.points);
@@ -373,7 +472,10 @@ void VNA::deactivate()
 void VNA::initializeDevice()
 {
     defaultCalMenu->setEnabled(true);
-    connect(window->getDevice(), &Device::DatapointReceived, this, &VNA::NewDatapoint, Qt::UniqueConnection);
+    // received points are passed directly from the USB thread to the processing pipeline, the GUI only gets the results
+    auto direct = static_cast<Qt::ConnectionType>(Qt::DirectConnection | Qt::UniqueConnection);
+    connect(window->getDevice(), &Device::DatapointReceived, &pipeline, &ProcessingPipeline::addDatapoint, direct);
+    connect(window->getDevice(), &Device::RawDatapointsReceived, &pipeline, &ProcessingPipeline::addRawDatapoints, direct);
     // Check if default calibration exists and attempt to load it
     QSettings s;
     auto key = "DefaultCalibration"+window->getDevice()->serial();
@@ -381,8 +483,7 @@ void VNA::initializeDevice()
         auto filename = s.value(key).toString();
         qDebug() << "Attempting to load default calibration file \"" << filename << "\"";
         if(QFile::exists(filename)) {
-            cal.openFromFile(filename);
-            ApplyCalibration(cal.getType());
+            calBuilder.load(filename);
         }
         removeDefaultCal->setEnabled(true);
     } else {
@@ -400,43 +501,182 @@ void VNA::deviceDisconnected()
 
 using namespace std;
 
-void VNA::NewDatapoint(Protocol::Datapoint d)
+void VNA::NewResults()
 {
-    if(calMeasuring) {
-        if(!calWaitFirst || d.pointNum == 0) {
-            calWaitFirst = false;
-            cal.addMeasurement(calMeasurement, d);
-            if(d.pointNum == settings.points - 1) {
-                calMeasuring = false;
-                emit CalibrationMeasurementComplete(calMeasurement);
+    results.clear();
+    pipeline.takeResults(results);
+    bool added = false;
+    for(auto &r : results) {
+        if(r.generation != pipeline.generation()) {
+            // measured with previous settings
+            continue;
+        }
+        auto &d = r.measured;
+        bool lastPoint = d.pointNum == TransmittedPoints() - 1;
+        if(rawData) {
+            if(r.minReference < rawMinReference) {
+                rawMinReference = r.minReference;
+            }
+            if(r.overload) {
+                rawOverloads++;
+            }
+            if(lastPoint) {
+                // end of sweep, update diagnostics
+                auto text = "Ref: " + QString::number(rawMinReference, 'f', 1) + "dB";
+                if(rawOverloads > 0) {
+                    text.append(", Overload: " + QString::number(rawOverloads));
+                }
+                lRawStatus->setText(text);
+                rawOverloads = 0;
+                rawMinReference = std::numeric_limits<double>::max();
             }
-            calDialog.setValue(d.pointNum + 1);
+        }
+        if(tuneActive) {
+            if(!tuneWaitFirst || d.pointNum == 0) {
+                tuneWaitFirst = false;
+                tuneSweep.push_back(d);
+                if(lastPoint) {
+                    SettlingAutoTuneSweepComplete();
+                }
+            }
+        }
+        if(calMeasuring) {
+            if(!calWaitFirst || d.pointNum == 0) {
+                calWaitFirst = false;
+                cal.addMeasurement(calMeasurement, d);
+                if(lastPoint) {
+                    calMeasuring = false;
+                    emit CalibrationMeasurementComplete(calMeasurement);
+                    if(decimation > 1) {
+                        // calibration measurement is done without decimation, restore previous setting
+                        SettingsChanged();
+                    }
+                }
+                calDialog.setValue(d.pointNum + 1);
+            }
+        }
+        if(r.generation != pipeline.generation()) {
+            // settings were changed while handling this point
+            continue;
+        }
+        traceModel.addVNAData(r.processed);
+        added = true;
+        if(lastPoint) {
+            averageLevel = r.averageLevel;
+            UpdateAverageCount();
+            markerModel->updateMarkers();
+            UpdateProcessingStatistics();
         }
     }
-    if(calValid) {
-        cal.correctMeasurement(d);
-    }
-    d = average.process(d);
-    traceModel.addVNAData(d);
-    emit dataChanged();
-    if(d.pointNum == settings.points - 1) {
-        UpdateAverageCount();
-        markerModel->updateMarkers();
+    if(added) {
+        emit dataChanged();
     }
 }
 
 void VNA::UpdateAverageCount()
 {
-    lAverages->setText(QString::number(average.getLevel()) + "/");
+    lAverages->setText(QString::number(averageLevel) + "/");
+}
+
+void VNA::UpdateProcessingStatistics()
+{
+    auto stats = pipeline.getStatistics();
+    double latency = 0.0;
+    QString tooltip = "Latency of the processing stages in the last sweep:";
+    for(auto &s : stats) {
+        latency += s.avgLatency;
+        tooltip.append("\n" + s.name + ": " + QString::number(s.avgLatency, 'f', 1) + "us avg, "
+                       + QString::number(s.maxLatency, 'f', 1) + "us max, " + QString::number(s.queueDepth) + " queued");
+    }
+    lProcessing->setText("Latency: " + QString::number(latency / 1000.0, 'f', 2) + "ms");
+    lProcessing->setToolTip(tooltip);
+}
+
+unsigned int VNA::TransmittedPoints()
+{
+    unsigned int d = settings.decimation > 1 ? settings.decimation : 1;
+    return (settings.points + d - 1) / d;
+}
+
+void VNA::AddSweepPoints(std::vector<uint64_t> &sweep, uint64_t f_start, uint64_t f_stop, unsigned int points,
+                         bool log, unsigned int maxPoints)
+{
+    log = log && f_start > 0;
+    double logStep = log && points > 1 ? pow((double) f_stop / f_start, 1.0 / (points - 1)) : 1.0;
+    double logFrequency = f_start;
+    for(unsigned int i=0;i<points && sweep.size() < maxPoints;i++) {
+        if(i == 0) {
+            sweep.push_back(f_start);
+        } else if(i == points - 1) {
+            sweep.push_back(f_stop);
+        } else if(log) {
+            logFrequency *= logStep;
+            sweep.push_back(logFrequency);
+        } else {
+            sweep.push_back(f_start + (f_stop - f_start) * i / (points - 1));
+        }
+    }
+}
+
+std::vector<uint64_t> VNA::TransmittedFrequencies()
+{
+    vector<uint64_t> sweep;
+    sweep.reserve(settings.points);
+    if(zeroSpan || powerSweep) {
+        sweep.assign(settings.points, (settings.f_start + settings.f_stop) / 2);
+    } else if(segments.size() > 0) {
+        for(const auto &seg : segments) {
+            AddSweepPoints(sweep, seg.f_start, seg.f_stop, seg.points, seg.logSweep, settings.points);
+        }
+    } else {
+        AddSweepPoints(sweep, settings.f_start, settings.f_stop, settings.points, settings.logSweep, settings.points);
+    }
+    // only every n-th point is transmitted when decimating
+    unsigned int d = settings.decimation > 1 ? settings.decimation : 1;
+    vector<uint64_t> transmitted;
+    transmitted.reserve(TransmittedPoints());
+    for(unsigned int i=0;i<sweep.size();i+=d) {
+        transmitted.push_back(sweep[i]);
+    }
+    return transmitted;
 }
 
 void VNA::SettingsChanged()
 {
+    if(recallingPreset) {
+        // the complete preset is applied at once afterwards
+        return;
+    }
     settings.suppressPeaks = Preferences::getInstance().Acquisition.suppressPeaks ? 1 : 0;
+    // calibration measurements need all points
+    settings.decimation = calMeasuring ? 1 : decimation;
+    settings.rawData = rawData ? 1 : 0;
+    settings.zeroSpan = zeroSpan ? 1 : 0;
+    settings.powerSweep = powerSweep ? 1 : 0;
+    if(zeroSpan) {
+        traceModel.setLiveDomain(Trace::Domain::Time);
+    } else if(powerSweep) {
+        traceModel.setLiveDomain(Trace::Domain::Power);
+    } else {
+        traceModel.setLiveDomain(Trace::Domain::Frequency);
+    }
+    lRawStatus->clear();
+    rawOverloads = 0;
+    rawMinReference = std::numeric_limits<double>::max();
     if(window->getDevice()) {
-        window->getDevice()->Configure(settings);
+        if(zeroSpan || powerSweep) {
+            // the device measures at the start frequency, use the center of the span instead
+            auto cw = settings;
+            cw.f_start = cw.f_stop = (settings.f_start + settings.f_stop) / 2;
+            window->getDevice()->Configure(cw);
+        } else if(segments.size() > 0) {
+            window->getDevice()->Configure(settings, segments);
+        } else {
+            window->getDevice()->Configure(settings);
+        }
     }
-    average.reset();
+    pipeline.reset();
+    averageLevel = 0;
     traceModel.clearVNAData();
     UpdateAverageCount();
     emit traceModel.SpanChanged(settings.f_start, settings.f_stop);
@@ -520,6 +760,188 @@ void VNA::SpanZoomOut()
     ConstrainAndUpdateFrequencies();
 }
 
+void VNA::SetLogSweep(bool log)
+{
+    settings.logSweep = log ? 1 : 0;
+    emit logSweepChanged(log);
+    if(log && segments.empty() && settings.f_start < MinLogSweepFrequency) {
+        // start frequency has to be moved
+        ConstrainAndUpdateFrequencies();
+    } else {
+        SettingsChanged();
+    }
+}
+
+void VNA::SetZeroSpan(bool enabled)
+{
+    zeroSpan = enabled;
+    emit zeroSpanChanged(enabled);
+    if(enabled && powerSweep) {
+        // only one of the modes can be displayed
+        powerSweep = false;
+        emit powerSweepChanged(false);
+    }
+    SettingsChanged();
+}
+
+void VNA::LoadSegmentTable()
+{
+    auto filename = QFileDialog::getOpenFileName(nullptr, "Load segment table", "", "Segment table (*.txt *.csv)", nullptr, QFileDialog::DontUseNativeDialog);
+    if(filename.isEmpty()) {
+        // aborted selection
+        return;
+    }
+    ifstream file;
+    file.open(filename.toStdString());
+    if(!file.is_open()) {
+        QMessageBox::warning(this, "Segment table", "Unable to open file");
+        return;
+    }
+    // one segment per line: start[Hz] stop[Hz] points IF_bandwidth[Hz] level[dBm] [settling time 0-3] [log]
+    std::vector<Protocol::SweepSegment> newSegments;
+    string line;
+    while(getline(file, line)) {
+        // remove comments and separators
+        line = line.substr(0, line.find('#'));
+        replace(line.begin(), line.end(), ',', ' ');
+        istringstream iss(line);
+        double start, stop, bandwidth, level;
+        unsigned int points;
+        if(!(iss >> start >> stop >> points >> bandwidth >> level)) {
+            // empty or malformed line
+            continue;
+        }
+        Protocol::SweepSegment seg;
+        seg.f_start = start;
+        seg.f_stop = stop;
+        seg.points = points;
+        seg.if_bandwidth = bandwidth;
+        seg.cdbm_excitation = level * 100;
+        seg.settlingTime = 0;
+        seg.logSweep = 0;
+        unsigned int settling;
+        if(iss >> settling) {
+            seg.settlingTime = settling <= 3 ? settling : 3;
+            string log;
+            if(iss >> log && log == "log") {
+                seg.logSweep = 1;
+            }
+        }
+        if(seg.points < 1 || seg.f_start > seg.f_stop || seg.f_start < Device::Limits().minFreq || seg.f_stop > Device::Limits().maxFreq
+                || (seg.logSweep && seg.f_start < MinLogSweepFrequency)
+                || seg.if_bandwidth < Device::Limits().minIFBW || seg.if_bandwidth > Device::Limits().maxIFBW) {
+            QMessageBox::warning(this, "Segment table", "Invalid segment: \"" + QString::fromStdString(line) + "\"");
+            return;
+        }
+        if(newSegments.size() > 0 && seg.f_start < newSegments.back().f_stop) {
+            // traces and calibration expect a single ascending frequency axis
+            QMessageBox::warning(this, "Segment table", "Segments must be in ascending order without overlap: \""
+                                 + QString::fromStdString(line) + "\"");
+            return;
+        }
+        newSegments.push_back(seg);
+    }
+    if(newSegments.size() == 0 || newSegments.size() > Protocol::MaxSweepSegments) {
+        QMessageBox::warning(this, "Segment table", "The segment table must contain between 1 and " + QString::number(Protocol::MaxSweepSegments) + " segments");
+        return;
+    }
+    segments = newSegments;
+    SegmentsChanged();
+}
+
+void VNA::LoadFrequencyList()
+{
+    auto filename = QFileDialog::getOpenFileName(nullptr, "Load frequency list", "", "Frequency list (*.txt *.csv)", nullptr, QFileDialog::DontUseNativeDialog);
+    if(filename.isEmpty()) {
+        // aborted selection
+        return;
+    }
+    ifstream file;
+    file.open(filename.toStdString());
+    if(!file.is_open()) {
+        QMessageBox::warning(this, "Frequency list", "Unable to open file");
+        return;
+    }
+    // one frequency (in Hz) per line
+    std::vector<uint64_t> frequencies;
+    double f;
+    while(file >> f) {
+        if(f >= Device::Limits().minFreq && f <= Device::Limits().maxFreq) {
+            frequencies.push_back(f);
+        }
+    }
+    sort(frequencies.begin(), frequencies.end());
+    frequencies.erase(unique(frequencies.begin(), frequencies.end()), frequencies.end());
+    // combine equidistant frequencies into linear segments
+    std::vector<Protocol::SweepSegment> newSegments;
+    unsigned int i = 0;
+    while(i < frequencies.size()) {
+        unsigned int n = 1;
+        if(i + 1 < frequencies.size()) {
+            auto step = frequencies[i + 1] - frequencies[i];
+            n = 2;
+            while(i + n < frequencies.size() && frequencies[i + n] - frequencies[i + n - 1] == step && n < UINT16_MAX) {
+                n++;
+            }
+        }
+        Protocol::SweepSegment seg;
+        seg.f_start = frequencies[i];
+        seg.f_stop = frequencies[i + n - 1];
+        seg.points = n;
+        seg.if_bandwidth = settings.if_bandwidth;
+        seg.cdbm_excitation = settings.cdbm_excitation;
+        seg.settlingTime = 0;
+        seg.logSweep = 0;
+        newSegments.push_back(seg);
+        i += n;
+    }
+    if(newSegments.size() == 0 || newSegments.size() > Protocol::MaxSweepSegments) {
+        QMessageBox::warning(this, "Frequency list", "The frequency list must be composed of between 1 and " + QString::number(Protocol::MaxSweepSegments)
+                             + " equidistant segments (got " + QString::number(newSegments.size()) + ")");
+        return;
+    }
+    segments = newSegments;
+    SegmentsChanged();
+}
+
+void VNA::ClearSegments()
+{
+    if(segments.size() > 0) {
+        segments.clear();
+        emit pointsChanged(settings.points);
+        ConstrainAndUpdateFrequencies();
+    }
+}
+
+void VNA::SegmentsChanged()
+{
+    // keep settings consistent with the segments, the overall span and point count is used for displaying and calibration
+    unsigned int points = 0;
+    for(auto s : segments) {
+        points += s.points;
+    }
+    settings.f_start = segments.front().f_start;
+    settings.f_stop = segments.back().f_stop;
+    if(points > Device::Limits().maxPoints) {
+        QMessageBox::warning(this, "Segmented sweep", "The segments contain " + QString::number(points) + " points, only the first "
+                             + QString::number(Device::Limits().maxPoints) + " will be measured");
+        points = Device::Limits().maxPoints;
+        // the sweep ends at the last point that is actually measured
+        vector<uint64_t> sweep;
+        sweep.reserve(points);
+        for(const auto &seg : segments) {
+            AddSweepPoints(sweep, seg.f_start, seg.f_stop, seg.points, seg.logSweep, points);
+        }
+        settings.f_stop = sweep.back();
+    }
+    settings.points = points;
+    emit startFreqChanged(settings.f_start);
+    emit stopFreqChanged(settings.f_stop);
+    emit spanChanged(settings.f_stop - settings.f_start);
+    emit centerFreqChanged((settings.f_stop + settings.f_start)/2);
+    SettingsChanged();
+}
+
 void VNA::SetSourceLevel(double level)
 {
     // TODO remove hardcoded limits
@@ -533,6 +955,31 @@ void VNA::SetSourceLevel(double level)
     SettingsChanged();
 }
 
+void VNA::SetStopSourceLevel(double level)
+{
+    if(level > Device::Limits().cdbm_max / 100.0) {
+        level = Device::Limits().cdbm_max / 100.0;
+    } else if(level < Device::Limits().cdbm_min / 100.0) {
+        level = Device::Limits().cdbm_min / 100.0;
+    }
+    emit stopSourceLevelChanged(level);
+    settings.cdbm_excitation_stop = level * 100;
+    if(powerSweep) {
+        SettingsChanged();
+    }
+}
+
+void VNA::SetPowerSweep(bool enabled)
+{
+    powerSweep = enabled;
+    emit powerSweepChanged(enabled);
+    if(enabled && zeroSpan) {
+        zeroSpan = false;
+        emit zeroSpanChanged(false);
+    }
+    SettingsChanged();
+}
+
 void VNA::SetPoints(unsigned int points)
 {
     // TODO remove hardcoded limits
@@ -543,6 +990,8 @@ void VNA::SetPoints(unsigned int points)
     }
     emit pointsChanged(points);
     settings.points = points;
+    // manually changing the points/span returns to a normal sweep
+    segments.clear();
     SettingsChanged();
 }
 
@@ -561,11 +1010,41 @@ void VNA::SetIFBandwidth(double bandwidth)
 void VNA::SetAveraging(unsigned int averages)
 {
     this->averages = averages;
-    average.setAverages(averages);
+    if(deviceAveraging) {
+        settings.averages = averages;
+        pipeline.setAverages(1);
+    } else {
+        settings.averages = 1;
+        pipeline.setAverages(averages);
+    }
     emit averagingChanged(averages);
     SettingsChanged();
 }
 
+void VNA::SetDeviceAveraging(bool enabled)
+{
+    deviceAveraging = enabled;
+    emit deviceAveragingChanged(enabled);
+    SetAveraging(averages);
+}
+
+void VNA::SetDecimation(unsigned int decimation)
+{
+    if(decimation < 1) {
+        decimation = 1;
+    }
+    this->decimation = decimation;
+    emit decimationChanged(decimation);
+    SettingsChanged();
+}
+
+void VNA::SetRawData(bool enabled)
+{
+    rawData = enabled;
+    emit rawDataChanged(enabled);
+    SettingsChanged();
+}
+
 void VNA::ExcitationRequired(bool port1, bool port2)
 {
     if(Preferences::getInstance().Acquisition.alwaysExciteBothPorts) {
@@ -583,26 +1062,21 @@ void VNA::ExcitationRequired(bool port1, bool port2)
 
 void VNA::DisableCalibration(bool force)
 {
+    // a calibration that is still under construction must not be applied afterwards
+    calBuilder.cancel();
     if(calValid || force) {
         calValid = false;
+        pipeline.clearCalibration();
         emit CalibrationDisabled();
-        average.reset();
+        pipeline.reset();
     }
 }
 
 void VNA::ApplyCalibration(Calibration::Type type)
 {
     if(cal.calculationPossible(type)) {
-        try {
-            if(cal.constructErrorTerms(type)) {
-                calValid = true;
-                average.reset();
-                emit CalibrationApplied(type);
-            }
-        } catch (runtime_error e) {
-            QMessageBox::critical(this, "Calibration failure", e.what());
-            DisableCalibration(true);
-        }
+        // live data is corrected with the previous error terms until the construction has finished
+        calBuilder.construct(cal, type);
     } else {
         // Not all required traces available
         // TODO start tracedata dialog with required traces
@@ -616,15 +1090,48 @@ void VNA::ApplyCalibration(Calibration::Type type)
     }
 }
 
+void VNA::CalibrationBuilt()
+{
+    auto result = calBuilder.takeResult();
+    if(!result.warning.isEmpty()) {
+        QMessageBox::warning(this, "Missing calibration kit", result.warning);
+    }
+    if(!result.cal) {
+        if(!result.error.isEmpty()) {
+            QMessageBox::critical(this, "Calibration failure", result.error);
+            DisableCalibration(true);
+        }
+        return;
+    }
+    if(result.loaded) {
+        // the measurements of the loaded file replace the current ones
+        cal = *result.cal;
+    } else {
+        cal.setErrorTerms(*result.cal);
+    }
+    auto type = result.cal->getType();
+    if(type == Calibration::Type::None) {
+        // calibration file without error terms
+        return;
+    }
+    // the correction stage only needs the error terms. The new terms are swapped in atomically, points that
+    // are currently being corrected still use the previous terms
+    result.cal->clearMeasurements();
+    calValid = true;
+    pipeline.setCalibration(result.cal);
+    pipeline.reset();
+    emit CalibrationApplied(type);
+}
+
 void VNA::StartCalibrationMeasurement(Calibration::Measurement m)
 {
-    // Trigger sweep to start from beginning
-    SettingsChanged();
     calMeasurement = m;
     // Delete any already captured data of this measurement
     cal.clearMeasurement(m);
     calWaitFirst = true;
     calMeasuring = true;
+    // Trigger sweep to start from beginning
+    SettingsChanged();
     QString text = "Measuring \"";
     text.append(Calibration::MeasurementToString(m));
     text.append("\" parameters.");
@@ -640,11 +1147,240 @@ void VNA::StartCalibrationMeasurement(Calibration::Measurement m)
         // the user aborted the calibration measurement
         calMeasuring = false;
         cal.clearMeasurement(calMeasurement);
+        if(decimation > 1) {
+            SettingsChanged();
+        }
     });
 }
 
+void VNA::SetSettlingTime(unsigned int settling)
+{
+    settings.settlingTime = settling <= 3 ? settling : 3;
+    for(auto &s : segments) {
+        s.settlingTime = settings.settlingTime;
+    }
+    SettingsChanged();
+}
+
+void VNA::StartSettlingAutoTune()
+{
+    bool ok;
+    auto tolerance = QInputDialog::getDouble(this, "Settling time auto-tuning", "The sweep is repeated with different settling times.\n"
+                                             "The shortest settling time whose result deviates less than this limit from\n"
+                                             "a sweep with the longest settling time will be selected.\n\n"
+                                             "Maximum deviation (dB):", 0.1, 0.001, 10.0, 3, &ok);
+    if(!ok) {
+        return;
+    }
+    tuneTolerance = tolerance;
+    // take reference sweep with the longest settling time
+    tuneReference.clear();
+    tuneSweep.clear();
+    tuneSettling = 3;
+    tuneActive = true;
+    tuneWaitFirst = true;
+    SetSettlingTime(tuneSettling);
+}
+
+// Largest deviation (in dB) of a sweep from the reference sweep. The deviation is relative to the reference
+// magnitude which is limited to -40dB to keep noise on low level signals from dominating.
+static double SweepDeviation(const std::vector<Protocol::Datapoint> &ref, const std::vector<Protocol::Datapoint> &sweep, bool port1, bool port2)
+{
+    double maxDeviation = 0.0;
+    auto compare = [&](float real_ref, float imag_ref, float real, float imag) {
+        auto r = complex<double>(real_ref, imag_ref);
+        auto m = complex<double>(real, imag);
+        auto deviation = 20*log10(1.0 + abs(m - r) / max(abs(r), 0.01));
+        if(deviation > maxDeviation) {
+            maxDeviation = deviation;
+        }
+    };
+    for(unsigned int i=0;i<ref.size() && i<sweep.size();i++) {
+        if(port1) {
+            compare(ref[i].real_S11, ref[i].imag_S11, sweep[i].real_S11, sweep[i].imag_S11);
+            compare(ref[i].real_S21, ref[i].imag_S21, sweep[i].real_S21, sweep[i].imag_S21);
+        }
+        if(port2) {
+            compare(ref[i].real_S12, ref[i].imag_S12, sweep[i].real_S12, sweep[i].imag_S12);
+            compare(ref[i].real_S22, ref[i].imag_S22, sweep[i].real_S22, sweep[i].imag_S22);
+        }
+    }
+    return maxDeviation;
+}
+
+void VNA::SettlingAutoTuneSweepComplete()
+{
+    double deviation = 0.0;
+    bool finished = false;
+    if(tuneReference.size() == 0) {
+        // this was the reference sweep, continue with the shortest settling time
+        tuneReference = tuneSweep;
+        tuneSettling = 0;
+    } else {
+        deviation = SweepDeviation(tuneReference, tuneSweep, settings.excitePort1, settings.excitePort2);
+        if(deviation <= tuneTolerance) {
+            finished = true;
+        } else {
+            tuneSettling++;
+            // the longest settling time is the reference, always within tolerance
+            finished = tuneSettling >= 3;
+        }
+    }
+    tuneSweep.clear();
+    tuneWaitFirst = true;
+    if(finished) {
+        tuneActive = false;
+        tuneReference.clear();
+    }
+    SetSettlingTime(tuneSettling);
+    if(finished) {
+        constexpr unsigned int settlingTimes[] = {20, 60, 180, 540};
+        QMessageBox::information(this, "Settling time auto-tuning", "Selected a minimum settling time of " + QString::number(settlingTimes[tuneSettling])
+                                 + "us (maximum deviation " + QString::number(deviation, 'g', 3) + "dB)");
+    }
+}
+
+void VNA::StorePreset()
+{
+    if(calMeasuring) {
+        QMessageBox::warning(this, "Presets", "Presets can not be stored while a calibration measurement is active");
+        return;
+    }
+    bool ok;
+    auto name = QInputDialog::getText(this, "Store preset", "Name of the preset (an existing preset with this name is replaced):", QLineEdit::Normal, "", &ok);
+    if(!ok || name.isEmpty()) {
+        return;
+    }
+    Preset p;
+    p.settings = settings;
+    p.segments = segments;
+    p.averages = averages;
+    p.deviceAveraging = deviceAveraging;
+    p.decimation = decimation;
+    p.rawData = rawData;
+    p.zeroSpan = zeroSpan;
+    p.powerSweep = powerSweep;
+    if(calValid) {
+        // only the error terms are required, interpolate them for this sweep now instead of for every received point
+        p.calibration = make_shared<Calibration>();
+        p.calibration->setErrorTerms(cal);
+        p.calibration->setSweepFrequencies(TransmittedFrequencies());
+    }
+    for(auto t : traceModel.getTraces()) {
+        p.traceVisibility[t] = t->isVisible();
+        // the key must not outlive the trace, a new trace could be allocated at the same address
+        connect(t, &Trace::deleted, this, &VNA::PresetTraceDeleted, Qt::UniqueConnection);
+    }
+    presets[name] = p;
+}
+
+void VNA::PresetTraceDeleted(Trace *t)
+{
+    for(auto &p : presets) {
+        p.second.traceVisibility.erase(t);
+    }
+}
+
+void VNA::RecallPreset(QString name)
+{
+    auto it = presets.find(name);
+    if(it == presets.end()) {
+        return;
+    }
+    if(calMeasuring) {
+        QMessageBox::warning(this, "Presets", "Presets can not be recalled while a calibration measurement is active");
+        return;
+    }
+    const auto &p = it->second;
+    recallingPreset = true;
+    // Update the widgets first. Their feedback through the setters may not exactly reproduce the preset
+    // (e.g. rounded levels), the preset itself is applied afterwards
+    emit startFreqChanged(p.settings.f_start);
+    emit stopFreqChanged(p.settings.f_stop);
+    emit spanChanged(p.settings.f_stop - p.settings.f_start);
+    emit centerFreqChanged((p.settings.f_stop + p.settings.f_start)/2);
+    emit logSweepChanged(p.settings.logSweep);
+    emit zeroSpanChanged(p.zeroSpan);
+    emit powerSweepChanged(p.powerSweep);
+    emit sourceLevelChanged(p.settings.cdbm_excitation / 100.0);
+    emit stopSourceLevelChanged(p.settings.cdbm_excitation_stop / 100.0);
+    if(p.segments.size() == 0) {
+        // a segmented sweep leaves the points widget untouched (changing the points ends a segmented sweep)
+        emit pointsChanged(p.settings.points);
+    }
+    emit IFBandwidthChanged(p.settings.if_bandwidth);
+    emit averagingChanged(p.averages);
+    emit deviceAveragingChanged(p.deviceAveraging);
+    emit decimationChanged(p.decimation);
+    emit rawDataChanged(p.rawData);
+    for(auto t : traceModel.getTraces()) {
+        auto v = p.traceVisibility.find(t);
+        if(v != p.traceVisibility.end() && v->second != t->isVisible()) {
+            t->setVisible(v->second);
+        }
+    }
+
+    settings = p.settings;
+    segments = p.segments;
+    averages = p.averages;
+    deviceAveraging = p.deviceAveraging;
+    decimation = p.decimation;
+    rawData = p.rawData;
+    zeroSpan = p.zeroSpan;
+    powerSweep = p.powerSweep;
+    pipeline.setAverages(deviceAveraging ? 1 : averages);
+
+    // the error terms of the preset are used as they are, a calibration that is still being constructed is dropped
+    calBuilder.cancel();
+    if(p.calibration) {
+        // keep the measurements, dialogs, saving and re-applying continue with the error terms of the preset
+        cal.setErrorTerms(*p.calibration);
+        calValid = true;
+        pipeline.setCalibration(p.calibration);
+        emit CalibrationApplied(p.calibration->getType());
+    } else {
+        cal.resetErrorTerms();
+        if(calValid) {
+            calValid = false;
+            pipeline.clearCalibration();
+            emit CalibrationDisabled();
+        }
+    }
+
+    recallingPreset = false;
+    SettingsChanged();
+}
+
+void VNA::DeletePreset(QString name)
+{
+    presets.erase(name);
+}
+
+void VNA::UpdatePresetMenu()
+{
+    for(auto m : presetMenu->findChildren<QMenu*>()) {
+        m->deleteLater();
+    }
+    presetMenu->clear();
+    auto store = presetMenu->addAction("Store current settings...");
+    connect(store, &QAction::triggered, this, &VNA::StorePreset);
+    auto deleteMenu = presetMenu->addMenu("Delete");
+    deleteMenu->setEnabled(presets.size() > 0);
+    presetMenu->addSeparator();
+    for(auto &p : presets) {
+        auto name = p.first;
+        connect(presetMenu->addAction(name), &QAction::triggered, [=](){
+            RecallPreset(name);
+        });
+        connect(deleteMenu->addAction(name), &QAction::triggered, [=](){
+            DeletePreset(name);
+        });
+    }
+}
+
 void VNA::ConstrainAndUpdateFrequencies()
 {
+    segments.clear();
     if(settings.f_stop > Device::Limits().maxFreq) {
         settings.f_stop = Device::Limits().maxFreq;
     }
@@ -654,6 +1390,12 @@ void VNA::ConstrainAndUpdateFrequencies()
     if(settings.f_start < Device::Limits().minFreq) {
         settings.f_start = Device::Limits().minFreq;
     }
+    if(settings.logSweep && settings.f_start < MinLogSweepFrequency) {
+        settings.f_start = MinLogSweepFrequency;
+        if(settings.f_stop < settings.f_start) {
+            settings.f_stop = settings.f_start;
+        }
+    }
     emit startFreqChanged(settings.f_start);
     emit stopFreqChanged(settings.f_stop);
     emit spanChanged(settings.f_stop - settings.f_start);
@@ -672,6 +1414,14 @@ void VNA::LoadSweepSettings()
     SetPoints(s.value("SweepPoints", pref.Startup.DefaultSweep.points).toInt());
     SetAveraging(s.value("SweepAveraging", pref.Startup.DefaultSweep.averaging).toInt());
     SetSourceLevel(s.value("SweepLevel", pref.Startup.DefaultSweep.excitation).toDouble());
+    SetStopSourceLevel(s.value("SweepLevelStop", Device::Limits().cdbm_min / 100.0).toDouble());
+    SetPowerSweep(s.value("SweepPowerSweep", false).toBool());
+    SetLogSweep(s.value("SweepLog", false).toBool());
+    SetZeroSpan(s.value("SweepZeroSpan", false).toBool());
+    SetSettlingTime(s.value("SweepSettling", 0).toUInt());
+    SetDeviceAveraging(s.value("SweepDeviceAveraging", false).toBool());
+    SetDecimation(s.value("SweepDecimation", 1).toUInt());
+    SetRawData(s.value("SweepRawData", false).toBool());
 }
 
 void VNA::StoreSweepSettings()
@@ -683,4 +1433,12 @@ void VNA::StoreSweepSettings()
     s.setValue("SweepPoints", settings.points);
     s.setValue("SweepAveraging", averages);
     s.setValue("SweepLevel", (double) settings.cdbm_excitation / 100.0);
+    s.setValue("SweepLevelStop", (double) settings.cdbm_excitation_stop / 100.0);
+    s.setValue("SweepPowerSweep", powerSweep);
+    s.setValue("SweepLog", settings.logSweep == 1);
+    s.setValue("SweepZeroSpan", zeroSpan);
+    s.setValue("SweepSettling", settings.settlingTime);
+    s.setValue("SweepDeviceAveraging", deviceAveraging);
+    s.setValue("SweepDecimation", decimation);
+    s.setValue("SweepRawData", rawData);
 }
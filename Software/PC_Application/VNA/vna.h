@@ -6,6 +6,8 @@
 #include "appwindow.h"
 #include "mode.h"
 #include "CustomWidgets/tilewidget.h"
+#include "processingpipeline.h"
+#include "Calibration/calibrationbuilder.h"
 
 class VNA : public Mode
 {
@@ -17,7 +19,7 @@ public:
     void initializeDevice() override;
     void deviceDisconnected() override;
 private slots:
-    void NewDatapoint(Protocol::Datapoint d);
+    void NewResults();
     void StartImpedanceMatching();
     // Sweep control
     void SetStartFreq(double freq);
@@ -27,46 +29,130 @@ private slots:
     void SetFullSpan();
     void SpanZoomIn();
     void SpanZoomOut();
+    void SetLogSweep(bool log);
+    void SetZeroSpan(bool enabled);
+    // Segmented sweeps
+    void LoadSegmentTable();
+    void LoadFrequencyList();
+    void ClearSegments();
     // Acquisition control
     void SetSourceLevel(double level);
+    void SetStopSourceLevel(double level);
+    void SetPowerSweep(bool enabled);
     void SetPoints(unsigned int points);
     void SetIFBandwidth(double bandwidth);
     void SetAveraging(unsigned int averages);
+    void SetDeviceAveraging(bool enabled);
+    void SetDecimation(unsigned int decimation);
+    void SetRawData(bool enabled);
     void ExcitationRequired(bool port1, bool port2);
     // Calibration
     void DisableCalibration(bool force = false);
     void ApplyCalibration(Calibration::Type type);
     void StartCalibrationMeasurement(Calibration::Measurement m);
+    void CalibrationBuilt();
+    // Settling time
+    void SetSettlingTime(unsigned int settling);
+    void StartSettlingAutoTune();
+    // Instrument presets
+    void StorePreset();
+    void RecallPreset(QString name);
+    void DeletePreset(QString name);
 
 signals:
     void CalibrationMeasurementComplete(Calibration::Measurement m);
 
 private:
     void UpdateAverageCount();
+    void UpdateProcessingStatistics();
     void SettingsChanged();
     void ConstrainAndUpdateFrequencies();
     void LoadSweepSettings();
     void StoreSweepSettings();
+    void SegmentsChanged();
+    // number of points per sweep that are actually received (less than the sweep points when decimating)
+    unsigned int TransmittedPoints();
+    // frequencies of the received points of the current sweep, indexed by the point number
+    std::vector<uint64_t> TransmittedFrequencies();
+    // appends the points of a (segment of a) sweep to 'sweep', up to a total of maxPoints. Same calculation as on
+    // the device: log points are stepped with a constant factor (rounded down to whole Hz), the last point of a
+    // segment is exactly at its stop frequency
+    static void AddSweepPoints(std::vector<uint64_t> &sweep, uint64_t f_start, uint64_t f_stop, unsigned int points,
+                               bool log, unsigned int maxPoints);
+    void UpdatePresetMenu();
+    // removes a deleted trace from the trace visibility of all presets
+    void PresetTraceDeleted(Trace *t);
+
+    // logarithmic sweeps need a positive start frequency
+    static constexpr uint64_t MinLogSweepFrequency = 1;
 
     Protocol::SweepSettings settings;
+    // if not empty, the sweep consists of these segments instead of the linear/log sweep in settings
+    std::vector<Protocol::SweepSegment> segments;
     unsigned int averages;
+    bool deviceAveraging;
+    unsigned int decimation;
+    // receive raw receiver values and calculate the ratios on the host
+    bool rawData;
+    // CW measurement at the center frequency, the live traces are displayed over time
+    bool zeroSpan;
+    // excitation level sweep at the center frequency, the live traces are displayed over the level
+    bool powerSweep;
+    // raw data diagnostics of the current sweep
+    unsigned int rawOverloads;
+    double rawMinReference;
     TraceModel traceModel;
     TraceMarkerModel *markerModel;
-    Averaging average;
+    // calibration correction and averaging of the received points
+    ProcessingPipeline pipeline;
+    std::vector<ProcessingPipeline::Result> results;
+    unsigned int averageLevel;
 
     // Calibration
     Calibration cal;
+    // error terms are constructed (and calibration files loaded) in the background
+    CalibrationBuilder calBuilder;
     bool calValid;
     Calibration::Measurement calMeasurement;
     bool calMeasuring;
     bool calWaitFirst;
     QProgressDialog calDialog;
 
+    // Instrument presets: everything needed to switch to a different measurement without recalculating anything
+    class Preset {
+    public:
+        Protocol::SweepSettings settings;
+        std::vector<Protocol::SweepSegment> segments;
+        unsigned int averages;
+        bool deviceAveraging;
+        unsigned int decimation;
+        bool rawData;
+        bool zeroSpan;
+        bool powerSweep;
+        // error terms interpolated for the sweep of this preset, nullptr if the calibration is disabled
+        std::shared_ptr<Calibration> calibration;
+        std::map<Trace*, bool> traceVisibility;
+    };
+    std::map<QString, Preset> presets;
+    // set while a preset is recalled, the device is configured only once at the end
+    bool recallingPreset;
+    QMenu *presetMenu;
+
+    // Settling time auto tuning
+    void SettlingAutoTuneSweepComplete();
+    bool tuneActive;
+    bool tuneWaitFirst;
+    unsigned int tuneSettling;
+    double tuneTolerance;
+    std::vector<Protocol::Datapoint> tuneReference, tuneSweep;
+
     QMenu *defaultCalMenu;
     QAction *assignDefaultCal, *removeDefaultCal;
 
     // Status Labels
     QLabel *lAverages;
+    QLabel *lRawStatus;
+    QLabel *lProcessing;
 
     TileWidget *central;
 
@@ -76,11 +162,18 @@ signals:
     void stopFreqChanged(double freq);
     void centerFreqChanged(double freq);
     void spanChanged(double span);
+    void logSweepChanged(bool log);
+    void zeroSpanChanged(bool enabled);
 
     void sourceLevelChanged(double level);
+    void stopSourceLevelChanged(double level);
+    void powerSweepChanged(bool enabled);
     void pointsChanged(unsigned int points);
     void IFBandwidthChanged(double bandwidth);
     void averagingChanged(unsigned int averages);
+    void deviceAveragingChanged(bool enabled);
+    void decimationChanged(unsigned int decimation);
+    void rawDataChanged(bool enabled);
 
     void CalibrationDisabled();
     void CalibrationApplied(Calibration::Type type);
@@ -22,6 +22,7 @@
 #include "unit.h"
 #include "CustomWidgets/toggleswitch.h"
 #include "Device/manualcontroldialog.h"
+#include "Device/profilingdialog.h"
 #include "Traces/tracemodel.h"
 #include "Traces/tracewidget.h"
 #include "Traces/tracesmithchart.h"
@@ -107,10 +108,19 @@ AppWindow::AppWindow(QWidget *parent)
             fw_update->exec();
         }
     });
+    connect(ui->actionProfiling, &QAction::triggered, [=](){
+        if(device) {
+            auto profiling = new ProfilingDialog(*device, this);
+            // the dialog keeps requesting reports, it must not outlive the device
+            connect(device, &QObject::destroyed, profiling, &QDialog::close);
+            profiling->show();
+        }
+    });
     connect(ui->actionPreferences, &QAction::triggered, [=](){
         Preferences::getInstance().edit();
         // settings might have changed, update necessary stuff
         TraceBodePlot::updateGraphColors();
+        TraceSmithChart::updateGraphColors();
     });
 
     setWindowTitle("VNA");
@@ -168,6 +178,7 @@ void AppWindow::ConnectToDevice(QString serial)
         ui->actionDisconnect->setEnabled(true);
         ui->actionManual_Control->setEnabled(true);
         ui->actionFirmware_Update->setEnabled(true);
+        ui->actionProfiling->setEnabled(true);
 
         Mode::getActiveMode()->initializeDevice();
         UpdateReference();
@@ -193,6 +204,7 @@ void AppWindow::DisconnectDevice()
     ui->actionDisconnect->setEnabled(false);
     ui->actionManual_Control->setEnabled(false);
     ui->actionFirmware_Update->setEnabled(false);
+    ui->actionProfiling->setEnabled(false);
     for(auto a : deviceActionGroup->actions()) {
         a->setChecked(false);
     }
@@ -1,4 +1,5 @@
 #include "averaging.h"
+#include <algorithm>
 
 using namespace std;
 
@@ -9,12 +10,14 @@ Averaging::Averaging()
 
 void Averaging::reset()
 {
-    avg.clear();
+    samples.clear();
+    sampleCnt.clear();
 }
 
 void Averaging::setAverages(unsigned int a)
 {
-    averages = a;
+    // at least one sample is required for the ring buffers
+    averages = max(a, 1U);
     reset();
 }
 
@@ -25,35 +28,12 @@ Protocol::Datapoint Averaging::process(Protocol::Datapoint d)
     auto S21 = complex<double>(d.real_S21, d.imag_S21);
     auto S22 = complex<double>(d.real_S22, d.imag_S22);
 
-    if (d.pointNum == avg.size()) {
-        // add moving average entry
-        deque<array<complex<double>, 4>> deque;
-        avg.push_back(deque);
-    }
-
-    if (d.pointNum < avg.size()) {
-        // can compute average
-        // get correct queue
-        auto deque = &avg[d.pointNum];
-        // add newest sample to queue
-        array<complex<double>, 4> sample = {S11, S12, S21, S22};
-        deque->push_back(sample);
-        if(deque->size() > averages) {
-            deque->pop_front();
-        }
-
-        // calculate average
-        complex<double> sum[4];
-        for(auto s : *deque) {
-            sum[0] += s[0];
-            sum[1] += s[1];
-            sum[2] += s[2];
-            sum[3] += s[3];
-        }
-        S11 = sum[0] / (double) (deque->size());
-        S12 = sum[1] / (double) (deque->size());
-        S21 = sum[2] / (double) (deque->size());
-        S22 = sum[3] / (double) (deque->size());
+    array<complex<double>, 4> sample = {S11, S12, S21, S22};
+    if(addSample(d.pointNum, sample)) {
+        S11 = sample[0];
+        S12 = sample[1];
+        S21 = sample[2];
+        S22 = sample[3];
     }
 
     d.real_S11 = S11.real();
@@ -70,33 +50,10 @@ Protocol::Datapoint Averaging::process(Protocol::Datapoint d)
 
 Protocol::SpectrumAnalyzerResult Averaging::process(Protocol::SpectrumAnalyzerResult d)
 {
-    if (d.pointNum == avg.size()) {
-        // add moving average entry
-        deque<array<complex<double>, 4>> deque;
-        avg.push_back(deque);
-    }
-
-    if (d.pointNum < avg.size()) {
-        // can compute average
-        // get correct queue
-        auto deque = &avg[d.pointNum];
-        // add newest sample to queue
-        array<complex<double>, 4> sample = {d.port1, d.port2, 0, 0};
-        deque->push_back(sample);
-        if(deque->size() > averages) {
-            deque->pop_front();
-        }
-
-        // calculate average
-        complex<double> sum[4];
-        for(auto s : *deque) {
-            sum[0] += s[0];
-            sum[1] += s[1];
-            sum[2] += s[2];
-            sum[3] += s[3];
-        }
-        d.port1 = abs(sum[0] / (double) (deque->size()));
-        d.port2 = abs(sum[1] / (double) (deque->size()));
+    array<complex<double>, 4> sample = {d.port1, d.port2, 0, 0};
+    if(addSample(d.pointNum, sample)) {
+        d.port1 = abs(sample[0]);
+        d.port2 = abs(sample[1]);
     }
 
     return d;
@@ -104,9 +61,42 @@ Protocol::SpectrumAnalyzerResult Averaging::process(Protocol::SpectrumAnalyzerRe
 
 unsigned int Averaging::getLevel()
 {
-    if(avg.size() > 0) {
-        return avg.back().size();
+    if(sampleCnt.size() > 0) {
+        return min(sampleCnt.back(), averages);
     } else {
         return 0;
     }
 }
+
+bool Averaging::addSample(unsigned int pointNum, array<complex<double>, 4> &sample)
+{
+    if (pointNum == sampleCnt.size()) {
+        // add moving average entry
+        sampleCnt.push_back(0);
+        samples.resize(samples.size() + averages);
+    }
+
+    if (pointNum >= sampleCnt.size()) {
+        // can't compute average
+        return false;
+    }
+
+    // add newest sample to the ring buffer of this point, replacing the oldest one
+    auto buffer = &samples[pointNum * averages];
+    buffer[sampleCnt[pointNum] % averages] = sample;
+    sampleCnt[pointNum]++;
+
+    // calculate average
+    auto used = min(sampleCnt[pointNum], averages);
+    complex<double> sum[4];
+    for(unsigned int i=0;i<used;i++) {
+        sum[0] += buffer[i][0];
+        sum[1] += buffer[i][1];
+        sum[2] += buffer[i][2];
+        sum[3] += buffer[i][3];
+    }
+    for(unsigned int i=0;i<4;i++) {
+        sample[i] = sum[i] / (double) used;
+    }
+    return true;
+}
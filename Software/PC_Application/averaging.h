@@ -3,7 +3,6 @@
 
 
 #include "Device/device.h"
-#include <deque>
 #include <complex>
 
 class Averaging
@@ -16,8 +15,14 @@ public:
     Protocol::SpectrumAnalyzerResult process(Protocol::SpectrumAnalyzerResult d);
     unsigned int getLevel();
 private:
-    std::vector<std::deque<std::array<std::complex<double>, 4>>> avg;
-    int maxPoints;
+    // adds the sample to the moving average of the point and replaces it with the average.
+    // Returns false if the point is not consecutive to the already known points
+    bool addSample(unsigned int pointNum, std::array<std::complex<double>, 4> &sample);
+    // one contiguous block of 'averages' samples per point (used as ring buffer), avoids
+    // per point allocations for sweeps with many points
+    std::vector<std::array<std::complex<double>, 4>> samples;
+    // number of samples added to each point
+    std::vector<unsigned int> sampleCnt;
     unsigned int averages;
 };
 
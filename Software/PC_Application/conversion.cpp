@@ -0,0 +1,72 @@
+#include "conversion.h"
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+
+using namespace std;
+
+// 10*log10(power) for positive normal numbers, without range checks
+static inline double powerDB(double power)
+{
+    // split into exponent and mantissa in [1,2) by manipulating the bits. The exponent is converted to a double
+    // by placing it in the mantissa of 2^52 (avoids an integer conversion which most SIMD instruction sets lack)
+    uint64_t bits;
+    memcpy(&bits, &power, sizeof(bits));
+    uint64_t exponentBits = ((bits >> 52) & 0x7FF) | 0x4330000000000000;
+    uint64_t mantissaBits = (bits & 0x000FFFFFFFFFFFFF) | 0x3FF0000000000000;
+    double exponent, mantissa;
+    memcpy(&exponent, &exponentBits, sizeof(exponent));
+    memcpy(&mantissa, &mantissaBits, sizeof(mantissa));
+    exponent -= 4503599627370496.0 + 1023.0;
+    // move the mantissa into [sqrt(0.5), sqrt(2)), the series below converges faster around 1
+    bool high = mantissa > M_SQRT2;
+    mantissa = high ? mantissa * 0.5 : mantissa;
+    exponent = high ? exponent + 1.0 : exponent;
+    // ln(m) = 2*atanh(t) with t = (m-1)/(m+1) and |t| < 0.1716. Stopping after t^9 leaves an error
+    // below 7e-10 (3e-9dB)
+    double t = (mantissa - 1.0) / (mantissa + 1.0);
+    double t2 = t * t;
+    double ln = 2.0 * t * (1.0 + t2 * (1.0/3.0 + t2 * (1.0/5.0 + t2 * (1.0/7.0 + t2 * (1.0/9.0)))));
+    return 10.0 * M_LN2 / M_LN10 * exponent + 10.0 / M_LN10 * ln;
+}
+
+static inline bool isNormalPower(double power)
+{
+    return power >= numeric_limits<double>::min() && power <= numeric_limits<double>::max();
+}
+
+double Conversion::VSWR(std::complex<double> S)
+{
+    auto mag = abs(S);
+    return mag < 1.0 ? (1.0 + mag) / (1.0 - mag) : numeric_limits<double>::quiet_NaN();
+}
+
+double Conversion::FastPowerDB(double power)
+{
+    if(!isNormalPower(power)) {
+        return 10*log10(power);
+    }
+    return powerDB(power);
+}
+
+void Conversion::MagnitudeDB(const std::complex<double> *S, double *dest, unsigned int n)
+{
+    // complex numbers are stored as two consecutive doubles
+    auto values = reinterpret_cast<const double*>(S);
+    unsigned int special = 0;
+    for(unsigned int i=0;i<n;i++) {
+        double power = values[2*i] * values[2*i] + values[2*i+1] * values[2*i+1];
+        special |= !isNormalPower(power);
+        dest[i] = powerDB(power);
+    }
+    if(special) {
+        // rare, redo the values whose squared magnitude is out of range (or zero/NaN) exactly
+        for(unsigned int i=0;i<n;i++) {
+            double power = values[2*i] * values[2*i] + values[2*i+1] * values[2*i+1];
+            if(!isNormalPower(power)) {
+                dest[i] = dB(S[i]);
+            }
+        }
+    }
+}
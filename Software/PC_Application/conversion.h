@@ -0,0 +1,27 @@
+#ifndef CONVERSION_H
+#define CONVERSION_H
+
+#include <complex>
+
+// Conversions of S parameters into display quantities. The scalar functions are exact, the batch magnitude works on
+// contiguous arrays and is written without branches or library calls in its inner loop, leaving the vectorization
+// to the compiler. Benchmark/ measures it against the scalar conversion
+class Conversion
+{
+public:
+    static double dB(std::complex<double> S) { return 20*std::log10(std::abs(S)); }
+    // in degrees
+    static double Phase(std::complex<double> S) { return std::arg(S) * 180.0 / M_PI; }
+    // NaN for |S| >= 1
+    static double VSWR(std::complex<double> S);
+    static std::complex<double> Impedance(std::complex<double> S, double Z0 = 50.0) { return Z0 * (1.0 + S) / (1.0 - S); }
+
+    // Approximation of 10*log10(power). The absolute error is below 1e-8dB for all positive normal numbers.
+    // Other values (zero, negative, denormal, infinite, NaN) are passed on to log10
+    static double FastPowerDB(double power);
+
+    // |S| in dB, calculated with FastPowerDB
+    static void MagnitudeDB(const std::complex<double> *S, double *dest, unsigned int n);
+};
+
+#endif // CONVERSION_H
@@ -1,11 +1,14 @@
 #include "touchstone.h"
+#include "conversion.h"
 #include <limits>
 #include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <cmath>
 #include <cctype>
+#include <cstring>
 #include <string>
+#include <sstream>
 
 using namespace std;
 
@@ -33,6 +36,144 @@ void Touchstone::AddDatapoint(Touchstone::Datapoint p)
     }
 }
 
+// Locale independent number conversion without streams. Numbers whose significant digits fit into the mantissa of a
+// double (up to 15 digits, sometimes 16) and with a small exponent are converted exactly with a single floating point
+// operation. All other numbers take the slow path through a stream.
+static constexpr double exactPowersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// Parses the number at pos (no leading whitespace) and advances pos behind it
+static double parseNumber(const char *&pos, const char *end)
+{
+    auto start = pos;
+    bool negative = false;
+    if(pos < end && (*pos == '-' || *pos == '+')) {
+        negative = *pos == '-';
+        pos++;
+    }
+    // value = mantissa * 10^exponent. Zeros are only added to the mantissa once another digit follows,
+    // trailing zeros (e.g. from fixed point output) do not count as significant digits
+    uint64_t mantissa = 0;
+    unsigned int digits = 0;
+    unsigned int pendingZeros = 0;
+    // pending zeros behind the decimal point
+    unsigned int pendingFractionZeros = 0;
+    int exponent = 0;
+    bool anyDigit = false;
+    auto addDigit = [&](char c, bool fraction) {
+        anyDigit = true;
+        if(c == '0') {
+            if(mantissa == 0) {
+                // leading zero
+                exponent -= fraction ? 1 : 0;
+            } else {
+                pendingZeros++;
+                pendingFractionZeros += fraction ? 1 : 0;
+            }
+            return;
+        }
+        digits += pendingZeros + 1;
+        if(digits <= 19) {
+            for(;pendingZeros > 0;pendingZeros--) {
+                mantissa *= 10;
+            }
+            mantissa = mantissa * 10 + (c - '0');
+        }
+        exponent -= fraction ? pendingFractionZeros + 1 : 0;
+        pendingZeros = 0;
+        pendingFractionZeros = 0;
+    };
+    for(;pos < end && isdigit(*pos);pos++) {
+        addDigit(*pos, false);
+    }
+    if(pos < end && *pos == '.') {
+        pos++;
+        for(;pos < end && isdigit(*pos);pos++) {
+            addDigit(*pos, true);
+        }
+    }
+    // remaining zeros of the integer part
+    exponent += pendingZeros - pendingFractionZeros;
+    if(!anyDigit) {
+        throw runtime_error("Invalid number in data line");
+    }
+    if(pos < end && (*pos == 'e' || *pos == 'E')) {
+        auto exponentStart = pos;
+        pos++;
+        bool negativeExponent = false;
+        if(pos < end && (*pos == '-' || *pos == '+')) {
+            negativeExponent = *pos == '-';
+            pos++;
+        }
+        if(pos < end && isdigit(*pos)) {
+            int e = 0;
+            for(;pos < end && isdigit(*pos);pos++) {
+                if(e < 10000) {
+                    e = e * 10 + (*pos - '0');
+                }
+            }
+            exponent += negativeExponent ? -e : e;
+        } else {
+            // not an exponent after all
+            pos = exponentStart;
+        }
+    }
+    if(digits <= 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        // the mantissa and the power of ten are exact, the result is correctly rounded
+        double value = mantissa;
+        if(exponent < 0) {
+            value /= exactPowersOf10[-exponent];
+        } else {
+            value *= exactPowersOf10[exponent];
+        }
+        return negative ? -value : value;
+    }
+    istringstream iss(string(start, pos));
+    iss.imbue(locale::classic());
+    double value;
+    iss >> value;
+    return value;
+}
+
+// Appends the number with a fixed number of decimals (same format as std::fixed with a classic locale)
+static void appendNumber(string &out, double value, unsigned int decimals = 12)
+{
+    auto scale = exactPowersOf10[decimals];
+    double integral;
+    double fraction = modf(abs(value), &integral);
+    auto fractionDigits = (uint64_t) llround(fraction * scale);
+    if(fractionDigits >= scale) {
+        integral += 1.0;
+        fractionDigits = 0;
+    }
+    if(!isfinite(value) || integral >= 1e19) {
+        // rare, use the slow path
+        ostringstream oss;
+        oss.imbue(locale::classic());
+        oss << fixed << setprecision(decimals) << value;
+        out.append(oss.str());
+        return;
+    }
+    char buf[48];
+    char *p = buf + sizeof(buf);
+    for(unsigned int i=0;i<decimals;i++) {
+        *--p = '0' + fractionDigits % 10;
+        fractionDigits /= 10;
+    }
+    *--p = '.';
+    auto integralDigits = (uint64_t) integral;
+    do {
+        *--p = '0' + integralDigits % 10;
+        integralDigits /= 10;
+    } while(integralDigits > 0);
+    if(signbit(value)) {
+        *--p = '-';
+    }
+    out.append(p, buf + sizeof(buf) - p);
+}
+
 void Touchstone::toFile(string filename, Unit unit, Format format)
 {
     // strip any potential file name extension and apply snp convention
@@ -41,89 +182,100 @@ void Touchstone::toFile(string filename, Unit unit, Format format)
     }
     filename.append(".s" + to_string(m_ports) + "p");
 
-    // create file
-    ofstream file;
-    file.open(filename);
-    file << std::fixed << std::setprecision(12);
+    // the whole file is assembled in memory and written at once
+    string out;
+    // every parameter takes roughly two numbers with 16 characters
+    out.reserve(m_datapoints.size() * (m_ports * m_ports * 34 + 24) + 64);
 
     // write option line
-    file << "# ";
+    out.append("# ");
     switch(unit) {
-        case Unit::Hz: file << "HZ "; break;
-        case Unit::kHz: file << "KHZ "; break;
-        case Unit::MHz: file << "MHZ "; break;
-        case Unit::GHz: file << "GHZ "; break;
+        case Unit::Hz: out.append("HZ "); break;
+        case Unit::kHz: out.append("KHZ "); break;
+        case Unit::MHz: out.append("MHZ "); break;
+        case Unit::GHz: out.append("GHZ "); break;
     }
     // only S parameters supported so far
-    file << "S ";
+    out.append("S ");
     switch(format) {
-        case Format::DBAngle: file << "DB "; break;
-        case Format::RealImaginary: file << "RI "; break;
-        case Format::MagnitudeAngle: file << "MA "; break;
+        case Format::DBAngle: out.append("DB "); break;
+        case Format::RealImaginary: out.append("RI "); break;
+        case Format::MagnitudeAngle: out.append("MA "); break;
     }
     // reference impedance is always 50 ohm
-    file << "R 50\n";
+    out.append("R 50\n");
 
-    auto printParameter = [format](ostream &out, complex<double> &c) {
+    auto printParameter = [format, &out](const complex<double> &c) {
         switch (format) {
         case Format::RealImaginary:
-            out << c.real() << " " << c.imag();
+            appendNumber(out, c.real());
+            out.push_back(' ');
+            appendNumber(out, c.imag());
             break;
         case Format::MagnitudeAngle:
-            out << abs(c) << " " << arg(c) / M_PI * 180.0;
+            appendNumber(out, abs(c));
+            out.push_back(' ');
+            appendNumber(out, Conversion::Phase(c));
             break;
         case Format::DBAngle:
-            out << 20*log10(abs(c)) << " " << arg(c) / M_PI * 180.0;
+            appendNumber(out, Conversion::dB(c));
+            out.push_back(' ');
+            appendNumber(out, Conversion::Phase(c));
             break;
         }
     };
 
-    for(auto p : m_datapoints) {
+    for(const auto &p : m_datapoints) {
         switch(unit) {
-            case Unit::Hz: file << p.frequency; break;
-            case Unit::kHz: file << p.frequency / 1e3; break;
-            case Unit::MHz: file << p.frequency / 1e6; break;
-            case Unit::GHz: file << p.frequency / 1e9; break;
+            case Unit::Hz: appendNumber(out, p.frequency); break;
+            case Unit::kHz: appendNumber(out, p.frequency / 1e3); break;
+            case Unit::MHz: appendNumber(out, p.frequency / 1e6); break;
+            case Unit::GHz: appendNumber(out, p.frequency / 1e9); break;
         }
-        file << " ";
+        out.push_back(' ');
         // special cases for 1 and 2 port
         if (m_ports == 1) {
-            printParameter(file, p.S[0]);
-            file << "\n";
+            printParameter(p.S[0]);
+            out.push_back('\n');
         } else if (m_ports == 2){
-            printParameter(file, p.S[0]);
+            printParameter(p.S[0]);
             // touchstone expects S11 S21 S12 S22 order, swap S12 and S21
-            file << " ";
-            printParameter(file, p.S[2]);
-            file << " ";
-            printParameter(file, p.S[1]);
-            file << " ";
-            printParameter(file, p.S[3]);
-            file << "\n";
+            out.push_back(' ');
+            printParameter(p.S[2]);
+            out.push_back(' ');
+            printParameter(p.S[1]);
+            out.push_back(' ');
+            printParameter(p.S[3]);
+            out.push_back('\n');
         } else {
             // print parameters in matrix form
             for(unsigned int i=0;i<m_ports;i++) {
                 for(unsigned int j=0;j<m_ports;j++) {
-                    printParameter(file, p.S[i*m_ports + j]);
+                    printParameter(p.S[i*m_ports + j]);
                     if (j%4 == 3) {
-                        file << "\n";
+                        out.push_back('\n');
                     } else {
-                        file << " ";
+                        out.push_back(' ');
                     }
                 }
                 if(m_ports%4 != 0) {
-                    file << "\n";
+                    out.push_back('\n');
                 }
             }
         }
     }
+
+    ofstream file;
+    file.open(filename, ios::binary);
+    file.write(out.data(), out.size());
     file.close();
 }
 
 Touchstone Touchstone::fromFile(string filename)
 {
+    // read the whole file at once, it is parsed directly in the buffer
     ifstream file;
-    file.open(filename);
+    file.open(filename, ios::binary | ios::ate);
 
     if(!file.is_open()) {
         throw runtime_error("Unable to open file");
@@ -131,7 +283,9 @@ Touchstone Touchstone::fromFile(string filename)
 
     // extract number of ports from filename
     auto index_extension = filename.find_last_of('.');
-    if(filename[index_extension + 1] != 's'
+    if(index_extension == string::npos
+            || filename.size() < index_extension + 4
+            || filename[index_extension + 1] != 's'
             || filename[index_extension+2] < '1'
             || filename[index_extension+2] > '9'
             || filename[index_extension+3] != 'p') {
@@ -140,35 +294,54 @@ Touchstone Touchstone::fromFile(string filename)
     unsigned int ports = filename[index_extension + 2] - '0';
     auto ret = Touchstone(ports);
 
+    string buffer;
+    buffer.resize(file.tellg());
+    file.seekg(0);
+    file.read(&buffer[0], buffer.size());
+    file.close();
+
     Unit unit = Unit::GHz;
     Format format = Format::RealImaginary;
 
     bool option_line_found = false;
-    unsigned int parameter_cnt = 0;
 
-    Datapoint point;
+    // A datapoint consists of the frequency followed by two numbers for every parameter. Apart from the option line and
+    // comments, line breaks carry no information: the numbers are simply counted (this also handles matrix rows with more
+    // than four parameters that continue in the next line)
+    const unsigned int parameters_per_point = ports * ports;
+    vector<double> values(1 + 2 * parameters_per_point);
+    unsigned int value_cnt = 0;
+    bool sorted = true;
+    // about 20 characters per number, reserving a bit too much is cheaper than growing the vector
+    ret.m_datapoints.reserve(buffer.size() / (values.size() * 10) + 1);
 
-    string line;
-    while(getline(file, line)) {
-        // remove comments
-        auto comment = line.find_first_of('!');
-        if(comment != string::npos) {
-            line.erase(comment);
+    const char *pos = buffer.data();
+    auto end = pos + buffer.size();
+    while(pos < end) {
+        auto line_end = (const char*) memchr(pos, '\n', end - pos);
+        if(!line_end) {
+            line_end = end;
         }
+        // remove comments
+        auto comment = (const char*) memchr(pos, '!', line_end - pos);
+        auto content_end = comment ? comment : line_end;
         // remove leading whitespace
-        size_t first = line.find_first_not_of(" \t");
-        if (string::npos == first) {
-            // string does only contain whitespace, skip line
+        while(pos < content_end && isspace(*pos)) {
+            pos++;
+        }
+        if(pos == content_end) {
+            // line does only contain whitespace, skip line
+            pos = line_end + (line_end < end ? 1 : 0);
             continue;
         }
-        line.erase(0, first);
 
-        if (line[0] == '#') {
+        if (*pos == '#') {
             // this is the option line
             if (option_line_found) {
                 throw runtime_error("Additional option line present");
             }
             option_line_found = true;
+            string line(pos, content_end);
             transform(line.begin(), line.end(), line.begin(), ::toupper);
             // check individual options
             istringstream iss(line);
@@ -221,58 +394,59 @@ Touchstone Touchstone::fromFile(string filename)
             if(!option_line_found) {
                 throw runtime_error("First dataline before option line");
             }
-            auto parseDatapoint = [format](istream &in) -> complex<double> {
-                double part1, part2;
-                in >> part1;
-                in >> part2;
-                complex<double> ret;
-                switch(format) {
-                case Format::MagnitudeAngle:
-                    ret = polar(part1, part2 / 180.0 * M_PI);
-                    break;
-                case Format::DBAngle:
-                    ret = polar(pow(10, part1/20), part2 / 180.0 * M_PI);
-                    break;
-                case Format::RealImaginary:
-                    ret = complex<double>(part1, part2);
-                    break;
-                }
-                return ret;
-            };
-            istringstream iss(line);
-            if (parameter_cnt == 0) {
-                iss >> point.frequency;
-                point.S.clear();
-                switch(unit) {
-                    case Unit::Hz: break;
-                    case Unit::kHz: point.frequency *= 1e3; break;
-                    case Unit::MHz: point.frequency *= 1e6; break;
-                    case Unit::GHz: point.frequency *= 1e9; break;
-                }
-            }
-            unsigned int parameters_per_line;
-            if(ports == 1) {
-                parameters_per_line = 1;
-            } else if(ports == 3) {
-                parameters_per_line = 3;
-            } else {
-                parameters_per_line = 4;
-            }
-            unsigned int parameters_per_point = ports * ports;
-            for(unsigned int i=0;i<parameters_per_line;i++) {
-                point.S.push_back(parseDatapoint(iss));
-                parameter_cnt++;
-                if(parameter_cnt >= parameters_per_point) {
-                    parameter_cnt = 0;
+            while(pos < content_end) {
+                values[value_cnt++] = parseNumber(pos, content_end);
+                if(value_cnt == values.size()) {
+                    value_cnt = 0;
+                    Datapoint point;
+                    point.frequency = values[0];
+                    switch(unit) {
+                        case Unit::Hz: break;
+                        case Unit::kHz: point.frequency *= 1e3; break;
+                        case Unit::MHz: point.frequency *= 1e6; break;
+                        case Unit::GHz: point.frequency *= 1e9; break;
+                    }
+                    point.S.resize(parameters_per_point);
+                    for(unsigned int i=0;i<parameters_per_point;i++) {
+                        auto part1 = values[1 + 2*i];
+                        auto part2 = values[2 + 2*i];
+                        switch(format) {
+                        case Format::MagnitudeAngle:
+                            point.S[i] = polar(part1, part2 / 180.0 * M_PI);
+                            break;
+                        case Format::DBAngle:
+                            point.S[i] = polar(pow(10, part1/20), part2 / 180.0 * M_PI);
+                            break;
+                        case Format::RealImaginary:
+                            point.S[i] = complex<double>(part1, part2);
+                            break;
+                        }
+                    }
                     if(ports == 2) {
                         // 2 port touchstone has S11 S21 S12 S22 order, swap S12 and S21
                         swap(point.S[1], point.S[2]);
                     }
-                    ret.AddDatapoint(point);
-                    break;
+                    if(ret.m_datapoints.size() > 0 && ret.m_datapoints.back().frequency >= point.frequency) {
+                        sorted = false;
+                    }
+                    ret.m_datapoints.push_back(move(point));
+                }
+                if(pos < content_end && !isspace(*pos) && *pos != ',') {
+                    throw runtime_error("Invalid number in data line");
+                }
+                // skip separators
+                while(pos < content_end && (isspace(*pos) || *pos == ',')) {
+                    pos++;
                 }
             }
         }
+        pos = line_end + (line_end < end ? 1 : 0);
+    }
+    if(!sorted) {
+        // sorted once instead of with every point like AddDatapoint does
+        stable_sort(ret.m_datapoints.begin(), ret.m_datapoints.end(), [](const Datapoint &a, const Datapoint &b) {
+           return a.frequency < b.frequency;
+        });
     }
     return ret;
 }
@@ -307,12 +481,12 @@ Touchstone::Datapoint Touchstone::interpolate(double frequency)
         return m_datapoints.back();
     }
     // frequency within points, interpolate
-    auto lower = lower_bound(m_datapoints.begin(), m_datapoints.end(), frequency, [](const Datapoint &lhs, double rhs) -> bool {
+    auto upper = lower_bound(m_datapoints.begin(), m_datapoints.end(), frequency, [](const Datapoint &lhs, double rhs) -> bool {
         return lhs.frequency < rhs;
     });
-    auto lowPoint = *lower;
-    advance(lower, 1);
-    auto highPoint = *lower;
+    // upper is the first point at or above the frequency, it can't be the first point
+    auto &highPoint = *upper;
+    auto &lowPoint = *(upper - 1);
     double alpha = (frequency - lowPoint.frequency) / (highPoint.frequency - lowPoint.frequency);
     Datapoint ret;
     ret.frequency = frequency;
@@ -322,6 +496,76 @@ Touchstone::Datapoint Touchstone::interpolate(double frequency)
     return ret;
 }
 
+void Touchstone::resample(const std::vector<double> &frequencies, Touchstone::Resampled &dest, Touchstone::Interpolation interpolation)
+{
+    if(m_datapoints.size() == 0) {
+        throw runtime_error("Trying to interpolate empty touchstone data");
+    }
+    const unsigned int n = frequencies.size();
+    const unsigned int points = m_datapoints.size();
+    dest.frequencies.assign(frequencies.begin(), frequencies.end());
+
+    // Locate all frequencies first: every frequency is interpolated between the points low and high with the weight alpha
+    vector<unsigned int> low(n), high(n);
+    vector<double> alpha(n);
+    // index of the first point at or above the current frequency
+    unsigned int upper = 0;
+    for(unsigned int i=0;i<n;i++) {
+        auto frequency = frequencies[i];
+        if(i > 0 && frequency < frequencies[i-1]) {
+            // frequencies not sorted, start again at the beginning
+            upper = 0;
+        }
+        while(upper < points && m_datapoints[upper].frequency < frequency) {
+            upper++;
+        }
+        if(upper == 0 || upper == points) {
+            // outside of the data, use the first/last point
+            low[i] = high[i] = upper == 0 ? 0 : points - 1;
+            alpha[i] = 0.0;
+        } else {
+            low[i] = upper - 1;
+            high[i] = upper;
+            alpha[i] = (frequency - m_datapoints[low[i]].frequency) / (m_datapoints[high[i]].frequency - m_datapoints[low[i]].frequency);
+        }
+    }
+
+    // The parameters are interpolated one after the other. Each parameter is copied into plain arrays first,
+    // the interpolation loops then only contain arithmetic on arrays without branches
+    dest.S.resize(m_ports * m_ports);
+    vector<double> a(points), b(points);
+    for(unsigned int p=0;p<m_ports*m_ports;p++) {
+        auto &out = dest.S[p];
+        out.resize(n);
+        switch(interpolation) {
+        case Interpolation::Linear:
+            for(unsigned int k=0;k<points;k++) {
+                a[k] = m_datapoints[k].S[p].real();
+                b[k] = m_datapoints[k].S[p].imag();
+            }
+            for(unsigned int i=0;i<n;i++) {
+                out[i] = complex<double>(a[low[i]] + (a[high[i]] - a[low[i]]) * alpha[i],
+                                         b[low[i]] + (b[high[i]] - b[low[i]]) * alpha[i]);
+            }
+            break;
+        case Interpolation::Polar:
+            for(unsigned int k=0;k<points;k++) {
+                a[k] = abs(m_datapoints[k].S[p]);
+                b[k] = arg(m_datapoints[k].S[p]);
+                if(k > 0) {
+                    // unwrap, the phase is interpolated along the shorter way between neighboring points
+                    b[k] = b[k-1] + remainder(b[k] - b[k-1], 2 * M_PI);
+                }
+            }
+            for(unsigned int i=0;i<n;i++) {
+                out[i] = polar(a[low[i]] + (a[high[i]] - a[low[i]]) * alpha[i],
+                               b[low[i]] + (b[high[i]] - b[low[i]]) * alpha[i]);
+            }
+            break;
+        }
+    }
+}
+
 void Touchstone::reduceTo2Port(unsigned int port1, unsigned int port2)
 {
     if (port1 >= m_ports || port2 >= m_ports || port1 == port2) {
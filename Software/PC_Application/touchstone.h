@@ -27,15 +27,37 @@ public:
         std::vector<std::complex<double>> S;
     };
 
+    enum class Interpolation {
+        // real and imaginary part
+        Linear,
+        // magnitude and phase, follows rotating parameters (e.g. delays) more closely for sparse data
+        Polar,
+    };
+
+    // Resampled data, one array per parameter (structure of arrays). Can be reused for multiple
+    // resample calls, the arrays are only reallocated if they have to grow
+    class Resampled {
+    public:
+        std::vector<double> frequencies;
+        // S[parameter][index of frequency]
+        std::vector<std::vector<std::complex<double>>> S;
+    };
+
     Touchstone(unsigned int m_ports);
     void AddDatapoint(Datapoint p);
+    // The file is assembled in memory and written at once
     void toFile(std::string filename, Unit unit = Unit::GHz, Format format = Format::RealImaginary);
+    // The whole file is read at once and parsed without streams, independent of the locale
     static Touchstone fromFile(std::string filename);
     double minFreq();
     double maxFreq();
     unsigned int points() { return m_datapoints.size(); };
-    Datapoint point(int index) { return m_datapoints.at(index); };
+    const Datapoint &point(int index) { return m_datapoints.at(index); };
     Datapoint interpolate(double frequency);
+    // Interpolates all parameters for many frequencies at once. Sorted frequencies are located in a single pass
+    // through the data instead of searching the surrounding points for every frequency. Frequencies outside
+    // of the data get the first/last point
+    void resample(const std::vector<double> &frequencies, Resampled &dest, Interpolation interpolation = Interpolation::Linear);
     // remove all paramaters except the ones regarding port1 and port2 (port cnt starts at 0)
     void reduceTo2Port(unsigned int port1, unsigned int port2);
     // remove all paramaters except the ones from port (port cnt starts at 0)
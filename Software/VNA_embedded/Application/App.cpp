@@ -17,6 +17,7 @@
 #include "Manual.hpp"
 #include "Generator.hpp"
 #include "SpectrumAnalyzer.hpp"
+#include "Profiling.hpp"
 
 #define LOG_LEVEL	LOG_LEVEL_INFO
 #define LOG_MODULE	"App"
@@ -50,6 +51,13 @@ static void VNACallback(const Protocol::Datapoint &res) {
 	portYIELD_FROM_ISR(woken);
 	DEBUG2_LOW();
 }
+static void VNARawCallback(const Protocol::RawDatapoint &res) {
+	transmit_packet.type = Protocol::PacketType::RawDatapoint;
+	transmit_packet.rawDatapoint = res;
+	BaseType_t woken = false;
+	xTaskNotifyFromISR(handle, FLAG_DATAPOINT, eSetBits, &woken);
+	portYIELD_FROM_ISR(woken);
+}
 static void USBPacketReceived(const Protocol::PacketInfo &p) {
 	recv_packet = p;
 	BaseType_t woken = false;
@@ -59,6 +67,7 @@ static void USBPacketReceived(const Protocol::PacketInfo &p) {
 
 void App_Start() {
 	STM::Init();
+	Profiling::Init();
 	HAL_ADCEx_Calibration_Start(&hadc1, ADC_SINGLE_ENDED);
 	handle = xTaskGetCurrentTaskHandle();
 	usb_init(communication_usb_input);
@@ -68,6 +77,7 @@ void App_Start() {
 	Communication::SetCallback(USBPacketReceived);
 	// Pass on logging output to USB
 	Log_SetRedirect(usb_log);
+	usb_set_log_complete_callback(Log_RedirectComplete);
 	LOG_INFO("Start");
 	Exti::Init();
 #ifdef HAS_FLASH
@@ -75,20 +85,32 @@ void App_Start() {
 		LOG_CRIT("Failed to detect onboard FLASH");
 		LED::Error(1);
 	}
-	auto fw_info = Firmware::GetFlashContentInfo(&flash);
+	uint32_t bootHeader = HAL_GetTick();
+	auto fw_info = Firmware::GetFlashHeaderInfo(&flash);
+	uint32_t bootFPGA = HAL_GetTick();
+	uint32_t bootVerify = bootFPGA;
 	if(fw_info.valid) {
-		if(fw_info.CPU_need_update) {
-			// Function will not return, the device will reboot with the new firmware instead
-//			Firmware::PerformUpdate(&flash, fw_info);
-		}
-		if(!FPGA::Configure(&flash, fw_info.FPGA_bitstream_address, fw_info.FPGA_bitstream_size)) {
+		// Unless already verified during a previous boot, the CRC of the bitstream is calculated while
+		// configuring the FPGA. A corrupted bitstream is also rejected by the FPGA itself
+		uint32_t crc = UINT32_MAX;
+		if(!FPGA::Configure(&flash, fw_info.FPGA_bitstream_address, fw_info.FPGA_bitstream_size,
+				fw_info.verified ? nullptr : &crc)) {
 			LOG_CRIT("FPGA configuration failed");
 			LED::Error(3);
 		}
+		bootVerify = HAL_GetTick();
+		if(!fw_info.verified && !Firmware::CompleteVerification(&flash, fw_info, crc)) {
+			LOG_CRIT("Invalid bitstream/firmware");
+			LED::Error(2);
+		} else if(fw_info.CPU_need_update) {
+			// Function will not return, the device will reboot with the new firmware instead
+//			Firmware::PerformUpdate(&flash, fw_info);
+		}
 	} else {
 		LOG_CRIT("Invalid bitstream/firmware, not configuring FPGA");
 		LED::Error(2);
 	}
+	uint32_t bootHW = HAL_GetTick();
 #else
 	// The FPGA configures itself from the flash, allow time for this
 	vTaskDelay(2000);
@@ -102,13 +124,21 @@ void App_Start() {
 		LOG_CRIT("Initialization failed, unable to start");
 		LED::Error(4);
 	}
+#ifdef HAS_FLASH
+	uint32_t bootDone = HAL_GetTick();
+	LOG_INFO("Boot timing: header %lums, FPGA %lums, verification %lums, HW init %lums",
+			bootFPGA - bootHeader, bootVerify - bootFPGA, bootHW - bootVerify, bootDone - bootHW);
+#endif
 
 #if HW_REVISION == 'A'
 	// Allow USB enumeration
 	USB_EN_GPIO_Port->BSRR = USB_EN_Pin;
 #endif
 
-	uint32_t lastNewPoint = HAL_GetTick();
+	// averaged and decimated points take several measurements per transmitted point, the sweep is only considered
+	// stuck if no measurement completes at all
+	uint32_t lastMeasurement = HAL_GetTick();
+	uint32_t lastMeasurementCnt = VNA::MeasurementCount();
 	bool sweepActive = false;
 
 	LED::Off();
@@ -118,17 +148,25 @@ void App_Start() {
 			// something happened
 			if(notification & FLAG_DATAPOINT) {
 				Communication::Send(transmit_packet);
-				lastNewPoint = HAL_GetTick();
 			}
 			if(notification & FLAG_USB_PACKET) {
 				switch(recv_packet.type) {
 				case Protocol::PacketType::SweepSettings:
 					LOG_INFO("New settings received");
 					settings = recv_packet.settings;
-					sweepActive = VNA::Setup(settings, VNACallback);
-					lastNewPoint = HAL_GetTick();
+					sweepActive = VNA::Setup(settings, VNACallback, VNARawCallback);
+					lastMeasurement = HAL_GetTick();
 					Communication::SendWithoutPayload(Protocol::PacketType::Ack);
 					break;
+				case Protocol::PacketType::SweepSegment:
+					// stops the sweep, it must not be restarted before the settings of the new sweep arrive
+					sweepActive = false;
+					if(VNA::SetSegment(recv_packet.segment)) {
+						Communication::SendWithoutPayload(Protocol::PacketType::Ack);
+					} else {
+						Communication::SendWithoutPayload(Protocol::PacketType::Nack);
+					}
+					break;
 				case Protocol::PacketType::ManualControl:
 					sweepActive = false;
 					Manual::Setup(recv_packet.manual);
@@ -148,6 +186,13 @@ void App_Start() {
 					Generator::Setup(recv_packet.generator);
 					Communication::SendWithoutPayload(Protocol::PacketType::Ack);
 					break;
+				case Protocol::PacketType::GeneratorListEntry:
+					if(Generator::SetListEntry(recv_packet.generatorListEntry)) {
+						Communication::SendWithoutPayload(Protocol::PacketType::Ack);
+					} else {
+						Communication::SendWithoutPayload(Protocol::PacketType::Nack);
+					}
+					break;
 				case Protocol::PacketType::SpectrumAnalyzerSettings:
 					sweepActive = false;
 					LOG_INFO("Updating spectrum analyzer settings");
@@ -160,13 +205,21 @@ void App_Start() {
 					p.limits = HW::Limits;
 					Communication::Send(p);
 					break;
+				case Protocol::PacketType::RequestProfiling:
+					p.type = Protocol::PacketType::ProfilingReport;
+					Profiling::Report(p.profiling);
+					Communication::Send(p);
+					break;
+				case Protocol::PacketType::RequestLogFormat:
+					Log_SendFormat(recv_packet.logFormatID);
+					break;
 #ifdef HAS_FLASH
 				case Protocol::PacketType::ClearFlash:
 					HW::SetMode(HW::Mode::Idle);
 					sweepActive = false;
 					LOG_DEBUG("Erasing FLASH in preparation for firmware update...");
 					if(flash.eraseChip()) {
-						LOG_DEBUG("...FLASH erased")
+						LOG_DEBUG("...FLASH erased");
 						Communication::SendWithoutPayload(Protocol::PacketType::Ack);
 					} else {
 						LOG_ERR("Failed to erase FLASH");
@@ -204,15 +257,20 @@ void App_Start() {
 			}
 		}
 
-		if(sweepActive && HAL_GetTick() - lastNewPoint > 1000) {
-			LOG_WARN("Timed out waiting for point, last received point was %d (Status 0x%04x)", result.pointNum, FPGA::GetStatus());
+		uint32_t measurementCnt = VNA::MeasurementCount();
+		if(measurementCnt != lastMeasurementCnt) {
+			lastMeasurementCnt = measurementCnt;
+			lastMeasurement = HAL_GetTick();
+		}
+		if(sweepActive && HAL_GetTick() - lastMeasurement > 1000) {
+			LOG_WARN("Timed out waiting for measurement, last received point was %d (Status 0x%04x)", result.pointNum, FPGA::GetStatus());
 			FPGA::AbortSweep();
 			// restart the current sweep
 			HW::Init();
 			HW::Ref::update();
-			VNA::Setup(settings, VNACallback);
+			VNA::Setup(settings, VNACallback, VNARawCallback);
 			sweepActive = true;
-			lastNewPoint = HAL_GetTick();
+			lastMeasurement = HAL_GetTick();
 		}
 	}
 }
@@ -4,6 +4,7 @@
 #include "../App.h"
 #include <string.h>
 #include "USB/usb.h"
+#include "Profiling.hpp"
 
 static uint8_t inputBuffer[1024];
 uint16_t inputCnt = 0;
@@ -44,11 +45,19 @@ void Communication::Input(const uint8_t *buf, uint16_t len) {
 }
 #include "Hardware.hpp"
 bool Communication::Send(const Protocol::PacketInfo &packet) {
+	Profiling::Scope profiling(Profiling::Section::CommunicationSend);
 //	DEBUG1_HIGH();
 	uint16_t len = Protocol::EncodePacket(packet, outputBuffer,
 					sizeof(outputBuffer));
 //	DEBUG1_LOW();
-	return usb_transmit(outputBuffer, len);
+	// usb.c is plain C, its timing is measured here. Send is also called from interrupts, a local scope keeps
+	// nested calls from overwriting each others start time
+	bool success;
+	{
+		Profiling::Scope usbProfiling(Profiling::Section::USBTransmit);
+		success = usb_transmit(outputBuffer, len);
+	}
+	return success;
 //	if (hUsbDeviceFS.dev_state == USBD_STATE_CONFIGURED) {
 //		uint16_t len = Protocol::EncodePacket(packet, outputBuffer,
 //				sizeof(outputBuffer));
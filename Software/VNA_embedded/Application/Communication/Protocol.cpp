@@ -1,6 +1,7 @@
 #include "Protocol.hpp"
 
 #include <cstring>
+#include <cstddef>
 
 /*
  * General packet format:
@@ -15,15 +16,29 @@ static constexpr uint8_t header = 0x5A;
 static constexpr uint8_t header_size = 4;
 
 #define CRC32_POLYGON 0xEDB88320
+using CRC32Table = struct {
+	uint32_t entries[256];
+};
+static constexpr CRC32Table GenerateCRC32Table() {
+	CRC32Table t = {};
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (uint8_t k = 0; k < 8; k++) {
+			crc = crc & 1 ? (crc >> 1) ^ CRC32_POLYGON : crc >> 1;
+		}
+		t.entries[i] = crc;
+	}
+	return t;
+}
+// Generated at compile time (ends up in FLASH on the device), handles one byte per step instead of one bit
+static constexpr CRC32Table crc32Table = GenerateCRC32Table();
+
 uint32_t Protocol::CRC32(uint32_t crc, const void *data, uint32_t len) {
 	uint8_t *u8buf = (uint8_t*) data;
-	int k;
 
 	crc = ~crc;
 	while (len--) {
-		crc ^= *u8buf++;
-		for (k = 0; k < 8; k++)
-			crc = crc & 1 ? (crc >> 1) ^ CRC32_POLYGON : crc >> 1;
+		crc = crc32Table.entries[(crc ^ *u8buf++) & 0xFF] ^ (crc >> 8);
 	}
 	return ~crc;
 }
@@ -147,7 +162,9 @@ static Protocol::Datapoint DecodeDatapoint(uint8_t *buf) {
     e.get<float>(d.real_S22);
     e.get<float>(d.imag_S22);
     e.get<uint64_t>(d.frequency);
-    e.get<uint16_t>(d.pointNum);
+    e.get<uint32_t>(d.us);
+    e.get<uint32_t>(d.pointNum);
+    e.get<int16_t>(d.cdbm);
     return d;
 }
 static int16_t EncodeDatapoint(Protocol::Datapoint d, uint8_t *buf,
@@ -156,10 +173,11 @@ static int16_t EncodeDatapoint(Protocol::Datapoint d, uint8_t *buf,
 	// The datapoint is only ever encoded on the device and the
 	// Protocol::Datapoint struct is setup without any padding between
 	// the variables. In this case it is allowed to simply copy its
-	// content into the buffer. Compared to using the encoder, this
-	// saves approximately 40us for each datapoint
-	memcpy(buf, &d, sizeof(d));
-	return sizeof(d);
+	// content (up to the trailing padding) into the buffer. Compared
+	// to using the encoder, this saves approximately 40us for each datapoint
+	constexpr uint16_t size = offsetof(Protocol::Datapoint, cdbm) + sizeof(d.cdbm);
+	memcpy(buf, &d, size);
+	return size;
 //    Encoder e(buf, bufSize);
 //    e.add<float>(d.real_S11);
 //    e.add<float>(d.imag_S11);
@@ -170,21 +188,112 @@ static int16_t EncodeDatapoint(Protocol::Datapoint d, uint8_t *buf,
 //    e.add<float>(d.real_S22);
 //    e.add<float>(d.imag_S22);
 //    e.add<uint64_t>(d.frequency);
-//    e.add<uint16_t>(d.pointNum);
+//    e.add<uint32_t>(d.us);
+//    e.add<uint32_t>(d.pointNum);
+//    e.add<int16_t>(d.cdbm);
 //    return e.getSize();
 }
 
+static void Encode48(uint8_t *&buf, int64_t value) {
+	// both device and host are little endian, the lower six bytes contain the complete value
+	memcpy(buf, &value, 6);
+	buf += 6;
+}
+static int64_t Decode48(uint8_t *&buf) {
+	int64_t value = 0;
+	memcpy(&value, buf, 6);
+	buf += 6;
+	if(value & 0x800000000000LL) {
+		// sign extend
+		value -= 0x1000000000000LL;
+	}
+	return value;
+}
+
+static Protocol::RawDatapoint DecodeRawDatapoint(uint8_t *buf) {
+    Protocol::RawDatapoint d;
+    memset(&d, 0, sizeof(d));
+    uint8_t flags = *buf++;
+    d.excitePort1 = flags & 0x01 ? 1 : 0;
+    d.excitePort2 = flags & 0x02 ? 1 : 0;
+    d.port1Overload = flags & 0x04 ? 1 : 0;
+    d.port2Overload = flags & 0x08 ? 1 : 0;
+    d.refOverload = flags & 0x10 ? 1 : 0;
+    for(uint8_t i=0;i<2;i++) {
+        if(!(flags & (1 << i))) {
+            // this excitation was not measured and is not included in the packet
+            continue;
+        }
+        auto &e = d.excitation[i];
+        e.P1I = Decode48(buf);
+        e.P1Q = Decode48(buf);
+        e.P2I = Decode48(buf);
+        e.P2Q = Decode48(buf);
+        e.RefI = Decode48(buf);
+        e.RefQ = Decode48(buf);
+    }
+    memcpy(&d.frequency, buf, 8);
+    buf += 8;
+    memcpy(&d.us, buf, 4);
+    buf += 4;
+    memcpy(&d.pointNum, buf, 4);
+    buf += 4;
+    memcpy(&d.cdbm, buf, 2);
+    return d;
+}
+static int16_t EncodeRawDatapoint(const Protocol::RawDatapoint &d, uint8_t *buf,
+		uint16_t bufSize) {
+	// Bypassing the encoder for the same reason as the datapoint. Only the measured
+	// excitations are included and each value only occupies 6 bytes
+	uint16_t size = 1 + 8 + 4 + 4 + 2 + (d.excitePort1 + d.excitePort2) * 6 * 6;
+	if(size > bufSize) {
+		return -1;
+	}
+	uint8_t *start = buf;
+	*buf++ = d.excitePort1 | d.excitePort2 << 1 | d.port1Overload << 2
+			| d.port2Overload << 3 | d.refOverload << 4;
+	for(uint8_t i=0;i<2;i++) {
+		if(!(start[0] & (1 << i))) {
+			continue;
+		}
+		auto &e = d.excitation[i];
+		Encode48(buf, e.P1I);
+		Encode48(buf, e.P1Q);
+		Encode48(buf, e.P2I);
+		Encode48(buf, e.P2Q);
+		Encode48(buf, e.RefI);
+		Encode48(buf, e.RefQ);
+	}
+	memcpy(buf, &d.frequency, 8);
+	buf += 8;
+	memcpy(buf, &d.us, 4);
+	buf += 4;
+	memcpy(buf, &d.pointNum, 4);
+	buf += 4;
+	memcpy(buf, &d.cdbm, 2);
+	return size;
+}
+
 static Protocol::SweepSettings DecodeSweepSettings(uint8_t *buf) {
     Protocol::SweepSettings d;
     Decoder e(buf);
     e.get<uint64_t>(d.f_start);
     e.get<uint64_t>(d.f_stop);
-    e.get<uint16_t>(d.points);
+    e.get<uint32_t>(d.points);
     e.get<uint32_t>(d.if_bandwidth);
     e.get<int16_t>(d.cdbm_excitation);
+    e.get<int16_t>(d.cdbm_excitation_stop);
     d.excitePort1 = e.getBits(1);
     d.excitePort2 = e.getBits(1);
     d.suppressPeaks = e.getBits(1);
+    d.logSweep = e.getBits(1);
+    d.settlingTime = e.getBits(2);
+    d.rawData = e.getBits(1);
+    d.zeroSpan = e.getBits(1);
+    d.powerSweep = e.getBits(1);
+    e.get<uint8_t>(d.segments);
+    e.get<uint8_t>(d.averages);
+    e.get<uint8_t>(d.decimation);
     return d;
 }
 static int16_t EncodeSweepSettings(Protocol::SweepSettings d, uint8_t *buf,
@@ -192,12 +301,48 @@ static int16_t EncodeSweepSettings(Protocol::SweepSettings d, uint8_t *buf,
     Encoder e(buf, bufSize);
     e.add<uint64_t>(d.f_start);
     e.add<uint64_t>(d.f_stop);
-    e.add<uint16_t>(d.points);
+    e.add<uint32_t>(d.points);
     e.add<uint32_t>(d.if_bandwidth);
     e.add<int16_t>(d.cdbm_excitation);
+    e.add<int16_t>(d.cdbm_excitation_stop);
     e.addBits(d.excitePort1, 1);
     e.addBits(d.excitePort2, 1);
     e.addBits(d.suppressPeaks, 1);
+    e.addBits(d.logSweep, 1);
+    e.addBits(d.settlingTime, 2);
+    e.addBits(d.rawData, 1);
+    e.addBits(d.zeroSpan, 1);
+    e.addBits(d.powerSweep, 1);
+    e.add<uint8_t>(d.segments);
+    e.add<uint8_t>(d.averages);
+    e.add<uint8_t>(d.decimation);
+    return e.getSize();
+}
+
+static Protocol::SweepSegment DecodeSweepSegment(uint8_t *buf) {
+    Protocol::SweepSegment d;
+    Decoder e(buf);
+    e.get<uint8_t>(d.index);
+    e.get<uint64_t>(d.f_start);
+    e.get<uint64_t>(d.f_stop);
+    e.get<uint32_t>(d.points);
+    e.get<uint32_t>(d.if_bandwidth);
+    e.get<int16_t>(d.cdbm_excitation);
+    d.settlingTime = e.getBits(2);
+    d.logSweep = e.getBits(1);
+    return d;
+}
+static int16_t EncodeSweepSegment(Protocol::SweepSegment d, uint8_t *buf,
+		uint16_t bufSize) {
+    Encoder e(buf, bufSize);
+    e.add<uint8_t>(d.index);
+    e.add<uint64_t>(d.f_start);
+    e.add<uint64_t>(d.f_stop);
+    e.add<uint32_t>(d.points);
+    e.add<uint32_t>(d.if_bandwidth);
+    e.add<int16_t>(d.cdbm_excitation);
+    e.addBits(d.settlingTime, 2);
+    e.addBits(d.logSweep, 1);
     return e.getSize();
 }
 
@@ -224,6 +369,9 @@ static Protocol::GeneratorSettings DecodeGeneratorSettings(uint8_t *buf) {
     e.get<uint64_t>(d.frequency);
     e.get<int16_t>(d.cdbm_level);
     e.get<uint8_t>(d.activePort);
+    e.get<uint8_t>(d.listEntries);
+    d.listStatus = e.getBits(1);
+    d.listTrigger = e.getBits(1);
     return d;
 }
 static int16_t EncodeGeneratorSettings(Protocol::GeneratorSettings d, uint8_t *buf,
@@ -232,6 +380,41 @@ static int16_t EncodeGeneratorSettings(Protocol::GeneratorSettings d, uint8_t *b
     e.add<uint64_t>(d.frequency);
     e.add<int16_t>(d.cdbm_level);
     e.add<uint8_t>(d.activePort);
+    e.add<uint8_t>(d.listEntries);
+    e.addBits(d.listStatus, 1);
+    e.addBits(d.listTrigger, 1);
+    return e.getSize();
+}
+
+static Protocol::GeneratorListEntry DecodeGeneratorListEntry(uint8_t *buf) {
+    Protocol::GeneratorListEntry d;
+    Decoder e(buf);
+    e.get<uint8_t>(d.index);
+    e.get<uint64_t>(d.frequency);
+    e.get<int16_t>(d.cdbm_level);
+    e.get<uint32_t>(d.dwell_us);
+    return d;
+}
+static int16_t EncodeGeneratorListEntry(Protocol::GeneratorListEntry d, uint8_t *buf,
+		uint16_t bufSize) {
+    Encoder e(buf, bufSize);
+    e.add<uint8_t>(d.index);
+    e.add<uint64_t>(d.frequency);
+    e.add<int16_t>(d.cdbm_level);
+    e.add<uint32_t>(d.dwell_us);
+    return e.getSize();
+}
+
+static Protocol::GeneratorStep DecodeGeneratorStep(uint8_t *buf) {
+    Protocol::GeneratorStep d;
+    Decoder e(buf);
+    e.get<uint8_t>(d.entry);
+    return d;
+}
+static int16_t EncodeGeneratorStep(Protocol::GeneratorStep d, uint8_t *buf,
+		uint16_t bufSize) {
+    Encoder e(buf, bufSize);
+    e.add<uint8_t>(d.entry);
     return e.getSize();
 }
 
@@ -378,6 +561,8 @@ static Protocol::SpectrumAnalyzerSettings DecodeSpectrumAnalyzerSettings(uint8_t
     d.WindowType = e.getBits(2);
     d.SignalID = e.getBits(1);
     d.Detector = e.getBits(3);
+    d.FastScan = e.getBits(1);
+    e.get<float>(d.FastScanThreshold);
     return d;
 }
 static int16_t EncodeSpectrumAnalyzerSettings(Protocol::SpectrumAnalyzerSettings d, uint8_t *buf,
@@ -390,6 +575,8 @@ static int16_t EncodeSpectrumAnalyzerSettings(Protocol::SpectrumAnalyzerSettings
     e.addBits(d.WindowType, 2);
     e.addBits(d.SignalID, 1);
     e.addBits(d.Detector, 3);
+    e.addBits(d.FastScan, 1);
+    e.add<float>(d.FastScanThreshold);
     return e.getSize();
 }
 
@@ -441,6 +628,43 @@ static int16_t EncodeDeviceLimits(Protocol::DeviceLimits d, uint8_t *buf,
     return e.getSize();
 }
 
+static uint16_t DecodeLogFormatRequest(uint8_t *buf) {
+    uint16_t id;
+    Decoder e(buf);
+    e.get<uint16_t>(id);
+    return id;
+}
+static int16_t EncodeLogFormatRequest(uint16_t id, uint8_t *buf, uint16_t bufSize) {
+    Encoder e(buf, bufSize);
+    e.add<uint16_t>(id);
+    return e.getSize();
+}
+
+static Protocol::ProfilingReport DecodeProfilingReport(uint8_t *buf) {
+    Protocol::ProfilingReport d;
+    Decoder e(buf);
+    e.get(d.timerFrequency);
+    for(auto &s : d.sections) {
+        e.get(s.count);
+        e.get(s.min);
+        e.get(s.max);
+        e.get(s.avg);
+    }
+    return d;
+}
+static int16_t EncodeProfilingReport(const Protocol::ProfilingReport &d, uint8_t *buf,
+                                                   uint16_t bufSize) {
+    Encoder e(buf, bufSize);
+    e.add(d.timerFrequency);
+    for(auto &s : d.sections) {
+        e.add(s.count);
+        e.add(s.min);
+        e.add(s.max);
+        e.add(s.avg);
+    }
+    return e.getSize();
+}
+
 static Protocol::FirmwarePacket DecodeFirmwarePacket(uint8_t *buf) {
     Protocol::FirmwarePacket d;
     // simple packet format, memcpy is faster than using the decoder
@@ -518,9 +742,15 @@ uint16_t Protocol::DecodeBuffer(uint8_t *buf, uint16_t len, PacketInfo *info) {
 	case PacketType::Datapoint:
 		info->datapoint = DecodeDatapoint(&data[4]);
 		break;
+	case PacketType::RawDatapoint:
+		info->rawDatapoint = DecodeRawDatapoint(&data[4]);
+		break;
 	case PacketType::SweepSettings:
 		info->settings = DecodeSweepSettings(&data[4]);
 		break;
+	case PacketType::SweepSegment:
+		info->segment = DecodeSweepSegment(&data[4]);
+		break;
 	case PacketType::Reference:
 		info->reference = DecodeReferenceSettings(&data[4]);
 		break;
@@ -539,6 +769,12 @@ uint16_t Protocol::DecodeBuffer(uint8_t *buf, uint16_t len, PacketInfo *info) {
     case PacketType::Generator:
     	info->generator = DecodeGeneratorSettings(&data[4]);
     	break;
+    case PacketType::GeneratorListEntry:
+    	info->generatorListEntry = DecodeGeneratorListEntry(&data[4]);
+    	break;
+    case PacketType::GeneratorStep:
+    	info->generatorStep = DecodeGeneratorStep(&data[4]);
+    	break;
     case PacketType::SpectrumAnalyzerSettings:
     	info->spectrumSettings = DecodeSpectrumAnalyzerSettings(&data[4]);
     	break;
@@ -548,11 +784,18 @@ uint16_t Protocol::DecodeBuffer(uint8_t *buf, uint16_t len, PacketInfo *info) {
     case PacketType::DeviceLimits:
         info->limits = DecodeDeviceLimits(&data[4]);
         break;
+    case PacketType::ProfilingReport:
+        info->profiling = DecodeProfilingReport(&data[4]);
+        break;
+    case PacketType::RequestLogFormat:
+        info->logFormatID = DecodeLogFormatRequest(&data[4]);
+        break;
     case PacketType::Ack:
     case PacketType::PerformFirmwareUpdate:
     case PacketType::ClearFlash:
     case PacketType::Nack:
     case PacketType::RequestDeviceLimits:
+    case PacketType::RequestProfiling:
         // no payload, nothing to do
         break;
     case PacketType::None:
@@ -568,9 +811,15 @@ uint16_t Protocol::EncodePacket(const PacketInfo &packet, uint8_t *dest, uint16_
 	case PacketType::Datapoint:
         payload_size = EncodeDatapoint(packet.datapoint, &dest[4], destsize - 8);
         break;
+	case PacketType::RawDatapoint:
+        payload_size = EncodeRawDatapoint(packet.rawDatapoint, &dest[4], destsize - 8);
+        break;
 	case PacketType::SweepSettings:
         payload_size = EncodeSweepSettings(packet.settings, &dest[4], destsize - 8);
 		break;
+	case PacketType::SweepSegment:
+        payload_size = EncodeSweepSegment(packet.segment, &dest[4], destsize - 8);
+		break;
 	case PacketType::Reference:
 		payload_size = EncodeReferenceSettings(packet.reference, &dest[4], destsize - 8);
 		break;
@@ -589,6 +838,12 @@ uint16_t Protocol::EncodePacket(const PacketInfo &packet, uint8_t *dest, uint16_
     case PacketType::Generator:
     	payload_size = EncodeGeneratorSettings(packet.generator, &dest[4], destsize - 8);
     	break;
+    case PacketType::GeneratorListEntry:
+    	payload_size = EncodeGeneratorListEntry(packet.generatorListEntry, &dest[4], destsize - 8);
+    	break;
+    case PacketType::GeneratorStep:
+    	payload_size = EncodeGeneratorStep(packet.generatorStep, &dest[4], destsize - 8);
+    	break;
     case PacketType::SpectrumAnalyzerSettings:
     	payload_size = EncodeSpectrumAnalyzerSettings(packet.spectrumSettings, &dest[4], destsize - 8);
     	break;
@@ -598,11 +853,18 @@ uint16_t Protocol::EncodePacket(const PacketInfo &packet, uint8_t *dest, uint16_
     case PacketType::DeviceLimits:
         payload_size = EncodeDeviceLimits(packet.limits, &dest[4], destsize - 8);
         break;
+    case PacketType::ProfilingReport:
+        payload_size = EncodeProfilingReport(packet.profiling, &dest[4], destsize - 8);
+        break;
+    case PacketType::RequestLogFormat:
+        payload_size = EncodeLogFormatRequest(packet.logFormatID, &dest[4], destsize - 8);
+        break;
     case PacketType::Ack:
     case PacketType::PerformFirmwareUpdate:
     case PacketType::ClearFlash:
     case PacketType::Nack:
     case PacketType::RequestDeviceLimits:
+    case PacketType::RequestProfiling:
         // no payload, nothing to do
         break;
     case PacketType::None:
@@ -619,7 +881,7 @@ uint16_t Protocol::EncodePacket(const PacketInfo &packet, uint8_t *dest, uint16_
 	dest[3] = (int) packet.type;
 	// Calculate checksum
 	uint32_t crc = 0x00000000;
-	if(packet.type == PacketType::Datapoint) {
+	if(packet.type == PacketType::Datapoint || packet.type == PacketType::RawDatapoint) {
 		// CRC calculation takes about 18us which is the bulk of the time required to encode and transmit a datapoint.
 		// Skip CRC for data points to optimize throughput
 		crc = 0x00000000;
@@ -12,18 +12,69 @@ using Datapoint = struct _datapoint {
 	float real_S12, imag_S12;
 	float real_S22, imag_S22;
 	uint64_t frequency;
-	uint16_t pointNum;
+	// time of the measurement in us (wraps around after ~71 minutes)
+	uint32_t us;
+	uint32_t pointNum;
+	int16_t cdbm; // requested excitation level in 1/100 dbm
+};
+
+using RawDatapoint = struct _rawDatapoint {
+	// Receiver accumulator values (48 bit, sign extended), averaged over the measurements
+	// of this point. Index 0 is measured with port 1 excited, index 1 with port 2 excited
+	struct {
+		int64_t P1I, P1Q;
+		int64_t P2I, P2Q;
+		int64_t RefI, RefQ;
+	} excitation[2];
+	uint64_t frequency;
+	// time of the measurement in us (wraps around after ~71 minutes)
+	uint32_t us;
+	uint32_t pointNum;
+	int16_t cdbm; // requested excitation level in 1/100 dbm
+	uint8_t excitePort1:1;
+	uint8_t excitePort2:1;
+	// ADC limits exceeded while measuring this point
+	uint8_t port1Overload:1;
+	uint8_t port2Overload:1;
+	uint8_t refOverload:1;
 };
 
 using SweepSettings = struct _sweepSettings {
 	uint64_t f_start;
 	uint64_t f_stop;
-    uint16_t points;
+    uint32_t points;
     uint32_t if_bandwidth;
     int16_t cdbm_excitation; // in 1/100 dbm
+    // excitation level of the last point of every segment in a power sweep, in 1/100 dbm
+    int16_t cdbm_excitation_stop;
 	uint8_t excitePort1:1;
 	uint8_t excitePort2:1;
 	uint8_t suppressPeaks:1;
+	uint8_t logSweep:1;
+	uint8_t settlingTime:2; // minimum settling time, 0: 20us, 1: 60us, 2: 180us, 3: 540us
+	uint8_t rawData:1; // transmit RawDatapoints instead of Datapoints
+	uint8_t zeroSpan:1; // continuously measure f_start without retuning, segments and f_stop are ignored
+	// step the excitation level from cdbm_excitation to cdbm_excitation_stop across the points of every
+	// segment. Each segment is measured at its start frequency, f_stop is ignored
+	uint8_t powerSweep:1;
+	// 0: single sweep as described above, otherwise the number of sweep segments (transmitted before) to use
+	uint8_t segments;
+	// number of measurements averaged on the device for each point (0 or 1: no averaging)
+	uint8_t averages;
+	// only every n-th point is transmitted with consecutive point numbers (0 or 1: all points)
+	uint8_t decimation;
+};
+
+static constexpr uint8_t MaxSweepSegments = 32;
+using SweepSegment = struct _sweepSegment {
+	uint8_t index;
+	uint64_t f_start;
+	uint64_t f_stop;
+	uint32_t points;
+	uint32_t if_bandwidth;
+	int16_t cdbm_excitation; // in 1/100 dbm
+	uint8_t settlingTime:2; // minimum settling time, 0: 20us, 1: 60us, 2: 180us, 3: 540us
+	uint8_t logSweep:1;
 };
 
 using ReferenceSettings = struct _referenceSettings {
@@ -36,6 +87,23 @@ using GeneratorSettings = struct _generatorSettings {
 	uint64_t frequency;
 	int16_t cdbm_level;
 	uint8_t activePort;
+	// 0: fixed frequency and level as above, otherwise the number of list entries (transmitted before) that are
+	// stepped through repeatedly. Frequency and level are ignored in this case
+	uint8_t listEntries;
+	uint8_t listStatus:1; // send a GeneratorStep packet at the start of every list entry
+	uint8_t listTrigger:1; // pulse the trigger output (debug pin 1) at the start of every list entry
+};
+
+static constexpr uint8_t MaxGeneratorListEntries = 64;
+using GeneratorListEntry = struct _generatorListEntry {
+	uint8_t index;
+	uint64_t frequency;
+	int16_t cdbm_level;
+	uint32_t dwell_us; // time until the next entry starts
+};
+
+using GeneratorStep = struct _generatorStep {
+	uint8_t entry; // list entry that has just been started
 };
 
 using DeviceInfo = struct _deviceInfo {
@@ -107,6 +175,10 @@ using SpectrumAnalyzerSettings = struct _spectrumAnalyzerSettings {
 	uint8_t WindowType :2;
 	uint8_t SignalID :1;
 	uint8_t Detector :3;
+	// Coarse pass at the widest RBW first, only regions above the threshold are measured at the requested RBW
+	uint8_t FastScan :1;
+	// Amplitude threshold for the coarse pass, in the same (linear) units as SpectrumAnalyzerResult
+	float FastScanThreshold;
 };
 
 using SpectrumAnalyzerResult = struct _spectrumAnalyzerResult {
@@ -121,7 +193,7 @@ using DeviceLimits = struct _deviceLimits {
     uint64_t maxFreq;
     uint32_t minIFBW;
     uint32_t maxIFBW;
-    uint16_t maxPoints;
+    uint32_t maxPoints;
     int16_t cdbm_min;
     int16_t cdbm_max;
     uint32_t minRBW;
@@ -134,6 +206,29 @@ using FirmwarePacket = struct _firmwarePacket {
     uint8_t data[FirmwareChunkSize];
 };
 
+// Code sections with execution time statistics on the device
+enum class ProfilingSection : uint8_t {
+	SampleRead = 0, // from initiating the FPGA result read until the data is available
+	MeasurementDone = 1,
+	SweepHalted = 2,
+	CommunicationSend = 3,
+	USBTransmit = 4,
+	VNASetup = 5,
+	Last,
+};
+static constexpr uint8_t ProfilingSections = (uint8_t) ProfilingSection::Last;
+
+using ProfilingReport = struct _profilingReport {
+	// frequency of the timer used for the measurements (all times are in timer ticks)
+	uint32_t timerFrequency;
+	struct {
+		uint32_t count;
+		uint32_t min;
+		uint32_t max;
+		uint32_t avg;
+	} sections[ProfilingSections];
+};
+
 enum class PacketType : uint8_t {
 	None = 0,
 	Datapoint = 1,
@@ -152,15 +247,26 @@ enum class PacketType : uint8_t {
 	SpectrumAnalyzerResult =  14,
     RequestDeviceLimits = 15,
     DeviceLimits = 16,
+    SweepSegment = 17,
+    RawDatapoint = 18,
+    RequestProfiling = 19,
+    ProfilingReport = 20,
+    RequestLogFormat = 21,
+    GeneratorListEntry = 22,
+    GeneratorStep = 23,
 };
 
 using PacketInfo = struct _packetinfo {
 	PacketType type;
 	union {
 		Datapoint datapoint;
+		RawDatapoint rawDatapoint;
 		SweepSettings settings;
+		SweepSegment segment;
 		ReferenceSettings reference;
 		GeneratorSettings generator;
+		GeneratorListEntry generatorListEntry;
+		GeneratorStep generatorStep;
         DeviceInfo info;
         ManualControl manual;
         FirmwarePacket firmware;
@@ -168,6 +274,8 @@ using PacketInfo = struct _packetinfo {
         SpectrumAnalyzerSettings spectrumSettings;
         SpectrumAnalyzerResult spectrumResult;
         DeviceLimits limits;
+        ProfilingReport profiling;
+        uint16_t logFormatID;
 	};
 };
 
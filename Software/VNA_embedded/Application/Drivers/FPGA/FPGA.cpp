@@ -3,6 +3,8 @@
 #include "stm.hpp"
 #include "main.h"
 #include "FPGA_HAL.hpp"
+#include "Protocol.hpp"
+#include "Profiling.hpp"
 
 #define LOG_LEVEL	LOG_LEVEL_DEBUG
 #define LOG_MODULE	"FPGA"
@@ -11,6 +13,7 @@
 static FPGA::HaltedCallback halted_cb;
 static uint16_t SysCtrlReg = 0x0000;
 static uint16_t ISRMaskReg = 0x0000;
+static bool busy_reading = false;
 
 using namespace FPGAHAL;
 
@@ -28,7 +31,7 @@ void FPGA::WriteRegister(FPGA::Reg reg, uint16_t value) {
 	High(CS);
 }
 
-bool FPGA::Configure(Flash *f, uint32_t start_address, uint32_t bitstream_size) {
+bool FPGA::Configure(Flash *f, uint32_t start_address, uint32_t bitstream_size, uint32_t *crc) {
 	if(!PROGRAM_B.gpio) {
 		LOG_WARN("PROGRAM_B not defined, assuming FPGA configures itself in master configuration");
 		// wait too allow enough time for FPGA configuration
@@ -46,25 +49,55 @@ bool FPGA::Configure(Flash *f, uint32_t start_address, uint32_t bitstream_size)
 		return false;
 	}
 
+	// Double buffered: while one chunk is passed on to the FPGA (and included in the CRC),
+	// the next chunk is already read from the flash by the DMA
+	uint8_t buf[2][512];
+	uint8_t active = 0;
 	uint32_t lastmessage = HAL_GetTick();
-	uint8_t buf[256];
+	uint16_t size = sizeof(buf[0]);
+	if(size > bitstream_size) {
+		size = bitstream_size;
+	}
+	f->initiateRead(start_address);
+	if(!f->continueReadDMA(size, buf[active])) {
+		LOG_ERR("Failed to start reading the bitstream");
+		f->stopRead();
+		return false;
+	}
 	while(bitstream_size > 0) {
 		if(HAL_GetTick() - lastmessage > 100) {
 			LOG_DEBUG("Remaining: %lu", bitstream_size);
 			lastmessage = HAL_GetTick();
 		}
-		uint16_t size = sizeof(buf);
-		if(size > bitstream_size) {
-			size = bitstream_size;
+		uint32_t readStart = HAL_GetTick();
+		while(!f->isReadDMAComplete()) {
+			if(HAL_GetTick() - readStart > 100) {
+				LOG_ERR("Timeout while reading the bitstream");
+				f->stopRead();
+				return false;
+			}
 		}
-		// TODO this part might be doable with the DMA instead of the buffer
-		// get chunk of bitstream from flash...
-		f->read(start_address, size, buf);
-		// ... and pass it on to FPGA
-		HAL_SPI_Transmit(&CONFIGURATION_SPI, buf, size, 100);
 		bitstream_size -= size;
-		start_address += size;
+		uint16_t next_size = sizeof(buf[0]);
+		if(next_size > bitstream_size) {
+			next_size = bitstream_size;
+		}
+		if(next_size > 0) {
+			// flash continues with the following address as long as the read is not stopped
+			if(!f->continueReadDMA(next_size, buf[!active])) {
+				LOG_ERR("Failed to continue reading the bitstream");
+				f->stopRead();
+				return false;
+			}
+		}
+		HAL_SPI_Transmit(&CONFIGURATION_SPI, buf[active], size, 100);
+		if(crc) {
+			*crc = Protocol::CRC32(*crc, buf[active], size);
+		}
+		active = !active;
+		size = next_size;
 	}
+	f->stopRead();
 	Delay::ms(1);
 	if(!isHigh(INIT_B)) {
 		LOG_CRIT("INIT_B asserted after configuration, CRC error occurred");
@@ -173,9 +206,30 @@ void FPGA::WriteMAX2871Default(uint32_t *DefaultRegs) {
 	WriteRegister(Reg::MAX2871Def4MSB, DefaultRegs[4] >> 16);
 }
 
-void FPGA::WriteSweepConfig(uint16_t pointnum, bool lowband, uint32_t *SourceRegs, uint32_t *LORegs,
+FPGA::LowpassFilter FPGA::SelectLowpass(uint64_t frequency) {
+	// Select source LP filter
+	if (frequency >= 3500000000) {
+		return LowpassFilter::None;
+	} else if (frequency >= 1800000000) {
+		return LowpassFilter::M3500;
+	} else if (frequency >= 900000000) {
+		return LowpassFilter::M1880;
+	} else {
+		return LowpassFilter::M947;
+	}
+}
+
+bool FPGA::WriteSweepConfig(uint16_t pointnum, bool lowband, uint32_t *SourceRegs, uint32_t *LORegs,
 		uint8_t attenuation, uint64_t frequency, SettlingTime settling, Samples samples, bool halt, LowpassFilter filter) {
-	uint16_t send[7];
+	SweepConfig config;
+	EncodeSweepConfig(config, pointnum, lowband, SourceRegs, LORegs, attenuation, frequency, settling, samples, halt,
+			filter);
+	return WriteSweepConfig(config);
+}
+
+void FPGA::EncodeSweepConfig(SweepConfig &send, uint16_t pointnum, bool lowband, const uint32_t *SourceRegs,
+		const uint32_t *LORegs, uint8_t attenuation, uint64_t frequency, SettlingTime settling, Samples samples,
+		bool halt, LowpassFilter filter) {
 	// select which point this sweep config is for
 	send[0] = pointnum & 0x1FFF;
 	// assemble sweep config from required fields of PLL registers
@@ -198,19 +252,9 @@ void FPGA::WriteSweepConfig(uint16_t pointnum, bool lowband, uint32_t *SourceReg
 	send[1] |= (int) settling << 13;
 	send[1] |= (int) samples << 10;
 	if(filter == LowpassFilter::Auto) {
-		// Select source LP filter
-		if (frequency >= 3500000000) {
-			send[1] |= (int) LowpassFilter::None << 8;
-		} else if (frequency >= 1800000000) {
-			send[1] |= (int) LowpassFilter::M3500 << 8;
-		} else if (frequency >= 900000000) {
-			send[1] |= (int) LowpassFilter::M1880 << 8;
-		} else {
-			send[1] |= (int) LowpassFilter::M947 << 8;
-		}
-	} else {
-		send[1] |= (int) filter << 8;
+		filter = SelectLowpass(frequency);
 	}
+	send[1] |= (int) filter << 8;
 	send[2] = (LO_M & 0x000F) << 12 | LO_FRAC;
 	send[3] = LO_DIV_A << 13 | LO_VCO << 7 | LO_N;
 	send[4] = (uint16_t) attenuation << 8 | Source_M >> 4;
@@ -226,9 +270,21 @@ void FPGA::WriteSweepConfig(uint16_t pointnum, bool lowband, uint32_t *SourceReg
 	SwitchBytes(send[4]);
 	SwitchBytes(send[5]);
 	SwitchBytes(send[6]);
+}
+
+bool FPGA::WriteSweepConfig(const SweepConfig &config) {
+	// a sample read started by the FPGA interrupt must not interfere with the transfer
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if(busy_reading) {
+		__set_PRIMASK(primask);
+		return false;
+	}
 	Low(CS);
-	HAL_SPI_Transmit(&FPGA_SPI, (uint8_t*) send, 14, 100);
+	HAL_SPI_Transmit(&FPGA_SPI, (uint8_t*) config, sizeof(config), 100);
 	High(CS);
+	__set_PRIMASK(primask);
+	return true;
 }
 
 static inline int64_t sign_extend_64(int64_t x, uint16_t bits) {
@@ -239,7 +295,6 @@ static inline int64_t sign_extend_64(int64_t x, uint16_t bits) {
 static FPGA::ReadCallback callback;
 static uint8_t raw[38];
 static FPGA::SamplingResult result;
-static bool busy_reading = false;
 
 bool FPGA::InitiateSampleRead(ReadCallback cb) {
 	if(busy_reading) {
@@ -247,6 +302,7 @@ bool FPGA::InitiateSampleRead(ReadCallback cb) {
 		return false;
 	}
 	callback = cb;
+	Profiling::Start(Profiling::Section::SampleRead);
 	uint8_t cmd[38] = {0xC0, 0x00};
 	// Start data read
 	Low(CS);
@@ -359,6 +415,20 @@ void FPGA::ResetADCLimits() {
 	High(CS);
 }
 
+bool FPGA::ReadAndResetADCLimits(ADCLimits &limits) {
+	// a sample read started by the FPGA interrupt must not interfere with the transfers
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if(busy_reading) {
+		__set_PRIMASK(primask);
+		return false;
+	}
+	limits = GetADCLimits();
+	ResetADCLimits();
+	__set_PRIMASK(primask);
+	return true;
+}
+
 void FPGA::ResumeHaltedSweep() {
 	uint16_t cmd = 0x2000;
 	SwitchBytes(cmd);
@@ -36,6 +36,9 @@ using ADCLimits = struct _adclimits {
 	int16_t Rmin, Rmax;
 };
 
+// ADC values beyond this limit are considered an overload
+static constexpr int16_t ADCOverloadLimit = 30000;
+
 enum class Periphery {
 	Port1Mixer = 0x8000,
 	Port2Mixer = 0x4000,
@@ -94,7 +97,9 @@ enum class Window {
 	Flattop = 0x03,
 };
 
-bool Configure(Flash *f, uint32_t start_address, uint32_t bitstream_size);
+// Streams the bitstream from the flash into the FPGA. If crc is not nullptr, the CRC32 of the bitstream
+// is accumulated into it while streaming (saves reading the bitstream a second time for verification)
+bool Configure(Flash *f, uint32_t start_address, uint32_t bitstream_size, uint32_t *crc = nullptr);
 
 using HaltedCallback = void(*)(void);
 bool Init(HaltedCallback cb = nullptr);
@@ -108,12 +113,26 @@ void SetWindow(Window w);
 void EnableInterrupt(Interrupt i);
 void DisableInterrupt(Interrupt i);
 void WriteMAX2871Default(uint32_t *DefaultRegs);
-void WriteSweepConfig(uint16_t pointnum, bool lowband, uint32_t *SourceRegs, uint32_t *LORegs,
+LowpassFilter SelectLowpass(uint64_t frequency);
+// Entries can also be written while a sweep is running, the FPGA only reads an entry when it reaches the point.
+// Returns false without writing if the SPI bus is occupied by a sample read
+bool WriteSweepConfig(uint16_t pointnum, bool lowband, uint32_t *SourceRegs, uint32_t *LORegs,
 		uint8_t attenuation, uint64_t frequency, SettlingTime settling, Samples samples, bool halt = false, LowpassFilter filter = LowpassFilter::Auto);
+// Sweep table entry in the format of the SPI transfer, including the index of the entry
+using SweepConfig = uint16_t[7];
+// Same as WriteSweepConfig but split into the calculation of the entry and the SPI transfer. Allows to prepare
+// entries ahead of time, writing a prepared entry only blocks the SPI bus for the transfer itself
+void EncodeSweepConfig(SweepConfig &config, uint16_t pointnum, bool lowband, const uint32_t *SourceRegs,
+		const uint32_t *LORegs, uint8_t attenuation, uint64_t frequency, SettlingTime settling, Samples samples,
+		bool halt = false, LowpassFilter filter = LowpassFilter::Auto);
+bool WriteSweepConfig(const SweepConfig &config);
 using ReadCallback = void(*)(const SamplingResult &result);
 bool InitiateSampleRead(ReadCallback cb);
 ADCLimits GetADCLimits();
 void ResetADCLimits();
+// Reads and resets the ADC limits while a sweep is running. Returns false without accessing the SPI bus if it is
+// occupied by a sample read, the limits are then kept until the next call
+bool ReadAndResetADCLimits(ADCLimits &limits);
 void ResumeHaltedSweep();
 uint16_t GetStatus();
 
@@ -101,6 +101,23 @@ void Flash::initiateRead(uint32_t address) {
 	HAL_SPI_Transmit(spi, cmd, 4, 100);
 }
 
+bool Flash::continueReadDMA(uint16_t length, void *dest) {
+	// In master mode the HAL transmits the buffer content as dummy data while receiving. The flash ignores
+	// its input during the read, the completion uses HAL_SPI_RxCpltCallback (not used anywhere else)
+	return HAL_SPI_Receive_DMA(spi, (uint8_t*) dest, length) == HAL_OK;
+}
+
+bool Flash::isReadDMAComplete() {
+	return HAL_SPI_GetState(spi) == HAL_SPI_STATE_READY;
+}
+
+void Flash::stopRead() {
+	if(!isReadDMAComplete()) {
+		HAL_SPI_Abort(spi);
+	}
+	CS(true);
+}
+
 bool Flash::WaitBusy(uint32_t timeout) {
 	uint32_t starttime = HAL_GetTick();
 	CS(false);
@@ -21,6 +21,11 @@ public:
 	bool eraseChip();
 	// Starts the reading process without actually reading any bytes
 	void initiateRead(uint32_t address);
+	// Reads the next bytes of a read started with initiateRead in the background (DMA)
+	bool continueReadDMA(uint16_t length, void *dest);
+	bool isReadDMAComplete();
+	// Ends a read started with initiateRead (aborts a read in the background that is still running)
+	void stopRead();
 	const SPI_HandleTypeDef* const getSpi() const {
 		return spi;
 	}
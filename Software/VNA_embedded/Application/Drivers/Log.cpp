@@ -1,6 +1,7 @@
 #include "Log.h"
 
 #include "stm.hpp"
+#include "LogRecord.hpp"
 #include <cstdarg>
 #include <cstdio>
 #include <cstring>
@@ -69,11 +70,59 @@ static uint16_t fifo_space() {
 }
 
 static log_redirect_t redirect;
+/* Data for the redirect (text lines as well as deferred log records) is kept in a separate FIFO until it
+ * has been sent. Positions are only modified with interrupts disabled */
+static uint8_t redirect_fifo[LOG_REDIRECT_LENGTH];
+static uint16_t redirect_write, redirect_read, redirect_active;
+
+static const log_format_t *formats[LOG_MAX_FORMATS];
+static uint16_t format_cnt;
+// marks call sites that could not be registered, the host would never get their format
+#define FORMAT_ID_NONE		UINT16_MAX
+
+static uint16_t redirect_space() {
+	uint16_t used = (redirect_write + LOG_REDIRECT_LENGTH - redirect_read) % LOG_REDIRECT_LENGTH;
+	return LOG_REDIRECT_LENGTH - used - 1;
+}
+
+// Must be called with interrupts disabled
+static void redirect_next() {
+	if (!redirect || redirect_active || redirect_read == redirect_write) {
+		return;
+	}
+	uint16_t length;
+	if (redirect_write > redirect_read) {
+		length = redirect_write - redirect_read;
+	} else {
+		// only pass on the part up to the end of the buffer, the rest follows in the next chunk
+		length = LOG_REDIRECT_LENGTH - redirect_read;
+	}
+	if (redirect(&redirect_fifo[redirect_read], length)) {
+		redirect_active = length;
+	}
+}
+
+// Adds the concatenation of both data blocks to the redirect FIFO. Nothing is added if it does not fit completely
+static void redirect_add(const uint8_t *head, uint16_t head_length, const uint8_t *data, uint16_t length) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if (head_length + length <= redirect_space()) {
+		for (uint16_t i = 0; i < head_length + length; i++) {
+			redirect_fifo[redirect_write] = i < head_length ? head[i] : data[i - head_length];
+			redirect_write = (redirect_write + 1) % LOG_REDIRECT_LENGTH;
+		}
+		redirect_next();
+	}
+	__set_PRIMASK(primask);
+}
 
 void Log_Init() {
 	fifo_write = 0;
 	fifo_read = 0;
 	redirect = NULL;
+	redirect_write = 0;
+	redirect_read = 0;
+	redirect_active = 0;
 #ifdef LOG_USE_MUTEXES
 	mutex = xSemaphoreCreateMutexStatic(&xMutex);
 #endif
@@ -87,6 +136,70 @@ void Log_SetRedirect(log_redirect_t redirect_function) {
 	redirect = redirect_function;
 }
 
+void Log_RedirectComplete() {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	redirect_read = (redirect_read + redirect_active) % LOG_REDIRECT_LENGTH;
+	redirect_active = 0;
+	redirect_next();
+	__set_PRIMASK(primask);
+}
+
+void Log_SendFormat(uint16_t id) {
+	if (id == 0 || id > format_cnt) {
+		return;
+	}
+	const log_format_t *f = formats[id - 1];
+	uint8_t buf[LogRecord::HeaderSize + 3 + MAX_LINE_LENGTH];
+	uint16_t module_len = strlen(f->module) + 1;
+	uint16_t fmt_len = strlen(f->fmt) + 1;
+	if (module_len + fmt_len + 3 > UINT8_MAX) {
+		fmt_len = UINT8_MAX - 3 - module_len;
+	}
+	buf[0] = LogRecord::MarkerFormat;
+	buf[1] = 3 + module_len + fmt_len;
+	memcpy(&buf[2], &id, 2);
+	buf[4] = f->level;
+	memcpy(&buf[5], f->module, module_len);
+	memcpy(&buf[5 + module_len], f->fmt, fmt_len);
+	// make sure a truncated format is still terminated
+	buf[4 + module_len + fmt_len] = 0;
+	redirect_add(buf, LogRecord::HeaderSize + buf[1], nullptr, 0);
+}
+
+void _log_entry(const log_format_t *format, uint16_t *id, const uint8_t *args, uint8_t length) {
+	if (!*id) {
+		// first use of this call site, register format
+		bool full = false;
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		if (!*id) {
+			if (format_cnt < LOG_MAX_FORMATS) {
+				formats[format_cnt++] = format;
+				*id = format_cnt;
+			} else {
+				*id = FORMAT_ID_NONE;
+				full = true;
+			}
+		}
+		__set_PRIMASK(primask);
+		if (full) {
+			// the arguments can not be formatted on the device, drop the entries of this call site
+			_log_write(format->module, "ERR", "Too many log formats, dropping entries of \"%s\"", format->fmt);
+		}
+	}
+	if (*id == FORMAT_ID_NONE) {
+		return;
+	}
+	uint8_t head[LogRecord::EntryHeaderSize];
+	uint32_t tick = HAL_GetTick();
+	head[0] = LogRecord::MarkerEntry;
+	head[1] = LogRecord::EntryHeaderSize - LogRecord::HeaderSize + length;
+	memcpy(&head[2], id, 2);
+	memcpy(&head[4], &tick, 4);
+	redirect_add(head, sizeof(head), args, length);
+}
+
 void _log_write(const char *module, const char *level, const char *fmt, ...) {
 	int written = 0;
 	va_list args;
@@ -102,9 +215,7 @@ void _log_write(const char *module, const char *level, const char *fmt, ...) {
 			fmt, args);
 	written += snprintf(&fifo[fifo_write + written], MAX_LINE_LENGTH - written,
 			"\r\n");
-	if(redirect) {
-		redirect(&fifo[fifo_write], written);
-	}
+	redirect_add((const uint8_t*) &fifo[fifo_write], written, nullptr, 0);
 	// check if line still fits into ring buffer
 #ifdef LOG_BLOCKING
 	while (written > fifo_space()) {
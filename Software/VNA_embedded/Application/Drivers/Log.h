@@ -8,6 +8,8 @@ extern "C" {
 
 #define LOG_USART			3
 #define LOG_SENDBUF_LENGTH	1024
+#define LOG_REDIRECT_LENGTH	1024
+#define LOG_MAX_FORMATS		128
 //#define LOG_USE_MUTEX
 
 #define LOG_LEVEL_DEBUG	4
@@ -26,40 +28,86 @@ extern "C" {
 #define LOG_MODULE	"Log"
 #endif
 
+/* C++ code logs in the deferred format (see LogRecord.hpp): only the format ID and the arguments are stored,
+ * the text is assembled on the host. Entries in this format are only sent over USB, not to the USART. Critical
+ * messages and errors keep the text format, they also have to reach the USART (e.g. during boot, before USB is up) */
+#define LOG_DEFERRED
+
+#if defined(__cplusplus) && defined(LOG_DEFERRED)
+#define _LOG(level, name, fmt, ...) do { \
+	if (level <= LOG_LEVEL_ERR) { \
+		_log_write(LOG_MODULE, name, fmt, ## __VA_ARGS__); \
+	} else { \
+		static const log_format_t _log_format = {LOG_MODULE, fmt, level}; \
+		static uint16_t _log_format_id; \
+		_log_deferred(&_log_format, &_log_format_id, ## __VA_ARGS__); \
+	} \
+} while(0)
+#else
+#define _LOG(level, name, fmt, ...)	_log_write(LOG_MODULE, name, fmt, ## __VA_ARGS__)
+#endif
+
 #if LOG_LEVEL >= LOG_LEVEL_CRIT
-#define LOG_CRIT(fmt, ...)		_log_write(LOG_MODULE, "CRT", fmt, ## __VA_ARGS__)
+#define LOG_CRIT(fmt, ...)		_LOG(LOG_LEVEL_CRIT, "CRT", fmt, ## __VA_ARGS__)
 #else
 #define LOG_CRIT(fmt, ...)
 #endif
 #if LOG_LEVEL >= LOG_LEVEL_ERR
-#define LOG_ERR(fmt, ...)		_log_write(LOG_MODULE, "ERR", fmt, ## __VA_ARGS__)
+#define LOG_ERR(fmt, ...)		_LOG(LOG_LEVEL_ERR, "ERR", fmt, ## __VA_ARGS__)
 #else
 #define LOG_ERR(fmt, ...)
 #endif
 #if LOG_LEVEL >= LOG_LEVEL_WARN
-#define LOG_WARN(fmt, ...)		_log_write(LOG_MODULE, "WRN", fmt, ## __VA_ARGS__)
+#define LOG_WARN(fmt, ...)		_LOG(LOG_LEVEL_WARN, "WRN", fmt, ## __VA_ARGS__)
 #else
 #define LOG_WARN(fmt, ...)
 #endif
 #if LOG_LEVEL >= LOG_LEVEL_INFO
-#define LOG_INFO(fmt, ...)		_log_write(LOG_MODULE, "INF", fmt, ## __VA_ARGS__)
+#define LOG_INFO(fmt, ...)		_LOG(LOG_LEVEL_INFO, "INF", fmt, ## __VA_ARGS__)
 #else
 #define LOG_INFO(fmt, ...)
 #endif
 #if LOG_LEVEL >= LOG_LEVEL_DEBUG
-#define LOG_DEBUG(fmt, ...)		_log_write(LOG_MODULE, "DBG", fmt, ## __VA_ARGS__)
+#define LOG_DEBUG(fmt, ...)		_LOG(LOG_LEVEL_DEBUG, "DBG", fmt, ## __VA_ARGS__)
 #else
 #define LOG_DEBUG(fmt, ...)
 #endif
 
 #include <stdint.h>
+#include <stdbool.h>
 
 void Log_Init();
-typedef void (*log_redirect_t)(const char *line, uint16_t length);
+/* Called with a contiguous chunk of pending log data. Returns false if busy, otherwise the data must stay
+ * untouched until Log_RedirectComplete() is called */
+typedef bool (*log_redirect_t)(const uint8_t *data, uint16_t length);
 void Log_SetRedirect(log_redirect_t redirect_function);
+void Log_RedirectComplete();
+// Queues the definition of a deferred log format for the host
+void Log_SendFormat(uint16_t id);
 void _log_write(const char *module, const char *level, const char *fmt, ...);
 void Log_Flush();
 
+typedef struct {
+	const char *module;
+	const char *fmt;
+	uint8_t level;
+} log_format_t;
+
+/* The format ID is assigned on first use of a call site, only the ID itself is kept in RAM */
+void _log_entry(const log_format_t *format, uint16_t *id, const uint8_t *args, uint8_t length);
+
 #ifdef __cplusplus
 }
+
+#include "LogRecord.hpp"
+
+inline void _log_deferred(const log_format_t *format, uint16_t *id) {
+	_log_entry(format, id, nullptr, 0);
+}
+template<typename... Args> void _log_deferred(const log_format_t *format, uint16_t *id, Args... args) {
+	uint8_t buf[LogRecord::MaxArgumentSize];
+	LogRecord::Encoder e(buf, sizeof(buf));
+	e.addArguments(args...);
+	_log_entry(format, id, buf, e.getSize());
+}
 #endif
@@ -0,0 +1,164 @@
+#include "LogRecord.hpp"
+
+#include <cstdio>
+
+static bool isFloatConversion(char c) {
+	return strchr("fFeEgGaA", c) != nullptr;
+}
+
+static bool isSignedConversion(char c) {
+	return c == 'd' || c == 'i';
+}
+
+uint16_t LogRecord::Format(const char *fmt, const uint8_t *args, uint16_t argLength, char *out,
+		uint16_t outSize) {
+	if(!outSize) {
+		return 0;
+	}
+	uint16_t pos = 0;
+	uint16_t argPos = 0;
+	while(*fmt && pos < outSize - 1) {
+		if(*fmt != '%') {
+			out[pos++] = *fmt++;
+			continue;
+		}
+		if(fmt[1] == '%') {
+			out[pos++] = '%';
+			fmt += 2;
+			continue;
+		}
+		// Copy flags, width and precision. Length modifiers are skipped, they are chosen according to the
+		// transmitted argument type instead (the host might not use the same integer sizes as the device)
+		char spec[16];
+		uint8_t specLen = 0;
+		spec[specLen++] = *fmt++;
+		while(*fmt && strchr("-+ #0123456789.", *fmt)) {
+			if(specLen < sizeof(spec) - 4) {
+				spec[specLen++] = *fmt;
+			}
+			fmt++;
+		}
+		while(*fmt && strchr("hlLqjzt", *fmt)) {
+			fmt++;
+		}
+		char conversion = *fmt;
+		if(!conversion) {
+			break;
+		}
+		fmt++;
+
+		int written = 0;
+		char *dest = &out[pos];
+		uint16_t space = outSize - pos;
+		Type type = argPos < argLength ? (Type) args[argPos++] : (Type) UINT8_MAX;
+		switch(type) {
+		case Type::Int32:
+		case Type::UInt32:
+		case Type::Int64:
+		case Type::UInt64: {
+			bool wide = type == Type::Int64 || type == Type::UInt64;
+			uint8_t size = wide ? 8 : 4;
+			if(argPos + size > argLength) {
+				argPos = argLength;
+				written = snprintf(dest, space, "?");
+				break;
+			}
+			int64_t sv;
+			uint64_t uv;
+			if(wide) {
+				memcpy(&uv, &args[argPos], 8);
+				sv = uv;
+			} else {
+				uint32_t v;
+				memcpy(&v, &args[argPos], 4);
+				uv = v;
+				sv = type == Type::Int32 ? (int64_t) (int32_t) v : (int64_t) v;
+			}
+			argPos += size;
+			if(isFloatConversion(conversion)) {
+				spec[specLen++] = conversion;
+				spec[specLen] = 0;
+				written = snprintf(dest, space, spec, (double) sv);
+			} else if(conversion == 'c') {
+				spec[specLen++] = 'c';
+				spec[specLen] = 0;
+				written = snprintf(dest, space, spec, (int) sv);
+			} else if(conversion == 'p') {
+				written = snprintf(dest, space, "0x%llx", (unsigned long long) uv);
+			} else {
+				if(conversion == 's') {
+					conversion = type == Type::Int32 || type == Type::Int64 ? 'd' : 'u';
+				}
+				spec[specLen++] = 'l';
+				spec[specLen++] = 'l';
+				spec[specLen++] = conversion;
+				spec[specLen] = 0;
+				if(isSignedConversion(conversion)) {
+					written = snprintf(dest, space, spec, (long long) sv);
+				} else {
+					written = snprintf(dest, space, spec, (unsigned long long) uv);
+				}
+			}
+		}
+			break;
+		case Type::Float:
+		case Type::Double: {
+			uint8_t size = type == Type::Float ? 4 : 8;
+			if(argPos + size > argLength) {
+				argPos = argLength;
+				written = snprintf(dest, space, "?");
+				break;
+			}
+			double d;
+			if(type == Type::Float) {
+				float f;
+				memcpy(&f, &args[argPos], 4);
+				d = f;
+			} else {
+				memcpy(&d, &args[argPos], 8);
+			}
+			argPos += size;
+			spec[specLen++] = isFloatConversion(conversion) ? conversion : 'g';
+			spec[specLen] = 0;
+			written = snprintf(dest, space, spec, d);
+		}
+			break;
+		case Type::String: {
+			uint8_t len = argPos < argLength ? args[argPos++] : 0;
+			if(argPos + len > argLength || len > MaxStringLength) {
+				// truncated or corrupted record (the encoder never sends longer strings)
+				argPos = argLength;
+				written = snprintf(dest, space, "?");
+				break;
+			}
+			char s[MaxStringLength + 1];
+			memcpy(s, &args[argPos], len);
+			s[len] = 0;
+			argPos += len;
+			spec[specLen++] = 's';
+			spec[specLen] = 0;
+			written = snprintf(dest, space, spec, s);
+		}
+			break;
+		default:
+			// missing or unknown argument, the remaining arguments can't be decoded either
+			argPos = argLength;
+			written = snprintf(dest, space, "?");
+			break;
+		}
+		if(written > 0) {
+			pos += written < space ? written : space - 1;
+		}
+	}
+	out[pos] = 0;
+	return pos;
+}
+
+const char* LogRecord::LevelName(uint8_t level) {
+	// same order as the LOG_LEVEL_x defines in Log.h
+	static const char *names[] = { "CRT", "ERR", "WRN", "INF", "DBG" };
+	if(level < sizeof(names) / sizeof(names[0])) {
+		return names[level];
+	}
+	return "???";
+}
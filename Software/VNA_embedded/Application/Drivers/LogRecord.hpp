@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * Binary log records. Instead of formatting each line on the device, only the format ID and the raw
+ * arguments are sent. The format itself is requested by the host once per ID and the text is assembled there.
+ *
+ * Entry:	0xFF, length, format ID (uint16), tick (uint32), arguments (type + value each)
+ * Format:	0xFE, length, format ID (uint16), level, module (zero terminated), format (zero terminated)
+ *
+ * The length byte covers everything after it. Any other byte starts a plain text line terminated by "\r\n".
+ */
+namespace LogRecord {
+
+constexpr uint8_t MarkerEntry = 0xFF;
+constexpr uint8_t MarkerFormat = 0xFE;
+constexpr uint8_t HeaderSize = 2;
+constexpr uint8_t EntryHeaderSize = HeaderSize + 6;
+// Kept small, the arguments are assembled on the stack of the logging function
+constexpr uint8_t MaxArgumentSize = 56;
+constexpr uint8_t MaxStringLength = 24;
+
+enum class Type : uint8_t {
+	Int32 = 0,
+	UInt32 = 1,
+	Int64 = 2,
+	UInt64 = 3,
+	Float = 4,
+	Double = 5,
+	String = 6,
+};
+
+class Encoder {
+public:
+	Encoder(uint8_t *buf, uint16_t size) :
+		buf(buf),
+		bufSize(size),
+		usedSize(0) {};
+
+	void addArguments() {};
+	template<typename T, typename... Args> void addArguments(T first, Args... rest) {
+		addArgument(first);
+		addArguments(rest...);
+	}
+
+	void addArgument(float f) {
+		add(Type::Float, &f, sizeof(f));
+	}
+	void addArgument(double d) {
+		add(Type::Double, &d, sizeof(d));
+	}
+	void addArgument(const char *s) {
+		uint8_t len = strnlen(s, MaxStringLength);
+		if(bufSize - usedSize < len + 2) {
+			return;
+		}
+		buf[usedSize++] = (uint8_t) Type::String;
+		buf[usedSize++] = len;
+		memcpy(&buf[usedSize], s, len);
+		usedSize += len;
+	}
+	void addArgument(char *s) {
+		addArgument((const char*) s);
+	}
+	template<typename T> typename std::enable_if<std::is_integral<T>::value>::type addArgument(T value) {
+		if(sizeof(T) > 4) {
+			uint64_t v = value;
+			add(std::is_signed<T>::value ? Type::Int64 : Type::UInt64, &v, sizeof(v));
+		} else {
+			uint32_t v = value;
+			add(std::is_signed<T>::value ? Type::Int32 : Type::UInt32, &v, sizeof(v));
+		}
+	}
+	template<typename T> typename std::enable_if<std::is_enum<T>::value>::type addArgument(T value) {
+		addArgument((typename std::underlying_type<T>::type) value);
+	}
+	template<typename T> void addArgument(T *p) {
+		addArgument((uintptr_t) p);
+	}
+
+	uint16_t getSize() const {
+		return usedSize;
+	}
+
+private:
+	void add(Type type, const void *data, uint8_t size) {
+		if(bufSize - usedSize < size + 1) {
+			// not enough space left, argument is skipped
+			return;
+		}
+		buf[usedSize++] = (uint8_t) type;
+		memcpy(&buf[usedSize], data, size);
+		usedSize += size;
+	}
+
+	uint8_t *buf;
+	uint16_t bufSize;
+	uint16_t usedSize;
+};
+
+// Assembles the text of an entry from its printf style format and the encoded arguments (host side only).
+// Returns the length of the text, missing arguments are replaced with '?'
+uint16_t Format(const char *fmt, const uint8_t *args, uint16_t argLength, char *out, uint16_t outSize);
+// Abbreviated level name, as used in the header of text lines
+const char *LevelName(uint8_t level);
+
+}
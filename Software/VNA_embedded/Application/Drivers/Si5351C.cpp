@@ -76,15 +76,34 @@ bool Si5351C::SetPLL(PLL pll, uint32_t frequency, PLLSource src) {
 
 bool Si5351C::SetCLK(uint8_t clknum, uint32_t frequency, PLL source, DriveStrength strength, uint32_t PLLFreqOverride) {
 	ClkConfig c;
+	c.source = source;
+	c.strength = strength;
+	if (!CalculateClkConfig(c, clknum, frequency, PLLFreqOverride)) {
+		return false;
+	}
+	LOG_DEBUG("Setting CLK%d to %luHz", clknum, frequency);
+	return WriteClkConfig(c, clknum);
+}
+
+bool Si5351C::CalculateRawCLKConfig(uint32_t frequency, PLL source, uint8_t *config, uint32_t PLLFreqOverride) {
+	ClkConfig c;
+	c.source = source;
+	// only the multisynth divider is part of the raw configuration, the output (and thus its number) does not matter
+	if (!CalculateClkConfig(c, 0, frequency, PLLFreqOverride)) {
+		return false;
+	}
+	AssembleRawCLKConfig(c, config);
+	return true;
+}
+
+bool Si5351C::CalculateClkConfig(ClkConfig &c, uint8_t clknum, uint32_t frequency, uint32_t PLLFreqOverride) {
 	c.DivideBy4 = false;
 	c.IntegerMode = false;
 	c.Inverted = false;
 	c.PoweredDown = false;
 	c.RDiv = 1;
-	c.source = source;
-	c.strength = strength;
 
-	uint32_t pllFreq = PLLFreqOverride > 0 ? PLLFreqOverride : FreqPLL[(int) source];
+	uint32_t pllFreq = PLLFreqOverride > 0 ? PLLFreqOverride : FreqPLL[(int) c.source];
 	if (clknum > 5) {
 		// outputs 6 and 7 are integer dividers only
 		uint32_t div = pllFreq / frequency;
@@ -115,8 +134,7 @@ bool Si5351C::SetCLK(uint8_t clknum, uint32_t frequency, PLL source, DriveStreng
 		}
 		FindOptimalDivider(pllFreq, frequency * c.RDiv, c.P1, c.P2, c.P3);
 	}
-	LOG_DEBUG("Setting CLK%d to %luHz", clknum, frequency);
-	return WriteClkConfig(c, clknum);
+	return true;
 }
 
 bool Si5351C::SetCLKtoXTAL(uint8_t clknum) {
@@ -233,15 +251,7 @@ bool Si5351C::WriteClkConfig(ClkConfig config, uint8_t clknum) {
 	success &= WriteRegister(reg, clkcontrol);
 	if (clknum <= 5) {
 		uint8_t ClkData[8];
-		ClkData[0] = (config.P3 >> 8) & 0xFF;
-		ClkData[1] = config.P3 & 0xFF;
-		ClkData[2] = (31 - __builtin_clz(config.RDiv)) << 4
-				| (config.DivideBy4 ? 0xC0 : 0x00) | ((config.P1 >> 16) & 0x03);
-		ClkData[3] = (config.P1 >> 8) & 0xFF;
-		ClkData[4] = config.P1 & 0xFF;
-		ClkData[5] = ((config.P3 >> 12) & 0xF0) | ((config.P2 >> 16) & 0x0F);
-		ClkData[6] = (config.P2 >> 8) & 0xFF;
-		ClkData[7] = config.P2 & 0xFF;
+		AssembleRawCLKConfig(config, ClkData);
 		// Calculate address of register control block
 		reg = (Reg) ((int) Reg::MS0_CONFIG + 8 * clknum);
 		success &= WriteRegisterRange(reg, ClkData, sizeof(ClkData));
@@ -254,6 +264,18 @@ bool Si5351C::WriteClkConfig(ClkConfig config, uint8_t clknum) {
 	return success;
 }
 
+void Si5351C::AssembleRawCLKConfig(const ClkConfig &config, uint8_t *data) {
+	data[0] = (config.P3 >> 8) & 0xFF;
+	data[1] = config.P3 & 0xFF;
+	data[2] = (31 - __builtin_clz(config.RDiv)) << 4
+			| (config.DivideBy4 ? 0xC0 : 0x00) | ((config.P1 >> 16) & 0x03);
+	data[3] = (config.P1 >> 8) & 0xFF;
+	data[4] = config.P1 & 0xFF;
+	data[5] = ((config.P3 >> 12) & 0xF0) | ((config.P2 >> 16) & 0x0F);
+	data[6] = (config.P2 >> 8) & 0xFF;
+	data[7] = config.P2 & 0xFF;
+}
+
 bool Si5351C::WriteRegister(Reg reg, uint8_t data) {
 	return WriteRegisterRange(reg, &data, 1);
 }
@@ -45,6 +45,8 @@ public:
 	// config has to point to a buffer containing at least 8 bytes
 	bool WriteRawCLKConfig(uint8_t clknum, const uint8_t *config);
 	bool ReadRawCLKConfig(uint8_t clknum, uint8_t *config);
+	// Calculates the raw configuration of CLK0-5 for a frequency without accessing the chip
+	bool CalculateRawCLKConfig(uint32_t frequency, PLL source, uint8_t *config, uint32_t PLLFreqOverride = 0);
 private:
 	void FindOptimalDivider(uint32_t f_pll, uint32_t f, uint32_t &P1, uint32_t &P2, uint32_t &P3);
 	enum class Reg : uint8_t {
@@ -105,6 +107,8 @@ private:
 		DriveStrength strength;
 	};
 	bool WriteClkConfig(ClkConfig config, uint8_t clknum);
+	bool CalculateClkConfig(ClkConfig &config, uint8_t clknum, uint32_t frequency, uint32_t PLLFreqOverride);
+	static void AssembleRawCLKConfig(const ClkConfig &config, uint8_t *data);
 
 	static constexpr uint8_t address = 0xC0;
 	bool WriteRegister(Reg reg, uint8_t data);
@@ -18,6 +18,7 @@ static uint8_t  *USBD_Class_GetFSCfgDesc (uint16_t *length);
 static uint8_t  *USBD_Class_GetDeviceQualifierDescriptor (uint16_t *length);
 
 static usbd_recv_callback_t cb;
+static usbd_log_complete_callback_t log_cb;
 static uint8_t usb_receive_buffer[1024];
 static uint8_t usb_transmit_fifo[4092];
 static uint16_t usb_transmit_read_index = 0;
@@ -187,6 +188,9 @@ static uint8_t USBD_Class_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum) {
 			}
 		} else {
 			log_transmission_active = false;
+			if(log_cb) {
+				log_cb();
+			}
 		}
 	}
 	return USBD_OK;
@@ -251,6 +255,10 @@ bool usb_transmit(const uint8_t *data, uint16_t length) {
 	if(first) {
 		log_transmission_active = false;
 		first = false;
+		// log data might have been queued already
+		if(log_cb) {
+			log_cb();
+		}
 	}
 	if(!data_transmission_active) {
 		return trigger_next_fifo_transmission();
@@ -260,18 +268,22 @@ bool usb_transmit(const uint8_t *data, uint16_t length) {
 	}
 }
 
-void usb_log(const char *log, uint16_t length) {
+bool usb_log(const uint8_t *data, uint16_t length) {
 	if(!log_transmission_active) {
-		static uint8_t buffer[256];
-		memcpy(buffer, log, length);
 		log_transmission_active = true;
 		hUsbDeviceFS.ep_in[EP_LOG_IN_ADDRESS & 0x7F].total_length = length;
-		USBD_LL_Transmit(&hUsbDeviceFS, EP_LOG_IN_ADDRESS, buffer, length);
+		USBD_LL_Transmit(&hUsbDeviceFS, EP_LOG_IN_ADDRESS, (uint8_t*) data, length);
+		return true;
 	} else {
 		// still busy, unable to send log
+		return false;
 	}
 }
 
+void usb_set_log_complete_callback(usbd_log_complete_callback_t callback) {
+	log_cb = callback;
+}
+
 void USB_HP_IRQHandler(void)
 {
   HAL_PCD_IRQHandler(&hpcd_USB_FS);
@@ -16,10 +16,13 @@ extern "C" {
 #include <stdbool.h>
 
 typedef void(*usbd_recv_callback_t)(const uint8_t *buf, uint16_t len);
+typedef void(*usbd_log_complete_callback_t)(void);
 
 void usb_init(usbd_recv_callback_t receive_callback);
 bool usb_transmit(const uint8_t *data, uint16_t length);
-void usb_log(const char *log, uint16_t length);
+// Data is sent without copying, it must remain valid until the log complete callback
+bool usb_log(const uint8_t *data, uint16_t length);
+void usb_set_log_complete_callback(usbd_log_complete_callback_t callback);
 
 
 #ifdef __cplusplus
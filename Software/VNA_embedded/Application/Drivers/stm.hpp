@@ -18,6 +18,21 @@ static inline bool InInterrupt() {
 	return (SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) != 0;
 }
 
+// Free running cycle counter (DWT), used for execution time measurements
+static inline void enableCycleCounter() {
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t getCycles() {
+	return DWT->CYCCNT;
+}
+
+static inline uint32_t getCycleFrequency() {
+	return SystemCoreClock;
+}
+
 static inline int8_t getTemperature() {
 	HAL_ADC_Start(&hadc1);
 	HAL_ADC_PollForConversion(&hadc1, 100);
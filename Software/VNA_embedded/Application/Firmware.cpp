@@ -19,7 +19,19 @@ using Header = struct {
 	uint32_t crc;
 } __attribute__((packed));
 
-Firmware::Info Firmware::GetFlashContentInfo(Flash *f) {
+// Once the content has been verified and the CPU firmware matches the running one, a marker is stored in the
+// last page of the FLASH (W25Q16). The FLASH is completely erased before every firmware update, this also
+// removes the marker
+#define MARKER_ADDRESS	0x1FFF00
+
+using Marker = struct {
+	char magic[4];
+	uint32_t crc;
+	uint32_t FPGA_size;
+	uint32_t CPU_size;
+} __attribute__((packed));
+
+Firmware::Info Firmware::GetFlashHeaderInfo(Flash *f) {
 	Info ret;
 	memset(&ret, 0, sizeof(ret));
 	Header h;
@@ -31,44 +43,93 @@ Firmware::Info Firmware::GetFlashContentInfo(Flash *f) {
 		LOG_WARN("Invalid content, probably empty FLASH");
 		return ret;
 	}
-	LOG_DEBUG("Checking FPGA bitstream...");
-	uint32_t crc = UINT32_MAX;
-	uint8_t buf[128];
+	ret.valid = true;
+	ret.FPGA_bitstream_address = h.FPGA_start;
+	ret.FPGA_bitstream_size = h.FPGA_size;
+	ret.CPU_image_address = h.CPU_start;
+	ret.CPU_image_size = h.CPU_size;
+	ret.crc = h.crc;
+
+	Marker m;
+	f->read(MARKER_ADDRESS, sizeof(m), &m);
+	if (!memcmp(&m.magic, "VOK!", 4) && m.crc == h.crc
+			&& m.FPGA_size == h.FPGA_size && m.CPU_size == h.CPU_size) {
+		// Quick check against a MCU firmware that has been changed without an update (e.g. by the debugger),
+		// the vector table at the beginning differs for almost every build
+		uint8_t buf[256];
+		f->read(h.CPU_start, sizeof(buf), buf);
+		if (!memcmp(buf, (void*) 0x8000000, sizeof(buf))) {
+			LOG_DEBUG("Content already verified");
+			ret.verified = true;
+		}
+	}
+	return ret;
+}
+
+bool Firmware::CompleteVerification(Flash *f, Info &info, uint32_t bitstream_crc) {
+	// Continue the CRC with the CPU firmware and compare it to the one currently
+	// running in the MCU in the same pass
+	uint32_t crc = bitstream_crc;
+	uint8_t buf[256];
 	uint32_t checked_size = 0;
-	while (checked_size < h.FPGA_size + h.CPU_size) {
+	info.CPU_need_update = false;
+	while (checked_size < info.CPU_image_size) {
 		uint16_t read_size = sizeof(buf);
-		if (h.FPGA_size + h.CPU_size - checked_size < read_size) {
-			read_size = h.FPGA_size + h.CPU_size - checked_size;
+		if (info.CPU_image_size - checked_size < read_size) {
+			read_size = info.CPU_image_size - checked_size;
 		}
-		f->read(h.FPGA_start + checked_size, read_size, buf);
+		f->read(info.CPU_image_address + checked_size, read_size, buf);
 		crc = Protocol::CRC32(crc, buf, read_size);
+		if(!info.CPU_need_update && memcmp(buf, (void*)(0x8000000+checked_size), read_size)) {
+			LOG_INFO("Difference to CPU firmware in external FLASH detected, update required");
+			info.CPU_need_update = true;
+		}
 		checked_size += read_size;
 	}
-	if (crc != h.crc) {
+	if (crc != info.crc) {
 		LOG_ERR("CRC mismatch, invalid FPGA bitstream/CPU firmware");
+		info.valid = false;
+		info.verified = false;
+		return false;
+	}
+	info.verified = true;
+	if (info.CPU_need_update) {
+		// the marker is only valid for the running firmware, check again after the update
+		return true;
+	}
+	// Store marker, the following boots can skip the verification
+	Marker m;
+	memcpy(&m.magic, "VOK!", 4);
+	m.crc = info.crc;
+	m.FPGA_size = info.FPGA_bitstream_size;
+	m.CPU_size = info.CPU_image_size;
+	memset(buf, 0xFF, sizeof(buf));
+	memcpy(buf, &m, sizeof(m));
+	if (!f->write(MARKER_ADDRESS, sizeof(buf), buf)) {
+		LOG_WARN("Failed to store verification marker");
+	}
+	return true;
+}
+
+Firmware::Info Firmware::GetFlashContentInfo(Flash *f) {
+	Info ret = GetFlashHeaderInfo(f);
+	if (!ret.valid) {
 		return ret;
 	}
-	// Compare CPU firmware in external Flash to the one currently running in the MCU
-	checked_size = 0;
-	while (checked_size < h.CPU_size) {
+	LOG_DEBUG("Checking FPGA bitstream...");
+	uint32_t crc = UINT32_MAX;
+	uint8_t buf[256];
+	uint32_t checked_size = 0;
+	while (checked_size < ret.FPGA_bitstream_size) {
 		uint16_t read_size = sizeof(buf);
-		if (h.CPU_size - checked_size < read_size) {
-			read_size = h.CPU_size - checked_size;
-		}
-		f->read(h.CPU_start + checked_size, read_size, buf);
-		if(memcmp(buf, (void*)(0x8000000+checked_size), read_size)) {
-			LOG_INFO("Difference to CPU firmware in external FLASH detected, update required");
-			ret.CPU_need_update = true;
-			break;
+		if (ret.FPGA_bitstream_size - checked_size < read_size) {
+			read_size = ret.FPGA_bitstream_size - checked_size;
 		}
+		f->read(ret.FPGA_bitstream_address + checked_size, read_size, buf);
+		crc = Protocol::CRC32(crc, buf, read_size);
 		checked_size += read_size;
 	}
-	ret.valid = true;
-	ret.FPGA_bitstream_address = h.FPGA_start;
-	ret.FPGA_bitstream_size = h.FPGA_size;
-	ret.CPU_image_address = h.CPU_start;
-	ret.CPU_image_size = h.CPU_size;
-
+	CompleteVerification(f, ret, crc);
 	return ret;
 }
 
@@ -17,11 +17,19 @@ using Info = struct info {
 	uint32_t FPGA_bitstream_size;
 	uint32_t CPU_image_address;
 	uint32_t CPU_image_size;
+	uint32_t crc;
 	bool valid;
+	// CRC checked and CPU image compared, either just now or during a previous boot
+	bool verified;
 	bool CPU_need_update;
 };
 
+// Reads the header and verifies the complete content
 Info GetFlashContentInfo(Flash *f);
+// Only reads the header, the content is marked as verified if this has been done before for the same content
+Info GetFlashHeaderInfo(Flash *f);
+// Verifies the content after the CRC over the FPGA bitstream has already been calculated (e.g. while configuring the FPGA)
+bool CompleteVerification(Flash *f, Info &info, uint32_t bitstream_crc);
 void PerformUpdate(Flash *f, Info info);
 
 }
@@ -1,17 +1,165 @@
 #include "Generator.hpp"
 #include "Manual.hpp"
 #include "Hardware.hpp"
+#include "HW_HAL.hpp"
 #include "max2871.hpp"
 #include "Si5351C.hpp"
+#include "Communication.h"
+#include "stm.hpp"
+
+#define LOG_LEVEL	LOG_LEVEL_INFO
+#define LOG_MODULE	"Gen"
+#include "Log.h"
 
 static constexpr uint32_t BandSwitchFrequency = 25000000;
 
+using namespace HWHAL;
+
+// list mode
+static Protocol::GeneratorSettings settings;
+static Protocol::GeneratorListEntry list[Protocol::MaxGeneratorListEntries];
+static bool active = false;
+static bool highPower;
+static uint16_t points;
+static uint16_t pointCnt;
+// entry that starts at the next halted point
+static uint8_t nextEntry;
+static bool lowbandEnabled;
+static uint64_t lowbandFrequency;
+static uint8_t stepEntry;
+
+// Converts a level into the attenuator setting (not very accurate)
+static uint8_t Attenuation(int16_t cdbm, bool highPower) {
+	if(!highPower) {
+		// lower source power is approx. 10db below higher source power
+		cdbm += 1000;
+	}
+	if(cdbm >= 0) {
+		return 0;
+	}
+	uint16_t attval = -cdbm / 25;
+	return attval > 127 ? 127 : attval;
+}
+
+// Splits the dwell time into sweep points with equal sample counts (the samples per point register is limited).
+// Each point additionally takes the minimum settling time
+static uint16_t DwellPoints(uint32_t dwell_us, uint32_t &samplesPerPoint) {
+	constexpr uint32_t maxSamples = 8191 * 16;
+	constexpr uint32_t settlingUs = 20;
+	uint32_t samples = (uint64_t) dwell_us * HW::ADCSamplerate / 1000000;
+	uint16_t n = samples / maxSamples + 1;
+	uint32_t settlingSamples = n * settlingUs * HW::ADCSamplerate / 1000000;
+	samples = samples > settlingSamples ? samples - settlingSamples : 0;
+	// register is in multiples of 16
+	samplesPerPoint = (samples / n + 8) / 16 * 16;
+	if(samplesPerPoint < 16) {
+		samplesPerPoint = 16;
+	}
+	return n;
+}
+
+static void SendStep() {
+	Protocol::PacketInfo p;
+	p.type = Protocol::PacketType::GeneratorStep;
+	p.generatorStep.entry = stepEntry;
+	Communication::Send(p);
+}
+
+static void SetupList(const Protocol::GeneratorSettings &g) {
+	HW::SetMode(HW::Mode::Generator);
+	if(g.listEntries > Protocol::MaxGeneratorListEntries) {
+		LOG_ERR("Too many list entries: %u", g.listEntries);
+		HW::SetIdle();
+		return;
+	}
+	settings = g;
+	// the source power is part of the default registers and can't change from point to point
+	highPower = false;
+	for(uint8_t i=0;i<g.listEntries;i++) {
+		if(list[i].cdbm_level > -1000) {
+			highPower = true;
+		}
+	}
+	Source.SetPowerOutA(highPower ? MAX2871::Power::p5dbm : MAX2871::Power::n4dbm);
+	FPGA::WriteMAX2871Default(Source.GetRegisters());
+
+	// Precompute the register sets of all entries. Only the first point of an entry is halted to
+	// apply the sample count and (for the lowband) the Si5351 frequency
+	points = 0;
+	for(uint8_t i=0;i<g.listEntries;i++) {
+		auto &e = list[i];
+		uint32_t samplesPerPoint;
+		uint16_t n = DwellPoints(e.dwell_us, samplesPerPoint);
+		if(points + n > FPGA::MaxPoints) {
+			LOG_ERR("List does not fit into the sweep table, total dwell time too long");
+			HW::SetIdle();
+			return;
+		}
+		bool lowband = e.frequency < BandSwitchFrequency;
+		if(!lowband) {
+			Source.SetFrequency(e.frequency);
+		}
+		uint8_t attenuator = Attenuation(e.cdbm_level, highPower);
+		auto filter = FPGA::SelectLowpass(e.frequency);
+		for(uint16_t j=0;j<n;j++) {
+			FPGA::WriteSweepConfig(points + j, lowband, Source.GetRegisters(), LO1.GetRegisters(), attenuator,
+					e.frequency, FPGA::SettlingTime::us20, FPGA::Samples::SPPRegister, j == 0, filter);
+		}
+		points += n;
+	}
+	FPGA::SetNumberOfPoints(points);
+	FPGA::SetWindow(FPGA::Window::None);
+
+	// LOs and receivers are not required
+	Si5351.Disable(SiChannel::Port1LO2);
+	Si5351.Disable(SiChannel::Port2LO2);
+	Si5351.Disable(SiChannel::RefLO2);
+	Si5351.Disable(SiChannel::LowbandSource);
+	lowbandEnabled = false;
+	lowbandFrequency = 0;
+	FPGA::Enable(FPGA::Periphery::SourceChip);
+	// the correct source is enabled when halted before the first entry
+	FPGA::Disable(FPGA::Periphery::SourceRF);
+	FPGA::Disable(FPGA::Periphery::LO1Chip);
+	FPGA::Disable(FPGA::Periphery::LO1RF);
+	FPGA::Enable(FPGA::Periphery::Amplifier);
+	FPGA::Disable(FPGA::Periphery::Port1Mixer);
+	FPGA::Disable(FPGA::Periphery::Port2Mixer);
+	FPGA::Disable(FPGA::Periphery::RefMixer);
+	FPGA::Enable(FPGA::Periphery::ExcitePort1, g.activePort == 1);
+	FPGA::Enable(FPGA::Periphery::ExcitePort2, g.activePort == 2);
+	FPGA::Enable(FPGA::Periphery::PortSwitch);
+
+	LOG_INFO("List with %u entries uses %u sweep points", g.listEntries, points);
+	pointCnt = 0;
+	nextEntry = 0;
+	active = true;
+	FPGA::StartSweep();
+}
+
+bool Generator::SetListEntry(const Protocol::GeneratorListEntry &entry) {
+	if(entry.index >= Protocol::MaxGeneratorListEntries) {
+		LOG_ERR("List entry %u out of range", entry.index);
+		return false;
+	}
+	if(active) {
+		// entries are used by the interrupts of an active list, stop it until the new list is set up
+		Stop();
+	}
+	list[entry.index] = entry;
+	return true;
+}
+
 void Generator::Setup(Protocol::GeneratorSettings g) {
 	if(g.activePort == 0) {
 			// both ports disabled, no need to configure PLLs
 			HW::SetMode(HW::Mode::Idle);
 			return;
 	}
+	if(g.listEntries > 0) {
+		SetupList(g);
+		return;
+	}
 	Protocol::ManualControl m;
 	// LOs not required
 	m.LO1CE = 0;
@@ -63,7 +211,8 @@ void Generator::Setup(Protocol::GeneratorSettings g) {
 		break;
 	}
 	// Set level (not very accurate)
-	if(g.cdbm_level > -1000) {
+	bool high = g.cdbm_level > -1000;
+	if(high) {
 		// use higher source power (approx 0dbm with no attenuation)
 		m.SourceHighPower = (int) MAX2871::Power::p5dbm;
 		m.SourceLowPower = (int) Si5351C::DriveStrength::mA8;
@@ -71,13 +220,76 @@ void Generator::Setup(Protocol::GeneratorSettings g) {
 		// use lower source power (approx -10dbm with no attenuation)
 		m.SourceHighPower = (int) MAX2871::Power::n4dbm;
 		m.SourceLowPower = (int) Si5351C::DriveStrength::mA2;
-		g.cdbm_level += 1000;
-	}
-	// calculate required attenuation
-	uint16_t attval = -g.cdbm_level / 25;
-	if(attval > 127) {
-		attval = 127;
 	}
-	m.attenuator = attval;
+	m.attenuator = Attenuation(g.cdbm_level, high);
 	Manual::Setup(m);
 }
+
+bool Generator::MeasurementDone(const FPGA::SamplingResult &result) {
+	if(!active) {
+		return false;
+	}
+	// the samples are not needed, only keep track of the end of the table
+	if(++pointCnt >= points) {
+		pointCnt = 0;
+		return true;
+	}
+	return false;
+}
+
+void Generator::Work() {
+	if(!active) {
+		return;
+	}
+	// start again with the first entry
+	FPGA::StartSweep();
+}
+
+void Generator::SweepHalted() {
+	if(!active) {
+		return;
+	}
+	// The FPGA has already switched the source to the new entry, the entry lasts until the next halt
+	uint8_t entry = nextEntry;
+	if(++nextEntry >= settings.listEntries) {
+		nextEntry = 0;
+	}
+	auto &e = list[entry];
+	uint32_t samplesPerPoint;
+	DwellPoints(e.dwell_us, samplesPerPoint);
+	FPGA::SetSamplesPerPoint(samplesPerPoint);
+	if(e.frequency < BandSwitchFrequency) {
+		if(e.frequency != lowbandFrequency) {
+			Si5351.SetCLK(SiChannel::LowbandSource, e.frequency, Si5351C::PLL::B,
+					highPower ? Si5351C::DriveStrength::mA8 : Si5351C::DriveStrength::mA2);
+			lowbandFrequency = e.frequency;
+		}
+		if(!lowbandEnabled) {
+			Si5351.Enable(SiChannel::LowbandSource);
+			FPGA::Disable(FPGA::Periphery::SourceRF);
+			lowbandEnabled = true;
+		}
+	} else if(lowbandEnabled || !FPGA::IsEnabled(FPGA::Periphery::SourceRF)) {
+		Si5351.Disable(SiChannel::LowbandSource);
+		FPGA::Enable(FPGA::Periphery::SourceRF);
+		lowbandEnabled = false;
+	}
+#ifdef USE_DEBUG_PINS
+	if(settings.listTrigger) {
+		DEBUG1_HIGH();
+	}
+#endif
+	FPGA::ResumeHaltedSweep();
+#ifdef USE_DEBUG_PINS
+	DEBUG1_LOW();
+#endif
+	if(settings.listStatus) {
+		stepEntry = entry;
+		STM::DispatchToInterrupt(SendStep);
+	}
+}
+
+void Generator::Stop() {
+	active = false;
+	FPGA::AbortSweep();
+}
@@ -1,10 +1,17 @@
 #pragma once
 
 #include "Protocol.hpp"
+#include "FPGA/FPGA.hpp"
 
 namespace Generator {
 
-// Generator is using the manual mode with some encapsulation for setting up. No further functions required
+// A fixed frequency and level is generated with the manual mode. In list mode, the entries are written into the
+// sweep table and stepped through by the FPGA
 void Setup(Protocol::GeneratorSettings g);
+bool SetListEntry(const Protocol::GeneratorListEntry &entry);
+bool MeasurementDone(const FPGA::SamplingResult &result);
+void Work();
+void SweepHalted();
+void Stop();
 
 }
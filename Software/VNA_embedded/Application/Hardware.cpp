@@ -7,6 +7,8 @@
 #include "VNA.hpp"
 #include "Manual.hpp"
 #include "SpectrumAnalyzer.hpp"
+#include "Generator.hpp"
+#include "Profiling.hpp"
 
 #define LOG_LEVEL	LOG_LEVEL_INFO
 #define LOG_MODULE	"HW"
@@ -25,12 +27,19 @@ static void HaltedCallback() {
 	case HW::Mode::VNA:
 		VNA::SweepHalted();
 		break;
+	case HW::Mode::SA:
+		SA::SweepHalted();
+		break;
+	case HW::Mode::Generator:
+		Generator::SweepHalted();
+		break;
 	default:
 		break;
 	}
 }
 
 static void ReadComplete(const FPGA::SamplingResult &result) {
+	Profiling::Stop(Profiling::Section::SampleRead);
 	bool needs_work = false;
 	switch(activeMode) {
 	case HW::Mode::VNA:
@@ -42,6 +51,9 @@ static void ReadComplete(const FPGA::SamplingResult &result) {
 	case HW::Mode::SA:
 		needs_work = SA::MeasurementDone(result);
 		break;
+	case HW::Mode::Generator:
+		needs_work = Generator::MeasurementDone(result);
+		break;
 	default:
 		break;
 	}
@@ -65,6 +77,9 @@ void HW::Work() {
 	case HW::Mode::SA:
 		SA::Work();
 		break;
+	case HW::Mode::Generator:
+		Generator::Work();
+		break;
 	default:
 		break;
 	}
@@ -191,6 +206,9 @@ void HW::SetMode(Mode mode) {
 	case Mode::VNA:
 		VNA::Stop();
 		break;
+	case Mode::Generator:
+		Generator::Stop();
+		break;
 	default:
 		break;
 	}
@@ -235,10 +253,10 @@ void HW::fillDeviceInfo(Protocol::DeviceInfo *info) {
 	LOG_INFO("ADC limits: P1: %d/%d P2: %d/%d R: %d/%d",
 			limits.P1min, limits.P1max, limits.P2min, limits.P2max,
 			limits.Rmin, limits.Rmax);
-#define ADC_LIMIT 		30000
-	if(limits.P1min < -ADC_LIMIT || limits.P1max > ADC_LIMIT
-			|| limits.P2min < -ADC_LIMIT || limits.P2max > ADC_LIMIT
-			|| limits.Rmin < -ADC_LIMIT || limits.Rmax > ADC_LIMIT) {
+	constexpr int16_t limit = FPGA::ADCOverloadLimit;
+	if(limits.P1min < -limit || limits.P1max > limit
+			|| limits.P2min < -limit || limits.P2max > limit
+			|| limits.Rmin < -limit || limits.Rmax > limit) {
 		info->ADC_overload = true;
 	} else {
 		info->ADC_overload = false;
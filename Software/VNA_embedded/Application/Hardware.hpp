@@ -31,7 +31,8 @@ static constexpr uint32_t LO1_minFreq = 25000000;
 static constexpr uint32_t MaxSamples = 130944;
 static constexpr uint32_t MinSamples = 16;
 static constexpr uint32_t PLLRef = 100000000;
-static constexpr uint16_t MaxPoints = 4501;
+// sweeps with more points than fit into the FPGA sweep table are measured in blocks
+static constexpr uint32_t MaxPoints = 100001;
 
 static constexpr Protocol::DeviceLimits Limits = {
 		.minFreq = 1000000,
@@ -50,6 +51,7 @@ enum class Mode {
 	Manual,
 	VNA,
 	SA,
+	Generator,
 };
 
 bool Init();
@@ -0,0 +1,67 @@
+#include "Profiling.hpp"
+
+#include <cstring>
+
+using Statistics = struct {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+};
+
+static Statistics stats[Protocol::ProfilingSections];
+static uint32_t startCycles[Protocol::ProfilingSections];
+
+static void Reset() {
+	for (auto &s : stats) {
+		s.count = 0;
+		s.min = UINT32_MAX;
+		s.max = 0;
+		s.sum = 0;
+	}
+}
+
+void Profiling::Init() {
+	STM::enableCycleCounter();
+	Reset();
+}
+
+void Profiling::Record(Section s, uint32_t cycles) {
+	auto &stat = stats[(int) s];
+	// sections may be recorded from thread and interrupt context
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	stat.count++;
+	stat.sum += cycles;
+	if (cycles < stat.min) {
+		stat.min = cycles;
+	}
+	if (cycles > stat.max) {
+		stat.max = cycles;
+	}
+	__set_PRIMASK(primask);
+}
+
+void Profiling::Start(Section s) {
+	startCycles[(int) s] = STM::getCycles();
+}
+
+void Profiling::Stop(Section s) {
+	Record(s, STM::getCycles() - startCycles[(int) s]);
+}
+
+void Profiling::Report(Protocol::ProfilingReport &r) {
+	Statistics copy[Protocol::ProfilingSections];
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	memcpy(copy, stats, sizeof(copy));
+	Reset();
+	__set_PRIMASK(primask);
+	r.timerFrequency = STM::getCycleFrequency();
+	for (uint8_t i = 0; i < Protocol::ProfilingSections; i++) {
+		r.sections[i].count = copy[i].count;
+		r.sections[i].min = copy[i].count ? copy[i].min : 0;
+		r.sections[i].max = copy[i].max;
+		r.sections[i].avg = copy[i].count ? copy[i].sum / copy[i].count : 0;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include "Protocol.hpp"
+#include "stm.hpp"
+
+// Execution time statistics (call count, min/avg/max) of code sections on the hot path, based on the cycle counter
+namespace Profiling {
+
+using Section = Protocol::ProfilingSection;
+
+void Init();
+void Record(Section s, uint32_t cycles);
+// For sections that begin and end in different functions (e.g. in different interrupts)
+void Start(Section s);
+void Stop(Section s);
+// Fills in the statistics since the last report and resets them
+void Report(Protocol::ProfilingReport &r);
+
+// Measures the lifetime of the object
+class Scope {
+public:
+	Scope(Section s) : section(s), start(STM::getCycles()) {};
+	~Scope() {
+		Record(section, STM::getCycles() - start);
+	}
+private:
+	Section section;
+	uint32_t start;
+};
+
+}
@@ -3,6 +3,7 @@
 #include "HW_HAL.hpp"
 #include <complex.h>
 #include <limits>
+#include <cstring>
 #include "Communication.h"
 #include "FreeRTOS.h"
 #include "task.h"
@@ -12,98 +13,428 @@
 #include "Log.h"
 
 static Protocol::SpectrumAnalyzerSettings s;
-static uint32_t pointCnt;
 static uint32_t points;
 static uint32_t binSize;
-static uint8_t signalIDstep;
 static uint32_t sampleNum;
 static Protocol::PacketInfo p;
+static Protocol::PacketInfo result;
 static bool active = false;
-static uint32_t lastLO2;
 static uint32_t actualRBW;
 
-static float port1Measurement, port2Measurement;
+// Each point is measured with up to 5 different LO configurations when signal ID is enabled
+static constexpr uint8_t SignalIDSteps = 5;
+// With signal ID, all steps of a block are measured before moving on to the next block. The minimum
+// amplitude of every point has to be kept until its last step, this limits the block size
+static constexpr uint16_t SignalIDBlockPoints = 128;
+static float port1Min[SignalIDBlockPoints], port2Min[SignalIDBlockPoints];
+
+using Step = struct {
+	uint32_t point;
+	uint8_t signalID;
+};
+
+// Points are measured in blocks, all steps of a block are loaded into the FPGA sweep table at once
+static uint32_t blockStart;
+static uint32_t blockPoints;
+// step that will be measured next
+static Step nextStep;
+
+// Fast scan: the span is handled in segments of result bins. Each segment is first measured at the widest RBW
+// (coarse pass), afterwards only the regions around coarse points above the threshold are measured again at
+// the requested RBW (fine pass). Bins without any fine measurement report the result of the coarse pass.
+enum class Phase : uint8_t {
+	Normal,
+	Coarse,
+	Fine,
+};
+static Phase phase;
+// The coarse pass has to be at least this many times faster per point, otherwise the normal sweep is used
+static constexpr uint8_t FastScanMinSpeedup = 4;
+static constexpr uint16_t SegmentMaxBins = 64;
+static constexpr uint16_t SegmentMaxCoarsePoints = 1024;
+static uint32_t coarsePoints;
+static uint32_t coarseBinSize;
+static uint32_t coarseSampleNum;
+static uint32_t coarseRBW;
+using CoarseResult = struct {
+	float port1;
+	float port2;
+};
+static CoarseResult coarseResult[SegmentMaxBins];
+// one bit per coarse point of the segment, set if the point exceeded the threshold
+static uint32_t candidates[SegmentMaxCoarsePoints / 32];
+static uint16_t segmentBin;
+static uint16_t segmentBins;
+// coarse point at which the search for the next fine region continues
+static uint32_t searchPoint;
+static uint32_t regionEnd;
+// next bin that has to be sent and the bin with fine measurements that has not been sent yet (-1 if none)
+static uint16_t nextBin;
+static int32_t fineBin;
+// number of measurements combined by the detector in the current bin
+static uint32_t detectorCount;
 
 using namespace HWHAL;
 
-static void StartNextSample() {
-	uint64_t freq = s.f_start + (s.f_stop - s.f_start) * pointCnt / (points - 1);
-	uint64_t LO1freq;
-	uint32_t LO2freq;
-	switch(signalIDstep) {
+// Calculates the LO frequencies for a signal ID step. Returns false if the step is not possible at this frequency
+static bool PlanStep(uint64_t freq, uint8_t step, uint64_t &LO1freq, uint32_t &LO2freq) {
+	switch(step) {
 	case 0:
 	default:
-		// reset minimum amplitudes in first signal ID step
-		port1Measurement = std::numeric_limits<float>::max();
-		port2Measurement = std::numeric_limits<float>::max();
 		// Use default LO frequencies
 		LO1freq = freq + HW::IF1;
 		LO2freq = HW::IF1 - HW::IF2;
-		FPGA::WriteRegister(FPGA::Reg::ADCPrescaler, 112);
-		FPGA::WriteRegister(FPGA::Reg::PhaseIncrement, 1120);
-		break;
+		return true;
 	case 1:
-		LO2freq = HW::IF1 - HW::IF2;
-		// Shift first LO to other side
-		// depending on the measurement frequency this is not possible or additive mixing has to be used
+	case 3:
+		// Shift first LO to other side (step 3 also uses the second LO on the other side).
+		// Depending on the measurement frequency this is not possible or additive mixing has to be used
+		LO2freq = step == 1 ? HW::IF1 - HW::IF2 : HW::IF1 + HW::IF2;
 		if(freq >= HW::IF1 + HW::LO1_minFreq) {
 			// frequency is high enough to shift 1.LO below measurement frequency
 			LO1freq = freq - HW::IF1;
-			break;
+			return true;
 		} else if(freq <= HW::IF1 - HW::LO1_minFreq) {
 			// frequency is low enough to add 1.LO to measurement frequency
 			LO1freq = HW::IF1 - freq;
-			break;
+			return true;
 		}
 		// unable to reach required frequency with 1.LO, skip this signal ID step
-		signalIDstep++;
-		/* no break */
+		return false;
 	case 2:
 		// Shift both LOs to other side
 		LO1freq = freq + HW::IF1;
 		LO2freq = HW::IF1 + HW::IF2;
-		break;
-	case 3:
-		LO2freq = HW::IF1 + HW::IF2;
-		// Shift second LO to other side
-		// depending on the measurement frequency this is not possible or additive mixing has to be used
-		if(freq >= HW::IF1 + HW::LO1_minFreq) {
-			// frequency is high enough to shift 1.LO below measurement frequency
-			LO1freq = freq - HW::IF1;
-			break;
-		} else if(freq <= HW::IF1 - HW::LO1_minFreq) {
-			// frequency is low enough to add 1.LO to measurement frequency
-			LO1freq = HW::IF1 - freq;
-			break;
-		}
-		// unable to reach required frequency with 1.LO, skip this signal ID step
-		signalIDstep++;
-		/* no break */
+		return true;
 	case 4:
 		// Use default frequencies with different ADC samplerate to remove images in final IF
 		LO1freq = freq + HW::IF1;
 		LO2freq = HW::IF1 - HW::IF2;
-		FPGA::WriteRegister(FPGA::Reg::ADCPrescaler, 120);
-		FPGA::WriteRegister(FPGA::Reg::PhaseIncrement, 1200);
+		return true;
 	}
+}
+
+static bool SignalIDActive() {
+	// the coarse pass only looks for candidates, signals in the fine regions are identified there
+	return s.SignalID && phase != Phase::Coarse;
+}
+
+static uint64_t PointFrequency(uint32_t point) {
+	uint32_t n = phase == Phase::Coarse ? coarsePoints : points;
+	return s.f_start + (s.f_stop - s.f_start) * point / (n - 1);
+}
+
+static bool StepPossible(const Step &step) {
+	uint64_t LO1freq = 0;
+	uint32_t LO2freq;
+	return PlanStep(PointFrequency(step.point), step.signalID, LO1freq, LO2freq);
+}
+
+// Sets the 1.LO registers (in RAM only) and returns the 2.LO frequency required for this step
+static uint32_t ConfigureStep(const Step &step) {
+	uint64_t LO1freq = 0;
+	uint32_t LO2freq;
+	PlanStep(PointFrequency(step.point), step.signalID, LO1freq, LO2freq);
 	LO1.SetFrequency(LO1freq);
 	// LO1 is not able to reach all frequencies with the required precision, adjust LO2 to account for deviation
 	int32_t LO1deviation = (int64_t) LO1.GetActualFrequency() - LO1freq;
-	LO2freq += LO1deviation;
-	// only adjust LO2 PLL if necessary (if the deviation is significantly less than the RBW it does not matter)
-	if((uint32_t) abs(LO2freq - lastLO2) > actualRBW / 2) {
-		Si5351.SetCLK(SiChannel::Port1LO2, LO2freq, Si5351C::PLL::B, Si5351C::DriveStrength::mA2);
-		Si5351.SetCLK(SiChannel::Port2LO2, LO2freq, Si5351C::PLL::B, Si5351C::DriveStrength::mA2);
-		lastLO2 = LO2freq;
-	}
-	// Configure the sampling in the FPGA
-	FPGA::WriteSweepConfig(0, 0, Source.GetRegisters(), LO1.GetRegisters(), 0,
-			0, FPGA::SettlingTime::us20, FPGA::Samples::SPPRegister, 0,
-			FPGA::LowpassFilter::M947);
+	return LO2freq + LO1deviation;
+}
 
+// Advances to the next step in the order the steps of a block are measured. Returns false at the end of the block
+static bool NextStep(Step &step) {
+	do {
+		step.point++;
+		if(step.point >= blockStart + blockPoints) {
+			if(!SignalIDActive() || step.signalID >= SignalIDSteps - 1) {
+				return false;
+			}
+			step.signalID++;
+			step.point = blockStart;
+		}
+	} while(!StepPossible(step));
+	return true;
+}
+
+static void SetLO2(uint32_t freq) {
+	Si5351.SetCLK(SiChannel::Port1LO2, freq, Si5351C::PLL::B, Si5351C::DriveStrength::mA2);
+	Si5351.SetCLK(SiChannel::Port2LO2, freq, Si5351C::PLL::B, Si5351C::DriveStrength::mA2);
+}
+
+static void SetADCSamplerate(bool alternative) {
+	FPGA::WriteRegister(FPGA::Reg::ADCPrescaler, alternative ? 120 : 112);
+	FPGA::WriteRegister(FPGA::Reg::PhaseIncrement, alternative ? 1200 : 1120);
+}
+
+// Loads all steps of the block starting at blockStart (up to the point before end) into the FPGA and starts the
+// sweep through them. The 2.LO and the ADC samplerate are not part of the sweep table, the FPGA halts whenever
+// they have to change
+static void LoadBlock(uint32_t end) {
+	blockPoints = end - blockStart;
+	uint32_t maxBlockPoints = SignalIDActive() ? SignalIDBlockPoints : FPGA::MaxPoints;
+	if(blockPoints > maxBlockPoints) {
+		blockPoints = maxBlockPoints;
+	}
+	Step step = {blockStart, 0};
+	uint16_t entries = 0;
+	uint16_t halts = 0;
+	uint32_t activeLO2 = 0;
+	bool activeSamplerate = false;
+	uint32_t RBW = phase == Phase::Coarse ? coarseRBW : actualRBW;
+	do {
+		uint32_t LO2freq = ConfigureStep(step);
+		bool alternativeSamplerate = step.signalID == 4;
+		bool halt = false;
+		if(entries == 0) {
+			// FPGA is idle, configure for first step right away
+			SetLO2(LO2freq);
+			SetADCSamplerate(alternativeSamplerate);
+			activeLO2 = LO2freq;
+			activeSamplerate = alternativeSamplerate;
+		} else if(alternativeSamplerate != activeSamplerate
+				|| (uint32_t) abs((int32_t) (LO2freq - activeLO2)) > RBW / 2) {
+			// only adjust LO2 PLL if necessary (if the deviation is significantly less than the RBW it does not matter)
+			halt = true;
+			halts++;
+			activeLO2 = LO2freq;
+			activeSamplerate = alternativeSamplerate;
+		}
+		FPGA::WriteSweepConfig(entries, 0, Source.GetRegisters(), LO1.GetRegisters(), 0,
+				0, FPGA::SettlingTime::us20, FPGA::Samples::SPPRegister, halt,
+				FPGA::LowpassFilter::M947);
+		entries++;
+	} while(NextStep(step));
+	LOG_DEBUG("Block at point %lu: %lu points, %u steps, %u halts", blockStart, blockPoints, entries, halts);
+	FPGA::SetNumberOfPoints(entries);
+	nextStep = {blockStart, 0};
 	FPGA::StartSweep();
 }
 
+static void SendResult() {
+	Communication::Send(result);
+}
+
+// Combines a measurement with the previous measurements of its bin according to the detector
+static void Detect(uint16_t binIndex, uint32_t pointInBin, uint32_t size, bool first, float port1Measurement,
+		float port2Measurement) {
+	auto det = (SA::Detector) s.Detector;
+	if(det == SA::Detector::Normal) {
+		det = binIndex & 0x01 ? SA::Detector::PosPeak : SA::Detector::NegPeak;
+	}
+	if(first) {
+		detectorCount = 0;
+	}
+	detectorCount++;
+	switch(det) {
+	case SA::Detector::PosPeak:
+		if(first) {
+			p.spectrumResult.port1 = std::numeric_limits<float>::min();
+			p.spectrumResult.port2 = std::numeric_limits<float>::min();
+		}
+		if(port1Measurement > p.spectrumResult.port1) {
+			p.spectrumResult.port1 = port1Measurement;
+		}
+		if(port2Measurement > p.spectrumResult.port2) {
+			p.spectrumResult.port2 = port2Measurement;
+		}
+		break;
+	case SA::Detector::NegPeak:
+		if(first) {
+			p.spectrumResult.port1 = std::numeric_limits<float>::max();
+			p.spectrumResult.port2 = std::numeric_limits<float>::max();
+		}
+		if(port1Measurement < p.spectrumResult.port1) {
+			p.spectrumResult.port1 = port1Measurement;
+		}
+		if(port2Measurement < p.spectrumResult.port2) {
+			p.spectrumResult.port2 = port2Measurement;
+		}
+		break;
+	case SA::Detector::Sample:
+		if(first || pointInBin <= size / 2) {
+			// still in first half of bin, simply overwrite
+			p.spectrumResult.port1 = port1Measurement;
+			p.spectrumResult.port2 = port2Measurement;
+		}
+		break;
+	case SA::Detector::Average:
+		if(first) {
+			p.spectrumResult.port1 = 0;
+			p.spectrumResult.port2 = 0;
+		}
+		p.spectrumResult.port1 += port1Measurement;
+		p.spectrumResult.port2 += port2Measurement;
+		break;
+	case SA::Detector::Normal:
+		// nothing to do, normal detector handled by PosPeak or NegPeak in each sample
+		break;
+	}
+}
+
+// Completes the detector result of a bin, must be called after its last measurement
+static void DetectorFinish() {
+	if((SA::Detector) s.Detector == SA::Detector::Average && detectorCount > 0) {
+		// calculate average
+		p.spectrumResult.port1 /= detectorCount;
+		p.spectrumResult.port2 /= detectorCount;
+	}
+}
+
+static void PrepareResult(uint16_t binIndex, float port1, float port2) {
+	result.type = Protocol::PacketType::SpectrumAnalyzerResult;
+	result.spectrumResult.port1 = port1;
+	result.spectrumResult.port2 = port2;
+	result.spectrumResult.pointNum = binIndex;
+	result.spectrumResult.frequency = s.f_start + (s.f_stop - s.f_start) * binIndex / (s.pointNum - 1);
+}
+
+// Handles the final measurement of a point
+static void PointComplete(uint32_t point, float port1Measurement, float port2Measurement) {
+	uint16_t binIndex = point / binSize;
+	uint32_t pointInBin = point % binSize;
+	if(phase == Phase::Fine) {
+		// only parts of a bin might be measured, the bin is complete once a measurement of another bin arrives
+		bool first = (int32_t) binIndex != fineBin;
+		if(first && fineBin >= 0) {
+			DetectorFinish();
+			PrepareResult(fineBin, p.spectrumResult.port1, p.spectrumResult.port2);
+			nextBin = fineBin + 1;
+			STM::DispatchToInterrupt(SendResult);
+		}
+		fineBin = binIndex;
+		Detect(binIndex, pointInBin, binSize, first, port1Measurement, port2Measurement);
+		return;
+	}
+	Detect(binIndex, pointInBin, binSize, pointInBin == 0, port1Measurement, port2Measurement);
+	if(pointInBin >= binSize - 1) {
+		DetectorFinish();
+		// Send result to application. The next bin is already being measured while the result is sent
+		PrepareResult(binIndex, p.spectrumResult.port1, p.spectrumResult.port2);
+		STM::DispatchToInterrupt(SendResult);
+	}
+}
+
+// Handles a measurement of the coarse pass
+static void CoarsePointComplete(uint32_t point, float port1Measurement, float port2Measurement) {
+	uint32_t segmentPoint = point - segmentBin * coarseBinSize;
+	if(port1Measurement > s.FastScanThreshold || port2Measurement > s.FastScanThreshold) {
+		candidates[segmentPoint / 32] |= 1UL << (segmentPoint % 32);
+	}
+	uint16_t binIndex = point / coarseBinSize;
+	uint32_t pointInBin = point % coarseBinSize;
+	Detect(binIndex, pointInBin, coarseBinSize, pointInBin == 0, port1Measurement, port2Measurement);
+	if(pointInBin >= coarseBinSize - 1) {
+		DetectorFinish();
+		coarseResult[binIndex - segmentBin].port1 = p.spectrumResult.port1;
+		coarseResult[binIndex - segmentBin].port2 = p.spectrumResult.port2;
+	}
+}
+
+static bool IsCandidate(uint32_t point) {
+	uint32_t segmentPoint = point - segmentBin * coarseBinSize;
+	return candidates[segmentPoint / 32] & (1UL << (segmentPoint % 32));
+}
+
+// Fine point at (or right after) the frequency of a coarse point
+static uint32_t CoarseToFine(uint32_t point) {
+	return ((uint64_t) point * (points - 1) + coarsePoints - 2) / (coarsePoints - 1);
+}
+
+// Finds the next range of fine points that has to be measured. Returns false if there is none left in the segment
+static bool NextRegion(uint32_t &start, uint32_t &stop) {
+	uint32_t segmentEnd = (segmentBin + segmentBins) * coarseBinSize;
+	while(searchPoint < segmentEnd && !IsCandidate(searchPoint)) {
+		searchPoint++;
+	}
+	if(searchPoint >= segmentEnd) {
+		return false;
+	}
+	uint32_t first = searchPoint;
+	while(searchPoint < segmentEnd && IsCandidate(searchPoint)) {
+		searchPoint++;
+	}
+	// the candidate might be anywhere within the RBW of the coarse points, include the neighbouring points
+	start = CoarseToFine(first > 0 ? first - 1 : 0);
+	stop = searchPoint < coarsePoints ? CoarseToFine(searchPoint) + 1 : points;
+	// limit to the bins of this segment and do not measure points again
+	uint32_t segmentFineStart = segmentBin * binSize;
+	uint32_t segmentFineEnd = (segmentBin + segmentBins) * binSize;
+	if(start < segmentFineStart) {
+		start = segmentFineStart;
+	}
+	if(start < regionEnd) {
+		start = regionEnd;
+	}
+	if(stop > segmentFineEnd) {
+		stop = segmentFineEnd;
+	}
+	return start < stop;
+}
+
+// Sends all bins before the given bin that have not been sent yet (called from HW::Work, the FPGA is idle)
+static void SendBinsUntil(uint16_t bin) {
+	for(; nextBin < bin; nextBin++) {
+		if((int32_t) nextBin == fineBin) {
+			DetectorFinish();
+			PrepareResult(nextBin, p.spectrumResult.port1, p.spectrumResult.port2);
+			fineBin = -1;
+		} else {
+			auto &c = coarseResult[nextBin - segmentBin];
+			PrepareResult(nextBin, c.port1, c.port2);
+		}
+		Communication::Send(result);
+	}
+}
+
+static void StartSegment() {
+	segmentBins = SegmentMaxCoarsePoints / coarseBinSize;
+	if(segmentBins > SegmentMaxBins) {
+		segmentBins = SegmentMaxBins;
+	}
+	if(segmentBins > s.pointNum - segmentBin) {
+		segmentBins = s.pointNum - segmentBin;
+	}
+	memset(candidates, 0, sizeof(candidates));
+	nextBin = segmentBin;
+	fineBin = -1;
+	phase = Phase::Coarse;
+	FPGA::SetSamplesPerPoint(coarseSampleNum);
+	blockStart = segmentBin * coarseBinSize;
+	LoadBlock(blockStart + segmentBins * coarseBinSize);
+}
+
+// Continues with the next fine region of the segment or the next segment
+static void ContinueFastScan() {
+	uint32_t start, stop;
+	if(NextRegion(start, stop)) {
+		SendBinsUntil(start / binSize);
+		if(phase != Phase::Fine) {
+			phase = Phase::Fine;
+			FPGA::SetSamplesPerPoint(sampleNum);
+		}
+		regionEnd = stop;
+		blockStart = start;
+		LoadBlock(stop);
+		return;
+	}
+	// segment complete
+	SendBinsUntil(segmentBin + segmentBins);
+	segmentBin += segmentBins;
+	if(segmentBin >= s.pointNum) {
+		// start next sweep
+		segmentBin = 0;
+	}
+	StartSegment();
+}
+
+// Number of points required to cover the span with the given RBW, an integer multiple of the result points
+// (in order to have the same amount of measurements in each bin)
+static uint32_t PointsForRBW(uint32_t RBW) {
+	uint32_t n = 2 * (s.f_stop - s.f_start) / RBW;
+	n += s.pointNum - n % s.pointNum;
+	return n;
+}
+
 void SA::Setup(Protocol::SpectrumAnalyzerSettings settings) {
 	LOG_DEBUG("Setting up...");
 	SA::Stop();
@@ -111,9 +442,6 @@ void SA::Setup(Protocol::SpectrumAnalyzerSettings settings) {
 	s = settings;
 	HW::SetMode(HW::Mode::SA);
 	FPGA::SetMode(FPGA::Mode::FPGA);
-	// in almost all cases a full sweep requires more points than the FPGA can handle at a time
-	// individually start each point and do the sweep in the uC
-	FPGA::SetNumberOfPoints(1);
 	// calculate required samples per measurement for requested RBW
 	// see https://www.tek.com/blog/window-functions-spectrum-analyzers for window factors
 	constexpr float window_factors[4] = {0.89f, 2.23f, 1.44f, 3.77f};
@@ -128,13 +456,25 @@ void SA::Setup(Protocol::SpectrumAnalyzerSettings settings) {
 	actualRBW = HW::ADCSamplerate * window_factors[s.WindowType] / sampleNum;
 	FPGA::SetSamplesPerPoint(sampleNum);
 	// calculate amount of required points
-	points = 2 * (s.f_stop - s.f_start) / actualRBW;
-	// adjust to integer multiple of requested result points (in order to have the same amount of measurements in each bin)
-	points += s.pointNum - points % s.pointNum;
+	points = PointsForRBW(actualRBW);
 	binSize = points / s.pointNum;
 	LOG_DEBUG("%u displayed points, resulting in %lu points and bins of size %u", s.pointNum, points, binSize);
-	// set initial state
-	pointCnt = 0;
+	phase = Phase::Normal;
+	if(s.FastScan) {
+		// coarse pass with the widest possible RBW
+		coarseSampleNum = HW::MinSamples;
+		coarseRBW = HW::ADCSamplerate * window_factors[s.WindowType] / coarseSampleNum;
+		coarsePoints = PointsForRBW(coarseRBW);
+		coarseBinSize = coarsePoints / s.pointNum;
+		if(coarseSampleNum * FastScanMinSpeedup > sampleNum) {
+			LOG_INFO("RBW too wide for fast scan, using normal sweep");
+		} else if(coarseBinSize > SegmentMaxCoarsePoints) {
+			LOG_WARN("Too few points for fast scan, using normal sweep");
+		} else {
+			LOG_DEBUG("Fast scan: %lu coarse points, bins of size %lu", coarsePoints, coarseBinSize);
+			phase = Phase::Coarse;
+		}
+	}
 	// enable the required hardware resources
 	Si5351.Enable(SiChannel::Port1LO2);
 	Si5351.Enable(SiChannel::Port2LO2);
@@ -144,110 +484,86 @@ void SA::Setup(Protocol::SpectrumAnalyzerSettings settings) {
 	FPGA::Enable(FPGA::Periphery::ExcitePort1);
 	FPGA::Enable(FPGA::Periphery::Port1Mixer);
 	FPGA::Enable(FPGA::Periphery::Port2Mixer);
-	lastLO2 = 0;
 	active = true;
-	StartNextSample();
+	if(phase == Phase::Coarse) {
+		segmentBin = 0;
+		StartSegment();
+	} else {
+		blockStart = 0;
+		LoadBlock(points);
+	}
 }
 
 bool SA::MeasurementDone(const FPGA::SamplingResult &result) {
 	if(!active) {
 		return false;
 	}
-	FPGA::AbortSweep();
-	float port1 = abs(std::complex<float>(result.P1I, result.P1Q))/sampleNum;
-	float port2 = abs(std::complex<float>(result.P2I, result.P2Q))/sampleNum;
-	if(port1 < port1Measurement) {
-		port1Measurement = port1;
+	uint32_t samples = phase == Phase::Coarse ? coarseSampleNum : sampleNum;
+	float port1 = abs(std::complex<float>(result.P1I, result.P1Q))/samples;
+	float port2 = abs(std::complex<float>(result.P2I, result.P2Q))/samples;
+	if(phase == Phase::Coarse) {
+		CoarsePointComplete(nextStep.point, port1, port2);
+	} else if(s.SignalID) {
+		// keep minimum amplitudes of all signal ID steps
+		uint16_t i = nextStep.point - blockStart;
+		if(nextStep.signalID == 0 || port1 < port1Min[i]) {
+			port1Min[i] = port1;
+		}
+		if(nextStep.signalID == 0 || port2 < port2Min[i]) {
+			port2Min[i] = port2;
+		}
+		if(nextStep.signalID == SignalIDSteps - 1) {
+			PointComplete(nextStep.point, port1Min[i], port2Min[i]);
+		}
+	} else {
+		PointComplete(nextStep.point, port1, port2);
 	}
-	if(port2 < port2Measurement) {
-		port2Measurement = port2;
+	if(!NextStep(nextStep)) {
+		// end of block, trigger work function to load the next one
+		return true;
 	}
-	// trigger work function
-	return true;
+	return false;
 }
 
 void SA::Work() {
 	if(!active) {
 		return;
 	}
-	if(!s.SignalID || signalIDstep >= 4) {
-		// this measurement point is done, handle result according to detector
-		uint16_t binIndex = pointCnt / binSize;
-		uint32_t pointInBin = pointCnt % binSize;
-		bool lastPointInBin = pointInBin >= binSize - 1;
-		auto det = (Detector) s.Detector;
-		if(det == Detector::Normal) {
-			det = binIndex & 0x01 ? Detector::PosPeak : Detector::NegPeak;
-		}
-		switch(det) {
-		case Detector::PosPeak:
-			if(pointInBin == 0) {
-				p.spectrumResult.port1 = std::numeric_limits<float>::min();
-				p.spectrumResult.port2 = std::numeric_limits<float>::min();
-			}
-			if(port1Measurement > p.spectrumResult.port1) {
-				p.spectrumResult.port1 = port1Measurement;
-			}
-			if(port2Measurement > p.spectrumResult.port2) {
-				p.spectrumResult.port2 = port2Measurement;
-			}
-			break;
-		case Detector::NegPeak:
-			if(pointInBin == 0) {
-				p.spectrumResult.port1 = std::numeric_limits<float>::max();
-				p.spectrumResult.port2 = std::numeric_limits<float>::max();
-			}
-			if(port1Measurement < p.spectrumResult.port1) {
-				p.spectrumResult.port1 = port1Measurement;
-			}
-			if(port2Measurement < p.spectrumResult.port2) {
-				p.spectrumResult.port2 = port2Measurement;
-			}
-			break;
-		case Detector::Sample:
-			if(pointInBin <= binSize / 2) {
-				// still in first half of bin, simply overwrite
-				p.spectrumResult.port1 = port1Measurement;
-				p.spectrumResult.port2 = port2Measurement;
-			}
-			break;
-		case Detector::Average:
-			if(pointInBin == 0) {
-				p.spectrumResult.port1 = 0;
-				p.spectrumResult.port2 = 0;
-			}
-			p.spectrumResult.port1 += port1Measurement;
-			p.spectrumResult.port2 += port2Measurement;
-			if(lastPointInBin) {
-				// calculate average
-				p.spectrumResult.port1 /= binSize;
-				p.spectrumResult.port2 /= binSize;
-			}
-			break;
-		case Detector::Normal:
-			// nothing to do, normal detector handled by PosPeak or NegPeak in each sample
-			break;
+	switch(phase) {
+	case Phase::Normal:
+		blockStart += blockPoints;
+		if(blockStart >= points) {
+			// start next sweep
+			blockStart = 0;
 		}
-		if(lastPointInBin) {
-			// Send result to application
-			p.type = Protocol::PacketType::SpectrumAnalyzerResult;
-			// measurements are already up to date, fill remaining fields
-			p.spectrumResult.pointNum = binIndex;
-			p.spectrumResult.frequency = s.f_start + (s.f_stop - s.f_start) * binIndex / (s.pointNum - 1);
-			Communication::Send(p);
-		}
-		// setup for next step
-		signalIDstep = 0;
-		if(pointCnt < points - 1) {
-			pointCnt++;
+		LoadBlock(points);
+		break;
+	case Phase::Coarse:
+		// coarse pass of the segment complete, look for candidates
+		searchPoint = segmentBin * coarseBinSize;
+		regionEnd = 0;
+		ContinueFastScan();
+		break;
+	case Phase::Fine:
+		blockStart += blockPoints;
+		if(blockStart < regionEnd) {
+			// region did not fit into a single block
+			LoadBlock(regionEnd);
 		} else {
-			pointCnt = 0;
+			ContinueFastScan();
 		}
-	} else {
-		// more measurements required for signal ID
-		signalIDstep++;
+		break;
+	}
+}
+
+void SA::SweepHalted() {
+	if(!active) {
+		return;
 	}
-	StartNextSample();
+	// halted before nextStep, apply the settings that are not part of the sweep table
+	SetLO2(ConfigureStep(nextStep));
+	SetADCSamplerate(nextStep.signalID == 4);
+	FPGA::ResumeHaltedSweep();
 }
 
 void SA::Stop() {
@@ -16,6 +16,7 @@ enum class Detector {
 void Setup(Protocol::SpectrumAnalyzerSettings settings);
 bool MeasurementDone(const FPGA::SamplingResult &result);
 void Work();
+void SweepHalted();
 void Stop();
 
 }
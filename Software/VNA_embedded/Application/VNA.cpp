@@ -6,11 +6,14 @@
 #include "delay.hpp"
 #include "FPGA/FPGA.hpp"
 #include <complex>
+#include <cmath>
+#include <cstring>
 #include "Exti.hpp"
 #include "Hardware.hpp"
 #include "Communication.h"
 #include "FreeRTOS.h"
 #include "task.h"
+#include "Profiling.hpp"
 
 #define LOG_LEVEL	LOG_LEVEL_INFO
 #define LOG_MODULE	"VNA"
@@ -18,28 +21,477 @@
 
 static VNA::SweepCallback sweepCallback;
 static Protocol::SweepSettings settings;
-static uint16_t pointCnt;
+static uint32_t pointCnt;
 static bool excitingPort1;
 static Protocol::Datapoint data;
 static bool active = false;
 static bool sourceHighPower;
+// on-device averaging: every point is measured several times and the results are summed up
+static uint8_t averages;
+static uint8_t averageCnt;
+static std::complex<float> sumS11, sumS21, sumS12, sumS22;
+static uint8_t decimation;
+// raw data mode
+static VNA::RawCallback rawCallback;
+static Protocol::RawDatapoint rawData;
+static FPGA::SamplingResult rawSum[2];
+// ADC overload of any transmitted raw data point in the current sweep. The limits of these points are read (and
+// reset) before the device info is compiled, the overload is merged into the device info
+static bool sweepOverload;
+// measurement timestamps, derived from the cycle counter (which overflows after a few seconds)
+static uint32_t timestampUs;
+static uint32_t timestampCycles;
+static uint32_t timestampRemainder;
+static uint32_t cyclesPerUs;
+static volatile uint32_t measurementCnt;
 
 using IFTableEntry = struct {
-	uint16_t pointCnt;
+	// point within its block and the parity of the block (entries of two blocks can be in the table)
+	uint16_t point:15;
+	uint16_t block:1;
 	uint8_t clkconfig[8];
 };
 
 static constexpr uint16_t IFTableNumEntries = 500;
 static IFTableEntry IFTable[IFTableNumEntries];
-static uint16_t IFTableIndexCnt = 0;
+// The IF table is a ring buffer. Sweeps that fit into the sweep table use the same entries in every sweep,
+// blocked sweeps add the entries of the next block while measuring the current one
+static uint16_t IFTableRead, IFTableWrite, IFTableUsed;
+static uint16_t IFTableSweepEntries;
+
+// sweep segments as received from the host. A normal sweep is converted into a single segment
+static Protocol::SweepSegment segments[Protocol::MaxSweepSegments];
+static uint8_t numSegments;
+
+// acquisition settings derived from the segments in Setup
+using SegmentConfig = struct {
+	FPGA::Samples samples;
+	uint32_t samplesPerPoint;
+	uint32_t bandwidth;
+	double logStep;
+};
+static SegmentConfig segmentConfig[Protocol::MaxSweepSegments];
+
+using SweepPosition = struct {
+	uint8_t segment;
+	uint32_t segmentPoint;
+	uint64_t frequency;
+	double logFrequency;
+	int16_t cdbm;
+};
+// position of the point that is currently measured
+static SweepPosition sweepPosition;
+
+// Sweeps with more points than fit into the sweep table are measured in blocks of (almost) equal size. While the
+// FPGA measures a block, the table entries of its already measured points are overwritten with the next block
+static uint32_t blockPoints;
+// first point of the block that is currently measured and the number of blocks started since the setup
+static uint32_t blockStart;
+static uint32_t blockCnt;
+
+// Plans the sweep table point by point, its state is kept to continue with the next block during the sweep
+using TableWriter = struct {
+	// next point to write and the block it belongs to
+	SweepPosition pos;
+	uint32_t point;
+	uint32_t blockStart;
+	uint32_t blockCnt;
+	// next table entry of the point (averaged points occupy several entries)
+	uint8_t average;
+	bool planned;
+	// table entry settings of the planned point
+	bool lowband;
+	bool halt;
+	uint8_t attenuator;
+	FPGA::SettlingTime settling;
+	FPGA::LowpassFilter filter;
+	// state after the previously planned point
+	bool lastLowband;
+	uint64_t lastFreq;
+	uint32_t lastSourceRegs[6], lastLORegs[6];
+	FPGA::LowpassFilter lastFilter;
+	uint32_t LO2;
+	// planning statistics
+	uint32_t halts;
+	uint32_t LO2Shifts;
+	uint32_t longSettlingPoints;
+	uint64_t timeUs;
+};
+static TableWriter writer;
+
+// Blocked sweeps plan the entries of the next block in the work function, the interrupt of a measured point only
+// copies already planned entries into the freed table entries. The FIFO only holds entries of the block following
+// the one that is currently measured. A complete block does not fit into the RAM, the work function is requested
+// whenever the FIFO runs low.
+using PlannedEntry = struct {
+	FPGA::SweepConfig config;
+	// point within its block
+	uint16_t point;
+};
+static constexpr uint16_t PlannedNumEntries = 128;
+static PlannedEntry planned[PlannedNumEntries];
+// read index only changed by the measurement interrupt, write index only by the work function (or before the sweep)
+static volatile uint16_t plannedRead, plannedWrite;
+// set by the measurement interrupt, handled by the work function
+static volatile bool blockComplete, refillRequested;
 
 static constexpr uint32_t BandSwitchFrequency = 25000000;
+// PLL reset causes the 2.LO to turn off briefly and then ramp on back, needs delay before next point
+static constexpr uint32_t LO2SettlingTimeUs = 1300;
+// rough estimate of the time spent in a halted point (interrupt latency and Si5351 access)
+static constexpr uint32_t HaltOverheadUs = 200;
+// settling times in us, indexed by FPGA::SettlingTime
+static constexpr uint16_t SettlingTimesUs[] = {20, 60, 180, 540};
+// sample counts available per point, starting at FPGA::Samples::S96
+static constexpr uint32_t SampleCounts[] = {96, 304, 912, 3040, 9136, 30464, 91392};
+// blocked sweeps plan the 2.LO while measuring (delaying the refill of the sweep table), limit how far ahead it looks
+static constexpr uint32_t BlockedLO2PlanPoints = 100;
 
 using namespace HWHAL;
 
-bool VNA::Setup(Protocol::SweepSettings s, SweepCallback cb) {
+// Requested excitation level of a point. Power sweeps step the level across the points of every segment
+static int16_t PointLevel(uint8_t segment, uint32_t segmentPoint) {
+	auto &seg = segments[segment];
+	if (!settings.powerSweep) {
+		return seg.cdbm_excitation;
+	}
+	if (seg.points < 2) {
+		return settings.cdbm_excitation;
+	}
+	return settings.cdbm_excitation
+			+ (int32_t) (settings.cdbm_excitation_stop - settings.cdbm_excitation) * segmentPoint / (seg.points - 1);
+}
+
+static void FirstPoint(SweepPosition &p) {
+	p.segment = 0;
+	p.segmentPoint = 0;
+	p.frequency = segments[0].f_start;
+	p.logFrequency = segments[0].f_start;
+	p.cdbm = PointLevel(0, 0);
+}
+
+// Advances to the next point. Log segments are stepped with a constant factor to avoid pow() in interrupt context
+static void NextPoint(SweepPosition &p) {
+	p.segmentPoint++;
+	if (p.segmentPoint >= segments[p.segment].points) {
+		if (p.segment < numSegments - 1) {
+			p.segment++;
+			p.segmentPoint = 0;
+			p.frequency = segments[p.segment].f_start;
+			p.logFrequency = segments[p.segment].f_start;
+			p.cdbm = PointLevel(p.segment, 0);
+		}
+		// otherwise the end of the sweep has been reached
+		return;
+	}
+	p.cdbm = PointLevel(p.segment, p.segmentPoint);
+	auto &seg = segments[p.segment];
+	if (p.segmentPoint == seg.points - 1) {
+		// last point of segment, avoid accumulated rounding errors
+		p.frequency = seg.f_stop;
+	} else if (seg.logSweep) {
+		p.logFrequency *= segmentConfig[p.segment].logStep;
+		p.frequency = p.logFrequency;
+	} else {
+		p.frequency = seg.f_start + (seg.f_stop - seg.f_start) * p.segmentPoint / (seg.points - 1);
+	}
+}
+
+// Selects the fixed per-point sample count with a bandwidth closest to (but not above) the requested bandwidth
+static FPGA::Samples SamplesForBandwidth(uint32_t bandwidth, uint32_t &samples) {
+	uint8_t i = 0;
+	while (i < 6 && HW::ADCSamplerate / SampleCounts[i] > bandwidth) {
+		i++;
+	}
+	samples = SampleCounts[i];
+	return (FPGA::Samples) ((uint8_t) FPGA::Samples::S96 + i);
+}
+
+// Converts an excitation level into the attenuator setting (not very accurate)
+static uint8_t Attenuation(int16_t cdbm) {
+	if (!sourceHighPower) {
+		// lower source power is approx. 10db below higher source power
+		cdbm += 1000;
+	}
+	if(cdbm >= 0) {
+		return 0;
+	} else if (cdbm <= -3175){
+		return 127;
+	} else {
+		return (-cdbm) / 25;
+	}
+}
+
+// Sets the source and 1.LO registers (in RAM only) and returns the resulting 1.IF
+static uint32_t ConfigurePLLs(uint64_t freq) {
+	uint64_t actualSourceFreq;
+	if (freq < BandSwitchFrequency) {
+		// lowband source is generated by the Si5351 with (almost) no frequency error
+		actualSourceFreq = freq;
+	} else {
+		Source.SetFrequency(freq);
+		actualSourceFreq = Source.GetActualFrequency();
+	}
+	LO1.SetFrequency(freq + HW::IF1);
+	return LO1.GetActualFrequency() - actualSourceFreq;
+}
+
+static void ResetTimestamp() {
+	cyclesPerUs = STM::getCycleFrequency() / 1000000;
+	timestampCycles = STM::getCycles();
+	timestampRemainder = 0;
+	timestampUs = 0;
+}
+
+// Returns the time since the sweep was set up. Has to be called at least once per cycle counter overflow
+static uint32_t Timestamp() {
+	uint32_t now = STM::getCycles();
+	uint32_t cycles = now - timestampCycles + timestampRemainder;
+	timestampCycles = now;
+	timestampUs += cycles / cyclesPerUs;
+	timestampRemainder = cycles % cyclesPerUs;
+	return timestampUs;
+}
+
+static uint8_t VCOBand(const uint32_t *regs) {
+	return (regs[3] & 0xFC000000) >> 26;
+}
+
+static uint8_t Divider(const uint32_t *regs) {
+	return (regs[4] & 0x00700000) >> 20;
+}
+
+// Selects the settling time required after the PLL registers changed from the last to the current point.
+// Small steps within a VCO band settle quickly, switching dividers/filters and especially VCO bands takes longer.
+static FPGA::SettlingTime RequiredSettlingTime(const uint32_t *lastSource, const uint32_t *lastLO,
+		bool filterChange, bool bandChange) {
+	if (bandChange) {
+		// switching between highband and lowband source
+		return FPGA::SettlingTime::us540;
+	}
+	if (VCOBand(lastSource) != VCOBand(Source.GetRegisters())
+			|| VCOBand(lastLO) != VCOBand(LO1.GetRegisters())) {
+		return FPGA::SettlingTime::us180;
+	}
+	if (filterChange || Divider(lastSource) != Divider(Source.GetRegisters())
+			|| Divider(lastLO) != Divider(LO1.GetRegisters())) {
+		return FPGA::SettlingTime::us60;
+	}
+	return FPGA::SettlingTime::us20;
+}
+
+// Finds the longest run of points starting at 'start' whose 1.IF frequencies fit into a window of their IF bandwidth
+// and returns the 2.LO frequency that centers the 2.IF in this window. Changes the PLL registers in RAM.
+static uint32_t PlanLO2(SweepPosition pos, uint32_t start, uint32_t end) {
+	uint32_t minIF = UINT32_MAX, maxIF = 0;
+	uint32_t bandwidth = UINT32_MAX;
+	for (uint32_t i = start; i < end; i++, NextPoint(pos)) {
+		uint32_t IF = ConfigurePLLs(pos.frequency);
+		uint32_t newMin = IF < minIF ? IF : minIF;
+		uint32_t newMax = IF > maxIF ? IF : maxIF;
+		uint32_t newBandwidth = segmentConfig[pos.segment].bandwidth;
+		if (newBandwidth > bandwidth) {
+			newBandwidth = bandwidth;
+		}
+		if (newMax - newMin > newBandwidth) {
+			break;
+		}
+		minIF = newMin;
+		maxIF = newMax;
+		bandwidth = newBandwidth;
+	}
+	return (minIF + maxIF) / 2 - HW::IF2;
+}
+
+// Number of points of the block starting at 'start'
+static uint32_t BlockLength(uint32_t start) {
+	uint32_t left = settings.points - start;
+	return left < blockPoints ? left : blockPoints;
+}
+
+// Returns the start of the block following the one starting at 'start'. The last block is followed by the first
+static uint32_t NextBlock(uint32_t start) {
+	start += blockPoints;
+	return start < settings.points ? start : 0;
+}
+
+// Configures the PLLs for the next point of the table writer and derives the table entry settings of the point
+static void PlanPoint() {
+	auto &w = writer;
+	uint64_t freq = w.pos.frequency;
+	auto &seg = segments[w.pos.segment];
+	auto &cfg = segmentConfig[w.pos.segment];
+	// SetFrequency only manipulates the register content in RAM, no SPI communication is done.
+	// No mode-switch of FPGA necessary here.
+
+	w.halt = false;
+	w.lowband = false;
+	if (freq < BandSwitchFrequency) {
+		// the lowband source is set in the halted callback, only necessary if the frequency changed
+		// (zero span and power sweeps stay at the same frequency)
+		w.halt = w.point == 0 || freq != w.lastFreq;
+		w.lowband = true;
+	}
+	if (w.lastLowband && !w.lowband) {
+		// additional halt before first highband point to enable highband source
+		w.halt = true;
+	}
+	uint32_t actualFirstIF = ConfigurePLLs(freq);
+	uint32_t actualFinalIF = actualFirstIF - w.LO2;
+	uint32_t IFdeviation = abs(actualFinalIF - HW::IF2);
+	bool needs_LO2_shift = false;
+	if(IFdeviation > cfg.bandwidth / 2) {
+		needs_LO2_shift = true;
+	}
+	if (settings.suppressPeaks && needs_LO2_shift) {
+		if (IFTableUsed < IFTableNumEntries) {
+			// still room in table
+			w.halt = true;
+			auto &entry = IFTable[IFTableWrite];
+			entry.point = w.point - w.blockStart;
+			entry.block = w.blockCnt & 0x01;
+			// Place the 2.LO in the center of the longest run of upcoming points it is able to cover.
+			// Each shift costs a halt and the 2.LO settling time, keep their number low
+			uint32_t end = settings.points;
+			if (blockPoints < settings.points && end - w.point > BlockedLO2PlanPoints) {
+				end = w.point + BlockedLO2PlanPoints;
+			}
+			w.LO2 = PlanLO2(w.pos, w.point, end);
+			// planning changed the PLL registers, restore them for the current point
+			ConfigurePLLs(freq);
+			LOG_INFO("Changing 2.LO to %lu at point %lu (%lu%06luHz) to reach correct 2.IF frequency",
+					w.LO2, w.point, (uint32_t ) (freq / 1000000),
+					(uint32_t ) (freq % 1000000));
+			// store calculated clock configuration for later change
+			Si5351.CalculateRawCLKConfig(w.LO2, Si5351C::PLL::B, entry.clkconfig);
+			IFTableWrite = (IFTableWrite + 1) % IFTableNumEntries;
+			// the halted interrupt of a running blocked sweep consumes entries concurrently
+			uint32_t primask = __get_PRIMASK();
+			__disable_irq();
+			IFTableUsed++;
+			__set_PRIMASK(primask);
+			w.LO2Shifts++;
+			needs_LO2_shift = false;
+		}
+	}
+	if(needs_LO2_shift) {
+		// if shift is still needed either peak suppression is disabled or no more room in IFTable was available
+		LOG_WARN(
+				"PLL deviation of %luHz for measurement at %lu%06luHz, will cause a peak",
+				IFdeviation, (uint32_t ) (freq / 1000000), (uint32_t ) (freq % 1000000));
+	}
+
+	// the segment settling time is the minimum, extend it if the PLLs need more time
+	w.settling = (FPGA::SettlingTime) seg.settlingTime;
+	w.filter = FPGA::SelectLowpass(freq);
+	// no previous point for the first point, the start of the sweep takes longer anyway
+	if (w.point > 0) {
+		auto required = RequiredSettlingTime(w.lastSourceRegs, w.lastLORegs, w.filter != w.lastFilter,
+				w.lowband != w.lastLowband);
+		if (required > w.settling) {
+			w.settling = required;
+			w.longSettlingPoints++;
+		}
+	}
+	memcpy(w.lastSourceRegs, Source.GetRegisters(), sizeof(w.lastSourceRegs));
+	memcpy(w.lastLORegs, LO1.GetRegisters(), sizeof(w.lastLORegs));
+	w.lastFilter = w.filter;
+
+	// the attenuator is switched together with the PLL registers of each point
+	w.attenuator = Attenuation(w.pos.cdbm);
+	w.lastLowband = w.lowband;
+	w.lastFreq = freq;
+	if (w.halt) {
+		w.halts++;
+	}
+	// every point is measured once per excited port
+	uint8_t ports = (settings.excitePort1 ? 1 : 0) + (settings.excitePort2 ? 1 : 0);
+	w.timeUs += ports * (averages * cfg.samplesPerPoint * 1000000ULL / HW::ADCSamplerate
+			+ SettlingTimesUs[(int) w.settling] + (averages - 1) * SettlingTimesUs[seg.settlingTime]);
+}
+
+// Plans the next sweep table entry of the table writer
+static void PlanEntry(PlannedEntry &e) {
+	auto &w = writer;
+	if (!w.planned) {
+		PlanPoint();
+		w.planned = true;
+	}
+	// repeated measurements of the same point do not halt, the PLLs are already settled
+	bool first = w.average == 0;
+	auto settling = first ? w.settling : (FPGA::SettlingTime) segments[w.pos.segment].settlingTime;
+	e.point = w.point - w.blockStart;
+	FPGA::EncodeSweepConfig(e.config, e.point * averages + w.average, w.lowband, Source.GetRegisters(),
+			LO1.GetRegisters(), w.attenuator, w.pos.frequency, settling, segmentConfig[w.pos.segment].samples,
+			first && w.halt, w.filter);
+	if (++w.average < averages) {
+		return;
+	}
+	// point complete, advance to the next one
+	w.average = 0;
+	w.planned = false;
+	w.point++;
+	if (w.point >= settings.points) {
+		// continue with the first point of the next sweep
+		w.point = 0;
+		FirstPoint(w.pos);
+	} else {
+		NextPoint(w.pos);
+	}
+	if (w.point == 0 || w.point - w.blockStart >= blockPoints) {
+		w.blockStart = w.point;
+		w.blockCnt++;
+	}
+}
+
+static uint16_t PlannedEntries() {
+	return (plannedWrite + PlannedNumEntries - plannedRead) % PlannedNumEntries;
+}
+
+// Plans entries of the next block until the FIFO is full or the next block has been planned completely
+static void FillPlannedEntries() {
+	while (PlannedEntries() < PlannedNumEntries - 1 && writer.blockStart == NextBlock(blockStart)) {
+		PlanEntry(planned[plannedWrite]);
+		plannedWrite = (plannedWrite + 1) % PlannedNumEntries;
+	}
+}
+
+// Checks whether the table entry of the oldest planned entry is not needed anymore by the block that is currently
+// measured
+static bool PlannedEntryFree() {
+	if (PlannedEntries() == 0) {
+		return false;
+	}
+	// entries of measured points and entries beyond the end of the current block (if it is shorter) are free
+	uint32_t index = planned[plannedRead].point;
+	return index < pointCnt - blockStart || index >= BlockLength(blockStart);
+}
+
+// Writes the oldest planned entry into the sweep table. Returns false if the SPI bus was busy
+static bool WritePlannedEntry() {
+	if (!FPGA::WriteSweepConfig(planned[plannedRead].config)) {
+		return false;
+	}
+	plannedRead = (plannedRead + 1) % PlannedNumEntries;
+	return true;
+}
+
+bool VNA::SetSegment(const Protocol::SweepSegment &segment) {
+	if (segment.index >= Protocol::MaxSweepSegments) {
+		LOG_ERR("Sweep segment %u out of range", segment.index);
+		return false;
+	}
+	// segments are used by the interrupts of an active sweep, stop it until the new sweep is set up
+	VNA::Stop();
+	segments[segment.index] = segment;
+	return true;
+}
+
+bool VNA::Setup(Protocol::SweepSettings s, SweepCallback cb, RawCallback rawCb) {
 	VNA::Stop();
 	vTaskDelay(5);
+	// only the setup itself, not the wait for the sweep to stop
+	Profiling::Scope profiling(Profiling::Section::VNASetup);
 	HW::SetMode(HW::Mode::VNA);
 	if(s.excitePort1 == 0 && s.excitePort2 == 0) {
 		// both ports disabled, nothing to do
@@ -47,120 +499,176 @@ bool VNA::Setup(Protocol::SweepSettings s, SweepCallback cb) {
 		active = false;
 		return false;
 	}
+	if (s.segments > Protocol::MaxSweepSegments) {
+		LOG_ERR("Too many sweep segments: %u", s.segments);
+		HW::SetIdle();
+		active = false;
+		return false;
+	}
+	if (s.zeroSpan) {
+		// CW measurement, every point of the sweep table uses the same frequency
+		s.f_stop = s.f_start;
+		s.logSweep = 0;
+		s.segments = 0;
+	}
 	sweepCallback = cb;
+	rawCallback = rawCb;
 	settings = s;
+	if (!rawCallback) {
+		settings.rawData = 0;
+	}
+	if (s.segments == 0) {
+		// normal sweep, convert to single segment
+		segments[0].index = 0;
+		segments[0].f_start = s.f_start;
+		segments[0].f_stop = s.f_stop;
+		segments[0].points = s.points;
+		segments[0].if_bandwidth = s.if_bandwidth;
+		segments[0].cdbm_excitation = s.cdbm_excitation;
+		segments[0].settlingTime = s.settlingTime;
+		segments[0].logSweep = s.logSweep;
+		numSegments = 1;
+	} else {
+		numSegments = s.segments;
+	}
+	uint32_t totalPoints = 0;
+	sourceHighPower = false;
+	for (uint8_t i = 0; i < numSegments; i++) {
+		totalPoints += segments[i].points;
+		if (s.powerSweep) {
+			// every segment is measured at a single frequency
+			segments[i].f_stop = segments[i].f_start;
+			segments[i].logSweep = 0;
+		} else if (segments[i].cdbm_excitation > -1000) {
+			sourceHighPower = true;
+		}
+	}
+	if (s.powerSweep && (s.cdbm_excitation > -1000 || s.cdbm_excitation_stop > -1000)) {
+		sourceHighPower = true;
+	}
+	if (totalPoints == 0) {
+		LOG_ERR("Sweep without points");
+		HW::SetIdle();
+		active = false;
+		return false;
+	}
+	for (uint8_t i = 0; i < numSegments; i++) {
+		if (segments[i].logSweep && segments[i].f_start == 0) {
+			// the frequency would stay at zero (or the step become infinite)
+			LOG_ERR("Logarithmic sweep starting at 0Hz");
+			HW::SetIdle();
+			active = false;
+			return false;
+		}
+	}
+	averages = s.averages > 1 ? s.averages : 1;
+	decimation = s.decimation > 1 ? s.decimation : 1;
 	// Abort possible active sweep first
 	FPGA::SetMode(FPGA::Mode::FPGA);
-	uint16_t points = settings.points <= FPGA::MaxPoints ? settings.points : FPGA::MaxPoints;
+	uint32_t points = totalPoints <= HW::MaxPoints ? totalPoints : HW::MaxPoints;
+	settings.points = points;
+	// averaged points are repeated in the sweep table. Longer sweeps are split into blocks of almost equal size,
+	// the last block is only slightly shorter than the others
+	uint32_t tablePoints = FPGA::MaxPoints / averages;
+	uint32_t blocks = (points + tablePoints - 1) / tablePoints;
+	blockPoints = (points + blocks - 1) / blocks;
+	blockStart = 0;
+	blockCnt = 0;
 	// Configure sweep
-	FPGA::SetNumberOfPoints(points);
-	uint32_t samplesPerPoint = (HW::ADCSamplerate / s.if_bandwidth);
+	FPGA::SetNumberOfPoints(blockPoints * averages);
+	uint32_t samplesPerPoint = (HW::ADCSamplerate / segments[0].if_bandwidth);
 	// round up to next multiple of 16 (16 samples are spread across 5 IF2 periods)
 	if(samplesPerPoint%16) {
 		samplesPerPoint += 16 - samplesPerPoint%16;
 	}
-	uint32_t actualBandwidth = HW::ADCSamplerate / samplesPerPoint;
 	// has to be one less than actual number of samples
 	FPGA::SetSamplesPerPoint(samplesPerPoint);
 
 	// Set level (not very accurate)
-	int16_t cdbm = s.cdbm_excitation;
-	if(cdbm > -1000) {
+	if(sourceHighPower) {
 		// use higher source power (approx 0dbm with no attenuation)
-		sourceHighPower = true;
 		Source.SetPowerOutA(MAX2871::Power::p5dbm, true);
 	} else {
 		// use lower source power (approx -10dbm with no attenuation)
-		sourceHighPower = false;
 		Source.SetPowerOutA(MAX2871::Power::n4dbm, true);
-		cdbm += 1000;
-	}
-	uint8_t attenuator;
-	if(cdbm >= 0) {
-		attenuator = 0;
-	} else if (cdbm <= -3175){
-		attenuator = 127;
-	} else {
-		attenuator = (-cdbm) / 25;
 	}
 	FPGA::WriteMAX2871Default(Source.GetRegisters());
 
-	uint32_t last_LO2 = HW::IF1 - HW::IF2;
-	Si5351.SetCLK(SiChannel::Port1LO2, last_LO2, Si5351C::PLL::B, Si5351C::DriveStrength::mA2);
-	Si5351.SetCLK(SiChannel::Port2LO2, last_LO2, Si5351C::PLL::B, Si5351C::DriveStrength::mA2);
-	Si5351.SetCLK(SiChannel::RefLO2, last_LO2, Si5351C::PLL::B, Si5351C::DriveStrength::mA2);
-	Si5351.ResetPLL(Si5351C::PLL::B);
-
-	IFTableIndexCnt = 0;
-
-	bool last_lowband = false;
-
-	// invalidate first entry of IFTable, preventing switing of 2.LO in halted callback
-	IFTable[0].pointCnt = 0xFFFF;
-
-	// Transfer PLL configuration to FPGA
-	for (uint16_t i = 0; i < points; i++) {
-		uint64_t freq = s.f_start + (s.f_stop - s.f_start) * i / (points - 1);
-		// SetFrequency only manipulates the register content in RAM, no SPI communication is done.
-		// No mode-switch of FPGA necessary here.
-
-		bool needs_halt = false;
-		uint64_t actualSourceFreq;
-		bool lowband = false;
-		if (freq < BandSwitchFrequency) {
-			needs_halt = true;
-			lowband = true;
-			actualSourceFreq = freq;
+	// Derive acquisition settings of all segments. The first segment uses the samples per point register,
+	// all other segments with a different IF bandwidth select one of the fixed sample counts
+	for (uint8_t i = 0; i < numSegments; i++) {
+		auto &seg = segments[i];
+		auto &cfg = segmentConfig[i];
+		if (seg.if_bandwidth == segments[0].if_bandwidth) {
+			cfg.samples = FPGA::Samples::SPPRegister;
+			cfg.samplesPerPoint = samplesPerPoint;
 		} else {
-			Source.SetFrequency(freq);
-			actualSourceFreq = Source.GetActualFrequency();
-		}
-		if (last_lowband && !lowband) {
-			// additional halt before first highband point to enable highband source
-			needs_halt = true;
+			cfg.samples = SamplesForBandwidth(seg.if_bandwidth, cfg.samplesPerPoint);
 		}
-		LO1.SetFrequency(freq + HW::IF1);
-		uint32_t actualFirstIF = LO1.GetActualFrequency() - actualSourceFreq;
-		uint32_t actualFinalIF = actualFirstIF - last_LO2;
-		uint32_t IFdeviation = abs(actualFinalIF - HW::IF2);
-		bool needs_LO2_shift = false;
-		if(IFdeviation > actualBandwidth / 2) {
-			needs_LO2_shift = true;
-		}
-		if (s.suppressPeaks && needs_LO2_shift) {
-			if (IFTableIndexCnt < IFTableNumEntries) {
-				// still room in table
-				needs_halt = true;
-				IFTable[IFTableIndexCnt].pointCnt = i;
-				// Configure LO2 for the changed IF1. This is not necessary right now but it will generate
-				// the correct clock settings
-				last_LO2 = actualFirstIF - HW::IF2;
-				LOG_INFO("Changing 2.LO to %lu at point %lu (%lu%06luHz) to reach correct 2.IF frequency",
-						last_LO2, i, (uint32_t ) (freq / 1000000),
-						(uint32_t ) (freq % 1000000));
-				Si5351.SetCLK(SiChannel::RefLO2, last_LO2,
-						Si5351C::PLL::B, Si5351C::DriveStrength::mA2);
-				// store calculated clock configuration for later change
-				Si5351.ReadRawCLKConfig(SiChannel::RefLO2, IFTable[IFTableIndexCnt].clkconfig);
-				IFTableIndexCnt++;
-				needs_LO2_shift = false;
-			}
-		}
-		if(needs_LO2_shift) {
-			// if shift is still needed either peak suppression is disabled or no more room in IFTable was available
-			LOG_WARN(
-					"PLL deviation of %luHz for measurement at %lu%06luHz, will cause a peak",
-					IFdeviation, (uint32_t ) (freq / 1000000), (uint32_t ) (freq % 1000000));
+		cfg.bandwidth = HW::ADCSamplerate / cfg.samplesPerPoint;
+		if (seg.logSweep && seg.points > 1) {
+			cfg.logStep = pow((double) seg.f_stop / seg.f_start, 1.0 / (seg.points - 1));
+		} else {
+			cfg.logStep = 1.0;
 		}
+	}
 
-		FPGA::WriteSweepConfig(i, lowband, Source.GetRegisters(),
-				LO1.GetRegisters(), attenuator, freq, FPGA::SettlingTime::us20,
-				FPGA::Samples::SPPRegister, needs_halt);
-		last_lowband = lowband;
+	uint32_t LO2 = HW::IF1 - HW::IF2;
+	if (s.zeroSpan) {
+		// the 2.LO never changes, place the 2.IF exactly at its nominal frequency from the start
+		LO2 = ConfigurePLLs(segments[0].f_start) - HW::IF2;
 	}
-	// revert clk configuration to previous value (might have been changed in sweep calculation)
-	Si5351.SetCLK(SiChannel::RefLO2, HW::IF1 - HW::IF2, Si5351C::PLL::B, Si5351C::DriveStrength::mA2);
+	Si5351.SetCLK(SiChannel::Port1LO2, LO2, Si5351C::PLL::B, Si5351C::DriveStrength::mA2);
+	Si5351.SetCLK(SiChannel::Port2LO2, LO2, Si5351C::PLL::B, Si5351C::DriveStrength::mA2);
+	Si5351.SetCLK(SiChannel::RefLO2, LO2, Si5351C::PLL::B, Si5351C::DriveStrength::mA2);
 	Si5351.ResetPLL(Si5351C::PLL::B);
+
+	IFTableRead = 0;
+	IFTableWrite = 0;
+	IFTableUsed = 0;
+
+	// Transfer PLL configuration of the first block to FPGA
+	FirstPoint(writer.pos);
+	writer.point = 0;
+	writer.blockStart = 0;
+	writer.blockCnt = 0;
+	writer.average = 0;
+	writer.planned = false;
+	writer.lastLowband = false;
+	writer.lastFreq = 0;
+	writer.lastFilter = FPGA::LowpassFilter::Auto;
+	writer.LO2 = LO2;
+	writer.halts = 0;
+	writer.LO2Shifts = 0;
+	writer.longSettlingPoints = 0;
+	writer.timeUs = 0;
+	plannedRead = 0;
+	plannedWrite = 0;
+	blockComplete = false;
+	refillRequested = false;
+	for (uint32_t i = 0; i < blockPoints * averages; i++) {
+		PlannedEntry e;
+		PlanEntry(e);
+		FPGA::WriteSweepConfig(e.config);
+	}
+	IFTableSweepEntries = IFTableUsed;
+	// estimate sweep time
+	uint64_t sweepTimeUs = writer.timeUs + (uint64_t) writer.halts * HaltOverheadUs
+			+ (uint64_t) writer.LO2Shifts * LO2SettlingTimeUs;
+	if (blocks > 1) {
+		// only the first block has been planned yet
+		sweepTimeUs = sweepTimeUs * points / blockPoints;
+	}
+	if (segments[0].f_start < BandSwitchFrequency) {
+		// enabling the lowband source
+		sweepTimeUs += LO2SettlingTimeUs;
+	}
+	LOG_INFO("Sweep planned with %u segments in %lu blocks, first block: %lu 2.LO shifts, %lu halts and %lu points with extended settling, predicted sweep time: %lums",
+			numSegments, blocks, writer.LO2Shifts, writer.halts, writer.longSettlingPoints, (uint32_t) (sweepTimeUs / 1000));
+	if (blocks > 1) {
+		// start planning the next block
+		FillPlannedEntries();
+	}
 	// Enable mixers/amplifier/PLLs
 	FPGA::SetWindow(FPGA::Window::None);
 	FPGA::Enable(FPGA::Periphery::Port1Mixer);
@@ -175,9 +683,13 @@ bool VNA::Setup(Protocol::SweepSettings s, SweepCallback cb) {
 	FPGA::Enable(FPGA::Periphery::ExcitePort2, s.excitePort2);
 	FPGA::Enable(FPGA::Periphery::PortSwitch);
 	pointCnt = 0;
+	averageCnt = 0;
+	sweepOverload = false;
+	FPGA::ResetADCLimits();
+	FirstPoint(sweepPosition);
 	// starting port depends on whether port 1 is active in sweep
 	excitingPort1 = s.excitePort1;
-	IFTableIndexCnt = 0;
+	ResetTimestamp();
 	active = true;
 	// Start the sweep
 	FPGA::StartSweep();
@@ -190,28 +702,92 @@ static void PassOnData() {
 	}
 }
 
+static void PassOnRawData() {
+	// The limits are read once per transmitted point, they cover all measurements since the previously transmitted
+	// point (including averaged and decimated points). If a sample read occupies the SPI bus, the limits are kept
+	// and reported with the next point
+	FPGA::ADCLimits limits;
+	rawData.port1Overload = rawData.port2Overload = rawData.refOverload = 0;
+	if (FPGA::ReadAndResetADCLimits(limits)) {
+		constexpr int16_t limit = FPGA::ADCOverloadLimit;
+		rawData.port1Overload = limits.P1min < -limit || limits.P1max > limit;
+		rawData.port2Overload = limits.P2min < -limit || limits.P2max > limit;
+		rawData.refOverload = limits.Rmin < -limit || limits.Rmax > limit;
+		if (rawData.port1Overload || rawData.port2Overload || rawData.refOverload) {
+			sweepOverload = true;
+		}
+	}
+	if (rawCallback) {
+		rawCallback(rawData);
+	}
+}
+
+static void AccumulateRaw(const FPGA::SamplingResult &result) {
+	auto &sum = rawSum[excitingPort1 ? 0 : 1];
+	if (averageCnt == 0) {
+		sum = result;
+	} else {
+		sum.P1I += result.P1I;
+		sum.P1Q += result.P1Q;
+		sum.P2I += result.P2I;
+		sum.P2Q += result.P2Q;
+		sum.RefI += result.RefI;
+		sum.RefQ += result.RefQ;
+	}
+}
+
+static void CompileRawData() {
+	rawData.pointNum = pointCnt / decimation;
+	rawData.frequency = sweepPosition.frequency;
+	rawData.cdbm = sweepPosition.cdbm;
+	rawData.excitePort1 = settings.excitePort1;
+	rawData.excitePort2 = settings.excitePort2;
+	for (uint8_t i = 0; i < 2; i++) {
+		// averaged sums stay within the 48 bit range of a single measurement
+		auto &e = rawData.excitation[i];
+		e.P1I = rawSum[i].P1I / averages;
+		e.P1Q = rawSum[i].P1Q / averages;
+		e.P2I = rawSum[i].P2I / averages;
+		e.P2Q = rawSum[i].P2Q / averages;
+		e.RefI = rawSum[i].RefI / averages;
+		e.RefQ = rawSum[i].RefQ / averages;
+	}
+}
+
 bool VNA::MeasurementDone(const FPGA::SamplingResult &result) {
+	Profiling::Scope profiling(Profiling::Section::MeasurementDone);
 	if(!active) {
 		return false;
 	}
-	// normal sweep mode
-	auto port1_raw = std::complex<float>(result.P1I, result.P1Q);
-	auto port2_raw = std::complex<float>(result.P2I, result.P2Q);
-	auto ref = std::complex<float>(result.RefI, result.RefQ);
-	auto port1 = port1_raw / ref;
-	auto port2 = port2_raw / ref;
-	data.pointNum = pointCnt;
-	data.frequency = settings.f_start + (settings.f_stop - settings.f_start) * pointCnt / (settings.points - 1);
-	if(excitingPort1) {
-		data.real_S11 = port1.real();
-		data.imag_S11 = port1.imag();
-		data.real_S21 = port2.real();
-		data.imag_S21 = port2.imag();
+	measurementCnt++;
+	if (settings.rawData) {
+		// ratios are calculated by the host
+		AccumulateRaw(result);
 	} else {
-		data.real_S12 = port1.real();
-		data.imag_S12 = port1.imag();
-		data.real_S22 = port2.real();
-		data.imag_S22 = port2.imag();
+		// normal sweep mode
+		auto port1_raw = std::complex<float>(result.P1I, result.P1Q);
+		auto port2_raw = std::complex<float>(result.P2I, result.P2Q);
+		auto ref = std::complex<float>(result.RefI, result.RefQ);
+		auto port1 = port1_raw / ref;
+		auto port2 = port2_raw / ref;
+		if (averageCnt == 0) {
+			// first measurement of this point
+			if (excitingPort1) {
+				sumS11 = port1;
+				sumS21 = port2;
+			} else {
+				sumS12 = port1;
+				sumS22 = port2;
+			}
+		} else {
+			if (excitingPort1) {
+				sumS11 += port1;
+				sumS21 += port2;
+			} else {
+				sumS12 += port1;
+				sumS22 += port2;
+			}
+		}
 	}
 	// figure out whether this sweep point is complete and which port gets excited next
 	bool pointComplete = false;
@@ -224,21 +800,107 @@ bool VNA::MeasurementDone(const FPGA::SamplingResult &result) {
 		// only one port active, point is complete after every measurement
 		pointComplete = true;
 	}
+	if(pointComplete && ++averageCnt < averages) {
+		// point is measured again
+		pointComplete = false;
+	}
 	if(pointComplete) {
-		STM::DispatchToInterrupt(PassOnData);
+		averageCnt = 0;
+		// also updated for points that are not transmitted to keep track of cycle counter overflows
+		uint32_t us = Timestamp();
+		if (pointCnt % decimation == 0) {
+			if (settings.rawData) {
+				CompileRawData();
+				rawData.us = us;
+				STM::DispatchToInterrupt(PassOnRawData);
+			} else {
+				data.pointNum = pointCnt / decimation;
+				data.frequency = sweepPosition.frequency;
+				data.us = us;
+				data.cdbm = sweepPosition.cdbm;
+				if (settings.excitePort1) {
+					data.real_S11 = sumS11.real() / averages;
+					data.imag_S11 = sumS11.imag() / averages;
+					data.real_S21 = sumS21.real() / averages;
+					data.imag_S21 = sumS21.imag() / averages;
+				}
+				if (settings.excitePort2) {
+					data.real_S12 = sumS12.real() / averages;
+					data.imag_S12 = sumS12.imag() / averages;
+					data.real_S22 = sumS22.real() / averages;
+					data.imag_S22 = sumS22.imag() / averages;
+				}
+				STM::DispatchToInterrupt(PassOnData);
+			}
+		}
 		pointCnt++;
-		if (pointCnt >= settings.points) {
-			// reached end of sweep, start again
-			pointCnt = 0;
-			IFTableIndexCnt = 0;
+		NextPoint(sweepPosition);
+		bool needs_work = false;
+		if (blockPoints < settings.points) {
+			// refill the table entries of measured points with the next block. Writing up to two points per
+			// measured point catches up with the slightly shorter last block
+			for (uint16_t i = 0; i < 2 * averages && PlannedEntryFree(); i++) {
+				if (!WritePlannedEntry()) {
+					break;
+				}
+			}
+			if (PlannedEntries() < PlannedNumEntries / 2 && !refillRequested) {
+				// let the work function plan more entries
+				refillRequested = true;
+				needs_work = true;
+			}
+		}
+		if (pointCnt >= blockStart + BlockLength(blockStart)) {
+			if (pointCnt >= settings.points) {
+				// reached end of sweep, start again
+				pointCnt = 0;
+				FirstPoint(sweepPosition);
+				if (blockPoints >= settings.points) {
+					// the IF table entries are used again in the next sweep
+					IFTableRead = 0;
+					IFTableUsed = IFTableSweepEntries;
+				}
+			}
+			blockComplete = true;
 			// request to trigger work function
 			return true;
 		}
+		return needs_work;
 	}
 	return false;
 }
 
 void VNA::Work() {
+	if(!active) {
+		return;
+	}
+	if (blockPoints < settings.points) {
+		refillRequested = false;
+		if (!blockComplete) {
+			// the measurement interrupt is running low on planned entries
+			FillPlannedEntries();
+			return;
+		}
+		blockComplete = false;
+		// end of block, the next block has usually been written almost completely during the measurement.
+		// The sweep is stopped, write the remaining entries directly
+		while (PlannedEntries() > 0 || writer.blockStart == NextBlock(blockStart)) {
+			FillPlannedEntries();
+			if (!WritePlannedEntry()) {
+				LOG_ERR("Failed to write sweep table");
+				break;
+			}
+		}
+		blockStart = NextBlock(blockStart);
+		blockCnt++;
+		FPGA::SetNumberOfPoints(BlockLength(blockStart) * averages);
+		if (blockStart > 0) {
+			// continue the sweep with the next block
+			FPGA::StartSweep();
+			FillPlannedEntries();
+			return;
+		}
+	}
 	// end of sweep
 	HW::Ref::update();
 	// Compile info packet
@@ -249,30 +911,37 @@ void VNA::Work() {
 	packet.info.FW_minor = FW_MINOR;
 	packet.info.HW_Revision = HW_REVISION;
 	HW::fillDeviceInfo(&packet.info);
+	if (sweepOverload) {
+		packet.info.ADC_overload = true;
+		sweepOverload = false;
+	}
 	Communication::Send(packet);
 	FPGA::ResetADCLimits();
 	// Start next sweep
 	FPGA::StartSweep();
+	if (blockPoints < settings.points) {
+		FillPlannedEntries();
+	}
 }
 
 void VNA::SweepHalted() {
+	Profiling::Scope profiling(Profiling::Section::SweepHalted);
 	if(!active) {
 		return;
 	}
-	LOG_DEBUG("Halted before point %d", pointCnt);
+	LOG_DEBUG("Halted before point %lu", pointCnt);
 	// Check if IF table has entry at this point
-	if (IFTable[IFTableIndexCnt].pointCnt == pointCnt) {
-		Si5351.WriteRawCLKConfig(SiChannel::Port1LO2, IFTable[IFTableIndexCnt].clkconfig);
-		Si5351.WriteRawCLKConfig(SiChannel::Port2LO2, IFTable[IFTableIndexCnt].clkconfig);
-		Si5351.WriteRawCLKConfig(SiChannel::RefLO2, IFTable[IFTableIndexCnt].clkconfig);
+	auto &entry = IFTable[IFTableRead];
+	if (IFTableUsed > 0 && entry.point == pointCnt - blockStart && entry.block == (blockCnt & 0x01)) {
+		Si5351.WriteRawCLKConfig(SiChannel::Port1LO2, entry.clkconfig);
+		Si5351.WriteRawCLKConfig(SiChannel::Port2LO2, entry.clkconfig);
+		Si5351.WriteRawCLKConfig(SiChannel::RefLO2, entry.clkconfig);
 		Si5351.ResetPLL(Si5351C::PLL::B);
-		IFTableIndexCnt++;
-		// PLL reset causes the 2.LO to turn off briefly and then ramp on back, needs delay before next point
-		Delay::us(1300);
+		IFTableRead = (IFTableRead + 1) % IFTableNumEntries;
+		IFTableUsed--;
+		Delay::us(LO2SettlingTimeUs);
 	}
-	uint64_t frequency = settings.f_start
-			+ (settings.f_stop - settings.f_start) * pointCnt
-					/ (settings.points - 1);
+	uint64_t frequency = sweepPosition.frequency;
 	if (frequency < BandSwitchFrequency) {
 		// need the Si5351 as Source
 		Si5351.SetCLK(SiChannel::LowbandSource, frequency, Si5351C::PLL::B,
@@ -281,7 +950,7 @@ void VNA::SweepHalted() {
 			// First point in sweep, enable CLK
 			Si5351.Enable(SiChannel::LowbandSource);
 			FPGA::Disable(FPGA::Periphery::SourceRF);
-			Delay::us(1300);
+			Delay::us(LO2SettlingTimeUs);
 		}
 	} else if(!FPGA::IsEnabled(FPGA::Periphery::SourceRF)){
 		// first sweep point in highband is also halted, disable lowband source
@@ -292,6 +961,10 @@ void VNA::SweepHalted() {
 	FPGA::ResumeHaltedSweep();
 }
 
+uint32_t VNA::MeasurementCount() {
+	return measurementCnt;
+}
+
 void VNA::Stop() {
 	active = false;
 	FPGA::AbortSweep();
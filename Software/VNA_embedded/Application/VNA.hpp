@@ -7,12 +7,17 @@
 namespace VNA {
 
 using SweepCallback = void(*)(const Protocol::Datapoint&);
+using RawCallback = void(*)(const Protocol::RawDatapoint&);
 
-bool Setup(Protocol::SweepSettings s, SweepCallback cb);
+bool SetSegment(const Protocol::SweepSegment &segment);
+bool Setup(Protocol::SweepSettings s, SweepCallback cb, RawCallback rawCb = nullptr);
 bool MeasurementDone(const FPGA::SamplingResult &result);
 void Work();
 void SweepHalted();
 void Stop();
+// Number of completed measurements, also counts the measurements of averaged and decimated points that are not
+// transmitted. Only the changes are meaningful, the counter is not reset
+uint32_t MeasurementCount();
 
 }
 
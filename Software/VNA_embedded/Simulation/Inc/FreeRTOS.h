@@ -0,0 +1,16 @@
+#pragma once
+
+// Stand-in for the FreeRTOS kernel header, the simulation runs everything in a single thread
+#include <stdint.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE		((BaseType_t) 0)
+#define pdTRUE		((BaseType_t) 1)
+#define pdPASS		(pdTRUE)
+#define pdFAIL		(pdFALSE)
+
+#define portMAX_DELAY	((TickType_t) 0xffffffffUL)
+#define portYIELD_FROM_ISR(x)	((void) (x))
@@ -0,0 +1,4 @@
+#pragma once
+
+// Stand-in for the device header, all required definitions are part of the simulated HAL
+#include "stm32g4xx_hal.h"
@@ -0,0 +1,179 @@
+#pragma once
+
+/*
+ * Minimal stand-in for the STM32G4 HAL used by the host simulation. Only the types, defines and
+ * functions used by the application modules are provided. The peripheral handles carry no state,
+ * the simulated chips are implemented in the Simulation directory.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	HAL_OK = 0x00,
+	HAL_ERROR = 0x01,
+	HAL_BUSY = 0x02,
+	HAL_TIMEOUT = 0x03,
+} HAL_StatusTypeDef;
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * Writes to BSRR are forwarded to the simulation (chip selects, PLL latch enables, etc.). IDR holds
+ * the input levels driven by the simulated chips, ODR the output levels set by the firmware
+ */
+struct SimGPIO {
+	struct BSRRRegister {
+		void operator=(uint32_t value);
+	} BSRR;
+	volatile uint32_t IDR;
+	volatile uint32_t ODR;
+};
+typedef struct SimGPIO GPIO_TypeDef;
+
+// The cycle counter is backed by the host clock (nanoseconds, see SystemCoreClock)
+struct SimCycleCounter {
+	operator uint32_t() const;
+	void operator=(uint32_t value);
+};
+struct SimDWT {
+	volatile uint32_t CTRL;
+	SimCycleCounter CYCCNT;
+};
+struct SimCoreDebug {
+	volatile uint32_t DEMCR;
+};
+extern SimDWT SimDWTUnit;
+extern SimCoreDebug SimCoreDebugUnit;
+#define DWT							(&SimDWTUnit)
+#define CoreDebug					(&SimCoreDebugUnit)
+#define DWT_CTRL_CYCCNTENA_Msk		0x00000001u
+#define CoreDebug_DEMCR_TRCENA_Msk	0x01000000u
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	uint32_t Pin;
+	uint32_t Mode;
+	uint32_t Pull;
+	uint32_t Speed;
+	uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+extern GPIO_TypeDef SimGPIOA, SimGPIOB, SimGPIOF;
+#define GPIOA	(&SimGPIOA)
+#define GPIOB	(&SimGPIOB)
+#define GPIOF	(&SimGPIOF)
+
+#define GPIO_PIN_0		((uint16_t)0x0001)
+#define GPIO_PIN_1		((uint16_t)0x0002)
+#define GPIO_PIN_2		((uint16_t)0x0004)
+#define GPIO_PIN_3		((uint16_t)0x0008)
+#define GPIO_PIN_4		((uint16_t)0x0010)
+#define GPIO_PIN_5		((uint16_t)0x0020)
+#define GPIO_PIN_6		((uint16_t)0x0040)
+#define GPIO_PIN_7		((uint16_t)0x0080)
+#define GPIO_PIN_8		((uint16_t)0x0100)
+#define GPIO_PIN_9		((uint16_t)0x0200)
+#define GPIO_PIN_10		((uint16_t)0x0400)
+#define GPIO_PIN_11		((uint16_t)0x0800)
+#define GPIO_PIN_12		((uint16_t)0x1000)
+#define GPIO_PIN_13		((uint16_t)0x2000)
+#define GPIO_PIN_14		((uint16_t)0x4000)
+#define GPIO_PIN_15		((uint16_t)0x8000)
+
+#define GPIO_MODE_OUTPUT_PP		0x00000001u
+#define GPIO_SPEED_HIGH			0x00000002u
+
+typedef struct {
+	volatile uint32_t CR1;
+	volatile uint32_t CR2;
+	volatile uint32_t SR;
+	volatile uint32_t DR;
+} SPI_TypeDef;
+
+typedef struct {
+	SPI_TypeDef *Instance;
+} SPI_HandleTypeDef;
+
+typedef enum {
+	HAL_SPI_STATE_RESET = 0x00,
+	HAL_SPI_STATE_READY = 0x01,
+	HAL_SPI_STATE_BUSY = 0x02,
+} HAL_SPI_StateTypeDef;
+
+#define SPI_CR1_BR_Msk				0x00000038u
+#define SPI_BAUDRATEPRESCALER_2		0x00000000u
+#define SPI_BAUDRATEPRESCALER_4		0x00000008u
+#define SPI_BAUDRATEPRESCALER_8		0x00000010u
+#define SPI_BAUDRATEPRESCALER_16	0x00000018u
+
+typedef struct {
+	uint32_t dummy;
+} I2C_HandleTypeDef;
+
+typedef struct {
+	uint32_t dummy;
+} ADC_HandleTypeDef;
+
+#define I2C_MEMADD_SIZE_8BIT	0x00000001u
+
+typedef struct {
+	volatile uint32_t ICSR;
+} SCB_Type;
+extern SCB_Type SimSCB;
+#define SCB							(&SimSCB)
+#define SCB_ICSR_VECTACTIVE_Msk		0x1FFu
+
+extern uint16_t SimTempCal[2];
+#define TEMPSENSOR_CAL1_ADDR	(&SimTempCal[0])
+#define TEMPSENSOR_CAL2_ADDR	(&SimTempCal[1])
+#define TEMPSENSOR_CAL1_TEMP	30
+#define TEMPSENSOR_CAL2_TEMP	130
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData, uint16_t Size,
+		uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData,
+		uint16_t Size);
+HAL_SPI_StateTypeDef HAL_SPI_GetState(SPI_HandleTypeDef *hspi);
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef *hspi);
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi);
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+
+HAL_StatusTypeDef HAL_ADC_Start(ADC_HandleTypeDef *hadc);
+HAL_StatusTypeDef HAL_ADC_PollForConversion(ADC_HandleTypeDef *hadc, uint32_t Timeout);
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef *hadc);
+
+extern uint32_t SystemCoreClock;
+
+// Interrupts are never preempted in the simulation
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+static inline uint32_t __get_PRIMASK(void) {
+	return 0;
+}
+static inline void __set_PRIMASK(uint32_t) {}
+
+#ifdef __cplusplus
+}
+#endif
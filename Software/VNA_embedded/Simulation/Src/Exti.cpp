@@ -0,0 +1,60 @@
+#include "Exti.hpp"
+
+#include "Sim.hpp"
+
+using Entry  = struct {
+	GPIO_TypeDef *gpio;
+	Exti::EdgeType edge;
+	Exti::Callback cb;
+	void *ptr;
+};
+
+static constexpr uint8_t MaxEntries = 16;
+
+static Entry entries[MaxEntries];
+
+void Exti::Init() {
+	for (uint8_t i = 0; i < MaxEntries; i++) {
+		entries[i].gpio = nullptr;
+		entries[i].cb = nullptr;
+		entries[i].ptr = nullptr;
+	}
+}
+
+bool Exti::SetCallback(GPIO_TypeDef *gpio, uint16_t pin, EdgeType edge,
+		Pull pull, Callback cb, void *ptr) {
+	uint8_t index = 31 - __builtin_clz(pin);
+	if (entries[index].gpio && entries[index].gpio != gpio) {
+		return false;
+	}
+	entries[index].gpio = gpio;
+	entries[index].edge = edge;
+	entries[index].cb = cb;
+	entries[index].ptr = ptr;
+	return true;
+}
+
+bool Exti::ClearCallback(GPIO_TypeDef *gpio, uint16_t pin) {
+	uint8_t index = 31 - __builtin_clz(pin);
+	if (entries[index].gpio) {
+		if (gpio != entries[index].gpio) {
+			return false;
+		}
+	}
+	entries[index].gpio = nullptr;
+	entries[index].cb = nullptr;
+	entries[index].ptr = nullptr;
+	return true;
+}
+
+// Called by the simulated GPIO inputs, already in interrupt context
+void Sim::GPIO::ExtiEdge(GPIO_TypeDef *gpio, uint16_t pin, bool rising) {
+	uint8_t index = 31 - __builtin_clz(pin);
+	auto &e = entries[index];
+	if (e.gpio != gpio || !e.cb) {
+		return;
+	}
+	if (e.edge == Exti::EdgeType::Both || (e.edge == Exti::EdgeType::Rising) == rising) {
+		e.cb(e.ptr);
+	}
+}
@@ -0,0 +1,74 @@
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "Sim.hpp"
+
+// There is only the one simulated task (the harness), its handle is a dummy value
+static uint8_t task;
+static uint32_t notificationValue = 0;
+static bool notificationPending = false;
+
+static bool NotificationPending() {
+	return notificationPending;
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay) {
+	Sim::Advance((uint64_t) xTicksToDelay * 1000000ULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+	return &task;
+}
+
+void vTaskSuspend(TaskHandle_t) {
+}
+
+void vTaskResume(TaskHandle_t) {
+}
+
+BaseType_t xTaskNotify(TaskHandle_t, uint32_t ulValue, eNotifyAction eAction) {
+	switch (eAction) {
+	case eSetBits:
+		notificationValue |= ulValue;
+		break;
+	case eIncrement:
+		notificationValue++;
+		break;
+	case eSetValueWithOverwrite:
+	case eSetValueWithoutOverwrite:
+		notificationValue = ulValue;
+		break;
+	default:
+		break;
+	}
+	notificationPending = true;
+	return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction,
+		BaseType_t *pxHigherPriorityTaskWoken) {
+	if (pxHigherPriorityTaskWoken) {
+		*pxHigherPriorityTaskWoken = pdTRUE;
+	}
+	return xTaskNotify(xTaskToNotify, ulValue, eAction);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit,
+		uint32_t *pulNotificationValue, TickType_t xTicksToWait) {
+	if (!notificationPending) {
+		notificationValue &= ~ulBitsToClearOnEntry;
+	}
+	uint64_t limit = Sim::Now() + (uint64_t) xTicksToWait * 1000000ULL;
+	if (xTicksToWait == portMAX_DELAY) {
+		limit = UINT64_MAX;
+	}
+	if (!Sim::RunUntil(limit, NotificationPending)) {
+		return pdFALSE;
+	}
+	if (pulNotificationValue) {
+		*pulNotificationValue = notificationValue;
+	}
+	notificationValue &= ~ulBitsToClearOnExit;
+	notificationPending = false;
+	return pdTRUE;
+}
@@ -0,0 +1,213 @@
+#include "stm32g4xx_hal.h"
+#include "main.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Sim.hpp"
+
+GPIO_TypeDef SimGPIOA, SimGPIOB, SimGPIOF;
+SimDWT SimDWTUnit;
+SimCoreDebug SimCoreDebugUnit;
+uint32_t SystemCoreClock = 1000000000;
+static uint32_t cycleCounterOffset;
+uint16_t SimTempCal[2] = {1000, 1300};
+
+static SPI_TypeDef SPI1, SPI2;
+SPI_HandleTypeDef hspi1 = {&SPI1};
+SPI_HandleTypeDef hspi2 = {&SPI2};
+I2C_HandleTypeDef hi2c2;
+ADC_HandleTypeDef hadc1;
+
+static HAL_SPI_StateTypeDef spi1State = HAL_SPI_STATE_READY;
+
+// SPI1/2 are clocked with 128MHz, the BR bits of CR1 select the prescaler
+static constexpr uint64_t SPIKernelClock = 128000000;
+// I2C in fast mode, 9 bit times per byte
+static constexpr uint64_t I2CNsPerByte = 9 * 1000000000ULL / 400000;
+
+void SimGPIO::BSRRRegister::operator=(uint32_t value) {
+	// BSRR is the first member, this is the port itself
+	auto port = reinterpret_cast<GPIO_TypeDef*>(this);
+	uint32_t oldODR = port->ODR;
+	uint32_t newODR = (oldODR | (value & 0xFFFF)) & ~(value >> 16);
+	port->ODR = newODR;
+	if (oldODR != newODR) {
+		Sim::GPIO::Changed(port, oldODR, newODR);
+	}
+}
+
+static uint32_t HostNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SimCycleCounter::operator uint32_t() const {
+	return HostNs() - cycleCounterOffset;
+}
+
+void SimCycleCounter::operator=(uint32_t value) {
+	cycleCounterOffset = HostNs() - value;
+}
+
+void Sim::GPIO::SetInput(GPIO_TypeDef *port, uint16_t pin, bool high) {
+	bool wasHigh = port->IDR & pin;
+	if (high) {
+		port->IDR |= pin;
+	} else {
+		port->IDR &= ~pin;
+	}
+	if (wasHigh != high) {
+		ExtiEdge(port, pin, high);
+	}
+}
+
+void Sim::GPIO::Changed(GPIO_TypeDef *port, uint32_t oldODR, uint32_t newODR) {
+	if (port != FPGA_CS_GPIO_Port) {
+		return;
+	}
+	uint32_t changed = oldODR ^ newODR;
+	bool aux1 = newODR & FPGA_AUX1_Pin;
+	bool aux2 = newODR & FPGA_AUX2_Pin;
+	if (changed & FPGA_CS_Pin) {
+		bool high = newODR & FPGA_CS_Pin;
+		// the FPGA passes the chip select on to the PLLs as latch enable
+		if (aux1) {
+			if (high) {
+				PLL::Latch(PLL::Chip::Source);
+			}
+		} else if (aux2) {
+			if (high) {
+				PLL::Latch(PLL::Chip::LO1);
+			}
+		} else {
+			FPGA::Select(!high);
+		}
+	}
+	if (changed & FPGA_AUX3_Pin) {
+		FPGA::SweepControl(newODR & FPGA_AUX3_Pin);
+	}
+}
+
+uint64_t Sim::SPI::TransferTimeNs(SPI_HandleTypeDef *hspi, uint16_t len) {
+	uint32_t prescaler = 2 << ((hspi->Instance->CR1 & SPI_CR1_BR_Msk) >> 3);
+	return (uint64_t) len * 8 * 1000000000ULL * prescaler / SPIKernelClock;
+}
+
+void Sim::SPI::Transfer(SPI_HandleTypeDef *hspi, const uint8_t *tx, uint8_t *rx, uint16_t len) {
+	if (rx) {
+		for (uint16_t i = 0; i < len; i++) {
+			rx[i] = 0xFF;
+		}
+	}
+	if (hspi == &hspi1) {
+		if (!(FLASH_CS_GPIO_Port->ODR & FLASH_CS_Pin)) {
+			// no flash chip in the simulation, MISO stays high
+		} else if (FPGA_AUX1_GPIO_Port->ODR & FPGA_AUX1_Pin) {
+			PLL::Data(PLL::Chip::Source, tx, rx, len);
+		} else if (FPGA_AUX2_GPIO_Port->ODR & FPGA_AUX2_Pin) {
+			PLL::Data(PLL::Chip::LO1, tx, rx, len);
+		} else if (!(FPGA_CS_GPIO_Port->ODR & FPGA_CS_Pin)) {
+			FPGA::Data(tx, rx, len);
+		}
+	}
+	Advance(TransferTimeNs(hspi, len));
+}
+
+uint32_t HAL_GetTick(void) {
+	return Sim::Now() / 1000000ULL;
+}
+
+void HAL_Delay(uint32_t Delay) {
+	Sim::Advance((uint64_t) Delay * 1000000ULL);
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef*, GPIO_InitTypeDef*) {
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t) {
+	Sim::SPI::Transfer(hspi, pData, nullptr, Size);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t) {
+	Sim::SPI::Transfer(hspi, nullptr, pData, Size);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData, uint16_t Size,
+		uint32_t) {
+	Sim::SPI::Transfer(hspi, pTxData, pRxData, Size);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size) {
+	// only used for the flash which is not part of the simulation, completes immediately
+	Sim::SPI::Transfer(hspi, nullptr, pData, Size);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData,
+		uint16_t Size) {
+	if (spi1State != HAL_SPI_STATE_READY) {
+		return HAL_BUSY;
+	}
+	// Data is exchanged right away but the completion interrupt is only raised after the transfer time.
+	// Transfer() must not advance the clock here (it may be called from thread context)
+	if (!(FPGA_CS_GPIO_Port->ODR & FPGA_CS_Pin)) {
+		Sim::FPGA::Data(pTxData, pRxData, Size);
+	}
+	spi1State = HAL_SPI_STATE_BUSY;
+	Sim::Schedule(Sim::Now() + Sim::SPI::TransferTimeNs(hspi, Size), [hspi]() {
+		spi1State = HAL_SPI_STATE_READY;
+		HAL_SPI_TxRxCpltCallback(hspi);
+	});
+	return HAL_OK;
+}
+
+HAL_SPI_StateTypeDef HAL_SPI_GetState(SPI_HandleTypeDef *hspi) {
+	if (hspi == &hspi1) {
+		return spi1State;
+	}
+	return HAL_SPI_STATE_READY;
+}
+
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef *hspi) {
+	// only used for the flash, its transfers complete immediately
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef*, uint16_t, uint16_t MemAddress,
+		uint16_t, uint8_t *pData, uint16_t Size, uint32_t) {
+	// the Si5351 is the only device on the bus
+	Sim::Si5351::Write(MemAddress, pData, Size);
+	Sim::Advance((2 + Size) * I2CNsPerByte);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef*, uint16_t, uint16_t MemAddress,
+		uint16_t, uint8_t *pData, uint16_t Size, uint32_t) {
+	Sim::Si5351::Read(MemAddress, pData, Size);
+	Sim::Advance((3 + Size) * I2CNsPerByte);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start(ADC_HandleTypeDef*) {
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_PollForConversion(ADC_HandleTypeDef*, uint32_t) {
+	Sim::Advance(10000);
+	return HAL_OK;
+}
+
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef*) {
+	// approximately 35°C
+	return 1015;
+}
+
+void Error_Handler(void) {
+	fprintf(stderr, "Error_Handler called\n");
+	abort();
+}
@@ -0,0 +1,53 @@
+#include "Log.h"
+#include "LogRecord.hpp"
+
+#include <cstdarg>
+#include <cstdio>
+
+#include "stm.hpp"
+#include "Sim.hpp"
+
+// Log output goes to stderr, keeping stdout free for the simulation results
+static bool enabled = true;
+
+void Log_Init() {
+}
+
+void Log_SetRedirect(log_redirect_t) {
+}
+
+void Log_Flush() {
+}
+
+void Log_RedirectComplete() {
+}
+
+void Log_SendFormat(uint16_t) {
+}
+
+// Deferred entries are formatted right away, using the same code as the host application
+void _log_entry(const log_format_t *format, uint16_t *, const uint8_t *args, uint8_t length) {
+	if (!enabled) {
+		return;
+	}
+	char text[256];
+	LogRecord::Format(format->fmt, args, length, text, sizeof(text));
+	fprintf(stderr, "%05lu [%6.6s,%s]: %s\n", (unsigned long) HAL_GetTick(), format->module,
+			LogRecord::LevelName(format->level), text);
+}
+
+void _log_write(const char *module, const char *level, const char *fmt, ...) {
+	if (!enabled) {
+		return;
+	}
+	va_list args;
+	va_start(args, fmt);
+	fprintf(stderr, "%05lu [%6.6s,%s]: ", (unsigned long) HAL_GetTick(), module, level);
+	vfprintf(stderr, fmt, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+}
+
+void Sim::Log::Enable(bool enable) {
+	enabled = enable;
+}
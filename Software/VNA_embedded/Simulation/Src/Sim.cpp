@@ -0,0 +1,164 @@
+#include "Sim.hpp"
+
+#include <chrono>
+#include <map>
+#include <vector>
+
+static uint64_t now = 0;
+static bool inInterrupt = false;
+
+static std::multimap<uint64_t, Sim::Event> events;
+
+using DispatchCallback = void(*)(void);
+// same depth as the callback FIFO in stm.cpp
+static constexpr uint8_t MaxDispatched = 9;
+static std::vector<DispatchCallback> dispatched;
+
+static Sim::Profile::Entry profile[(int) Sim::Profile::Context::Last];
+static std::vector<uint64_t> nestedNs;
+
+SCB_Type SimSCB;
+
+static uint64_t HostNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void EnterInterrupt() {
+	inInterrupt = true;
+	SCB->ICSR = 1;
+}
+
+static void LeaveInterrupt() {
+	inInterrupt = false;
+	SCB->ICSR = 0;
+}
+
+static void RunDispatched() {
+	// the software interrupt has the lowest priority, it runs once all other interrupts are done
+	while (!dispatched.empty()) {
+		auto cb = dispatched.front();
+		dispatched.erase(dispatched.begin());
+		EnterInterrupt();
+		{
+			Sim::Profile::Scope p(Sim::Profile::Context::DispatchedInterrupt);
+			cb();
+		}
+		LeaveInterrupt();
+	}
+}
+
+static void RunEvent(uint64_t due, const Sim::Event &e) {
+	auto &entry = profile[(int) Sim::Profile::Context::FPGAInterrupt];
+	if (now - due > entry.maxLatencyNs) {
+		entry.maxLatencyNs = now - due;
+	}
+	EnterInterrupt();
+	{
+		Sim::Profile::Scope p(Sim::Profile::Context::FPGAInterrupt);
+		e();
+	}
+	LeaveInterrupt();
+	RunDispatched();
+}
+
+// Executes the next event if it is due before the limit, returns false if there is none
+static bool RunNext(uint64_t limit) {
+	if (events.empty() || events.begin()->first > limit) {
+		return false;
+	}
+	auto it = events.begin();
+	uint64_t due = it->first;
+	auto e = it->second;
+	events.erase(it);
+	if (due > now) {
+		now = due;
+	}
+	RunEvent(due, e);
+	return true;
+}
+
+uint64_t Sim::Now() {
+	return now;
+}
+
+void Sim::Schedule(uint64_t at, Event e) {
+	events.insert(std::make_pair(at, e));
+}
+
+void Sim::Advance(uint64_t ns) {
+	uint64_t target = now + ns;
+	if (!inInterrupt) {
+		RunDispatched();
+		while (RunNext(target));
+	}
+	// interrupts may have spent virtual time on their own
+	if (now < target) {
+		now = target;
+	}
+}
+
+bool Sim::RunUntil(uint64_t limit, bool (*condition)()) {
+	RunDispatched();
+	while (!condition()) {
+		if (!RunNext(limit)) {
+			if (now < limit) {
+				now = limit;
+			}
+			return condition();
+		}
+	}
+	return true;
+}
+
+bool Sim::InInterrupt() {
+	return inInterrupt;
+}
+
+bool Sim::Dispatch(void (*cb)(void)) {
+	if (dispatched.size() >= MaxDispatched) {
+		return false;
+	}
+	dispatched.push_back(cb);
+	return true;
+}
+
+const Sim::Profile::Entry& Sim::Profile::Get(Context c) {
+	return profile[(int) c];
+}
+
+void Sim::Profile::Reset() {
+	for (auto &e : profile) {
+		e = {};
+	}
+}
+
+const char* Sim::Profile::Name(Context c) {
+	switch (c) {
+	case Context::FPGAInterrupt: return "FPGA interrupts";
+	case Context::DispatchedInterrupt: return "Dispatched work";
+	case Context::Thread: return "Thread";
+	default: return "Unknown";
+	}
+}
+
+Sim::Profile::Scope::Scope(Context c)
+	: context(c), start(HostNs()) {
+	nestedNs.push_back(0);
+}
+
+Sim::Profile::Scope::~Scope() {
+	uint64_t total = HostNs() - start;
+	// time spent in nested scopes is accounted for in their own context
+	uint64_t self = total - nestedNs.back();
+	nestedNs.pop_back();
+	if (!nestedNs.empty()) {
+		nestedNs.back() += total;
+	}
+	auto &e = profile[(int) context];
+	e.count++;
+	e.totalNs += self;
+	if (self > e.maxNs) {
+		e.maxNs = self;
+	}
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "stm32g4xx_hal.h"
+
+/*
+ * Host simulation of the VNA hardware. All simulated activity is driven by a virtual clock:
+ * SPI/I2C transfers and delays advance it, the simulated chips schedule events (e.g. the FPGA
+ * finishing a measurement) which are executed as interrupts once the virtual clock reaches them.
+ * The CPU time of the firmware itself is not part of the virtual clock, it is measured separately
+ * with the host clock and reported as the profiling result.
+ */
+namespace Sim {
+
+using Event = std::function<void()>;
+
+// virtual time in nanoseconds
+uint64_t Now();
+void Schedule(uint64_t at, Event e);
+// Advances the virtual clock. From thread context, events that become due in the meantime are
+// executed as interrupts. Interrupts do not nest: in interrupt context only the clock advances.
+void Advance(uint64_t ns);
+// Runs events until the condition is met or the virtual clock reaches the limit, returns the condition
+bool RunUntil(uint64_t limit, bool (*condition)());
+bool InInterrupt();
+// Queues a function for the low priority software interrupt (STM::DispatchToInterrupt)
+bool Dispatch(void (*cb)(void));
+
+namespace Profile {
+
+enum class Context {
+	FPGAInterrupt,
+	DispatchedInterrupt,
+	Thread,
+	Last,
+};
+
+struct Entry {
+	uint32_t count;
+	uint64_t totalNs;
+	uint64_t maxNs;
+	// largest delay between the time an interrupt became due and its execution
+	uint64_t maxLatencyNs;
+};
+
+const Entry& Get(Context c);
+void Reset();
+const char *Name(Context c);
+
+// Measures the host CPU time of a code section
+class Scope {
+public:
+	Scope(Context c);
+	~Scope();
+private:
+	Context context;
+	uint64_t start;
+};
+
+}
+
+namespace GPIO {
+
+// called by the BSRR register of the simulated GPIO ports
+void Changed(GPIO_TypeDef *port, uint32_t oldODR, uint32_t newODR);
+// Drives an input, rising/falling edges trigger the EXTI callbacks (call from interrupt context only)
+void SetInput(GPIO_TypeDef *port, uint16_t pin, bool high);
+void ExtiEdge(GPIO_TypeDef *port, uint16_t pin, bool rising);
+
+}
+
+namespace SPI {
+
+// Simulated chips on the FPGA SPI bus, selected through the chip select and FPGA AUX pins
+void Transfer(SPI_HandleTypeDef *hspi, const uint8_t *tx, uint8_t *rx, uint16_t len);
+uint64_t TransferTimeNs(SPI_HandleTypeDef *hspi, uint16_t len);
+
+}
+
+namespace FPGA {
+
+void Reset();
+// Chip select of the FPGA, frames are processed when CS is released
+void Select(bool selected);
+void Data(const uint8_t *tx, uint8_t *rx, uint16_t len);
+// AUX3 starts/aborts the sweep
+void SweepControl(bool high);
+
+struct Stats {
+	uint32_t points;
+	uint32_t halts;
+	uint32_t overruns;
+	uint32_t sweepsStarted;
+};
+const Stats& GetStats();
+
+}
+
+namespace PLL {
+
+enum class Chip {
+	Source,
+	LO1,
+};
+void Data(Chip c, const uint8_t *tx, uint8_t *rx, uint16_t len);
+void Latch(Chip c);
+
+}
+
+namespace Si5351 {
+
+void Write(uint8_t reg, const uint8_t *data, uint16_t len);
+void Read(uint8_t reg, uint8_t *data, uint16_t len);
+
+}
+
+namespace Log {
+
+void Enable(bool enable);
+
+}
+
+namespace USB {
+
+void Reset();
+// Moves the data that has been transferred to the host up to the current virtual time into buf
+uint32_t Receive(uint8_t *buf, uint32_t maxlen);
+struct Stats {
+	uint32_t maxFifoLevel;
+	uint32_t rejectedPackets;
+	uint64_t bytes;
+};
+const Stats& GetStats();
+
+}
+
+}
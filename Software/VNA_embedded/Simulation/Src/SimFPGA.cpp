@@ -0,0 +1,319 @@
+#include "Sim.hpp"
+
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include "main.h"
+#include "Hardware.hpp"
+#include "FPGA/FPGA.hpp"
+
+/*
+ * Model of the FPGA as seen over its SPI interface: register writes, the sweep table, status/result
+ * reads and the sweep state machine. Measurement results are generated from a simple DUT model
+ * (reflection/transmission with a delay) instead of sampled signals.
+ */
+
+using TableEntry = struct {
+	bool halt;
+	bool lowband;
+	uint8_t settling;
+	uint8_t samples;
+	uint64_t frequency;
+};
+
+static uint16_t regs[16];
+static TableEntry table[8192];
+
+static std::vector<uint8_t> frame;
+static std::vector<uint8_t> response;
+static bool selected = false;
+
+static constexpr uint16_t StatusNewData = (uint16_t) FPGA::Interrupt::NewData;
+static constexpr uint16_t StatusOverrun = (uint16_t) FPGA::Interrupt::DataOverrun;
+static constexpr uint16_t StatusHalted = (uint16_t) FPGA::Interrupt::SweepHalted;
+static uint16_t status;
+// status flags contained in the currently read result
+static uint16_t reportedStatus;
+static FPGA::SamplingResult result;
+
+static bool sweepLine = false;
+static bool sweepRunning = false;
+static bool waitingForResume = false;
+// incremented on every start/abort, events of an old sweep are ignored
+static uint32_t generation = 0;
+static uint16_t point;
+static uint8_t stage;
+static uint32_t noise = 12345;
+
+static Sim::FPGA::Stats stats;
+
+static constexpr uint16_t SettlingTimesUs[] = {20, 60, 180, 540};
+static constexpr uint32_t SampleCounts[] = {0, 96, 304, 912, 3040, 9136, 30464, 91392};
+// ADC clock before the prescaler
+static constexpr uint64_t ADCBaseClock = 102400000;
+
+static bool Enabled(FPGA::Periphery p) {
+	return regs[(int) FPGA::Reg::SystemControl] & (uint16_t) p;
+}
+
+static uint32_t Samples(const TableEntry &e) {
+	if (e.samples == (uint8_t) FPGA::Samples::SPPRegister) {
+		return (uint32_t) regs[(int) FPGA::Reg::SamplesPerPoint] * 16;
+	}
+	return SampleCounts[e.samples];
+}
+
+static uint64_t MeasurementTimeNs(const TableEntry &e) {
+	uint32_t prescaler = regs[(int) FPGA::Reg::ADCPrescaler];
+	if (!prescaler) {
+		prescaler = 128;
+	}
+	return SettlingTimesUs[e.settling] * 1000ULL + Samples(e) * prescaler * 1000000000ULL / ADCBaseClock;
+}
+
+static int32_t Noise(uint32_t samples) {
+	noise = noise * 1103515245 + 12345;
+	int32_t amplitude = 20 * sqrt(samples) + 1;
+	return (int32_t) ((noise >> 8) % (2 * amplitude)) - amplitude;
+}
+
+static void CalculateResult(const TableEntry &e, bool port1) {
+	double f = e.frequency;
+	auto delay = [f](double magnitude, double ns) {
+		return std::polar(magnitude, -2 * M_PI * f * ns * 1e-9);
+	};
+	// DUT: two-port with mismatched ports and a short line in between
+	auto S11 = delay(0.2, 1.0);
+	auto S21 = delay(0.7, 2.0);
+	auto S22 = delay(0.3, 0.5);
+	uint32_t samples = Samples(e);
+	// the phase of the reference mixer output changes from point to point
+	auto ref = std::polar(4000.0 * samples, 2 * M_PI * (point % 17) / 17);
+	auto p1 = (port1 ? S11 : S21) * ref;
+	auto p2 = (port1 ? S21 : S22) * ref;
+	result.RefI = ref.real() + Noise(samples);
+	result.RefQ = ref.imag() + Noise(samples);
+	result.P1I = p1.real() + Noise(samples);
+	result.P1Q = p1.imag() + Noise(samples);
+	result.P2I = p2.real() + Noise(samples);
+	result.P2Q = p2.imag() + Noise(samples);
+}
+
+static void RaiseInterrupt(uint16_t flags) {
+	if ((status & StatusNewData) && (flags & StatusNewData)) {
+		// previous result has not been read yet
+		status |= StatusOverrun;
+		stats.overruns++;
+	}
+	status |= flags;
+	if (status & regs[(int) FPGA::Reg::InterruptMask]) {
+		Sim::GPIO::SetInput(FPGA_INTR_GPIO_Port, FPGA_INTR_Pin, true);
+	}
+}
+
+static void NextStage(uint32_t gen);
+
+static void ScheduleStage() {
+	auto &e = table[point];
+	uint32_t gen = generation;
+	Sim::Schedule(Sim::Now() + MeasurementTimeNs(e), [gen]() {
+		NextStage(gen);
+	});
+}
+
+static void StartPoint() {
+	if (table[point].halt) {
+		waitingForResume = true;
+		stats.halts++;
+		// may be called from thread context (start of sweep), the interrupt is always raised from an event
+		uint32_t gen = generation;
+		Sim::Schedule(Sim::Now() + 1000, [gen]() {
+			if (gen == generation) {
+				RaiseInterrupt(StatusHalted);
+			}
+		});
+	} else {
+		stage = 0;
+		ScheduleStage();
+	}
+}
+
+static void NextStage(uint32_t gen) {
+	if (gen != generation || !sweepRunning) {
+		return;
+	}
+	bool port1 = Enabled(FPGA::Periphery::ExcitePort1);
+	bool port2 = Enabled(FPGA::Periphery::ExcitePort2);
+	bool excitingPort1 = port1 && stage == 0;
+	CalculateResult(table[point], excitingPort1);
+	RaiseInterrupt(StatusNewData);
+	stage++;
+	if (port1 && port2 && stage < 2) {
+		// second stage of this point with the other port excited
+		ScheduleStage();
+		return;
+	}
+	stats.points++;
+	if (point >= regs[(int) FPGA::Reg::SweepPoints]) {
+		// end of sweep, waiting for the next start
+		sweepRunning = false;
+		return;
+	}
+	point++;
+	StartPoint();
+}
+
+static void WriteSweepConfig(const uint8_t *data) {
+	uint16_t words[7];
+	for (uint8_t i = 0; i < 7; i++) {
+		words[i] = (uint16_t) data[2 * i] << 8 | data[2 * i + 1];
+	}
+	auto &e = table[words[0] & 0x1FFF];
+	e.halt = words[1] & 0x8000;
+	e.settling = (words[1] >> 13) & 0x03;
+	e.samples = (words[1] >> 10) & 0x07;
+	e.lowband = words[4] & 0x8000;
+	// the measured frequency is derived from the 1.LO
+	uint16_t LO_M = (words[1] & 0xFF) << 4 | words[2] >> 12;
+	uint16_t LO_FRAC = words[2] & 0x0FFF;
+	uint16_t LO_N = words[3] & 0x7F;
+	uint16_t LO_DIV = words[3] >> 13;
+	double fLO = (double) HW::PLLRef * (LO_N + (LO_M ? (double) LO_FRAC / LO_M : 0.0)) / (1 << LO_DIV);
+	e.frequency = fLO > HW::IF1 ? fLO - HW::IF1 : 0;
+}
+
+static void PrepareResponse(uint8_t cmd) {
+	response.clear();
+	auto word = [](uint16_t w) {
+		response.push_back(w >> 8);
+		response.push_back(w & 0xFF);
+	};
+	switch (cmd & 0xE0) {
+	case 0x40:
+		// status and the fixed identification value
+		word(status);
+		word(0xF0A5);
+		break;
+	case 0xC0: {
+		reportedStatus = status;
+		word(status);
+		const int64_t values[6] = {result.RefQ, result.RefI, result.P2Q, result.P2I, result.P1Q, result.P1I};
+		for (auto v : values) {
+			// 48 bit values, least significant word first
+			word(v & 0xFFFF);
+			word((v >> 16) & 0xFFFF);
+			word((v >> 32) & 0xFFFF);
+		}
+	}
+		break;
+	case 0xE0: {
+		// ADC limits follow the command word
+		word(0);
+		int16_t peakRef = 12000;
+		int16_t peakPort = 6000;
+		const int16_t limits[6] = {(int16_t) -peakPort, peakPort, (int16_t) -peakPort, peakPort, (int16_t) -peakRef,
+				peakRef};
+		for (auto l : limits) {
+			word(l);
+		}
+	}
+		break;
+	default:
+		break;
+	}
+}
+
+static void ProcessFrame() {
+	if (frame.size() < 2) {
+		return;
+	}
+	uint8_t cmd = frame[0];
+	if (cmd < 0x20) {
+		if (frame.size() >= 14) {
+			WriteSweepConfig(frame.data());
+		}
+		return;
+	}
+	switch (cmd & 0xE0) {
+	case 0x20:
+		if (waitingForResume) {
+			waitingForResume = false;
+			stage = 0;
+			ScheduleStage();
+		}
+		break;
+	case 0x80:
+		if (frame.size() >= 4) {
+			regs[frame[1] & 0x0F] = (uint16_t) frame[2] << 8 | frame[3];
+		}
+		break;
+	case 0xC0:
+		// reading the results acknowledges the reported interrupts
+		status &= ~reportedStatus;
+		Sim::GPIO::SetInput(FPGA_INTR_GPIO_Port, FPGA_INTR_Pin, false);
+		if (status & regs[(int) FPGA::Reg::InterruptMask]) {
+			// flags set during the read, generate a new edge
+			Sim::Schedule(Sim::Now() + 100, []() {
+				RaiseInterrupt(0);
+			});
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void Sim::FPGA::Reset() {
+	for (auto &r : regs) {
+		r = 0;
+	}
+	status = 0;
+	sweepRunning = false;
+	waitingForResume = false;
+	generation++;
+	stats = {};
+}
+
+void Sim::FPGA::Select(bool select) {
+	if (select) {
+		frame.clear();
+		response.clear();
+	} else if (selected) {
+		ProcessFrame();
+	}
+	selected = select;
+}
+
+void Sim::FPGA::Data(const uint8_t *tx, uint8_t *rx, uint16_t len) {
+	for (uint16_t i = 0; i < len; i++) {
+		if (frame.empty() && tx) {
+			PrepareResponse(tx[0]);
+		}
+		if (rx) {
+			rx[i] = frame.size() < response.size() ? response[frame.size()] : 0;
+		}
+		frame.push_back(tx ? tx[i] : 0);
+	}
+}
+
+void Sim::FPGA::SweepControl(bool high) {
+	if (high && !sweepLine) {
+		// rising edge starts the sweep at the first point
+		generation++;
+		sweepRunning = true;
+		waitingForResume = false;
+		point = 0;
+		stats.sweepsStarted++;
+		StartPoint();
+	} else if (!high) {
+		generation++;
+		sweepRunning = false;
+		waitingForResume = false;
+	}
+	sweepLine = high;
+}
+
+const Sim::FPGA::Stats& Sim::FPGA::GetStats() {
+	return stats;
+}
@@ -0,0 +1,56 @@
+#include "Sim.hpp"
+
+#include "Hardware.hpp"
+
+// MAX2871 model: shifts in 32 bit words, latches them on the rising LE edge and supports the register 6 readback
+using PLLState = struct {
+	uint32_t shift;
+	uint32_t regs[7];
+	bool readback;
+};
+
+static PLLState plls[2];
+
+static uint32_t Readback(const PLLState &p) {
+	// assume the reference configuration used by the firmware (R = 1, no doubler)
+	uint32_t N = (p.regs[0] & 0x7FFF8000) >> 15;
+	uint32_t FRAC = (p.regs[0] & 0x00007FF8) >> 3;
+	uint32_t M = (p.regs[1] & 0x00007FF8) >> 3;
+	double fVCO = (double) HW::PLLRef * (N + (M ? (double) FRAC / M : 0.0));
+	// 64 VCOs evenly spread across 3-6GHz
+	int vco = (fVCO - 3e9) / (3e9 / 64);
+	if (vco < 0) {
+		vco = 0;
+	} else if (vco > 63) {
+		vco = 63;
+	}
+	// ADC reading of approximately 40°C
+	constexpr uint32_t tempADC = 48;
+	// the firmware shifts the received word left by two bits
+	return (uint32_t) vco << 1 | tempADC << 14;
+}
+
+void Sim::PLL::Data(Chip c, const uint8_t *tx, uint8_t *rx, uint16_t len) {
+	auto &p = plls[(int) c];
+	uint32_t out = p.readback ? Readback(p) : 0;
+	for (uint16_t i = 0; i < len; i++) {
+		if (tx) {
+			p.shift = p.shift << 8 | tx[i];
+		}
+		if (rx) {
+			rx[i] = len == 4 ? out >> (24 - 8 * i) : 0;
+		}
+	}
+	p.readback = false;
+}
+
+void Sim::PLL::Latch(Chip c) {
+	auto &p = plls[(int) c];
+	uint8_t reg = p.shift & 0x07;
+	if (reg == 6) {
+		// next transfer shifts out the readback value
+		p.readback = true;
+	} else {
+		p.regs[reg] = p.shift;
+	}
+}
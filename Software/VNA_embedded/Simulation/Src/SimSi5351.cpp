@@ -0,0 +1,18 @@
+#include "Sim.hpp"
+
+// Si5351C model: plain register file, PLLs are always locked and the external clock always present
+static uint8_t regs[256];
+
+void Sim::Si5351::Write(uint8_t reg, const uint8_t *data, uint16_t len) {
+	while (len--) {
+		regs[reg++] = *data++;
+	}
+}
+
+void Sim::Si5351::Read(uint8_t reg, uint8_t *data, uint16_t len) {
+	while (len--) {
+		// device status: no loss of lock/signal flags set
+		*data++ = reg == 0 ? 0x00 : regs[reg];
+		reg++;
+	}
+}
@@ -0,0 +1,10 @@
+#include "delay.hpp"
+
+#include "Sim.hpp"
+
+void Delay::ms(uint32_t t) {
+	Sim::Advance((uint64_t) t * 1000000ULL);
+}
+void Delay::us(uint32_t t) {
+	Sim::Advance((uint64_t) t * 1000ULL);
+}
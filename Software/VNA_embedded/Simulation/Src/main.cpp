@@ -0,0 +1,417 @@
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <vector>
+
+#include "Sim.hpp"
+#include "stm.hpp"
+#include "main.h"
+#include "Exti.hpp"
+#include "Communication.h"
+#include "Hardware.hpp"
+#include "VNA.hpp"
+#include "SpectrumAnalyzer.hpp"
+#include "Generator.hpp"
+#include "Profiling.hpp"
+#include "USB/usb.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+/*
+ * Host simulation harness. Takes the role of App.cpp (task loop passing data on to the USB) and of the
+ * host application: settings are encoded and fed into the firmware as if they were received over USB,
+ * everything the firmware transmits is decoded with the same protocol code the PC application uses.
+ */
+
+#define FLAG_USB_PACKET		0x01
+#define FLAG_DATAPOINT		0x02
+
+static TaskHandle_t handle;
+static Protocol::PacketInfo recv_packet, transmit_packet;
+
+using Options = struct {
+	bool spectrumAnalyzer;
+	bool generator;
+	Protocol::SweepSettings vna;
+	Protocol::SpectrumAnalyzerSettings sa;
+	Protocol::GeneratorSettings gen;
+	uint32_t dwell;
+	uint32_t sweeps;
+	bool verbose;
+};
+
+using Results = struct {
+	uint32_t packets;
+	uint32_t points;
+	uint32_t sweeps;
+	uint32_t sequenceErrors;
+	uint32_t deviceInfos;
+	uint32_t acks;
+	uint32_t expectedPoint;
+	double maxError;
+	uint64_t sweepStart;
+	uint64_t minSweepTime;
+	uint64_t maxSweepTime;
+	uint64_t totalSweepTime;
+};
+
+static Results results;
+
+static void VNACallback(const Protocol::Datapoint &res) {
+	transmit_packet.type = Protocol::PacketType::Datapoint;
+	transmit_packet.datapoint = res;
+	BaseType_t woken = false;
+	xTaskNotifyFromISR(handle, FLAG_DATAPOINT, eSetBits, &woken);
+	portYIELD_FROM_ISR(woken);
+}
+static void VNARawCallback(const Protocol::RawDatapoint &res) {
+	transmit_packet.type = Protocol::PacketType::RawDatapoint;
+	transmit_packet.rawDatapoint = res;
+	BaseType_t woken = false;
+	xTaskNotifyFromISR(handle, FLAG_DATAPOINT, eSetBits, &woken);
+	portYIELD_FROM_ISR(woken);
+}
+static void USBPacketReceived(const Protocol::PacketInfo &p) {
+	recv_packet = p;
+	BaseType_t woken = false;
+	xTaskNotifyFromISR(handle, FLAG_USB_PACKET, eSetBits, &woken);
+	portYIELD_FROM_ISR(woken);
+}
+
+// Sends a packet to the firmware, received data is handled in the USB interrupt
+static void HostSend(const Protocol::PacketInfo &p) {
+	static uint8_t buf[1024];
+	uint16_t len = Protocol::EncodePacket(p, buf, sizeof(buf));
+	Sim::Schedule(Sim::Now(), [len]() {
+		communication_usb_input(buf, len);
+	});
+}
+
+static void PointReceived(uint32_t pointNum, uint32_t points) {
+	results.points++;
+	if (pointNum != results.expectedPoint) {
+		results.sequenceErrors++;
+	}
+	if (pointNum == 0) {
+		results.sweepStart = Sim::Now();
+	}
+	results.expectedPoint = pointNum + 1;
+	if (pointNum == points - 1) {
+		results.expectedPoint = 0;
+		results.sweeps++;
+		uint64_t time = Sim::Now() - results.sweepStart;
+		if (results.sweeps > 1) {
+			// the first sweep also includes the setup time
+			if (!results.minSweepTime || time < results.minSweepTime) {
+				results.minSweepTime = time;
+			}
+			if (time > results.maxSweepTime) {
+				results.maxSweepTime = time;
+			}
+			results.totalSweepTime += time;
+		}
+	}
+}
+
+static void CheckDatapoint(const Protocol::Datapoint &d) {
+	// compare with the DUT model of the simulated FPGA (S11 only, the other parameters use the same path)
+	double f = d.frequency;
+	auto expected = std::polar(0.2, -2 * M_PI * f * 1e-9);
+	auto S11 = std::complex<double>(d.real_S11, d.imag_S11);
+	double error = std::abs(S11 - expected);
+	if (error > results.maxError) {
+		results.maxError = error;
+	}
+}
+
+// Same handling as the PC application: decode everything that arrived at the host
+static void HostReceive(const Options &o) {
+	static uint8_t buf[65536];
+	static uint16_t level = 0;
+	level += Sim::USB::Receive(&buf[level], sizeof(buf) - level);
+	Protocol::PacketInfo packet;
+	uint16_t handled;
+	do {
+		handled = Protocol::DecodeBuffer(buf, level, &packet);
+		memmove(buf, &buf[handled], level - handled);
+		level -= handled;
+		if (packet.type == Protocol::PacketType::None) {
+			continue;
+		}
+		results.packets++;
+		uint8_t decimation = o.vna.decimation > 1 ? o.vna.decimation : 1;
+		uint32_t vnaPoints = (o.vna.points + decimation - 1) / decimation;
+		switch (packet.type) {
+		case Protocol::PacketType::Datapoint:
+			CheckDatapoint(packet.datapoint);
+			PointReceived(packet.datapoint.pointNum, vnaPoints);
+			break;
+		case Protocol::PacketType::RawDatapoint:
+			PointReceived(packet.rawDatapoint.pointNum, vnaPoints);
+			break;
+		case Protocol::PacketType::SpectrumAnalyzerResult:
+			PointReceived(packet.spectrumResult.pointNum, o.sa.pointNum);
+			break;
+		case Protocol::PacketType::GeneratorStep:
+			PointReceived(packet.generatorStep.entry, o.gen.listEntries);
+			break;
+		case Protocol::PacketType::DeviceInfo:
+			results.deviceInfos++;
+			break;
+		case Protocol::PacketType::Ack:
+			results.acks++;
+			break;
+		default:
+			break;
+		}
+	} while (handled > 0);
+}
+
+static void Usage(const char *name) {
+	printf("Usage: %s [options]\n"
+			"  -s            spectrum analyzer instead of VNA sweeps\n"
+			"  -f <Hz>       start frequency\n"
+			"  -F <Hz>       stop frequency\n"
+			"  -p <points>   number of points\n"
+			"  -b <Hz>       IF bandwidth (VNA) or RBW (SA)\n"
+			"  -a <n>        averages per point\n"
+			"  -d <n>        point decimation\n"
+			"  -r            raw receiver data\n"
+			"  -1/-2         only excite port 1/port 2\n"
+			"  -z            zero span (VNA, CW at the start frequency)\n"
+			"  -P            suppress peaks by shifting the 2.LO (VNA)\n"
+			"  -l <cdbm>     power sweep at the start frequency from -10dbm to the given level (VNA)\n"
+			"  -g <entries>  generator list mode, entries spread between start and stop frequency\n"
+			"  -w <us>       dwell time of the generator list entries\n"
+			"  -i            signal ID (SA)\n"
+			"  -t <level>    fast scan with the given threshold (SA, linear result units)\n"
+			"  -n <sweeps>   number of sweeps to simulate\n"
+			"  -v            show firmware log output\n", name);
+}
+
+static bool ParseOptions(int argc, char *argv[], Options &o) {
+	memset(&o, 0, sizeof(o));
+	o.vna.f_start = 1000000;
+	o.vna.f_stop = 6000000000;
+	o.vna.points = 501;
+	o.vna.if_bandwidth = 10000;
+	o.vna.cdbm_excitation = -1000;
+	o.vna.excitePort1 = 1;
+	o.vna.excitePort2 = 1;
+	o.sa.WindowType = 1;
+	o.gen.activePort = 1;
+	o.gen.listStatus = 1;
+	o.dwell = 1000;
+	o.sweeps = 10;
+	int opt;
+	while ((opt = getopt(argc, argv, "sf:F:p:b:a:d:r12zPl:g:w:it:n:vh")) != -1) {
+		switch (opt) {
+		case 's': o.spectrumAnalyzer = true; break;
+		case 'f': o.vna.f_start = strtoull(optarg, nullptr, 10); break;
+		case 'F': o.vna.f_stop = strtoull(optarg, nullptr, 10); break;
+		case 'p': o.vna.points = atoi(optarg); break;
+		case 'b': o.vna.if_bandwidth = atoi(optarg); break;
+		case 'a': o.vna.averages = atoi(optarg); break;
+		case 'd': o.vna.decimation = atoi(optarg); break;
+		case 'r': o.vna.rawData = 1; break;
+		case '1': o.vna.excitePort2 = 0; break;
+		case '2': o.vna.excitePort1 = 0; break;
+		case 'z': o.vna.zeroSpan = 1; break;
+		case 'P': o.vna.suppressPeaks = 1; break;
+		case 'l':
+			o.vna.powerSweep = 1;
+			o.vna.cdbm_excitation_stop = atoi(optarg);
+			break;
+		case 'g':
+			o.generator = true;
+			o.gen.listEntries = atoi(optarg);
+			break;
+		case 'w': o.dwell = atoi(optarg); break;
+		case 'i': o.sa.SignalID = 1; break;
+		case 't':
+			o.sa.FastScan = 1;
+			o.sa.FastScanThreshold = atof(optarg);
+			break;
+		case 'n': o.sweeps = atoi(optarg); break;
+		case 'v': o.verbose = true; break;
+		default:
+			Usage(argv[0]);
+			return false;
+		}
+	}
+	o.sa.f_start = o.vna.f_start;
+	o.sa.f_stop = o.vna.f_stop;
+	o.sa.pointNum = o.vna.points;
+	o.sa.RBW = o.vna.if_bandwidth;
+	return true;
+}
+
+static void PrintProfile(Sim::Profile::Context c, uint32_t points) {
+	auto &e = Sim::Profile::Get(c);
+	if (!e.count) {
+		return;
+	}
+	printf("%-16s %8u calls, %8.3fus avg, %8.3fus max, %8.3fus per point",
+			Sim::Profile::Name(c), e.count, e.totalNs / 1000.0 / e.count, e.maxNs / 1000.0,
+			points ? e.totalNs / 1000.0 / points : 0.0);
+	if (e.maxLatencyNs) {
+		printf(", max latency %.1fus", e.maxLatencyNs / 1000.0);
+	}
+	printf("\n");
+}
+
+// Firmware profiling sections, timed with the (host clock backed) cycle counter
+static void PrintSections() {
+	static const char *names[Protocol::ProfilingSections] = {
+		"SampleRead", "MeasurementDone", "SweepHalted", "CommSend", "USBTransmit", "VNASetup",
+	};
+	Protocol::ProfilingReport r;
+	Profiling::Report(r);
+	double usPerCycle = 1000000.0 / r.timerFrequency;
+	for (int i = 0; i < Protocol::ProfilingSections; i++) {
+		auto &s = r.sections[i];
+		if (!s.count) {
+			continue;
+		}
+		printf("%-16s %8u calls, %8.3fus avg, %8.3fus min, %8.3fus max\n", names[i], s.count,
+				s.avg * usPerCycle, s.min * usPerCycle, s.max * usPerCycle);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	Options o;
+	if (!ParseOptions(argc, argv, o)) {
+		return 1;
+	}
+	Sim::Log::Enable(o.verbose);
+
+	// initial output levels, same as the GPIO initialization in main.c
+	FPGA_CS_GPIO_Port->BSRR = FPGA_CS_Pin;
+	FLASH_CS_GPIO_Port->BSRR = FLASH_CS_Pin;
+	// MAX2871 MUX pins always indicate lock
+	GPIOA->IDR |= GPIO_PIN_6;
+	Sim::FPGA::Reset();
+
+	STM::Init();
+	Profiling::Init();
+	handle = xTaskGetCurrentTaskHandle();
+	usb_init(communication_usb_input);
+	Communication::SetCallback(USBPacketReceived);
+	Exti::Init();
+	uint64_t initStart = Sim::Now();
+	if (!HW::Init()) {
+		fprintf(stderr, "Hardware initialization failed\n");
+		return 1;
+	}
+	printf("HW::Init: %.1fms simulated\n", (Sim::Now() - initStart) / 1000000.0);
+
+	// the firmware handles one packet at a time, the next one is sent after the previous one was acknowledged
+	std::vector<Protocol::PacketInfo> hostPackets;
+	Protocol::PacketInfo p;
+	if (o.spectrumAnalyzer) {
+		p.type = Protocol::PacketType::SpectrumAnalyzerSettings;
+		p.spectrumSettings = o.sa;
+	} else if (o.generator) {
+		for (uint8_t i = 0; i < o.gen.listEntries; i++) {
+			p.type = Protocol::PacketType::GeneratorListEntry;
+			auto &e = p.generatorListEntry;
+			e.index = i;
+			e.frequency = o.vna.f_start;
+			if (o.gen.listEntries > 1) {
+				e.frequency += (o.vna.f_stop - o.vna.f_start) * i / (o.gen.listEntries - 1);
+			}
+			e.cdbm_level = o.vna.cdbm_excitation;
+			e.dwell_us = o.dwell;
+			hostPackets.push_back(p);
+		}
+		p.type = Protocol::PacketType::Generator;
+		p.generator = o.gen;
+	} else {
+		p.type = Protocol::PacketType::SweepSettings;
+		p.settings = o.vna;
+	}
+	hostPackets.push_back(p);
+	HostSend(hostPackets[0]);
+	unsigned int hostPacketsSent = 1;
+	Sim::Profile::Reset();
+
+	uint64_t setupWallNs = 0;
+	// like the firmware watchdog, only give up if no measurement completes (averaged and decimated points take longer)
+	uint64_t lastNewPoint = Sim::Now();
+	uint32_t measurementCnt = VNA::MeasurementCount();
+	auto wallStart = std::chrono::steady_clock::now();
+	while (results.sweeps < o.sweeps) {
+		uint32_t notification;
+		if (xTaskNotifyWait(0x00, UINT32_MAX, &notification, 100) == pdPASS) {
+			Sim::Profile::Scope profile(Sim::Profile::Context::Thread);
+			if (notification & FLAG_DATAPOINT) {
+				Communication::Send(transmit_packet);
+			}
+			if (notification & FLAG_USB_PACKET) {
+				auto start = std::chrono::steady_clock::now();
+				switch (recv_packet.type) {
+				case Protocol::PacketType::SweepSettings:
+					VNA::Setup(recv_packet.settings, VNACallback, VNARawCallback);
+					break;
+				case Protocol::PacketType::SpectrumAnalyzerSettings:
+					SA::Setup(recv_packet.spectrumSettings);
+					break;
+				case Protocol::PacketType::GeneratorListEntry:
+					Generator::SetListEntry(recv_packet.generatorListEntry);
+					break;
+				case Protocol::PacketType::Generator:
+					Generator::Setup(recv_packet.generator);
+					break;
+				default:
+					break;
+				}
+				setupWallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+						std::chrono::steady_clock::now() - start).count();
+				Communication::SendWithoutPayload(Protocol::PacketType::Ack);
+				lastNewPoint = Sim::Now();
+			}
+		}
+		uint32_t points = results.points;
+		HostReceive(o);
+		if (hostPacketsSent < hostPackets.size() && results.acks >= hostPacketsSent) {
+			HostSend(hostPackets[hostPacketsSent++]);
+		}
+		if (results.points != points || VNA::MeasurementCount() != measurementCnt) {
+			measurementCnt = VNA::MeasurementCount();
+			lastNewPoint = Sim::Now();
+		} else if (Sim::Now() - lastNewPoint > 1000000000ULL) {
+			fprintf(stderr, "Timed out waiting for data after %u sweeps\n", results.sweeps);
+			break;
+		}
+	}
+	double wallMs = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - wallStart).count() / 1000.0;
+
+	auto &fpga = Sim::FPGA::GetStats();
+	auto &usb = Sim::USB::GetStats();
+	printf("Setup: %.3fms host CPU time\n", setupWallNs / 1000000.0);
+	if (results.sweeps > 1) {
+		printf("Sweep time: %.2fms avg, %.2fms min, %.2fms max (simulated)\n",
+				results.totalSweepTime / 1000000.0 / (results.sweeps - 1), results.minSweepTime / 1000000.0,
+				results.maxSweepTime / 1000000.0);
+	}
+	printf("Received: %u packets, %u points, %u sweeps, %u device infos, %u sequence errors\n",
+			results.packets, results.points, results.sweeps, results.deviceInfos, results.sequenceErrors);
+	if (!o.spectrumAnalyzer && !o.generator && !o.vna.rawData && o.vna.excitePort1) {
+		printf("Max. S11 deviation from DUT model: %.2e\n", results.maxError);
+	}
+	printf("FPGA: %u measurements, %u halts, %u overruns\n", fpga.points, fpga.halts, fpga.overruns);
+	printf("USB: %lu bytes, max. FIFO level %u, %u rejected packets\n", (unsigned long) usb.bytes,
+			usb.maxFifoLevel, usb.rejectedPackets);
+	printf("Host CPU time (%.1fms wall for %.1fms simulated):\n", wallMs, Sim::Now() / 1000000.0);
+	for (int i = 0; i < (int) Sim::Profile::Context::Last; i++) {
+		PrintProfile((Sim::Profile::Context) i, results.points);
+	}
+	printf("Firmware sections:\n");
+	PrintSections();
+	return results.sequenceErrors || usb.rejectedPackets ? 2 : 0;
+}
@@ -0,0 +1,11 @@
+#include "stm.hpp"
+
+#include "Sim.hpp"
+
+// Dispatched functions are executed by the simulation once all higher priority interrupts are done
+void STM::Init() {
+}
+
+bool STM::DispatchToInterrupt(void (*cb)(void)) {
+	return Sim::Dispatch(cb);
+}
@@ -0,0 +1,95 @@
+#include "USB/usb.h"
+
+#include <cstring>
+
+#include "Sim.hpp"
+
+// Same FIFO size as the firmware, drained with the typical bulk throughput of a full speed device
+static uint8_t usb_transmit_fifo[4092];
+static uint16_t usb_transmit_read_index = 0;
+static uint16_t usb_transmit_fifo_level = 0;
+static constexpr uint64_t NsPerByte = 1000;
+static uint64_t lastDrain = 0;
+
+static uint8_t host_buffer[65536];
+static uint32_t host_level = 0;
+
+static Sim::USB::Stats stats;
+
+static void Drain() {
+	uint64_t now = Sim::Now();
+	if (usb_transmit_fifo_level == 0) {
+		lastDrain = now;
+		return;
+	}
+	uint64_t bytes = (now - lastDrain) / NsPerByte;
+	if (bytes > usb_transmit_fifo_level) {
+		bytes = usb_transmit_fifo_level;
+	}
+	if (bytes > sizeof(host_buffer) - host_level) {
+		// host is not fetching the data, stall the transfer
+		bytes = sizeof(host_buffer) - host_level;
+	}
+	lastDrain += bytes * NsPerByte;
+	while (bytes--) {
+		host_buffer[host_level++] = usb_transmit_fifo[usb_transmit_read_index];
+		usb_transmit_read_index = (usb_transmit_read_index + 1) % sizeof(usb_transmit_fifo);
+		usb_transmit_fifo_level--;
+	}
+	if (usb_transmit_fifo_level == 0) {
+		lastDrain = now;
+	}
+}
+
+void usb_init(usbd_recv_callback_t) {
+	Sim::USB::Reset();
+}
+
+bool usb_transmit(const uint8_t *data, uint16_t length) {
+	Drain();
+	if (usb_transmit_fifo_level + length > sizeof(usb_transmit_fifo)) {
+		// data won't fit, abort
+		stats.rejectedPackets++;
+		return false;
+	}
+	uint16_t write_index = (usb_transmit_read_index + usb_transmit_fifo_level) % sizeof(usb_transmit_fifo);
+	for (uint16_t i = 0; i < length; i++) {
+		usb_transmit_fifo[(write_index + i) % sizeof(usb_transmit_fifo)] = data[i];
+	}
+	usb_transmit_fifo_level += length;
+	stats.bytes += length;
+	if (usb_transmit_fifo_level > stats.maxFifoLevel) {
+		stats.maxFifoLevel = usb_transmit_fifo_level;
+	}
+	return true;
+}
+
+bool usb_log(const uint8_t*, uint16_t) {
+	return false;
+}
+
+void usb_set_log_complete_callback(usbd_log_complete_callback_t) {
+}
+
+void Sim::USB::Reset() {
+	usb_transmit_read_index = 0;
+	usb_transmit_fifo_level = 0;
+	host_level = 0;
+	lastDrain = Sim::Now();
+	stats = {};
+}
+
+uint32_t Sim::USB::Receive(uint8_t *buf, uint32_t maxlen) {
+	Drain();
+	if (maxlen > host_level) {
+		maxlen = host_level;
+	}
+	memcpy(buf, host_buffer, maxlen);
+	memmove(host_buffer, &host_buffer[maxlen], host_level - maxlen);
+	host_level -= maxlen;
+	return maxlen;
+}
+
+const Sim::USB::Stats& Sim::USB::GetStats() {
+	return stats;
+}